@@ -439,6 +439,13 @@ int main( int argc, char *argv[] )
   QObject::connect( &app, &QCoreApplication::aboutToQuit, &loader, &Loader::appAboutToQuit );
   QObject::connect( &pw, &ProjectWizard::projectCreated, &localProjectsManager, &LocalProjectsManager::addLocalProject );
   QObject::connect( ma.get(), &MerginApi::reloadProject, &loader, &Loader::reloadProject );
+  QObject::connect( &as, &AppSettings::activeProjectChanged, ma.get(), [&as, &localProjectsManager, &ma]
+  {
+    // sync of the opened project goes before other projects waiting in the sync queue
+    LocalProject project = localProjectsManager.projectFromProjectFilePath( as.activeProject() );
+    ma->syncScheduler()->setPriorityProject( project.isValid() ? project.id() : QString() );
+    ma->setOpenProject( project.isValid() ? project.id() : QString() );
+  } );
   QObject::connect( &mtm, &MapThemesModel::mapThemeChanged, &recordingLpm, &LayersProxyModel::onMapThemeChanged );
   QObject::connect( &loader, &Loader::projectReloaded, vm.get(), &VariablesManager::merginProjectChanged );
   QObject::connect( &loader, &Loader::projectWillBeReloaded, &inputProjUtils, &InputProjUtils::resetHandlers );
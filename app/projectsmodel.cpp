@@ -24,6 +24,7 @@ void ProjectsModel::initializeProjectsModel()
 
   QObject::connect( mBackend, &MerginApi::syncProjectStatusChanged, this, &ProjectsModel::onProjectSyncProgressChanged );
   QObject::connect( mBackend, &MerginApi::syncProjectFinished, this, &ProjectsModel::onProjectSyncFinished );
+  QObject::connect( mBackend->syncScheduler(), &SyncScheduler::queueChanged, this, &ProjectsModel::onProjectSyncQueueChanged );
   QObject::connect( mBackend, &MerginApi::projectDetached, this, &ProjectsModel::onProjectDetachedFromMergin );
   QObject::connect( mBackend, &MerginApi::projectAttachedToMergin, this, &ProjectsModel::onProjectAttachedToMergin );
   QObject::connect( mBackend, &MerginApi::authChanged, this, &ProjectsModel::onAuthChanged );
@@ -31,11 +32,13 @@ void ProjectsModel::initializeProjectsModel()
   if ( mModelType == ProjectModelTypes::LocalProjectsModel )
   {
     QObject::connect( mBackend, &MerginApi::listProjectsByNameFinished, this, &ProjectsModel::onListProjectsByNameFinished );
+    QObject::connect( mBackend, &MerginApi::listProjectsByNameFromCache, this, &ProjectsModel::onListProjectsByNameFromCache );
     loadLocalProjects();
   }
   else if ( mModelType != ProjectModelTypes::RecentProjectsModel )
   {
     QObject::connect( mBackend, &MerginApi::listProjectsFinished, this, &ProjectsModel::onListProjectsFinished );
+    QObject::connect( mBackend, &MerginApi::listProjectsFromCache, this, &ProjectsModel::onListProjectsFromCache );
   }
   else
   {
@@ -46,6 +49,7 @@ void ProjectsModel::initializeProjectsModel()
   QObject::connect( mLocalProjectsManager, &LocalProjectsManager::aboutToRemoveLocalProject, this, &ProjectsModel::onAboutToRemoveProject );
   QObject::connect( mLocalProjectsManager, &LocalProjectsManager::localProjectDataChanged, this, &ProjectsModel::onProjectDataChanged );
   QObject::connect( mLocalProjectsManager, &LocalProjectsManager::dataDirReloaded, this, &ProjectsModel::loadLocalProjects );
+  QObject::connect( mLocalProjectsManager->statusCache(), &ProjectStatusCache::localChangesUpdated, this, &ProjectsModel::onProjectLocalChangesUpdated );
 
   emit modelInitialized();
 }
@@ -103,8 +107,9 @@ QVariant ProjectsModel::data( const QModelIndex &index, int role ) const
       if ( !project->isMergin() ) return QVariant();
 
       // Roles only for projects that has mergin part
-      if ( role == ProjectPending ) return QVariant( project->mergin->pending );
+      if ( role == ProjectPending ) return QVariant( project->mergin->pending || projectSyncQueued( project ) );
       else if ( role == ProjectSyncProgress ) return QVariant( project->mergin->progress );
+      else if ( role == ProjectSyncQueued ) return QVariant( projectSyncQueued( project ) );
       else if ( role == ProjectRemoteError ) return QVariant( project->mergin->remoteError );
       return QVariant();
     }
@@ -134,6 +139,7 @@ QHash<int, QByteArray> ProjectsModel::roleNames() const
   roles[Roles::ProjectDescription]  = QStringLiteral( "ProjectDescription" ).toLatin1();
   roles[Roles::ProjectPending]      = QStringLiteral( "ProjectPending" ).toLatin1();
   roles[Roles::ProjectSyncProgress] = QStringLiteral( "ProjectSyncProgress" ).toLatin1();
+  roles[Roles::ProjectSyncQueued]   = QStringLiteral( "ProjectSyncQueued" ).toLatin1();
   roles[Roles::ProjectRemoteError]  = QStringLiteral( "ProjectRemoteError" ).toLatin1();
   return roles;
 }
@@ -152,6 +158,7 @@ void ProjectsModel::listProjects( const QString &searchExpression, int page )
   }
 
   mLastRequestId = mBackend->listProjects( searchExpression, modelTypeToFlag(), "", page );
+  mShowingCachedProjects = false;
 
   if ( !mLastRequestId.isEmpty() )
   {
@@ -195,6 +202,38 @@ void ProjectsModel::onListProjectsFinished( const MerginProjectsList &merginProj
     return;
   }
 
+  if ( mShowingCachedProjects && page > 1 && mCachedProjectsFirstRow < mProjects.size() )
+  {
+    // replace the cached page with the one from the server
+    beginRemoveRows( QModelIndex(), mCachedProjectsFirstRow, mProjects.size() - 1 );
+    mProjects.erase( mProjects.begin() + mCachedProjectsFirstRow, mProjects.end() );
+    endRemoveRows();
+  }
+  mShowingCachedProjects = false;
+
+  showListedProjects( merginProjects, pendingProjects, projectsCount, page );
+
+  setModelIsLoading( false );
+}
+
+void ProjectsModel::onListProjectsFromCache( const MerginProjectsList &merginProjects, Transactions pendingProjects, int projectsCount, int page, QString requestId )
+{
+  if ( mLastRequestId != requestId )
+  {
+    return;
+  }
+
+  mShowingCachedProjects = true;
+  mCachedProjectsFirstRow = page > 1 ? mProjects.size() : 0;
+
+  showListedProjects( merginProjects, pendingProjects, projectsCount, page );
+
+  // the projects are shown, it is only being checked whether they are up to date
+  setModelIsLoading( false );
+}
+
+void ProjectsModel::showListedProjects( const MerginProjectsList &merginProjects, Transactions pendingProjects, int projectsCount, int page )
+{
   if ( page == 1 )
   {
     // if we are populating first page, reset model and throw away previous projects
@@ -213,8 +252,6 @@ void ProjectsModel::onListProjectsFinished( const MerginProjectsList &merginProj
   mServerProjectsCount = projectsCount;
   mPaginatedPage = page;
   emit hasMoreProjectsChanged();
-
-  setModelIsLoading( false );
 }
 
 void ProjectsModel::onListProjectsByNameFinished( const MerginProjectsList &merginProjects, Transactions pendingProjects, QString requestId )
@@ -231,6 +268,12 @@ void ProjectsModel::onListProjectsByNameFinished( const MerginProjectsList &merg
   setModelIsLoading( false );
 }
 
+void ProjectsModel::onListProjectsByNameFromCache( const MerginProjectsList &merginProjects, Transactions pendingProjects, QString requestId )
+{
+  // the whole model gets reset again when the server replies
+  onListProjectsByNameFinished( merginProjects, pendingProjects, requestId );
+}
+
 void ProjectsModel::mergeProjects( const MerginProjectsList &merginProjects, Transactions pendingProjects, bool keepPrevious )
 {
   const LocalProjectsList localProjects = mLocalProjectsManager->projects();
@@ -262,7 +305,7 @@ void ProjectsModel::mergeProjects( const MerginProjectsList &merginProjects, Tra
           project->mergin->pending = true;
           pendingProjects.remove( project->mergin->id() );
         }
-        project->mergin->status = ProjectStatus::projectStatus( project );
+        updateProjectStatus( project );
       }
       else if ( project->local->localVersion > -1 )
       {
@@ -270,7 +313,7 @@ void ProjectsModel::mergeProjects( const MerginProjectsList &merginProjects, Tra
         project->mergin = std::unique_ptr<MerginProject>( new MerginProject() );
         project->mergin->projectName = project->local->projectName;
         project->mergin->projectNamespace = project->local->projectNamespace;
-        project->mergin->status = ProjectStatus::projectStatus( project );
+        updateProjectStatus( project );
       }
 
       mProjects << project;
@@ -288,7 +331,7 @@ void ProjectsModel::mergeProjects( const MerginProjectsList &merginProjects, Tra
       MerginApi::extractProjectName( i.key(), project->mergin->projectNamespace, project->mergin->projectName );
       project->mergin->progress = i.value().totalSize != 0 ? i.value().transferedSize / i.value().totalSize : 0;
       project->mergin->pending = true;
-      project->mergin->status = ProjectStatus::projectStatus( project );
+      updateProjectStatus( project );
 
       mProjects << project;
       ++i;
@@ -318,7 +361,7 @@ void ProjectsModel::mergeProjects( const MerginProjectsList &merginProjects, Tra
       {
         project->local = std::unique_ptr<LocalProject>( res->clone() );
       }
-      project->mergin->status = ProjectStatus::projectStatus( project );
+      updateProjectStatus( project );
 
       mProjects << project;
     }
@@ -329,7 +372,7 @@ void ProjectsModel::syncProject( const QString &projectId )
 {
   std::shared_ptr<Project> project = projectFromId( projectId );
 
-  if ( project == nullptr || !project->isMergin() || project->mergin->pending )
+  if ( project == nullptr || !project->isMergin() || project->mergin->pending || projectSyncQueued( project ) )
   {
     return;
   }
@@ -349,7 +392,7 @@ void ProjectsModel::stopProjectSync( const QString &projectId )
 {
   std::shared_ptr<Project> project = projectFromId( projectId );
 
-  if ( project == nullptr || !project->isMergin() || !project->mergin->pending )
+  if ( project == nullptr || !project->isMergin() || !( project->mergin->pending || projectSyncQueued( project ) ) )
   {
     return;
   }
@@ -380,18 +423,18 @@ void ProjectsModel::migrateProject( const QString &projectId )
 
 void ProjectsModel::onProjectSyncFinished( const QString &projectDir, const QString &projectFullName, bool successfully, int newVersion )
 {
-  Q_UNUSED( projectDir )
-
   std::shared_ptr<Project> project = projectFromId( projectFullName );
   if ( !project || !project->isMergin() )
     return;
 
   if ( successfully )
   {
+    mLocalProjectsManager->statusCache()->invalidate( projectDir );
+
     project->mergin->pending = false;
     project->mergin->progress = 0;
     project->mergin->serverVersion = newVersion;
-    project->mergin->status = ProjectStatus::projectStatus( project );
+    updateProjectStatus( project );
 
     QModelIndex ix = index( mProjects.indexOf( project ) );
     emit dataChanged( ix, ix );
@@ -407,6 +450,16 @@ void ProjectsModel::onProjectSyncFinished( const QString &projectDir, const QStr
   }
 }
 
+void ProjectsModel::onProjectSyncQueueChanged( const QString &projectFullName )
+{
+  std::shared_ptr<Project> project = projectFromId( projectFullName );
+  if ( !project || !project->isMergin() )
+    return;
+
+  QModelIndex ix = index( mProjects.indexOf( project ) );
+  emit dataChanged( ix, ix );
+}
+
 void ProjectsModel::onProjectSyncProgressChanged( const QString &projectFullName, qreal progress )
 {
   std::shared_ptr<Project> project = projectFromId( projectFullName );
@@ -428,8 +481,7 @@ void ProjectsModel::onProjectAdded( const LocalProject &project )
   {
     // add local information ~ project downloaded
     proj->local = std::unique_ptr<LocalProject>( project.clone() );
-    if ( proj->isMergin() )
-      proj->mergin->status = ProjectStatus::projectStatus( proj );
+    updateProjectStatus( proj );
 
     QModelIndex ix = index( mProjects.indexOf( proj ) );
     emit dataChanged( ix, ix );
@@ -467,8 +519,7 @@ void ProjectsModel::onAboutToRemoveProject( const LocalProject project )
       // just remove local part
       proj->local.reset();
 
-      if ( proj->isMergin() )
-        proj->mergin->status = ProjectStatus::projectStatus( proj );
+      updateProjectStatus( proj );
 
       QModelIndex ix = index( mProjects.indexOf( proj ) );
       emit dataChanged( ix, ix );
@@ -483,8 +534,7 @@ void ProjectsModel::onProjectDataChanged( const LocalProject &project )
   if ( proj )
   {
     proj->local = std::unique_ptr<LocalProject>( project.clone() );
-    if ( proj->isMergin() )
-      proj->mergin->status = ProjectStatus::projectStatus( proj );
+    updateProjectStatus( proj );
 
     QModelIndex editIndex = index( mProjects.indexOf( proj ) );
 
@@ -492,6 +542,23 @@ void ProjectsModel::onProjectDataChanged( const LocalProject &project )
   }
 }
 
+void ProjectsModel::onProjectLocalChangesUpdated( const QString &projectDir, bool modified )
+{
+  Q_UNUSED( modified )
+
+  for ( int i = 0; i < mProjects.size(); ++i )
+  {
+    const std::shared_ptr<Project> &project = mProjects.at( i );
+    if ( !project->isLocal() || project->local->projectDir != projectDir )
+      continue;
+
+    updateProjectStatus( project );
+
+    QModelIndex ix = index( i );
+    emit dataChanged( ix, ix, { ProjectSyncStatus } );
+  }
+}
+
 void ProjectsModel::onProjectDetachedFromMergin( const QString &projectFullName )
 {
   std::shared_ptr<Project> proj = projectFromId( projectFullName );
@@ -555,6 +622,24 @@ void ProjectsModel::setModelType( ProjectsModel::ProjectModelTypes modelType )
   initializeProjectsModel();
 }
 
+void ProjectsModel::updateProjectStatus( const std::shared_ptr<Project> &project )
+{
+  if ( !project->isMergin() )
+    return;
+
+  // local changes are checked in background, the status gets updated once they are known
+  bool modified = false;
+  if ( project->isLocal() && project->local->localVersion >= 0 )
+    modified = mLocalProjectsManager->statusCache()->hasLocalChanges( project->local->projectDir );
+
+  project->mergin->status = ProjectStatus::projectStatus( project, modified );
+}
+
+bool ProjectsModel::projectSyncQueued( const std::shared_ptr<Project> &project ) const
+{
+  return project->isMergin() && mBackend->syncScheduler()->isQueued( project->mergin->id() );
+}
+
 QString ProjectsModel::modelTypeToFlag() const
 {
   switch ( mModelType )
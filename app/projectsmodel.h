@@ -59,6 +59,7 @@ class ProjectsModel : public QAbstractListModel
       ProjectIsValid,
       ProjectSyncStatus,
       ProjectSyncProgress,
+      ProjectSyncQueued,  //!< sync has been requested, but the project waits for other projects to finish syncing
       ProjectRemoteError
     };
     Q_ENUM( Roles )
@@ -145,8 +146,11 @@ class ProjectsModel : public QAbstractListModel
     // MerginAPI - backend signals
     void onListProjectsFinished( const MerginProjectsList &merginProjects, Transactions pendingProjects, int projectsCount, int page, QString requestId );
     void onListProjectsByNameFinished( const MerginProjectsList &merginProjects, Transactions pendingProjects, QString requestId );
+    void onListProjectsFromCache( const MerginProjectsList &merginProjects, Transactions pendingProjects, int projectsCount, int page, QString requestId );
+    void onListProjectsByNameFromCache( const MerginProjectsList &merginProjects, Transactions pendingProjects, QString requestId );
     void onProjectSyncFinished( const QString &projectDir, const QString &projectFullName, bool successfully, int newVersion );
     void onProjectSyncProgressChanged( const QString &projectFullName, qreal progress );
+    void onProjectSyncQueueChanged( const QString &projectFullName );
     void onProjectDetachedFromMergin( const QString &projectFullName );
     void onProjectAttachedToMergin( const QString &projectFullName );
     void onAuthChanged(); // when user logs out
@@ -156,6 +160,9 @@ class ProjectsModel : public QAbstractListModel
     void onAboutToRemoveProject( const LocalProject project );
     void onProjectDataChanged( const LocalProject &project );
 
+    // ProjectStatusCache signals
+    void onProjectLocalChangesUpdated( const QString &projectDir, bool modified );
+
     void setMerginApi( MerginApi *merginApi );
     void setLocalProjectsManager( LocalProjectsManager *localProjectsManager );
     void setModelType( ProjectModelTypes modelType );
@@ -168,11 +175,18 @@ class ProjectsModel : public QAbstractListModel
 
   private:
     QString modelTypeToFlag() const;
+
+    //! Sets status of the project from its cached local changes (the change check gets started if they are not known)
+    void updateProjectStatus( const std::shared_ptr<Project> &project );
+    bool projectSyncQueued( const std::shared_ptr<Project> &project ) const;
     QStringList projectNames() const;
     void clearProjects();
     void loadLocalProjects();
     void initializeProjectsModel();
 
+    //! Shows listed projects - replaces the model for the first page, appends them for other pages
+    void showListedProjects( const MerginProjectsList &merginProjects, Transactions pendingProjects, int projectsCount, int page );
+
     MerginApi *mBackend = nullptr;
     LocalProjectsManager *mLocalProjectsManager = nullptr;
     QList<std::shared_ptr<Project>> mProjects;
@@ -186,6 +200,10 @@ class ProjectsModel : public QAbstractListModel
     //! For processing only my requests
     QString mLastRequestId;
 
+    //! Cached projects of the last request are shown (from this row) until the server replies
+    bool mShowingCachedProjects = false;
+    int mCachedProjectsFirstRow = 0;
+
     bool mModelIsLoading;
 };
 
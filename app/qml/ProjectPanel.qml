@@ -120,11 +120,11 @@ Item {
           hidePanel()
       }
 
+      property string changesProjectId // project whose changes are being loaded
+
       function showChanges( projectId ) {
-        if ( __merginProjectStatusModel.loadProjectInfo( projectId ) ) {
-          stackView.push( statusPanelComp )
-        }
-        else __inputUtils.showNotification( qsTr( "No Changes" ) )
+        changesProjectId = projectId
+        __merginProjectStatusModel.loadProjectInfo( projectId )
       }
 
       function refreshProjectList( keepSearchFilter = false ) {
@@ -435,6 +435,20 @@ Item {
         }
       }
 
+      Connections {
+        target: __merginProjectStatusModel
+        onProjectInfoLoaded: {
+          if ( projectFullName !== projectsPage.changesProjectId )
+            return
+
+          projectsPage.changesProjectId = ""
+          if ( hasChanges ) {
+            stackView.push( statusPanelComp )
+          }
+          else __inputUtils.showNotification( qsTr( "No Changes" ) )
+        }
+      }
+
       Connections {
         target: __merginApi
         onListProjectsFinished: stackView.pending = false
@@ -19,10 +19,24 @@ Item {
   property real rowHeight: InputStyle.rowHeight * 1.2
   signal back()
 
+  property string requestedProject // project whose changes are being loaded
+
   function open(projectFullName) {
-    if (__merginProjectStatusModel.loadProjectInfo(projectFullName)) {
-      statusPanel.visible = true;
-    } else __inputUtils.showNotification(qsTr("No Changes"))
+    requestedProject = projectFullName
+    __merginProjectStatusModel.loadProjectInfo(projectFullName)
+  }
+
+  Connections {
+    target: __merginProjectStatusModel
+    onProjectInfoLoaded: {
+      if (projectFullName !== statusPanel.requestedProject)
+        return
+
+      statusPanel.requestedProject = ""
+      if (hasChanges) {
+        statusPanel.visible = true;
+      } else __inputUtils.showNotification(qsTr("No Changes"))
+    }
   }
 
   // background
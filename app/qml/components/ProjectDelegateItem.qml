@@ -28,6 +28,7 @@ Rectangle {
   property bool projectIsValid
   property bool projectIsPending
   property real projectSyncProgress
+  property bool projectIsQueued
   property bool projectIsLocal
   property bool projectIsMergin
   property string projectRemoteError
@@ -174,9 +175,9 @@ Rectangle {
       Text {
         id: secondaryText
 
-        visible: !projectIsPending
+        visible: !projectIsPending || projectIsQueued
         height: textContainer.height/2
-        text: projectDescription
+        text: projectIsQueued ? qsTr("Waiting to synchronize") : projectDescription
         anchors.right: parent.right
         anchors.bottom: parent.bottom
         anchors.left: parent.left
@@ -197,7 +198,7 @@ Rectangle {
         height: InputStyle.fontPixelSizeSmall
         width: secondaryText.width
         value: projectSyncProgress
-        visible: projectIsPending
+        visible: projectIsPending && !projectIsQueued
 
         background: Rectangle {
           implicitWidth: parent.width
@@ -80,6 +80,7 @@ Item {
       projectIsValid: model.ProjectIsValid
       projectIsPending: model.ProjectPending ? model.ProjectPending : false
       projectSyncProgress: model.ProjectSyncProgress ? model.ProjectSyncProgress : -1
+      projectIsQueued: model.ProjectSyncQueued ? model.ProjectSyncQueued : false
       projectIsLocal: model.ProjectIsLocal
       projectIsMergin: model.ProjectIsMergin
       projectRemoteError: model.ProjectRemoteError ? model.ProjectRemoteError : ""
@@ -96,6 +96,8 @@ contains(DEFINES, INPUT_TEST) {
       test/testutils.cpp \
       test/testutilsfunctions.cpp \
       test/testmerginapi.cpp \
+      test/testmerginapimock.cpp \
+      test/mockmerginserver.cpp \
       test/testingpurchasingbackend.cpp \
       test/testpurchasing.cpp \
       test/testlinks.cpp \
@@ -107,12 +109,16 @@ contains(DEFINES, INPUT_TEST) {
       test/testscalebarkit.cpp \
       test/testvariablesmanager.cpp \
       test/testformeditors.cpp \
+      test/testbenchmarks.cpp \
+      test/testsyncbenchmarks.cpp \
 
   HEADERS += \
       test/inputtests.h \
       test/testutils.h \
       test/testutilsfunctions.h \
       test/testmerginapi.h \
+      test/testmerginapimock.h \
+      test/mockmerginserver.h \
       test/testingpurchasingbackend.h \
       test/testpurchasing.h \
       test/testpositionkit.h \
@@ -124,6 +130,8 @@ contains(DEFINES, INPUT_TEST) {
       test/testscalebarkit.h \
       test/testvariablesmanager.h \
       test/testformeditors.h \
+      test/testbenchmarks.h \
+      test/testsyncbenchmarks.h \
 }
 
 contains(DEFINES, APPLE_PURCHASING) {
@@ -13,6 +13,7 @@
 #include <QDebug>
 
 #include "test/testmerginapi.h"
+#include "test/testmerginapimock.h"
 #include "test/testlinks.h"
 #include "test/testutilsfunctions.h"
 #include "test/testattributepreviewcontroller.h"
@@ -23,6 +24,8 @@
 #include "test/testscalebarkit.h"
 #include "test/testvariablesmanager.h"
 #include "test/testformeditors.h"
+#include "test/testbenchmarks.h"
+#include "test/testsyncbenchmarks.h"
 
 #if not defined APPLE_PURCHASING
 #include "test/testpurchasing.h"
@@ -97,6 +100,11 @@ int InputTests::runTest() const
     TestMerginApi merginApiTest( mApi );
     nFailed = QTest::qExec( &merginApiTest, mTestArgs );
   }
+  else if ( mTestRequested == "--testMerginApiMock" )
+  {
+    TestMerginApiMock merginApiMockTest;
+    nFailed = QTest::qExec( &merginApiMockTest, mTestArgs );
+  }
   else if ( mTestRequested == "--testLinks" )
   {
     TestLinks linksTest( mApi, mInputUtils );
@@ -147,6 +155,16 @@ int InputTests::runTest() const
     TestFormEditors edTest;
     nFailed = QTest::qExec( &edTest, mTestArgs );
   }
+  else if ( mTestRequested == "--testBenchmarks" )
+  {
+    TestBenchmarks benchmarksTest;
+    nFailed = QTest::qExec( &benchmarksTest, mTestArgs );
+  }
+  else if ( mTestRequested == "--testSyncBenchmarks" )
+  {
+    TestSyncBenchmarks syncBenchmarksTest;
+    nFailed = QTest::qExec( &syncBenchmarksTest, mTestArgs );
+  }
 #if not defined APPLE_PURCHASING
   else if ( mTestRequested == "--testPurchasing" )
   {
@@ -0,0 +1,575 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "mockmerginserver.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QPointer>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QUrl>
+#include <QUuid>
+
+#include "httpcompression.h"
+
+MockMerginServer::MockMerginServer( QObject *parent )
+  : QObject( parent )
+{
+  connect( &mServer, &QTcpServer::newConnection, this, &MockMerginServer::onNewConnection );
+}
+
+bool MockMerginServer::listen()
+{
+  return mServer.listen( QHostAddress::LocalHost );
+}
+
+QString MockMerginServer::url() const
+{
+  return QStringLiteral( "http://127.0.0.1:%1/" ).arg( mServer.serverPort() );
+}
+
+void MockMerginServer::setProject( const QString &projectFullName, const Project &project )
+{
+  mProjects.insert( projectFullName, project );
+  clearChecksums( projectFullName );
+}
+
+MockMerginServer::Project MockMerginServer::project( const QString &projectFullName ) const
+{
+  return mProjects.value( projectFullName );
+}
+
+QByteArray MockMerginServer::projectInfo( const QString &projectFullName, int sinceVersion ) const
+{
+  Project project = mProjects.value( projectFullName );
+
+  QJsonArray files;
+  for ( auto it = project.files.constBegin(); it != project.files.constEnd(); ++it )
+  {
+    QJsonObject file;
+    file.insert( QStringLiteral( "path" ), it.key() );
+    file.insert( QStringLiteral( "size" ), it.value().size() );
+    file.insert( QStringLiteral( "checksum" ), checksum( projectFullName, it.key(), it.value() ) );
+    file.insert( QStringLiteral( "mtime" ), QDateTime::currentDateTimeUtc().toString( Qt::ISODateWithMs ) );
+
+    if ( sinceVersion > 0 && project.diffs.contains( it.key() ) )
+    {
+      QJsonObject history;
+      const QMap<int, QByteArray> diffs = project.diffs.value( it.key() );
+      for ( auto diff = diffs.lowerBound( sinceVersion ); diff != diffs.constEnd(); ++diff )
+      {
+        QJsonObject diffObj;
+        diffObj.insert( QStringLiteral( "path" ), QStringLiteral( "%1-diff-v%2" ).arg( it.key() ).arg( diff.key() ) );
+        diffObj.insert( QStringLiteral( "size" ), diff.value().size() );
+        QJsonObject versionObj;
+        versionObj.insert( QStringLiteral( "diff" ), diffObj );
+        history.insert( QStringLiteral( "v%1" ).arg( diff.key() ), versionObj );
+      }
+      file.insert( QStringLiteral( "history" ), history );
+    }
+    files.append( file );
+  }
+
+  QJsonObject info;
+  info.insert( QStringLiteral( "name" ), projectFullName.section( '/', 1 ) );
+  info.insert( QStringLiteral( "namespace" ), projectFullName.section( '/', 0, 0 ) );
+  info.insert( QStringLiteral( "version" ), QStringLiteral( "v%1" ).arg( project.version ) );
+  info.insert( QStringLiteral( "files" ), files );
+  return QJsonDocument( info ).toJson( QJsonDocument::Compact );
+}
+
+void MockMerginServer::failChunkUpload( int requestNumber, int status )
+{
+  mChunkFailures.insert( requestNumber, status );
+}
+
+void MockMerginServer::resetCounters()
+{
+  mChunkFailures.clear();
+  mPushStartCount = 0;
+  mChunkRequestCount = 0;
+  mMaxChunkRequestsInFlight = mChunkRequestsInFlight;
+  mPushFinishCount = 0;
+  mUploadedChunks.clear();
+  mCompressedChunkCount = 0;
+  mChunkBytesReceived = 0;
+  mListRequestCount = 0;
+  mNotModifiedCount = 0;
+  mDownloadRequestCount = 0;
+  mRequestCount = 0;
+  mBytesReceived = 0;
+  mBytesSent = 0;
+}
+
+void MockMerginServer::setThrottle( qint64 bytesPerSecond, int latencyMs )
+{
+  mThrottleBytesPerSecond = bytesPerSecond;
+  mThrottleLatencyMs = latencyMs;
+  mClock.start();
+  mLinkFreeAt = 0;
+}
+
+void MockMerginServer::setAcceptEncoding( const QByteArray &encodings, bool accepted )
+{
+  mAcceptEncoding = encodings;
+  mCompressionAccepted = accepted;
+}
+
+int MockMerginServer::throttleDelay( qint64 bytes )
+{
+  if ( mThrottleBytesPerSecond <= 0 )
+    return 0;
+
+  qint64 now = mClock.elapsed();
+  mLinkFreeAt = qMax( now, mLinkFreeAt ) + bytes * 1000 / mThrottleBytesPerSecond;
+  return static_cast<int>( mLinkFreeAt - now ) + mThrottleLatencyMs;
+}
+
+void MockMerginServer::onNewConnection()
+{
+  while ( QTcpSocket *socket = mServer.nextPendingConnection() )
+  {
+    connect( socket, &QTcpSocket::readyRead, this, &MockMerginServer::onReadyRead );
+    connect( socket, &QTcpSocket::disconnected, this, [this, socket]
+    {
+      mBuffers.remove( socket );
+      socket->deleteLater();
+    } );
+  }
+}
+
+void MockMerginServer::onReadyRead()
+{
+  QTcpSocket *socket = qobject_cast<QTcpSocket *>( sender() );
+  Q_ASSERT( socket );
+
+  QByteArray &buffer = mBuffers[socket];
+  buffer.append( socket->readAll() );
+
+  // there may be more requests in the buffer (or just a part of one)
+  while ( true )
+  {
+    int headerEnd = buffer.indexOf( "\r\n\r\n" );
+    if ( headerEnd < 0 )
+      return;
+
+    QList<QByteArray> lines = buffer.left( headerEnd ).split( '\n' );
+    QList<QByteArray> requestLine = lines.takeFirst().trimmed().split( ' ' );
+    if ( requestLine.count() < 2 )
+    {
+      socket->disconnectFromHost();
+      return;
+    }
+
+    Request request;
+    request.method = requestLine.at( 0 );
+    for ( const QByteArray &line : qAsConst( lines ) )
+    {
+      int colon = line.indexOf( ':' );
+      if ( colon > 0 )
+        request.headers.insert( line.left( colon ).trimmed().toLower(), line.mid( colon + 1 ).trimmed() );
+    }
+
+    int contentLength = request.headers.value( "content-length" ).toInt();
+    if ( buffer.size() < headerEnd + 4 + contentLength )
+      return;  // wait for the rest of the body
+
+    request.body = buffer.mid( headerEnd + 4, contentLength );
+    buffer.remove( 0, headerEnd + 4 + contentLength );
+    ++mRequestCount;
+    mBytesReceived += headerEnd + 4 + contentLength;
+
+    QUrl url( QString::fromUtf8( requestLine.at( 1 ) ) );
+    request.path = url.path();
+    while ( request.path.contains( QStringLiteral( "//" ) ) )  // API root is joined with paths starting with a slash
+      request.path.replace( QStringLiteral( "//" ), QStringLiteral( "/" ) );
+    request.query = QUrlQuery( url );
+
+    // a chunk upload is in flight until its response is sent (responses may be delayed)
+    bool chunkRequest = request.method == "POST" && request.path.startsWith( QStringLiteral( "/v1/project/push/chunk/" ) );
+    if ( chunkRequest )
+      mMaxChunkRequestsInFlight = qMax( mMaxChunkRequestsInFlight, ++mChunkRequestsInFlight );
+
+    Response response = handleRequest( request );
+    if ( !mAcceptEncoding.isEmpty() )
+      response.headers.insert( "Accept-Encoding", mAcceptEncoding );
+    response.delayMs += throttleDelay( request.body.size() + response.body.size() );
+    if ( chunkRequest )
+      sendResponse( socket, response, [this] { --mChunkRequestsInFlight; } );
+    else
+      sendResponse( socket, response );
+  }
+}
+
+MockMerginServer::Response MockMerginServer::handleRequest( const Request &request )
+{
+  const QString path = request.path;
+  const QString pushPrefix = QStringLiteral( "/v1/project/push/" );
+
+  if ( path == QStringLiteral( "/ping" ) )
+  {
+    QJsonObject obj;
+    obj.insert( QStringLiteral( "version" ), QStringLiteral( "2020.4.1" ) );
+    return jsonResponse( obj );
+  }
+  else if ( request.method == "POST" && path.startsWith( pushPrefix + QStringLiteral( "chunk/" ) ) )
+  {
+    QStringList parts = path.mid( pushPrefix.length() ).split( '/' );
+    if ( parts.count() == 3 )
+      return pushChunk( parts.at( 1 ), parts.at( 2 ), request );
+  }
+  else if ( request.method == "POST" && path.startsWith( pushPrefix + QStringLiteral( "finish/" ) ) )
+  {
+    return pushFinish( path.section( '/', -1 ) );
+  }
+  else if ( request.method == "POST" && path.startsWith( pushPrefix + QStringLiteral( "cancel/" ) ) )
+  {
+    return pushCancel( path.section( '/', -1 ) );
+  }
+  else if ( request.method == "POST" && path.startsWith( pushPrefix ) )
+  {
+    return pushStart( path.mid( pushPrefix.length() ), request );
+  }
+  else if ( request.method == "GET" && path == QStringLiteral( "/v1/project/paginated" ) )
+  {
+    return listProjects( request );
+  }
+  else if ( request.method == "GET" && path.startsWith( QStringLiteral( "/v1/project/raw/" ) ) )
+  {
+    return download( path.mid( QStringLiteral( "/v1/project/raw/" ).length() ), request );
+  }
+  else if ( request.method == "GET" && path.startsWith( QStringLiteral( "/v1/project/" ) ) )
+  {
+    QString projectFullName = path.mid( QStringLiteral( "/v1/project/" ).length() );
+    if ( !mProjects.contains( projectFullName ) )
+      return errorResponse( 404, QStringLiteral( "Project not found" ) );
+
+    // "since" is the first version whose history is requested
+    int sinceVersion = request.query.queryItemValue( QStringLiteral( "since" ) ).mid( 1 ).toInt();
+
+    Response response;
+    response.body = projectInfo( projectFullName, sinceVersion > 0 ? sinceVersion : -1 );
+    return response;
+  }
+
+  return errorResponse( 404, QStringLiteral( "Not found" ) );
+}
+
+MockMerginServer::Response MockMerginServer::pushStart( const QString &projectFullName, const Request &request )
+{
+  ++mPushStartCount;
+
+  if ( !mProjects.contains( projectFullName ) )
+    return errorResponse( 404, QStringLiteral( "Project not found" ) );
+
+  QJsonObject json = QJsonDocument::fromJson( request.body ).object();
+  if ( json.value( QStringLiteral( "version" ) ).toString() != QStringLiteral( "v%1" ).arg( mProjects[projectFullName].version ) )
+    return errorResponse( 400, QStringLiteral( "Version mismatch" ) );
+
+  Transaction transaction;
+  transaction.projectFullName = projectFullName;
+  transaction.changes = json.value( QStringLiteral( "changes" ) ).toObject();
+
+  QJsonArray uploaded = transaction.changes.value( QStringLiteral( "added" ) ).toArray();
+  for ( const QJsonValue &value : transaction.changes.value( QStringLiteral( "updated" ) ).toArray() )
+    uploaded.append( value );
+
+  for ( const QJsonValue &value : qAsConst( uploaded ) )
+  {
+    if ( value.toObject().contains( QStringLiteral( "diff" ) ) )
+      return errorResponse( 400, QStringLiteral( "Diff uploads are not supported" ) );
+  }
+
+  QString transactionUUID = QUuid::createUuid().toString().mid( 1, 36 );
+  mTransactions.insert( transactionUUID, transaction );
+
+  if ( uploaded.isEmpty() )
+  {
+    // only removed files - the new version is created right away
+    return pushFinish( transactionUUID );
+  }
+
+  QJsonObject obj;
+  obj.insert( QStringLiteral( "transaction" ), transactionUUID );
+  return jsonResponse( obj );
+}
+
+MockMerginServer::Response MockMerginServer::pushChunk( const QString &transactionUUID, const QString &chunkId, const Request &request )
+{
+  int requestNumber = ++mChunkRequestCount;
+  if ( mChunkFailures.contains( requestNumber ) )
+  {
+    Response response = errorResponse( mChunkFailures.value( requestNumber ), QStringLiteral( "Injected failure" ) );
+    response.delayMs = 200;
+    return response;
+  }
+
+  if ( !mTransactions.contains( transactionUUID ) )
+    return errorResponse( 404, QStringLiteral( "Transaction not found" ) );
+
+  mChunkBytesReceived += request.body.size();
+
+  QByteArray data = request.body;
+  QByteArray encoding = request.headers.value( "content-encoding" );
+  if ( !encoding.isEmpty() && encoding != "identity" )
+  {
+    if ( !mCompressionAccepted || encoding != HttpCompression::ENCODING || !HttpCompression::acceptsEncoding( mAcceptEncoding, encoding ) )
+      return errorResponse( 415, QStringLiteral( "Unsupported content encoding" ) );
+
+    data = HttpCompression::decompress( request.body, request.body.size() * 4 );
+    if ( data.isEmpty() )
+      return errorResponse( 400, QStringLiteral( "Invalid compressed data" ) );
+    ++mCompressedChunkCount;
+  }
+
+  mTransactions[transactionUUID].chunks.insert( chunkId, data );
+  mUploadedChunks << chunkId;
+
+  QJsonObject obj;
+  obj.insert( QStringLiteral( "checksum" ), QString::fromLatin1( QCryptographicHash::hash( data, QCryptographicHash::Sha1 ).toHex() ) );
+  obj.insert( QStringLiteral( "size" ), data.size() );
+  return jsonResponse( obj );
+}
+
+MockMerginServer::Response MockMerginServer::pushFinish( const QString &transactionUUID )
+{
+  ++mPushFinishCount;
+
+  if ( !mTransactions.contains( transactionUUID ) )
+    return errorResponse( 404, QStringLiteral( "Transaction not found" ) );
+
+  Transaction transaction = mTransactions.take( transactionUUID );
+  Project &project = mProjects[transaction.projectFullName];
+
+  QJsonArray uploaded = transaction.changes.value( QStringLiteral( "added" ) ).toArray();
+  for ( const QJsonValue &value : transaction.changes.value( QStringLiteral( "updated" ) ).toArray() )
+    uploaded.append( value );
+
+  QMap<QString, QByteArray> newFiles;
+  for ( const QJsonValue &value : qAsConst( uploaded ) )
+  {
+    QJsonObject file = value.toObject();
+    QByteArray content;
+    for ( const QJsonValue &chunk : file.value( QStringLiteral( "chunks" ) ).toArray() )
+    {
+      if ( !transaction.chunks.contains( chunk.toString() ) )
+        return errorResponse( 422, QStringLiteral( "Missing chunk " ) + chunk.toString() );
+      content.append( transaction.chunks.value( chunk.toString() ) );
+    }
+
+    QString checksum = QString::fromLatin1( QCryptographicHash::hash( content, QCryptographicHash::Sha1 ).toHex() );
+    if ( checksum != file.value( QStringLiteral( "checksum" ) ).toString() )
+      return errorResponse( 422, QStringLiteral( "Checksum mismatch of " ) + file.value( QStringLiteral( "path" ) ).toString() );
+
+    newFiles.insert( file.value( QStringLiteral( "path" ) ).toString(), content );
+  }
+
+  // renamed files keep their content from the server
+  QMap<QString, QString> renamedFiles;  // new path -> old path
+  for ( const QJsonValue &value : transaction.changes.value( QStringLiteral( "renamed" ) ).toArray() )
+  {
+    QJsonObject file = value.toObject();
+    QString path = file.value( QStringLiteral( "path" ) ).toString();
+    if ( !project.files.contains( path ) )
+      return errorResponse( 422, QStringLiteral( "Renamed file not found " ) + path );
+
+    QString checksum = QString::fromLatin1( QCryptographicHash::hash( project.files.value( path ), QCryptographicHash::Sha1 ).toHex() );
+    if ( checksum != file.value( QStringLiteral( "checksum" ) ).toString() )
+      return errorResponse( 422, QStringLiteral( "Checksum mismatch of " ) + path );
+
+    renamedFiles.insert( file.value( QStringLiteral( "new_path" ) ).toString(), path );
+  }
+  for ( auto it = renamedFiles.constBegin(); it != renamedFiles.constEnd(); ++it )
+  {
+    project.files.insert( it.key(), project.files.take( it.value() ) );
+    project.diffs.remove( it.value() );
+    project.diffs.remove( it.key() );
+  }
+
+  // history of diffs ends with a full upload
+  for ( const QJsonValue &value : transaction.changes.value( QStringLiteral( "removed" ) ).toArray() )
+  {
+    project.files.remove( value.toObject().value( QStringLiteral( "path" ) ).toString() );
+    project.diffs.remove( value.toObject().value( QStringLiteral( "path" ) ).toString() );
+  }
+  for ( auto it = newFiles.constBegin(); it != newFiles.constEnd(); ++it )
+  {
+    project.files.insert( it.key(), it.value() );
+    project.diffs.remove( it.key() );
+  }
+  ++project.version;
+  clearChecksums( transaction.projectFullName );
+
+  Response response;
+  response.body = projectInfo( transaction.projectFullName );
+  return response;
+}
+
+MockMerginServer::Response MockMerginServer::pushCancel( const QString &transactionUUID )
+{
+  if ( !mTransactions.remove( transactionUUID ) )
+    return errorResponse( 404, QStringLiteral( "Transaction not found" ) );
+  return jsonResponse( QJsonObject() );
+}
+
+MockMerginServer::Response MockMerginServer::listProjects( const Request &request )
+{
+  ++mListRequestCount;
+
+  int page = request.query.queryItemValue( QStringLiteral( "page" ) ).toInt();
+  int perPage = request.query.queryItemValue( QStringLiteral( "per_page" ) ).toInt();
+  if ( page < 1 || perPage < 1 )
+    return errorResponse( 400, QStringLiteral( "Invalid page" ) );
+
+  // QHash has no order - projects are listed by their full names
+  QStringList names = mProjects.keys();
+  names.sort();
+
+  QJsonArray projects;
+  for ( int i = ( page - 1 ) * perPage; i < qMin( page * perPage, names.count() ); ++i )
+  {
+    QJsonObject project;
+    project.insert( QStringLiteral( "name" ), names.at( i ).section( '/', 1 ) );
+    project.insert( QStringLiteral( "namespace" ), names.at( i ).section( '/', 0, 0 ) );
+    project.insert( QStringLiteral( "version" ), QStringLiteral( "v%1" ).arg( mProjects.value( names.at( i ) ).version ) );
+    projects.append( project );
+  }
+
+  QJsonObject obj;
+  obj.insert( QStringLiteral( "projects" ), projects );
+  obj.insert( QStringLiteral( "count" ), names.count() );
+  Response response = jsonResponse( obj );
+
+  QByteArray etag = "\"" + QCryptographicHash::hash( response.body, QCryptographicHash::Sha1 ).toHex() + "\"";
+  response.headers.insert( "ETag", etag );
+  if ( request.headers.value( "if-none-match" ) == etag )
+  {
+    ++mNotModifiedCount;
+    response.status = 304;
+    response.body.clear();
+  }
+  return response;
+}
+
+MockMerginServer::Response MockMerginServer::download( const QString &projectFullName, const Request &request )
+{
+  ++mDownloadRequestCount;
+
+  if ( !mProjects.contains( projectFullName ) )
+    return errorResponse( 404, QStringLiteral( "Project not found" ) );
+
+  // only the latest version of files is kept - older versions cannot be downloaded
+  const Project &project = mProjects[projectFullName];
+  QString filePath = request.query.queryItemValue( QStringLiteral( "file" ), QUrl::FullyDecoded );
+  int version = request.query.queryItemValue( QStringLiteral( "version" ) ).mid( 1 ).toInt();
+
+  Response response;
+  if ( request.query.queryItemValue( QStringLiteral( "diff" ) ) == QStringLiteral( "true" ) )
+  {
+    if ( !project.diffs.value( filePath ).contains( version ) )
+      return errorResponse( 404, QStringLiteral( "Diff not found" ) );
+    response.body = project.diffs.value( filePath ).value( version );
+    return response;
+  }
+
+  if ( !project.files.contains( filePath ) )
+    return errorResponse( 404, QStringLiteral( "File not found" ) );
+  if ( version != project.version )
+    return errorResponse( 404, QStringLiteral( "Version not available" ) );
+
+  const QByteArray &content = project.files[filePath];
+  QByteArray range = request.headers.value( "range" );
+  if ( range.startsWith( "bytes=" ) )
+  {
+    qint64 from = range.mid( 6 ).split( '-' ).value( 0 ).toLongLong();
+    qint64 to = qMin( range.mid( 6 ).split( '-' ).value( 1 ).toLongLong(), static_cast<qint64>( content.size() ) - 1 );
+    if ( from > to )
+      return errorResponse( 416, QStringLiteral( "Range not satisfiable" ) );
+
+    response.status = 206;
+    response.body = content.mid( static_cast<int>( from ), static_cast<int>( to - from + 1 ) );
+    response.headers.insert( "Content-Range", QStringLiteral( "bytes %1-%2/%3" ).arg( from ).arg( to ).arg( content.size() ).toLatin1() );
+    return response;
+  }
+
+  response.body = content;
+  return response;
+}
+
+QString MockMerginServer::checksum( const QString &projectFullName, const QString &filePath, const QByteArray &content ) const
+{
+  // large files are hashed once, not with every project info request
+  QString key = projectFullName + "/" + filePath;
+  auto it = mChecksums.constFind( key );
+  if ( it != mChecksums.constEnd() )
+    return *it;
+
+  QString checksum = QString::fromLatin1( QCryptographicHash::hash( content, QCryptographicHash::Sha1 ).toHex() );
+  mChecksums.insert( key, checksum );
+  return checksum;
+}
+
+void MockMerginServer::clearChecksums( const QString &projectFullName )
+{
+  for ( auto it = mChecksums.begin(); it != mChecksums.end(); )
+  {
+    if ( it.key().startsWith( projectFullName + "/" ) )
+      it = mChecksums.erase( it );
+    else
+      ++it;
+  }
+}
+
+void MockMerginServer::sendResponse( QTcpSocket *socket, const Response &response, const std::function<void()> &onSent )
+{
+  QByteArray data = QStringLiteral( "HTTP/1.1 %1 %2\r\n" ).arg( response.status ).arg( response.status < 400 ? "OK" : "Error" ).toLatin1();
+  data += "Content-Type: application/json\r\n";
+  data += "Content-Length: " + QByteArray::number( response.body.size() ) + "\r\n";
+  for ( auto it = response.headers.constBegin(); it != response.headers.constEnd(); ++it )
+    data += it.key() + ": " + it.value() + "\r\n";
+  data += "Connection: keep-alive\r\n\r\n";
+  data += response.body;
+  mBytesSent += data.size();
+
+  if ( response.delayMs > 0 )
+  {
+    QPointer<QTcpSocket> s( socket );
+    QTimer::singleShot( response.delayMs, this, [s, data, onSent]
+    {
+      if ( s )
+        s->write( data );
+      if ( onSent )
+        onSent();
+    } );
+  }
+  else
+  {
+    socket->write( data );
+    if ( onSent )
+      onSent();
+  }
+}
+
+MockMerginServer::Response MockMerginServer::jsonResponse( const QJsonObject &obj, int status )
+{
+  Response response;
+  response.status = status;
+  response.body = QJsonDocument( obj ).toJson( QJsonDocument::Compact );
+  return response;
+}
+
+MockMerginServer::Response MockMerginServer::errorResponse( int status, const QString &detail )
+{
+  QJsonObject obj;
+  obj.insert( QStringLiteral( "detail" ), detail );
+  return jsonResponse( obj, status );
+}
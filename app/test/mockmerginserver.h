@@ -0,0 +1,181 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef MOCKMERGINSERVER_H
+#define MOCKMERGINSERVER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QJsonObject>
+#include <QMap>
+#include <QSet>
+#include <QStringList>
+#include <QTcpServer>
+#include <QUrlQuery>
+
+#include <functional>
+
+class QTcpSocket;
+
+/**
+ * Minimal HTTP server running on localhost that implements the part of Mergin API used
+ * for synchronization of projects. Projects are kept in memory. It allows testing of
+ * MerginApi without a real Mergin server and injecting failures that are hard to get otherwise.
+ *
+ * Files are downloaded from the latest version of projects (whole or by ranges). Diffs of diffable
+ * files can be set up with their projects and get downloaded by pulls that can use them.
+ * Diff-based uploads are not supported - only full files and renames of files the server has.
+ * The paginated project list supports revalidation with ETag/If-None-Match.
+ */
+class MockMerginServer : public QObject
+{
+    Q_OBJECT
+  public:
+    struct Request
+    {
+      QByteArray method;
+      QString path;
+      QUrlQuery query;
+      QHash<QByteArray, QByteArray> headers;  //!< keys are lower case
+      QByteArray body;
+    };
+
+    struct Response
+    {
+      int status = 200;
+      QByteArray body;
+      int delayMs = 0;  //!< how long to wait before the response is sent
+      QHash<QByteArray, QByteArray> headers;  //!< extra headers of the response
+    };
+
+    struct Project
+    {
+      int version = 0;
+      QMap<QString, QByteArray> files;  //!< path -> content
+      QMap<QString, QMap<int, QByteArray> > diffs;  //!< path -> version -> changeset that created this version of the file
+    };
+
+    explicit MockMerginServer( QObject *parent = nullptr );
+
+    //! Starts listening on a random port of localhost
+    bool listen();
+
+    //! Returns URL of the server to be used as API root (with a trailing slash)
+    QString url() const;
+
+    //! Adds or replaces a project
+    void setProject( const QString &projectFullName, const Project &project );
+    Project project( const QString &projectFullName ) const;
+
+    /**
+     * Returns project metadata in the same form as Mergin's project info. With \a sinceVersion,
+     * files with diffs also get their history since that version.
+     */
+    QByteArray projectInfo( const QString &projectFullName, int sinceVersion = -1 ) const;
+
+    /**
+     * Makes the n-th chunk upload request (counted from 1 since the last reset of counters) fail with the given
+     * HTTP status. The failure is sent with a delay so that the other requests in progress get their replies first.
+     */
+    void failChunkUpload( int requestNumber, int status = 500 );
+
+    //! Resets request counters and failures
+    void resetCounters();
+
+    /**
+     * Simulates a slow connection: requests and responses of all clients share a link with the given
+     * throughput and each response is delayed by \a latencyMs on top. Zero throughput turns it off.
+     */
+    void setThrottle( qint64 bytesPerSecond, int latencyMs = 0 );
+
+    /**
+     * Advertises the given content codings in Accept-Encoding header of all responses (empty = none).
+     * Compressed chunks are decompressed if \a accepted is true, otherwise they are refused with 415.
+     */
+    void setAcceptEncoding( const QByteArray &encodings, bool accepted = true );
+
+    int pushStartCount() const { return mPushStartCount; }
+    int chunkRequestCount() const { return mChunkRequestCount; }
+    int chunkRequestsInFlight() const { return mChunkRequestsInFlight; }  //!< chunk requests received whose response has not been sent yet
+    int maxChunkRequestsInFlight() const { return mMaxChunkRequestsInFlight; }  //!< the most chunk requests in flight at the same time
+    int pushFinishCount() const { return mPushFinishCount; }
+    QStringList uploadedChunks() const { return mUploadedChunks; }
+    int compressedChunkCount() const { return mCompressedChunkCount; }
+    int listRequestCount() const { return mListRequestCount; }
+    int notModifiedCount() const { return mNotModifiedCount; }
+    qint64 chunkBytesReceived() const { return mChunkBytesReceived; }  //!< size of chunk requests' bodies as sent by the client
+    int downloadRequestCount() const { return mDownloadRequestCount; }
+    int requestCount() const { return mRequestCount; }  //!< all requests
+    qint64 bytesReceived() const { return mBytesReceived; }  //!< all requests (headers and bodies)
+    qint64 bytesSent() const { return mBytesSent; }  //!< all responses (headers and bodies)
+
+  private slots:
+    void onNewConnection();
+    void onReadyRead();
+
+  private:
+    struct Transaction
+    {
+      QString projectFullName;
+      QJsonObject changes;
+      QHash<QString, QByteArray> chunks;  //!< chunk ID -> data
+    };
+
+    Response handleRequest( const Request &request );
+    Response pushStart( const QString &projectFullName, const Request &request );
+    Response pushChunk( const QString &transactionUUID, const QString &chunkId, const Request &request );
+    Response pushFinish( const QString &transactionUUID );
+    Response pushCancel( const QString &transactionUUID );
+    Response listProjects( const Request &request );
+    Response download( const QString &projectFullName, const Request &request );
+    void sendResponse( QTcpSocket *socket, const Response &response, const std::function<void()> &onSent = nullptr );
+
+    //! Returns checksum of a file of the latest version of the project (cached)
+    QString checksum( const QString &projectFullName, const QString &filePath, const QByteArray &content ) const;
+    void clearChecksums( const QString &projectFullName );
+
+    //! Returns how long transfer of the data over the throttled link takes (including waiting for other transfers)
+    int throttleDelay( qint64 bytes );
+
+    static Response jsonResponse( const QJsonObject &obj, int status = 200 );
+    static Response errorResponse( int status, const QString &detail );
+
+    QTcpServer mServer;
+    QHash<QTcpSocket *, QByteArray> mBuffers;
+    QHash<QString, Project> mProjects;
+    QHash<QString, Transaction> mTransactions;
+    mutable QHash<QString, QString> mChecksums;  //!< "project/path" -> checksum of the file's latest version
+
+    QMap<int, int> mChunkFailures;  //!< request number -> HTTP status
+    int mPushStartCount = 0;
+    int mChunkRequestCount = 0;
+    int mChunkRequestsInFlight = 0;
+    int mMaxChunkRequestsInFlight = 0;
+    int mPushFinishCount = 0;
+    QStringList mUploadedChunks;
+    int mCompressedChunkCount = 0;
+    int mListRequestCount = 0;
+    int mNotModifiedCount = 0;
+    qint64 mChunkBytesReceived = 0;
+    int mDownloadRequestCount = 0;
+    int mRequestCount = 0;
+    qint64 mBytesReceived = 0;
+    qint64 mBytesSent = 0;
+
+    QByteArray mAcceptEncoding;
+    bool mCompressionAccepted = true;
+
+    qint64 mThrottleBytesPerSecond = 0;
+    int mThrottleLatencyMs = 0;
+    QElapsedTimer mClock;
+    qint64 mLinkFreeAt = 0;  //!< time (of mClock) when the throttled link is done with the transfers so far
+};
+
+#endif // MOCKMERGINSERVER_H
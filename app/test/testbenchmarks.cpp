@@ -0,0 +1,226 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "testbenchmarks.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QThread>
+#include <QtTest/QtTest>
+
+#include "checksumcache.h"
+#include "checksumengine.h"
+#include "localprojectsmanager.h"
+
+static const int PROJECT_FILES_COUNT = 5000;
+static const int PROJECT_LARGE_FILE_SIZE = 64 * 1024 * 1024;
+static const int CHECKSUM_FILE_ITERATIONS = 5;
+static const int LOCAL_PROJECTS_COUNT = 1000;
+
+//! Checksum computed the way MerginApi::getChecksum() did before the checksum engine
+static QByteArray readAndHashChecksum( const QString &filePath )
+{
+  QFile f( filePath );
+  if ( !f.open( QFile::ReadOnly ) )
+    return QByteArray();
+
+  QCryptographicHash hash( QCryptographicHash::Sha1 );
+  QByteArray chunk = f.read( 65536 );
+  while ( !chunk.isEmpty() )
+  {
+    hash.addData( chunk );
+    chunk = f.read( 65536 );
+  }
+  return hash.result().toHex();
+}
+
+void TestBenchmarks::initTestCase()
+{
+  QVERIFY( mDataDir.isValid() );
+
+  // synthetic project: many small files of various sizes (1-32 KB) in a few folders and one large raster
+  mProjectDir = mDataDir.path() + "/hash_project";
+  quint32 seed = 1;
+  for ( int i = 0; i < PROJECT_FILES_COUNT; ++i )
+  {
+    seed = seed * 1103515245 + 12345;
+    int size = 1024 + static_cast<int>( ( seed >> 8 ) % ( 31 * 1024 ) );
+    QString path = QStringLiteral( "dir%1/file%2.dat" ).arg( i % 20 ).arg( i );
+    mProjectFiles << path;
+
+    QDir().mkpath( QFileInfo( mProjectDir + "/" + path ).absolutePath() );
+    QFile f( mProjectDir + "/" + path );
+    QVERIFY( f.open( QIODevice::WriteOnly ) );
+    f.write( QByteArray( size, static_cast<char>( seed ) ) );
+  }
+
+  QString rasterPath = QStringLiteral( "raster.tif" );
+  mProjectFiles << rasterPath;
+  QFile raster( mProjectDir + "/" + rasterPath );
+  QVERIFY( raster.open( QIODevice::WriteOnly ) );
+  QByteArray block( 1024 * 1024, 'r' );
+  for ( int written = 0; written < PROJECT_LARGE_FILE_SIZE; written += block.size() )
+    raster.write( block );
+
+  // local Mergin projects with just metadata and a QGIS project file
+  mLocalProjectsDir = mDataDir.path() + "/local_projects";
+  for ( int i = 0; i < LOCAL_PROJECTS_COUNT; ++i )
+  {
+    QString projectName = QStringLiteral( "project%1" ).arg( i );
+    QString projectDir = mLocalProjectsDir + "/" + projectName;
+    QVERIFY( QDir().mkpath( projectDir + "/.mergin" ) );
+
+    QFile metadata( projectDir + "/.mergin/mergin.json" );
+    QVERIFY( metadata.open( QIODevice::WriteOnly ) );
+    metadata.write( QStringLiteral( "{\"name\": \"%1\", \"namespace\": \"benchmark\", \"version\": \"v1\", \"files\": []}" ).arg( projectName ).toUtf8() );
+
+    QFile qgisProject( projectDir + "/" + projectName + ".qgs" );
+    QVERIFY( qgisProject.open( QIODevice::WriteOnly ) );
+  }
+}
+
+void TestBenchmarks::benchmarkHashProject_data()
+{
+  QTest::addColumn<int>( "threads" );
+
+  QTest::newRow( "serial" ) << 1;
+  QTest::newRow( "parallel" ) << QThread::idealThreadCount();
+}
+
+void TestBenchmarks::benchmarkHashProject()
+{
+  QFETCH( int, threads );
+
+  QHash<QString, ChecksumCache::Entry> entries;
+  QBENCHMARK
+  {
+    // the project has no .mergin folder - the cache is always empty, so every file gets hashed
+    ChecksumCache cache( mProjectDir );
+    entries = cache.entries( mProjectFiles, threads );
+  }
+
+  QCOMPARE( entries.count(), mProjectFiles.count() );
+  for ( auto it = entries.constBegin(); it != entries.constEnd(); ++it )
+  {
+    QVERIFY( !it->checksum.isEmpty() );
+    if ( mProjectChecksums.contains( it.key() ) )
+      QCOMPARE( it->checksum, mProjectChecksums.value( it.key() ) );
+    else
+      mProjectChecksums.insert( it.key(), it->checksum );
+  }
+}
+
+void TestBenchmarks::benchmarkChecksumFile_data()
+{
+  QTest::addColumn<int>( "backend" );  // -1 for the previous implementation
+  QTest::addColumn<bool>( "mapFiles" );
+
+  QTest::newRow( "qfile-read" ) << -1 << false;
+  for ( ChecksumEngine::Backend backend : { ChecksumEngine::Generic, ChecksumEngine::ShaNi, ChecksumEngine::ArmV8 } )
+  {
+    if ( !ChecksumEngine::isBackendSupported( backend ) )
+      continue;
+
+    QByteArray name = ChecksumEngine::backendName( backend ).toLatin1();
+    QTest::newRow( ( name + "-buffer" ).constData() ) << static_cast<int>( backend ) << false;
+    QTest::newRow( ( name + "-mmap" ).constData() ) << static_cast<int>( backend ) << true;
+  }
+}
+
+void TestBenchmarks::benchmarkChecksumFile()
+{
+  QFETCH( int, backend );
+  QFETCH( bool, mapFiles );
+
+  const QString filePath = mProjectDir + "/raster.tif";
+  const QByteArray expected = readAndHashChecksum( filePath );
+
+  // the file is in the page cache after the first read, so this measures hashing rather than disk speed
+  QByteArray checksum;
+  QElapsedTimer timer;
+  timer.start();
+  for ( int i = 0; i < CHECKSUM_FILE_ITERATIONS; ++i )
+  {
+    if ( backend < 0 )
+      checksum = readAndHashChecksum( filePath );
+    else
+      checksum = ChecksumEngine::fileChecksum( filePath, static_cast<ChecksumEngine::Backend>( backend ), mapFiles );
+  }
+  qint64 elapsedMs = qMax( timer.elapsed(), static_cast<qint64>( 1 ) );
+
+  QCOMPARE( checksum, expected );
+
+  qreal bytesPerSecond = static_cast<qreal>( PROJECT_LARGE_FILE_SIZE ) * CHECKSUM_FILE_ITERATIONS * 1000 / elapsedMs;
+  QTest::setBenchmarkResult( bytesPerSecond, QTest::BytesPerSecond );
+}
+
+void TestBenchmarks::benchmarkLocalProjectLookups_data()
+{
+  QTest::addColumn<bool>( "indexed" );
+
+  QTest::newRow( "linear" ) << false;
+  QTest::newRow( "indexed" ) << true;
+}
+
+void TestBenchmarks::benchmarkLocalProjectLookups()
+{
+  QFETCH( bool, indexed );
+
+  LocalProjectsManager manager( mLocalProjectsDir );
+  const LocalProjectsList projects = manager.projects();
+  QCOMPARE( projects.count(), LOCAL_PROJECTS_COUNT );
+
+  // what a merge of the projects model or syncs of all projects do - each project is looked up by all its keys
+  int found = 0;
+  QBENCHMARK
+  {
+    found = 0;
+    for ( const LocalProject &project : projects )
+    {
+      if ( indexed )
+      {
+        found += manager.projectFromDirectory( project.projectDir ).isValid();
+        found += manager.projectFromProjectFilePath( project.qgisProjectFilePath ).isValid();
+        found += manager.projectFromMerginName( project.id() ).isValid();
+      }
+      else
+      {
+        // lookups the way LocalProjectsManager did them before it kept indices
+        for ( const LocalProject &p : projects )
+        {
+          if ( p.projectDir == project.projectDir )
+          {
+            ++found;
+            break;
+          }
+        }
+        for ( const LocalProject &p : projects )
+        {
+          if ( p.qgisProjectFilePath == project.qgisProjectFilePath )
+          {
+            ++found;
+            break;
+          }
+        }
+        for ( const LocalProject &p : projects )
+        {
+          if ( p.id() == project.id() )
+          {
+            ++found;
+            break;
+          }
+        }
+      }
+    }
+  }
+
+  QCOMPARE( found, 3 * LOCAL_PROJECTS_COUNT );
+}
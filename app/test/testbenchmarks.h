@@ -0,0 +1,48 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef TESTBENCHMARKS_H
+#define TESTBENCHMARKS_H
+
+#include <QHash>
+#include <QObject>
+#include <QStringList>
+#include <QTemporaryDir>
+
+/**
+ * Benchmarks of performance sensitive parts of sync (run with -tickcounter or -callgrind for other metrics).
+ * The data sets are generated in a temporary directory when the test case starts.
+ */
+class TestBenchmarks: public QObject
+{
+    Q_OBJECT
+  private slots:
+    void initTestCase();
+
+    //! Hashing of a project with 5000 files (and one large) with the checksum cache empty
+    void benchmarkHashProject_data();
+    void benchmarkHashProject();
+
+    //! Throughput of hashing of a single large file with the previous implementation and the checksum engine backends
+    void benchmarkChecksumFile_data();
+    void benchmarkChecksumFile();
+
+    //! Lookups of 1000 local projects by directory, QGIS project file and full name with linear search and with indices
+    void benchmarkLocalProjectLookups_data();
+    void benchmarkLocalProjectLookups();
+
+  private:
+    QTemporaryDir mDataDir;
+    QString mProjectDir;
+    QString mLocalProjectsDir;  //!< data directory with many small local projects
+    QStringList mProjectFiles;
+    QHash<QString, QString> mProjectChecksums;  //!< results of the first run to compare the others with
+};
+
+#endif // TESTBENCHMARKS_H
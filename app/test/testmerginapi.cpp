@@ -6,6 +6,8 @@
 
 #include "testmerginapi.h"
 #include "inpututils.h"
+#include "basefilestore.h"
+#include "checksumcache.h"
 #include "coreutils.h"
 #include "geodiffutils.h"
 #include "testutils.h"
@@ -308,6 +310,9 @@ void TestMerginApi::testCancelDownloadProject()
   QVERIFY( spy6.wait( TestUtils::LONG_REPLY ) );
   QCOMPARE( spy6.count(), 1 );
 
+  // both project files are requested at once
+  QCOMPARE( mApi->transactions().value( MerginApi::getFullProjectName( mUsername, projectName ) ).replyDownloadItems.count(), 2 );
+
   QSignalSpy spy7( mApi, &MerginApi::syncProjectFinished );
   mApi->updateCancel( MerginApi::getFullProjectName( mUsername, projectName ) );
 
@@ -498,6 +503,7 @@ void TestMerginApi::testUploadProject()
 
   QVERIFY( spy2.wait( TestUtils::LONG_REPLY ) );
   QCOMPARE( spy2.count(), 1 );
+  QTRY_VERIFY( !mApi->localProjectsManager().statusCache()->isBusy() );
 
   std::shared_ptr<Project> project3 = mLocalProjectsModel->projectFromId( MerginApi::getFullProjectName( projectNamespace, projectName ) );
   QVERIFY( project3 && project3->isLocal() && project3->isMergin() );
@@ -1524,6 +1530,114 @@ void TestMerginApi::testMigrateDetachProject()
   QVERIFY( !QFileInfo::exists( projectDir + "/.mergin/" ) );
 }
 
+void TestMerginApi::testChecksumCache()
+{
+  QTemporaryDir projectDir;
+  QVERIFY( projectDir.isValid() );
+  QDir( projectDir.path() ).mkpath( ".mergin" );
+
+  QString filePath = projectDir.path() + "/data.txt";
+  writeFileContent( filePath, QByteArray( "first version" ) );
+
+  // make the file look old enough to be cached
+  QDateTime mtime = QDateTime::currentDateTime().addSecs( -60 );
+  QFile f( filePath );
+  QVERIFY( f.open( QIODevice::ReadWrite ) );
+  QVERIFY( f.setFileTime( mtime, QFileDevice::FileModificationTime ) );
+  f.close();
+
+  QList<MerginFile> files = MerginApi::getLocalProjectFiles( projectDir.path() + "/" );
+  QCOMPARE( files.count(), 1 );
+  QCOMPARE( files[0].checksum.toLatin1(), MerginApi::getChecksum( filePath ) );
+  QVERIFY( QFileInfo::exists( projectDir.path() + "/.mergin/" + ChecksumCache::sCacheFile ) );
+
+  // cached entry is used when the stat data match
+  ChecksumCache cache( projectDir.path() );
+  ChecksumCache::Entry entry = cache.entry( "data.txt" );
+  QCOMPARE( entry.checksum, files[0].checksum );
+  QCOMPARE( entry.size, files[0].size );
+
+  // content with the same size but different modification time gets hashed again
+  writeFileContent( filePath, QByteArray( "other version" ) );
+  QVERIFY( f.open( QIODevice::ReadWrite ) );
+  QVERIFY( f.setFileTime( mtime.addSecs( 10 ), QFileDevice::FileModificationTime ) );
+  f.close();
+
+  files = MerginApi::getLocalProjectFiles( projectDir.path() + "/" );
+  QCOMPARE( files.count(), 1 );
+  QCOMPARE( files[0].checksum.toLatin1(), MerginApi::getChecksum( filePath ) );
+  QVERIFY( files[0].checksum != entry.checksum );
+
+  // removed files are dropped from the cache
+  QVERIFY( QFile::remove( filePath ) );
+  files = MerginApi::getLocalProjectFiles( projectDir.path() + "/" );
+  QCOMPARE( files.count(), 0 );
+  ChecksumCache cache2( projectDir.path() );
+  QCOMPARE( cache2.entry( "data.txt" ).checksum, QString() );
+}
+
+void TestMerginApi::testApplyConcatenatedDiffs()
+{
+  // two consecutive diffs (base -> added_row -> added_row_2) get squashed and applied in a single pass
+  QTemporaryDir tempDir;
+  QVERIFY( tempDir.isValid() );
+
+  QString base = mTestDataPath + "/diff_project/base.gpkg";
+  QString diff1 = tempDir.path() + "/1.diff";
+  QString diff2 = tempDir.path() + "/2.diff";
+  QCOMPARE( GEODIFF_createChangeset( base.toUtf8(), QString( mTestDataPath + "/added_row.gpkg" ).toUtf8(), diff1.toUtf8() ), GEODIFF_SUCCESS );
+  QCOMPARE( GEODIFF_createChangeset( QString( mTestDataPath + "/added_row.gpkg" ).toUtf8(), QString( mTestDataPath + "/added_row_2.gpkg" ).toUtf8(), diff2.toUtf8() ), GEODIFF_SUCCESS );
+
+  QString result = tempDir.path() + "/result.gpkg";
+  QVERIFY( QFile::copy( base, result ) );
+  QVERIFY( GeodiffUtils::applyDiffs( result, QStringList() << diff1 << diff2 ) );
+  QVERIFY( !QFileInfo::exists( result + "-concat.diff" ) );
+
+  QgsVectorLayer *vl = new QgsVectorLayer( result + "|layername=simple", "base", "ogr" );
+  QVERIFY( vl->isValid() );
+  QCOMPARE( vl->featureCount(), static_cast<long>( 5 ) );
+  delete vl;
+}
+
+void TestMerginApi::testBasefileInPlaceUpdate()
+{
+  // diffs get applied to the basefile and the unmodified local file in place,
+  // an interrupted update is remembered until the basefile is stored again
+  QTemporaryDir projectDir;
+  QVERIFY( projectDir.isValid() );
+  QVERIFY( QDir().mkpath( projectDir.path() + "/.mergin" ) );
+
+  QString diff = projectDir.path() + "/.mergin/1.diff";
+  QCOMPARE( GEODIFF_createChangeset( QString( mTestDataPath + "/diff_project/base.gpkg" ).toUtf8(), QString( mTestDataPath + "/added_row.gpkg" ).toUtf8(), diff.toUtf8() ), GEODIFF_SUCCESS );
+
+  BasefileStore basefiles( projectDir.path() );
+  QVERIFY( QFile::copy( mTestDataPath + "/diff_project/base.gpkg", projectDir.path() + "/base.gpkg" ) );
+  QVERIFY( basefiles.store( "base.gpkg", projectDir.path() + "/base.gpkg" ) );
+  QVERIFY( QFileInfo::exists( basefiles.basefilePath( "base.gpkg" ) ) );
+  QVERIFY( !basefiles.isInterrupted( "base.gpkg" ) );
+
+  QVERIFY( basefiles.applyDiffsInPlace( "base.gpkg", QStringList() << diff ) );
+  QVERIFY( !basefiles.isInterrupted( "base.gpkg" ) );
+  QVERIFY( !QFileInfo::exists( projectDir.path() + "/.mergin/" + BasefileStore::sJournalFile ) );
+  QVERIFY( !GeodiffUtils::hasPendingChanges( projectDir.path(), "base.gpkg" ) );
+
+  for ( const QString &path : { basefiles.basefilePath( "base.gpkg" ), projectDir.path() + "/base.gpkg" } )
+  {
+    QgsVectorLayer *vl = new QgsVectorLayer( path + "|layername=simple", "base", "ogr" );
+    QVERIFY( vl->isValid() );
+    QCOMPARE( vl->featureCount(), static_cast<long>( 4 ) );
+    delete vl;
+  }
+
+  // the same diff cannot be applied again - the update stays marked as interrupted
+  QVERIFY( !basefiles.applyDiffsInPlace( "base.gpkg", QStringList() << diff ) );
+  QVERIFY( basefiles.isInterrupted( "base.gpkg" ) );
+  QVERIFY( BasefileStore( projectDir.path() ).isInterrupted( "base.gpkg" ) );
+
+  QVERIFY( basefiles.store( "base.gpkg", projectDir.path() + "/base.gpkg" ) );
+  QVERIFY( !basefiles.isInterrupted( "base.gpkg" ) );
+}
+
 void TestMerginApi::testRegister()
 {
   QString password = mApi->userAuth()->password();
@@ -1609,6 +1723,9 @@ void TestMerginApi::downloadRemoteProject( MerginApi *api, const QString &projec
   QCOMPARE( api->transactions().count(), 1 );
   QVERIFY( spy.wait( TestUtils::LONG_REPLY * 5 ) );
   serverVersion = serverVersionFromSpy( spy );
+
+  // statuses of projects in models get updated once local changes are checked
+  QTRY_VERIFY( !api->localProjectsManager().statusCache()->isBusy() );
 }
 
 void TestMerginApi::uploadRemoteProject( MerginApi *api, const QString &projectNamespace, const QString &projectName )
@@ -1624,6 +1741,8 @@ void TestMerginApi::uploadRemoteProject( MerginApi *api, const QString &projectN
   QVERIFY( spy.wait( TestUtils::LONG_REPLY * 30 ) );
   QCOMPARE( spy.count(), 1 );
   serverVersion = serverVersionFromSpy( spy );
+
+  QTRY_VERIFY( !api->localProjectsManager().statusCache()->isBusy() );
 }
 
 void TestMerginApi::writeFileContent( const QString &filename, const QByteArray &data )
@@ -1669,4 +1788,7 @@ void TestMerginApi::refreshProjectsModel( const ProjectsModel::ProjectModelTypes
     QVERIFY( spy.wait( TestUtils::SHORT_REPLY ) );
     QCOMPARE( spy.count(), 1 );
   }
+
+  // statuses are updated once local changes are checked
+  QTRY_VERIFY( !mApi->localProjectsManager().statusCache()->isBusy() );
 }
@@ -66,6 +66,9 @@ class TestMerginApi: public QObject
     void testMigrateProject();
     void testMigrateProjectAndSync();
     void testMigrateDetachProject();
+    void testChecksumCache();
+    void testApplyConcatenatedDiffs();
+    void testBasefileInPlaceUpdate();
 
     void testRegister();
 
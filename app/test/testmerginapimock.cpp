@@ -0,0 +1,1113 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "testmerginapimock.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSignalSpy>
+#include <QtTest/QtTest>
+
+#include "adaptivechunkpolicy.h"
+#include "basefilestore.h"
+#include "changejournal.h"
+#include "contentstore.h"
+#include "localprojectsmanager.h"
+#include "merginapi.h"
+#include "merginprojectmetadata.h"
+#include "merginuserauth.h"
+#include "projectstatuscache.h"
+#include "syncmetrics.h"
+#include "testutils.h"
+
+static const QString TEST_NAMESPACE = QStringLiteral( "mock" );
+
+TestMerginApiMock::~TestMerginApiMock() = default;
+
+void TestMerginApiMock::initTestCase()
+{
+  QVERIFY( mDataDir.isValid() );
+  QVERIFY( mServer.listen() );
+
+  mLocalProjects.reset( new LocalProjectsManager( mDataDir.path() ) );
+  mApi.reset( new MerginApi( *mLocalProjects ) );
+  mApi->mApiRoot = mServer.url();
+  mApi->mApiVersionStatus = MerginApiStatus::OK;
+
+  // the mock server does not check authentication, we only need the client to think it is logged in
+  // (signals are blocked so that the fake credentials do not get stored in settings)
+  mApi->userAuth()->blockSignals( true );
+  mApi->userAuth()->setUsername( TEST_NAMESPACE );
+  mApi->userAuth()->setPassword( QStringLiteral( "password" ) );
+  mApi->userAuth()->setAuthToken( QByteArray( "token" ) );
+  mApi->userAuth()->setTokenExpiration( QDateTime::currentDateTimeUtc().addDays( 1 ) );
+  mApi->userAuth()->blockSignals( false );
+}
+
+void TestMerginApiMock::cleanupTestCase()
+{
+  mApi.reset();
+  mLocalProjects.reset();
+}
+
+void TestMerginApiMock::testResumePush()
+{
+  // first push fails in the middle - the second one should continue the same transaction
+  // and only upload the chunks that have not made it to the server
+
+  QString projectName = QStringLiteral( "testResumePush" );
+  QString projectDir = createProject( projectName );
+  QString journalPath = projectDir + "/.mergin/push.journal";
+
+  // 15mb -> two chunks
+  QByteArray content;
+  for ( int i = 0; i < 15; ++i )
+    content.append( QByteArray( 1024 * 1024, static_cast<char>( 'A' + i ) ) );
+  QFile file( projectDir + "/big_file.dat" );
+  QVERIFY( file.open( QIODevice::WriteOnly ) );
+  file.write( content );
+  file.close();
+
+  mServer.resetCounters();
+  mServer.failChunkUpload( 2 );
+  QVERIFY( !pushProject( projectName ) );
+
+  QCOMPARE( mServer.pushStartCount(), 1 );
+  QCOMPARE( mServer.pushFinishCount(), 0 );
+  QCOMPARE( mServer.project( TEST_NAMESPACE + "/" + projectName ).version, 1 );
+  QVERIFY( QFile::exists( journalPath ) );
+  int acked = mServer.uploadedChunks().count();
+  QCOMPARE( acked, 1 );
+
+  // try again - no new transaction, just the missing chunk
+  mServer.resetCounters();
+  QVERIFY( pushProject( projectName ) );
+
+  QCOMPARE( mServer.pushStartCount(), 0 );
+  QCOMPARE( mServer.uploadedChunks().count(), 2 - acked );
+  QCOMPARE( mServer.pushFinishCount(), 1 );
+  QVERIFY( !QFile::exists( journalPath ) );
+
+  MockMerginServer::Project serverProject = mServer.project( TEST_NAMESPACE + "/" + projectName );
+  QCOMPARE( serverProject.version, 2 );
+  QCOMPARE( serverProject.files.value( QStringLiteral( "big_file.dat" ) ), content );
+}
+
+void TestMerginApiMock::testParallelUpload()
+{
+  // chunks get uploaded several at a time, but never more than the window of the transaction allows;
+  // when one of them fails, the others are dropped and no new ones get started
+
+  QString projectName = QStringLiteral( "testParallelUpload" );
+  QString projectDir = createProject( projectName );
+
+  // every file is a chunk of its own
+  const int fileCount = 32;
+  QMap<QString, QByteArray> files;
+  for ( int i = 0; i < fileCount; ++i )
+  {
+    QString fileName = QStringLiteral( "data%1.dat" ).arg( i );
+    files.insert( fileName, QByteArray( 32 * 1024, static_cast<char>( '0' + i ) ) );
+    QFile file( projectDir + "/" + fileName );
+    QVERIFY( file.open( QIODevice::WriteOnly ) );
+    file.write( files.value( fileName ) );
+  }
+
+  // with some latency the requests overlap
+  mServer.setThrottle( 10 * 1024 * 1024, 100 );
+  const int window = TransactionStatus().maxParallelUploads;
+  QVERIFY( window > 1 );
+
+  mServer.resetCounters();
+  mServer.failChunkUpload( 2 );
+  QVERIFY( !pushProject( projectName ) );
+
+  QVERIFY( mServer.maxChunkRequestsInFlight() > 1 );
+  QVERIFY( mServer.maxChunkRequestsInFlight() <= window );
+  QCOMPARE( mApi->requestsInFlight(), 0 );
+  QTRY_COMPARE( mServer.chunkRequestsInFlight(), 0 );
+
+  // nothing else gets uploaded once the push has failed
+  int requested = mServer.chunkRequestCount();
+  QVERIFY( requested < fileCount );
+  QTest::qWait( 300 );
+  QCOMPARE( mServer.chunkRequestCount(), requested );
+  int acked = mServer.uploadedChunks().count();
+
+  // the resumed push uploads the rest within the same window
+  mServer.resetCounters();
+  QVERIFY( pushProject( projectName ) );
+  mServer.setThrottle( 0 );
+
+  QCOMPARE( mServer.uploadedChunks().count(), fileCount - acked );
+  QVERIFY( mServer.maxChunkRequestsInFlight() <= window );
+  QCOMPARE( mApi->requestsInFlight(), 0 );
+
+  MockMerginServer::Project serverProject = mServer.project( TEST_NAMESPACE + "/" + projectName );
+  QCOMPARE( serverProject.version, 2 );
+  QCOMPARE( serverProject.files, files );
+}
+
+void TestMerginApiMock::testSyncQueue()
+{
+  // with a single sync slot, requested pushes should run one after another - the priority project first
+
+  QStringList projectNames;
+  projectNames << QStringLiteral( "testSyncQueue1" ) << QStringLiteral( "testSyncQueue2" ) << QStringLiteral( "testSyncQueue3" );
+  for ( const QString &projectName : projectNames )
+  {
+    QString projectDir = createProject( projectName );
+    QFile file( projectDir + "/data.txt" );
+    QVERIFY( file.open( QIODevice::WriteOnly ) );
+    file.write( projectName.toUtf8() );
+  }
+
+  SyncScheduler *scheduler = mApi->syncScheduler();
+  scheduler->setMaxActiveSyncs( 1 );
+  scheduler->setPriorityProject( TEST_NAMESPACE + "/" + projectNames[2] );
+
+  QSignalSpy spy( mApi.get(), &MerginApi::syncProjectFinished );
+  for ( const QString &projectName : projectNames )
+    mApi->uploadProject( TEST_NAMESPACE, projectName );
+
+  // the first one started right away, the others are waiting
+  QVERIFY( scheduler->isActive( TEST_NAMESPACE + "/" + projectNames[0] ) );
+  QCOMPARE( scheduler->queuedProjects(), QStringList() << TEST_NAMESPACE + "/" + projectNames[2] << TEST_NAMESPACE + "/" + projectNames[1] );
+
+  // requesting the same project again does nothing - an update is covered by the waiting upload
+  mApi->uploadProject( TEST_NAMESPACE, projectNames[1] );
+  QCOMPARE( scheduler->queuedProjects().count(), 2 );
+  mApi->updateProject( TEST_NAMESPACE, projectNames[1] );
+  QCOMPARE( scheduler->queuedProjects().count(), 2 );
+
+  while ( spy.count() < 3 )
+    QVERIFY( spy.wait( TestUtils::LONG_REPLY ) );
+
+  QStringList finished;
+  for ( const QList<QVariant> &args : qAsConst( spy ) )
+  {
+    QVERIFY( args.at( 2 ).toBool() );
+    finished << args.at( 1 ).toString();
+  }
+  QCOMPARE( finished, QStringList() << TEST_NAMESPACE + "/" + projectNames[0] << TEST_NAMESPACE + "/" + projectNames[2] << TEST_NAMESPACE + "/" + projectNames[1] );
+  QVERIFY( scheduler->queuedProjects().isEmpty() );
+
+  for ( const QString &projectName : projectNames )
+    QCOMPARE( mServer.project( TEST_NAMESPACE + "/" + projectName ).files.value( QStringLiteral( "data.txt" ) ), projectName.toUtf8() );
+
+  scheduler->setMaxActiveSyncs( 3 );
+  scheduler->setPriorityProject( QString() );
+}
+
+void TestMerginApiMock::testResumedDownloadChunks()
+{
+  const qint64 MB = 1024 * 1024;
+
+  // ranges downloaded by a previous attempt are kept when a file is split with a different chunk size
+  MerginFile file;
+  file.path = QStringLiteral( "data.tif" );
+  file.size = 10 * MB;
+  QMap<qint64, qint64> downloaded;
+  downloaded.insert( 0, MB - 1 );
+  downloaded.insert( 5 * MB, 6 * MB - 1 );
+  QList<DownloadQueueItem> items = MerginApi::itemsForFileChunks( file, 2, 4 * MB, downloaded );
+  QCOMPARE( items.count(), 4 );
+  QCOMPARE( items[0].rangeFrom, 0 );
+  QCOMPARE( items[0].rangeTo, MB - 1 );
+  QCOMPARE( items[1].rangeFrom, MB );
+  QCOMPARE( items[1].rangeTo, 5 * MB - 1 );
+  QCOMPARE( items[2].rangeFrom, 5 * MB );
+  QCOMPARE( items[2].rangeTo, 6 * MB - 1 );
+  QCOMPARE( items[3].rangeFrom, 6 * MB );
+  QCOMPARE( items[3].rangeTo, 10 * MB - 1 );
+  QCOMPARE( items[3].size, 4 * MB );
+}
+
+void TestMerginApiMock::testAdaptiveUploadChunks()
+{
+  // the first push over a slow connection uses the default chunk size, the second one
+  // should split files into smaller chunks according to the throughput measured by the first one
+
+  AdaptiveChunkPolicy previousPolicy = mApi->mChunkPolicy;
+  mApi->mChunkPolicy = AdaptiveChunkPolicy();
+  mApi->mChunkPolicy.setTargetRequestDuration( 500 );
+  mServer.setThrottle( 1024 * 1024 );  // 1 MB/s
+
+  QString projectName = QStringLiteral( "testAdaptiveUploadChunks" );
+  QString projectDir = createProject( projectName );
+
+  QByteArray content1( 2 * 1024 * 1024, 'a' );
+  QFile file1( projectDir + "/data1.dat" );
+  QVERIFY( file1.open( QIODevice::WriteOnly ) );
+  file1.write( content1 );
+  file1.close();
+
+  mServer.resetCounters();
+  QVERIFY( pushProject( projectName ) );
+  QCOMPARE( mServer.chunkRequestCount(), 1 );
+
+  // about 1 MB/s with requests of 0.5 s
+  QVERIFY( mApi->mChunkPolicy.hasEstimate() );
+  QVERIFY( mApi->mChunkPolicy.uploadChunkSize() < content1.size() );
+
+  QByteArray content2( 2 * 1024 * 1024, 'b' );
+  QFile file2( projectDir + "/data2.dat" );
+  QVERIFY( file2.open( QIODevice::WriteOnly ) );
+  file2.write( content2 );
+  file2.close();
+
+  mServer.resetCounters();
+  QVERIFY( pushProject( projectName ) );
+  QVERIFY( mServer.chunkRequestCount() > 1 );
+
+  MockMerginServer::Project serverProject = mServer.project( TEST_NAMESPACE + "/" + projectName );
+  QCOMPARE( serverProject.version, 3 );
+  QCOMPARE( serverProject.files.value( QStringLiteral( "data1.dat" ) ), content1 );
+  QCOMPARE( serverProject.files.value( QStringLiteral( "data2.dat" ) ), content2 );
+
+  mServer.setThrottle( 0 );
+  mApi->mChunkPolicy = previousPolicy;
+}
+
+void TestMerginApiMock::testCompressedUpload()
+{
+  // text data get compressed, already compressed formats and data that do not compress well are sent as they are
+
+  QByteArray csv;
+  for ( int i = 0; i < 20000; ++i )
+    csv.append( QStringLiteral( "%1,point %1,%2\n" ).arg( i ).arg( i % 7 ).toUtf8() );
+
+  QByteArray noise( 256 * 1024, Qt::Uninitialized );
+  quint32 seed = 42;
+  for ( int i = 0; i < noise.size(); ++i )
+  {
+    seed = seed * 1103515245 + 12345;
+    noise[i] = static_cast<char>( seed >> 24 );
+  }
+
+  mServer.setAcceptEncoding( "gzip, deflate" );
+
+  QString projectName = QStringLiteral( "testCompressedUpload" );
+  QString projectDir = createProject( projectName );
+
+  QMap<QString, QByteArray> files;
+  files.insert( QStringLiteral( "points.csv" ), csv );
+  files.insert( QStringLiteral( "photo.jpg" ), noise );
+  files.insert( QStringLiteral( "raster.tif" ), noise );  // compressed GeoTIFF - only the ratio tells
+  for ( auto it = files.constBegin(); it != files.constEnd(); ++it )
+  {
+    QFile file( projectDir + "/" + it.key() );
+    QVERIFY( file.open( QIODevice::WriteOnly ) );
+    file.write( it.value() );
+  }
+
+  mServer.resetCounters();
+  QVERIFY( pushProject( projectName ) );
+
+  QCOMPARE( mServer.chunkRequestCount(), 3 );
+  QCOMPARE( mServer.compressedChunkCount(), 1 );
+  QVERIFY( mServer.chunkBytesReceived() < csv.size() / 2 + 2 * noise.size() );
+
+  MockMerginServer::Project serverProject = mServer.project( TEST_NAMESPACE + "/" + projectName );
+  QCOMPARE( serverProject.version, 2 );
+  QCOMPARE( serverProject.files, files );
+
+  mServer.setAcceptEncoding( QByteArray() );
+}
+
+void TestMerginApiMock::testCompressedUploadRejected()
+{
+  // the server advertises compression but refuses compressed chunks - they get sent again uncompressed
+
+  mServer.setAcceptEncoding( "deflate", false );
+
+  QString projectName = QStringLiteral( "testCompressedUploadRejected" );
+  QString projectDir = createProject( projectName );
+
+  QByteArray content = QByteArray( "mergin " ).repeated( 10000 );
+  QFile file( projectDir + "/notes.txt" );
+  QVERIFY( file.open( QIODevice::WriteOnly ) );
+  file.write( content );
+  file.close();
+
+  mServer.resetCounters();
+  QVERIFY( pushProject( projectName ) );
+
+  QCOMPARE( mServer.chunkRequestCount(), 2 );
+  QCOMPARE( mServer.compressedChunkCount(), 0 );
+  QCOMPARE( mServer.uploadedChunks().count(), 1 );
+
+  MockMerginServer::Project serverProject = mServer.project( TEST_NAMESPACE + "/" + projectName );
+  QCOMPARE( serverProject.version, 2 );
+  QCOMPARE( serverProject.files.value( QStringLiteral( "notes.txt" ) ), content );
+
+  mServer.setAcceptEncoding( QByteArray() );
+}
+
+void TestMerginApiMock::testProjectListCache()
+{
+  // listed projects are cached and revalidated, the next page gets prefetched
+
+  mApi->mProjectListCache.clear();
+  for ( int i = 0; i < 60; ++i )
+  {
+    MockMerginServer::Project project;
+    project.version = 1;
+    mServer.setProject( QStringLiteral( "%1/listed%2" ).arg( TEST_NAMESPACE ).arg( i, 2, 10, QChar( '0' ) ), project );
+  }
+  mServer.resetCounters();
+
+  QSignalSpy spyFinished( mApi.get(), &MerginApi::listProjectsFinished );
+  QSignalSpy spyCached( mApi.get(), &MerginApi::listProjectsFromCache );
+
+  // nothing is cached yet
+  QString requestId = mApi->listProjects( QString(), QString(), QString(), 1 );
+  QVERIFY( spyFinished.wait( TestUtils::SHORT_REPLY ) );
+  QCOMPARE( spyCached.count(), 0 );
+  QList<QVariant> args = spyFinished.takeFirst();
+  MerginProjectsList page1 = qvariant_cast<MerginProjectsList>( args.at( 0 ) );
+  int projectCount = args.at( 2 ).toInt();
+  QCOMPARE( args.at( 4 ).toString(), requestId );
+  QCOMPARE( page1.count(), 50 );
+  QVERIFY( projectCount >= 60 );
+  QVERIFY( QFile::exists( mApi->mProjectListCache.filePath() ) );
+
+  // the second page gets prefetched...
+  QTRY_COMPARE( mServer.listRequestCount(), 2 );
+  QTRY_VERIFY( mApi->mPrefetchedProjectLists.isEmpty() );
+
+  // ... so it is listed without a request
+  mApi->listProjects( QString(), QString(), QString(), 2 );
+  QVERIFY( spyFinished.wait( TestUtils::SHORT_REPLY ) );
+  QCOMPARE( mServer.listRequestCount(), 2 );
+  args = spyFinished.takeFirst();
+  QCOMPARE( qvariant_cast<MerginProjectsList>( args.at( 0 ) ).count(), qMin( 50, projectCount - 50 ) );
+  QCOMPARE( args.at( 3 ).toInt(), 2 );
+
+  // listing the first page again shows the cached projects right away and the server confirms them
+  mApi->listProjects( QString(), QString(), QString(), 1 );
+  QVERIFY( spyFinished.wait( TestUtils::SHORT_REPLY ) );
+  QCOMPARE( spyCached.count(), 1 );
+  QCOMPARE( qvariant_cast<MerginProjectsList>( spyCached.takeFirst().at( 0 ) ).count(), 50 );
+  QCOMPARE( mServer.listRequestCount(), 3 );
+  QCOMPARE( mServer.notModifiedCount(), 1 );
+  QCOMPARE( qvariant_cast<MerginProjectsList>( spyFinished.takeFirst().at( 0 ) ).count(), 50 );
+
+  // a new version of a listed project is pushed - cached pages with the project are not valid anymore
+  QString projectName = QStringLiteral( "listed00" );
+  QString projectDir = createProject( projectName );
+  QFile file( projectDir + "/data.txt" );
+  QVERIFY( file.open( QIODevice::WriteOnly ) );
+  file.write( "listed" );
+  file.close();
+  QVERIFY( pushProject( projectName ) );
+
+  mApi->listProjects( QString(), QString(), QString(), 1 );
+  QVERIFY( spyFinished.wait( TestUtils::SHORT_REPLY ) );
+  QCOMPARE( spyCached.count(), 0 );
+  QCOMPARE( mServer.notModifiedCount(), 1 );
+  const MerginProjectsList projects = qvariant_cast<MerginProjectsList>( spyFinished.takeFirst().at( 0 ) );
+  auto it = std::find_if( projects.constBegin(), projects.constEnd(), [&projectName]( const MerginProject & project )
+  {
+    return project.projectName == projectName;
+  } );
+  QVERIFY( it != projects.constEnd() );
+  QCOMPARE( it->serverVersion, 2 );
+}
+
+void TestMerginApiMock::testProjectMetadataCache()
+{
+  // metadata read from mergin.json are indexed by path and stored in a binary sidecar
+  // that is used until the JSON file gets modified
+
+  QString projectFullName = TEST_NAMESPACE + "/testProjectMetadataCache";
+  MockMerginServer::Project project;
+  project.version = 3;
+  for ( int i = 0; i < 100; ++i )
+    project.files.insert( QStringLiteral( "data/file%1.txt" ).arg( i ), QByteArray::number( i ) );
+  mServer.setProject( projectFullName, project );
+
+  QString projectDir = mDataDir.path() + "/testProjectMetadataCache";
+  QDir().mkpath( projectDir + "/.mergin" );
+  QString metadataFilePath = projectDir + MerginApi::sMetadataFile;
+  QString sidecarPath = MerginProjectMetadata::sidecarFilePath( metadataFilePath );
+  QCOMPARE( sidecarPath, projectDir + "/.mergin/mergin.cache" );
+
+  auto writeMetadata = [&]( const QByteArray &data, const QDateTime &mtime )
+  {
+    QFile f( metadataFilePath );
+    QVERIFY( f.open( QIODevice::WriteOnly ) );
+    f.write( data );
+    f.flush();
+    QVERIFY( f.setFileTime( mtime, QFileDevice::FileModificationTime ) );
+  };
+
+  // recently written JSON files do not get a sidecar yet
+  writeMetadata( mServer.projectInfo( projectFullName ), QDateTime::currentDateTime() );
+  MerginProjectMetadata meta = MerginProjectMetadata::fromCachedJson( metadataFilePath );
+  QCOMPARE( meta.files.count(), 100 );
+  QVERIFY( !QFile::exists( sidecarPath ) );
+
+  writeMetadata( mServer.projectInfo( projectFullName ), QDateTime::currentDateTime().addSecs( -60 ) );
+  MerginProjectMetadata parsed = MerginProjectMetadata::fromCachedJson( metadataFilePath );
+  QVERIFY( QFile::exists( sidecarPath ) );
+
+  MerginProjectMetadata cached = MerginProjectMetadata::fromCachedJson( metadataFilePath );
+  QCOMPARE( cached.name, parsed.name );
+  QCOMPARE( cached.projectNamespace, parsed.projectNamespace );
+  QCOMPARE( cached.version, 3 );
+  QCOMPARE( cached.files.count(), parsed.files.count() );
+  for ( const MerginFile &file : parsed.files )
+  {
+    QVERIFY( cached.hasFile( file.path ) );
+    MerginFile cachedFile = cached.fileInfo( file.path );
+    QCOMPARE( cachedFile.checksum, file.checksum );
+    QCOMPARE( cachedFile.size, file.size );
+    QCOMPARE( cachedFile.mtime, file.mtime );
+  }
+  QVERIFY( !cached.hasFile( QStringLiteral( "data/missing.txt" ) ) );
+  QVERIFY( cached.fileInfo( QStringLiteral( "data/missing.txt" ) ).path.isEmpty() );
+
+  // the index follows changes of the list of files
+  cached.files.removeFirst();
+  QVERIFY( !cached.hasFile( parsed.files.first().path ) );
+  QCOMPARE( cached.fileInfo( parsed.files.last().path ).checksum, parsed.files.last().checksum );
+
+  // the sidecar is not used anymore once the JSON file is modified
+  project.version = 4;
+  project.files.remove( QStringLiteral( "data/file0.txt" ) );
+  mServer.setProject( projectFullName, project );
+  writeMetadata( mServer.projectInfo( projectFullName ), QDateTime::currentDateTime().addSecs( -30 ) );
+  MerginProjectMetadata updated = MerginProjectMetadata::fromCachedJson( metadataFilePath );
+  QCOMPARE( updated.version, 4 );
+  QCOMPARE( updated.files.count(), 99 );
+  QVERIFY( !updated.hasFile( QStringLiteral( "data/file0.txt" ) ) );
+  QVERIFY( MerginProjectMetadata::fromCachedJson( metadataFilePath ).hasFile( QStringLiteral( "data/file1.txt" ) ) );
+}
+
+void TestMerginApiMock::testPullProject()
+{
+  // new version of a project gets pulled from the server - the large file by ranges
+
+  QString projectName = QStringLiteral( "testPullProject" );
+  QString projectFullName = TEST_NAMESPACE + "/" + projectName;
+  QString projectDir = createProject( projectName );
+
+  QByteArray bigContent;
+  for ( int i = 0; bigContent.size() < 24 * 1024 * 1024; ++i )
+    bigContent.append( QByteArray::number( i ).rightJustified( 16, ' ' ) );
+
+  MockMerginServer::Project project = mServer.project( projectFullName );
+  project.version = 2;
+  project.files.insert( QStringLiteral( "data/small.txt" ), QByteArray( "small file" ) );
+  project.files.insert( QStringLiteral( "data/empty.txt" ), QByteArray() );
+  project.files.insert( QStringLiteral( "big.bin" ), bigContent );
+  mServer.setProject( projectFullName, project );
+  mServer.resetCounters();
+
+  QSignalSpy spy( mApi.get(), &MerginApi::syncProjectFinished );
+  mApi->updateProject( TEST_NAMESPACE, projectName );
+  QVERIFY( spy.wait( TestUtils::LONG_REPLY ) );
+  QVERIFY( spy.takeFirst().at( 2 ).toBool() );
+
+  for ( auto it = project.files.constBegin(); it != project.files.constEnd(); ++it )
+  {
+    QFile f( projectDir + "/" + it.key() );
+    QVERIFY( f.open( QIODevice::ReadOnly ) );
+    QVERIFY( f.readAll() == it.value() );
+  }
+
+  // the small file and at least two ranges of the big file (the empty file is not downloaded)
+  QVERIFY( mServer.downloadRequestCount() >= 3 );
+  QVERIFY( mServer.bytesSent() > bigContent.size() );
+  QCOMPARE( mLocalProjects->projectFromMerginName( projectFullName ).localVersion, 2 );
+
+  // the open project gets reloaded when the pull has replaced its files
+  QSignalSpy reloadSpy( mApi.get(), &MerginApi::reloadProject );
+  mApi->setOpenProject( projectFullName );
+  project.version = 3;
+  project.files.insert( QStringLiteral( "data/small.txt" ), QByteArray( "small file updated" ) );
+  mServer.setProject( projectFullName, project );
+
+  mApi->updateProject( TEST_NAMESPACE, projectName );
+  QVERIFY( spy.wait( TestUtils::LONG_REPLY ) );
+  QVERIFY( spy.takeFirst().at( 2 ).toBool() );
+  mApi->setOpenProject( QString() );
+  QCOMPARE( reloadSpy.count(), 1 );
+  QCOMPARE( reloadSpy.first().at( 0 ).toString(), projectDir );
+
+  QFile updated( projectDir + "/data/small.txt" );
+  QVERIFY( updated.open( QIODevice::ReadOnly ) );
+  QVERIFY( updated.readAll() == "small file updated" );
+  QCOMPARE( mLocalProjects->projectFromMerginName( projectFullName ).localVersion, 3 );
+}
+
+void TestMerginApiMock::testSyncMetrics()
+{
+  // each sync records timing of its phases - the last one is exposed and all are appended to the metrics file
+
+  QString projectName = QStringLiteral( "testSyncMetrics" );
+  QString projectFullName = TEST_NAMESPACE + "/" + projectName;
+  QString projectDir = createProject( projectName );
+  QFile::remove( mApi->syncMetricsFilePath() );
+
+  QByteArray content( 1024 * 1024, 'm' );
+  QFile file( projectDir + "/data.dat" );
+  QVERIFY( file.open( QIODevice::WriteOnly ) );
+  file.write( content );
+  file.close();
+
+  QSignalSpy spyMetrics( mApi.get(), &MerginApi::lastSyncMetricsChanged );
+  QVERIFY( pushProject( projectName ) );
+  QCOMPARE( spyMetrics.count(), 1 );
+
+  QVariantMap metrics = mApi->lastSyncMetrics();
+  QCOMPARE( metrics.value( "project" ).toString(), projectFullName );
+  QCOMPARE( metrics.value( "type" ).toString(), QStringLiteral( "push" ) );
+  QVERIFY( metrics.value( "successful" ).toBool() );
+  QVERIFY( metrics.value( "durationMs" ).toLongLong() >= 0 );
+
+  QHash<QString, QVariantMap> phases;
+  for ( const QVariant &phase : metrics.value( "phases" ).toList() )
+    phases.insert( phase.toMap().value( "name" ).toString(), phase.toMap() );
+  for ( const QString &name : { SyncMetrics::ProjectInfo, SyncMetrics::Scan, SyncMetrics::Compare, SyncMetrics::Upload, SyncMetrics::Finalize, SyncMetrics::Metadata } )
+    QVERIFY2( phases.contains( name ), name.toUtf8() );
+  QCOMPARE( phases[SyncMetrics::Scan].value( "bytes" ).toLongLong(), static_cast<qint64>( content.size() ) );
+  QCOMPARE( phases[SyncMetrics::Upload].value( "bytes" ).toLongLong(), static_cast<qint64>( content.size() ) );
+  QVERIFY( !phases.contains( SyncMetrics::Download ) );
+
+  // a pull is appended as another line
+  MockMerginServer::Project project = mServer.project( projectFullName );
+  project.version += 1;
+  project.files.insert( QStringLiteral( "new.txt" ), QByteArray( "new file" ) );
+  mServer.setProject( projectFullName, project );
+
+  QSignalSpy spy( mApi.get(), &MerginApi::syncProjectFinished );
+  mApi->updateProject( TEST_NAMESPACE, projectName );
+  QVERIFY( spy.wait( TestUtils::LONG_REPLY ) );
+  QCOMPARE( mApi->lastSyncMetrics().value( "type" ).toString(), QStringLiteral( "pull" ) );
+
+  QFile metricsFile( mApi->syncMetricsFilePath() );
+  QVERIFY( metricsFile.open( QIODevice::ReadOnly ) );
+  QList<QByteArray> lines = metricsFile.readAll().trimmed().split( '\n' );
+  QCOMPARE( lines.count(), 2 );
+  QJsonObject pull = QJsonDocument::fromJson( lines.at( 1 ) ).object();
+  QCOMPARE( pull.value( "type" ).toString(), QStringLiteral( "pull" ) );
+  QJsonObject download = pull.value( "phases" ).toObject().value( SyncMetrics::Download ).toObject();
+  QCOMPARE( download.value( "count" ).toInt(), 1 );
+  QCOMPARE( download.value( "bytes" ).toInt(), 8 );
+}
+
+void TestMerginApiMock::testRateLimitedPull()
+{
+  // download of a file gets slowed down to the limit of the transaction
+
+  QString projectName = QStringLiteral( "testRateLimitedPull" );
+  QString projectFullName = TEST_NAMESPACE + "/" + projectName;
+  QString projectDir = createProject( projectName );
+
+  QByteArray content( 6 * 1024 * 1024, 'r' );
+  MockMerginServer::Project project = mServer.project( projectFullName );
+  project.version = 2;
+  project.files.insert( QStringLiteral( "data.bin" ), content );
+  mServer.setProject( projectFullName, project );
+
+  // the file is downloaded by a single request
+  AdaptiveChunkPolicy previousPolicy = mApi->mChunkPolicy;
+  mApi->mChunkPolicy = AdaptiveChunkPolicy();
+  mApi->setTransactionRateLimit( 2 * 1024 * 1024 );
+
+  QElapsedTimer timer;
+  timer.start();
+  QSignalSpy spy( mApi.get(), &MerginApi::syncProjectFinished );
+  mApi->updateProject( TEST_NAMESPACE, projectName );
+  QVERIFY( spy.wait( TestUtils::LONG_REPLY ) );
+  QVERIFY( spy.takeFirst().at( 2 ).toBool() );
+
+  // 1 MB goes right away and up to 1 MB is read at once when the reply finishes, the rest at 2 MB/s
+  QVERIFY( timer.elapsed() >= 1500 );
+
+  QFile f( projectDir + "/data.bin" );
+  QVERIFY( f.open( QIODevice::ReadOnly ) );
+  QVERIFY( f.readAll() == content );
+
+  mApi->setTransactionRateLimit( 0 );
+  mApi->mChunkPolicy = previousPolicy;
+}
+
+void TestMerginApiMock::testMeteredConnection()
+{
+  // on a metered connection large files that are not diffable are left out of syncs until the connection is not metered
+
+  QString projectName = QStringLiteral( "testMeteredConnection" );
+  QString projectFullName = TEST_NAMESPACE + "/" + projectName;
+  QString projectDir = createProject( projectName );
+
+  QByteArray photo( 2 * 1024 * 1024, 'p' );
+  MockMerginServer::Project project = mServer.project( projectFullName );
+  project.version = 2;
+  project.files.insert( QStringLiteral( "notes.txt" ), QByteArray( "notes" ) );
+  project.files.insert( QStringLiteral( "DCIM/photo.jpg" ), photo );
+  mServer.setProject( projectFullName, project );
+
+  mApi->setMeteredConnection( true );
+
+  QSignalSpy spy( mApi.get(), &MerginApi::syncProjectFinished );
+  mApi->updateProject( TEST_NAMESPACE, projectName );
+  QVERIFY( spy.wait( TestUtils::LONG_REPLY ) );
+  QVERIFY( spy.takeFirst().at( 2 ).toBool() );
+
+  QVERIFY( QFile::exists( projectDir + "/notes.txt" ) );
+  QVERIFY( !QFile::exists( projectDir + "/DCIM/photo.jpg" ) );
+  QVERIFY( mApi->hasDeferredFiles( projectFullName ) );
+  QCOMPARE( mLocalProjects->projectFromMerginName( projectFullName ).localVersion, 2 );
+
+  // the photo is not in local metadata, so it is not seen as removed locally
+  MerginProjectMetadata metadata = MerginProjectMetadata::fromJson( [&projectDir]
+  {
+    QFile f( projectDir + MerginApi::sMetadataFile );
+    f.open( QIODevice::ReadOnly );
+    return f.readAll();
+  }() );
+  QVERIFY( metadata.hasFile( QStringLiteral( "notes.txt" ) ) );
+  QVERIFY( !metadata.hasFile( QStringLiteral( "DCIM/photo.jpg" ) ) );
+  QVERIFY( MerginApi::localProjectChanges( projectDir ).localDeleted.isEmpty() );
+
+  // a new local photo does not get pushed, a small file does
+  QFile newPhoto( projectDir + "/DCIM/photo2.jpg" );
+  QDir().mkpath( projectDir + "/DCIM" );
+  QVERIFY( newPhoto.open( QIODevice::WriteOnly ) );
+  newPhoto.write( photo );
+  newPhoto.close();
+  QFile newNotes( projectDir + "/notes2.txt" );
+  QVERIFY( newNotes.open( QIODevice::WriteOnly ) );
+  newNotes.write( "more notes" );
+  newNotes.close();
+
+  QVERIFY( pushProject( projectName ) );
+  QVERIFY( mServer.project( projectFullName ).files.contains( QStringLiteral( "notes2.txt" ) ) );
+  QVERIFY( !mServer.project( projectFullName ).files.contains( QStringLiteral( "DCIM/photo2.jpg" ) ) );
+  QVERIFY( MerginApi::localProjectChanges( projectDir ).localAdded.contains( QStringLiteral( "DCIM/photo2.jpg" ) ) );
+
+  // without the metered connection the left out files get synced
+  mApi->setMeteredConnection( false );
+  QVERIFY( spy.wait( TestUtils::LONG_REPLY ) );
+  QVERIFY( spy.takeFirst().at( 2 ).toBool() );
+
+  QFile f( projectDir + "/DCIM/photo.jpg" );
+  QVERIFY( f.open( QIODevice::ReadOnly ) );
+  QVERIFY( f.readAll() == photo );
+  QVERIFY( mServer.project( projectFullName ).files.contains( QStringLiteral( "DCIM/photo2.jpg" ) ) );
+  QVERIFY( !mApi->hasDeferredFiles( projectFullName ) );
+
+  // a moved photo costs no data, so it is pushed as a rename even on the metered connection
+  mApi->setMeteredConnection( true );
+  QVERIFY( QDir().mkpath( projectDir + "/archive" ) );
+  QVERIFY( QFile::rename( projectDir + "/DCIM/photo.jpg", projectDir + "/archive/photo.jpg" ) );
+
+  mServer.resetCounters();
+  QVERIFY( pushProject( projectName ) );
+  QCOMPARE( mServer.chunkRequestCount(), 0 );
+  QVERIFY( !mServer.project( projectFullName ).files.contains( QStringLiteral( "DCIM/photo.jpg" ) ) );
+  QVERIFY( mServer.project( projectFullName ).files.value( QStringLiteral( "archive/photo.jpg" ) ) == photo );
+  QVERIFY( !mApi->hasDeferredFiles( projectFullName ) );
+  mApi->setMeteredConnection( false );
+}
+
+void TestMerginApiMock::testMovedFiles()
+{
+  // files moved locally are pushed as renames and files moved on the server are pulled from their local copies
+
+  QString projectName = QStringLiteral( "testMovedFiles" );
+  QString projectFullName = TEST_NAMESPACE + "/" + projectName;
+  QString projectDir = createProject( projectName );
+
+  QByteArray data( 512 * 1024, 'd' );
+  QByteArray notes( "notes" );
+  MockMerginServer::Project project = mServer.project( projectFullName );
+  project.version = 2;
+  project.files.insert( QStringLiteral( "data/data.bin" ), data );
+  project.files.insert( QStringLiteral( "notes.txt" ), notes );
+  mServer.setProject( projectFullName, project );
+
+  QSignalSpy spy( mApi.get(), &MerginApi::syncProjectFinished );
+  mApi->updateProject( TEST_NAMESPACE, projectName );
+  QVERIFY( spy.wait( TestUtils::LONG_REPLY ) );
+  QVERIFY( spy.takeFirst().at( 2 ).toBool() );
+
+  // move the file locally - nothing gets uploaded
+  QVERIFY( QDir().mkpath( projectDir + "/archive" ) );
+  QVERIFY( QFile::rename( projectDir + "/data/data.bin", projectDir + "/archive/data.bin" ) );
+
+  auto hasLocalChanges = [&projectDir]
+  {
+    ProjectDiff diff = MerginApi::localProjectChanges( projectDir );
+    return !diff.localAdded.isEmpty() || !diff.localUpdated.isEmpty() || !diff.localDeleted.isEmpty();
+  };
+  auto fileContent = [&projectDir]( const QString & path )
+  {
+    QFile f( projectDir + "/" + path );
+    f.open( QIODevice::ReadOnly );
+    return f.readAll();
+  };
+
+  ProjectDiff diff = MerginApi::localProjectChanges( projectDir );
+  MerginApi::findLocalRenames( diff, MerginProjectMetadata::fromJson( mServer.projectInfo( projectFullName ) ),
+                               MerginApi::getLocalProjectFiles( projectDir + "/" ) );
+  QCOMPARE( diff.localRenamed.value( QStringLiteral( "archive/data.bin" ) ), QStringLiteral( "data/data.bin" ) );
+
+  mServer.resetCounters();
+  QVERIFY( pushProject( projectName ) );
+  QCOMPARE( mServer.chunkRequestCount(), 0 );
+  project = mServer.project( projectFullName );
+  QCOMPARE( project.version, 3 );
+  QVERIFY( !project.files.contains( QStringLiteral( "data/data.bin" ) ) );
+  QVERIFY( project.files.value( QStringLiteral( "archive/data.bin" ) ) == data );
+  QVERIFY( !hasLocalChanges() );
+
+  // move and copy files on the server - nothing gets downloaded
+  project.files.insert( QStringLiteral( "docs/notes.txt" ), project.files.take( QStringLiteral( "notes.txt" ) ) );
+  project.files.insert( QStringLiteral( "backup/data.bin" ), data );
+  project.version = 4;
+  mServer.setProject( projectFullName, project );
+
+  mServer.resetCounters();
+  mApi->updateProject( TEST_NAMESPACE, projectName );
+  QVERIFY( spy.wait( TestUtils::LONG_REPLY ) );
+  QVERIFY( spy.takeFirst().at( 2 ).toBool() );
+  QCOMPARE( mServer.downloadRequestCount(), 0 );
+
+  QVERIFY( !QFile::exists( projectDir + "/notes.txt" ) );
+  QVERIFY( fileContent( QStringLiteral( "docs/notes.txt" ) ) == notes );
+  QVERIFY( fileContent( QStringLiteral( "archive/data.bin" ) ) == data );
+  QVERIFY( fileContent( QStringLiteral( "backup/data.bin" ) ) == data );
+  QCOMPARE( mLocalProjects->projectFromMerginName( projectFullName ).localVersion, 4 );
+  QVERIFY( !hasLocalChanges() );
+}
+
+void TestMerginApiMock::testInterruptedBasefile()
+{
+  // diffs that cannot be applied keep the old metadata and an interrupted basefile makes the next pull download the file
+
+  QString projectName = QStringLiteral( "testInterruptedBasefile" );
+  QString projectFullName = TEST_NAMESPACE + "/" + projectName;
+  QString projectDir = createProject( projectName );
+
+  QByteArray survey( "survey v2" );
+  MockMerginServer::Project project = mServer.project( projectFullName );
+  project.version = 2;
+  project.files.insert( QStringLiteral( "survey.gpkg" ), survey );
+  mServer.setProject( projectFullName, project );
+
+  QSignalSpy spy( mApi.get(), &MerginApi::syncProjectFinished );
+  mApi->updateProject( TEST_NAMESPACE, projectName );
+  QVERIFY( spy.wait( TestUtils::LONG_REPLY ) );
+  QVERIFY( spy.takeFirst().at( 2 ).toBool() );
+
+  auto fileContent = [&projectDir]( const QString & path )
+  {
+    QFile f( projectDir + "/" + path );
+    f.open( QIODevice::ReadOnly );
+    return f.readAll();
+  };
+
+  // a diff that cannot be applied - the file is reported as missing and stays untouched
+  QString tempDir = mDataDir.path() + "/temp" + projectName;
+  QVERIFY( QDir().mkpath( tempDir ) );
+  QFile diffFile( tempDir + "/1.diff" );
+  QVERIFY( diffFile.open( QIODevice::WriteOnly ) );
+  diffFile.write( "not a diff" );
+  diffFile.close();
+
+  DownloadQueueItem item( QStringLiteral( "survey.gpkg" ), 10, 3, -1, -1, true );
+  item.tempFileName = QStringLiteral( "1.diff" );
+  QList<UpdateTask> tasks = { UpdateTask( UpdateTask::ApplyDiffUnmodified, QStringLiteral( "survey.gpkg" ), { item } ) };
+  QSet<QString> missingFiles = MerginApi::runUpdateTasks( projectFullName, projectDir, tempDir, tasks, {}, QString(), {} );
+  QCOMPARE( missingFiles, QSet<QString>( { QStringLiteral( "survey.gpkg" ) } ) );
+  QVERIFY( fileContent( QStringLiteral( "survey.gpkg" ) ) == survey );
+
+  // an interrupted in-place update - the basefile cannot be used, so the file gets downloaded again
+  QVERIFY( QDir().mkpath( tempDir ) );
+  QVERIFY( diffFile.open( QIODevice::WriteOnly ) );
+  diffFile.write( "not a diff" );
+  diffFile.close();
+
+  BasefileStore basefiles( projectDir );
+  QVERIFY( !basefiles.applyDiffsInPlace( QStringLiteral( "survey.gpkg" ), { diffFile.fileName() } ) );
+  QVERIFY( basefiles.isInterrupted( QStringLiteral( "survey.gpkg" ) ) );
+  QVERIFY( QDir( tempDir ).removeRecursively() );
+
+  project = mServer.project( projectFullName );
+  project.version = 3;
+  project.files.insert( QStringLiteral( "notes.txt" ), QByteArray( "notes" ) );
+  mServer.setProject( projectFullName, project );
+
+  mServer.resetCounters();
+  mApi->updateProject( TEST_NAMESPACE, projectName );
+  QVERIFY( spy.wait( TestUtils::LONG_REPLY ) );
+  QVERIFY( spy.takeFirst().at( 2 ).toBool() );
+
+  // notes.txt and survey.gpkg
+  QCOMPARE( mServer.downloadRequestCount(), 2 );
+  QVERIFY( !basefiles.isInterrupted( QStringLiteral( "survey.gpkg" ) ) );
+  QVERIFY( fileContent( QStringLiteral( "survey.gpkg" ) ) == survey );
+  QCOMPARE( mLocalProjects->projectFromMerginName( projectFullName ).localVersion, 3 );
+}
+
+void TestMerginApiMock::testSharedContentStore()
+{
+  // a file pulled to one project is not downloaded again for other projects
+
+  QByteArray basemap( 1024 * 1024, 'b' );
+  QString checksum = QString::fromLatin1( QCryptographicHash::hash( basemap, QCryptographicHash::Sha1 ).toHex() );
+  ContentStore contentStore( ContentStore::storeDir( mDataDir.path() ) );
+
+  QStringList projectNames = { QStringLiteral( "testSharedContentStoreA" ), QStringLiteral( "testSharedContentStoreB" ), QStringLiteral( "testSharedContentStoreC" ) };
+  QStringList projectDirs;
+  for ( const QString &projectName : projectNames )
+  {
+    projectDirs << createProject( projectName );
+    MockMerginServer::Project project = mServer.project( TEST_NAMESPACE + "/" + projectName );
+    project.version = 2;
+    project.files.insert( QStringLiteral( "basemap.tif" ), basemap );
+    mServer.setProject( TEST_NAMESPACE + "/" + projectName, project );
+  }
+
+  auto pull = [this]( const QString & projectName )
+  {
+    QSignalSpy spy( mApi.get(), &MerginApi::syncProjectFinished );
+    mApi->updateProject( TEST_NAMESPACE, projectName );
+    return spy.wait( TestUtils::LONG_REPLY ) && spy.takeFirst().at( 2 ).toBool();
+  };
+  auto fileContent = []( const QString & path )
+  {
+    QFile f( path );
+    f.open( QIODevice::ReadOnly );
+    return f.readAll();
+  };
+
+  mApi->setSharedContentStore( true );
+
+  mServer.resetCounters();
+  QVERIFY( pull( projectNames[0] ) );
+  QVERIFY( mServer.downloadRequestCount() > 0 );
+  QVERIFY( contentStore.contains( checksum, basemap.size() ) );
+
+  mServer.resetCounters();
+  QVERIFY( pull( projectNames[1] ) );
+  QCOMPARE( mServer.downloadRequestCount(), 0 );
+  QVERIFY( fileContent( projectDirs[1] + "/basemap.tif" ) == basemap );
+  QCOMPARE( mLocalProjects->projectFromMerginName( TEST_NAMESPACE, projectNames[1] ).localVersion, 2 );
+
+  // a file modified in place must not spread to other projects nor to the store
+  QFile modified( projectDirs[1] + "/basemap.tif" );
+  QVERIFY( modified.open( QIODevice::ReadWrite ) );
+  modified.write( "modified" );
+  modified.close();
+  QVERIFY( fileContent( projectDirs[0] + "/basemap.tif" ) == basemap );
+
+  mServer.resetCounters();
+  QVERIFY( pull( projectNames[2] ) );
+  QCOMPARE( mServer.downloadRequestCount(), 0 );
+  QVERIFY( fileContent( projectDirs[2] + "/basemap.tif" ) == basemap );
+
+  // the object is removed with the last project that references it
+  mLocalProjects->removeLocalProject( TEST_NAMESPACE + "/" + projectNames[0] );
+  mLocalProjects->removeLocalProject( TEST_NAMESPACE + "/" + projectNames[1] );
+  QVERIFY( contentStore.contains( checksum, basemap.size() ) );
+  mLocalProjects->removeLocalProject( TEST_NAMESPACE + "/" + projectNames[2] );
+  QVERIFY( !QFile::exists( contentStore.objectPath( checksum ) ) );
+
+  // the store is removed in the sync worker
+  mApi->setSharedContentStore( false );
+  QTRY_VERIFY( !QFile::exists( ContentStore::storeDir( mDataDir.path() ) ) );
+}
+
+void TestMerginApiMock::testChangeJournal()
+{
+  // changes of local projects are journaled, so that scans only look at the changed paths
+
+  QString projectDir = createProject( QStringLiteral( "testChangeJournal" ) );
+  std::shared_ptr<ChangeJournal> journal = ChangeJournal::find( projectDir );
+  QVERIFY( journal );
+  if ( !journal->isExact() )
+    QSKIP( "Changes are not journaled exactly on this platform" );
+
+  auto writeFile = [&projectDir]( const QString & path, const QByteArray & content )
+  {
+    QDir().mkpath( QFileInfo( projectDir + "/" + path ).absolutePath() );
+    QFile f( projectDir + "/" + path );
+    f.open( QIODevice::WriteOnly );
+    f.write( content );
+  };
+  auto localFiles = [&projectDir]
+  {
+    QSet<QString> paths;
+    const QList<MerginFile> files = MerginApi::getLocalProjectFiles( projectDir + "/" );
+    for ( const MerginFile &file : files )
+      paths << file.path;
+    return paths;
+  };
+
+  // the first use needs a full scan
+  ChangeJournal::Cursor cursor;
+  QSet<QString> changes;
+  QVERIFY( !journal->changesSince( cursor, changes ) );
+  QVERIFY( journal->changesSince( cursor, changes ) );
+  QVERIFY( changes.isEmpty() );
+
+  writeFile( QStringLiteral( "notes.txt" ), "notes" );
+  writeFile( QStringLiteral( "photos/photo.jpg" ), "photo" );
+  writeFile( QStringLiteral( ".mergin/cache" ), "cache" );
+  QVERIFY( journal->changesSince( cursor, changes ) );
+  QVERIFY( changes.contains( QStringLiteral( "notes.txt" ) ) );
+  QVERIFY( changes.contains( QStringLiteral( "photos" ) ) );
+  QVERIFY( !changes.contains( QStringLiteral( ".mergin/cache" ) ) );
+  QCOMPARE( localFiles(), QSet<QString>( { QStringLiteral( "notes.txt" ), QStringLiteral( "photos/photo.jpg" ) } ) );
+
+  // files in new, moved and removed directories
+  writeFile( QStringLiteral( "photos/new/photo2.jpg" ), "photo2" );
+  QVERIFY( QDir( projectDir ).rename( QStringLiteral( "photos" ), QStringLiteral( "images" ) ) );
+  QCOMPARE( localFiles(), QSet<QString>( { QStringLiteral( "notes.txt" ), QStringLiteral( "images/photo.jpg" ), QStringLiteral( "images/new/photo2.jpg" ) } ) );
+
+  writeFile( QStringLiteral( "images/new/photo3.jpg" ), "photo3" );
+  QVERIFY( QDir( projectDir + "/images/new" ).removeRecursively() );
+  QVERIFY( QFile::remove( projectDir + "/notes.txt" ) );
+  QCOMPARE( localFiles(), QSet<QString>( { QStringLiteral( "images/photo.jpg" ) } ) );
+
+  // modified content gets hashed again
+  QByteArray checksum = MerginApi::getChecksum( projectDir + "/images/photo.jpg" );
+  writeFile( QStringLiteral( "images/photo.jpg" ), "modified photo" );
+  const QList<MerginFile> files = MerginApi::getLocalProjectFiles( projectDir + "/" );
+  QCOMPARE( files.count(), 1 );
+  QVERIFY( files.first().checksum.toLatin1() != checksum );
+}
+
+void TestMerginApiMock::testProjectStatusCache()
+{
+  // local changes of projects are checked in background and kept until the project changes
+
+  QString projectName = QStringLiteral( "testProjectStatusCache" );
+  QString projectDir = createProject( projectName );
+  ProjectStatusCache *cache = mLocalProjects->statusCache();
+  QSignalSpy spy( cache, &ProjectStatusCache::localChangesUpdated );
+
+  // not known yet - no changes are reported until the check finishes
+  QVERIFY( !cache->isKnown( projectDir ) );
+  QVERIFY( !cache->hasLocalChanges( projectDir ) );
+  QVERIFY( cache->isBusy() );
+  QTRY_VERIFY( cache->isKnown( projectDir ) );
+  QVERIFY( !cache->hasLocalChanges( projectDir ) );
+  QCOMPARE( spy.count(), 0 );
+
+  // a new file gets noticed without asking again
+  QFile f( projectDir + "/notes.txt" );
+  QVERIFY( f.open( QIODevice::WriteOnly ) );
+  f.write( "notes" );
+  f.close();
+  QVERIFY( spy.wait( TestUtils::LONG_REPLY ) );
+  QCOMPARE( spy.last().at( 0 ).toString(), projectDir );
+  QVERIFY( spy.last().at( 1 ).toBool() );
+  QVERIFY( cache->hasLocalChanges( projectDir ) );
+
+  // the push updates the local version which invalidates the result
+  QVERIFY( pushProject( projectName ) );
+  QTRY_VERIFY( cache->isKnown( projectDir ) && !cache->isBusy() );
+  QVERIFY( !cache->hasLocalChanges( projectDir ) );
+  QVERIFY( !spy.last().at( 1 ).toBool() );
+
+  mLocalProjects->removeLocalProject( TEST_NAMESPACE + "/" + projectName );
+  QVERIFY( !cache->isKnown( projectDir ) );
+}
+
+void TestMerginApiMock::testLocalProjectLookups()
+{
+  // local projects are found by all their keys after they get renamed, removed or added again
+
+  QStringList projectNames = { QStringLiteral( "testLookupsA" ), QStringLiteral( "testLookupsB" ), QStringLiteral( "testLookupsC" ) };
+  QStringList projectDirs;
+  int projectCount = mLocalProjects->projects().count();
+  for ( const QString &projectName : projectNames )
+  {
+    QString projectDir = mDataDir.path() + "/" + projectName;
+    QVERIFY( QDir().mkpath( projectDir ) );
+    QFile qgisProject( projectDir + "/project.qgs" );
+    QVERIFY( qgisProject.open( QIODevice::WriteOnly ) );
+    qgisProject.close();
+    mLocalProjects->addMerginProject( projectDir, TEST_NAMESPACE, projectName );
+    projectDirs << projectDir;
+  }
+  QCOMPARE( mLocalProjects->projects().count(), projectCount + 3 );
+
+  auto isFound = [this]( const QString & projectDir, const QString & projectFullName )
+  {
+    return mLocalProjects->projectFromDirectory( projectDir ).projectDir == projectDir &&
+           mLocalProjects->projectFromProjectFilePath( projectDir + "/project.qgs" ).projectDir == projectDir &&
+           mLocalProjects->projectFromMerginName( projectFullName ).projectDir == projectDir;
+  };
+  for ( int i = 0; i < projectNames.count(); ++i )
+    QVERIFY( isFound( projectDirs[i], TEST_NAMESPACE + "/" + projectNames[i] ) );
+
+  // the full name changes with the namespace
+  mLocalProjects->updateNamespace( projectDirs[1], QStringLiteral( "otherNamespace" ) );
+  QVERIFY( !mLocalProjects->projectFromMerginName( TEST_NAMESPACE, projectNames[1] ).isValid() );
+  QVERIFY( isFound( projectDirs[1], QStringLiteral( "otherNamespace/" ) + projectNames[1] ) );
+  QVERIFY( isFound( projectDirs[2], TEST_NAMESPACE + "/" + projectNames[2] ) );
+
+  // projects listed after a removed one are still found
+  mLocalProjects->removeLocalProject( TEST_NAMESPACE + "/" + projectNames[0] );
+  QVERIFY( !mLocalProjects->projectFromDirectory( projectDirs[0] ).isValid() );
+  QVERIFY( !mLocalProjects->projectFromProjectFilePath( projectDirs[0] + "/project.qgs" ).isValid() );
+  QVERIFY( !mLocalProjects->projectFromMerginName( TEST_NAMESPACE, projectNames[0] ).isValid() );
+  QVERIFY( isFound( projectDirs[1], QStringLiteral( "otherNamespace/" ) + projectNames[1] ) );
+  QVERIFY( isFound( projectDirs[2], TEST_NAMESPACE + "/" + projectNames[2] ) );
+  QCOMPARE( mLocalProjects->projects().count(), projectCount + 2 );
+
+  // a directory that is listed already replaces its project
+  mLocalProjects->addMerginProject( projectDirs[1], TEST_NAMESPACE, projectNames[1] );
+  QCOMPARE( mLocalProjects->projects().count(), projectCount + 2 );
+  QVERIFY( !mLocalProjects->projectFromMerginName( QStringLiteral( "otherNamespace" ), projectNames[1] ).isValid() );
+  QVERIFY( isFound( projectDirs[1], TEST_NAMESPACE + "/" + projectNames[1] ) );
+  QVERIFY( isFound( projectDirs[2], TEST_NAMESPACE + "/" + projectNames[2] ) );
+
+  mLocalProjects->removeLocalProject( TEST_NAMESPACE + "/" + projectNames[1] );
+  mLocalProjects->removeLocalProject( TEST_NAMESPACE + "/" + projectNames[2] );
+  QCOMPARE( mLocalProjects->projects().count(), projectCount );
+}
+
+QString TestMerginApiMock::createProject( const QString &projectName )
+{
+  QString projectFullName = TEST_NAMESPACE + "/" + projectName;
+  MockMerginServer::Project project;
+  project.version = 1;
+  mServer.setProject( projectFullName, project );
+
+  QString projectDir = mDataDir.path() + "/" + projectName;
+  QDir().mkpath( projectDir + "/.mergin" );
+  QFile metadata( projectDir + MerginApi::sMetadataFile );
+  if ( metadata.open( QIODevice::WriteOnly ) )
+    metadata.write( mServer.projectInfo( projectFullName ) );
+  metadata.close();
+
+  mLocalProjects->addMerginProject( projectDir, TEST_NAMESPACE, projectName );
+  return projectDir;
+}
+
+bool TestMerginApiMock::pushProject( const QString &projectName )
+{
+  QSignalSpy spy( mApi.get(), &MerginApi::syncProjectFinished );
+  mApi->uploadProject( TEST_NAMESPACE, projectName );
+  if ( !spy.wait( TestUtils::LONG_REPLY ) )
+    return false;
+  return spy.takeFirst().at( 2 ).toBool();
+}
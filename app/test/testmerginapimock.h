@@ -0,0 +1,70 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef TESTMERGINAPIMOCK_H
+#define TESTMERGINAPIMOCK_H
+
+#include <QObject>
+#include <QTemporaryDir>
+
+#include <memory>
+
+#include "mockmerginserver.h"
+
+class LocalProjectsManager;
+class MerginApi;
+
+/**
+ * Tests of MerginApi running against MockMerginServer - for scenarios that need
+ * failures injected on the server side.
+ */
+class TestMerginApiMock: public QObject
+{
+    Q_OBJECT
+  public:
+    TestMerginApiMock() = default;
+    ~TestMerginApiMock();
+
+  private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void testResumePush();
+    void testParallelUpload();
+    void testSyncQueue();
+    void testResumedDownloadChunks();
+    void testAdaptiveUploadChunks();
+    void testCompressedUpload();
+    void testCompressedUploadRejected();
+    void testProjectListCache();
+    void testProjectMetadataCache();
+    void testPullProject();
+    void testSyncMetrics();
+    void testRateLimitedPull();
+    void testMeteredConnection();
+    void testMovedFiles();
+    void testInterruptedBasefile();
+    void testSharedContentStore();
+    void testChangeJournal();
+    void testProjectStatusCache();
+    void testLocalProjectLookups();
+
+  private:
+    //! Creates a local project that is in sync with the project on the mock server (no files)
+    QString createProject( const QString &projectName );
+    //! Pushes a local project and waits until it is finished, returns whether it succeeded
+    bool pushProject( const QString &projectName );
+
+    QTemporaryDir mDataDir;
+    MockMerginServer mServer;
+    std::unique_ptr<LocalProjectsManager> mLocalProjects;
+    std::unique_ptr<MerginApi> mApi;
+};
+
+#endif // TESTMERGINAPIMOCK_H
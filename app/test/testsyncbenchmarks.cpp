@@ -0,0 +1,255 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "testsyncbenchmarks.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QSignalSpy>
+#include <QtTest/QtTest>
+
+#include <geodiff.h>
+
+#include "localprojectsmanager.h"
+#include "merginapi.h"
+#include "merginuserauth.h"
+#include "testutils.h"
+
+static const QString BENCHMARK_NAMESPACE = QStringLiteral( "benchmark" );
+static const int SMALL_FILES_COUNT = 2000;
+static const int LARGE_FILES_COUNT = 2;
+static const int LARGE_FILE_SIZE = 64 * 1024 * 1024;
+static const int GPKG_DIFFS_COUNT = 41;  // odd - the last version differs from the first one
+
+static QByteArray readFile( const QString &filePath )
+{
+  QFile f( filePath );
+  if ( !f.open( QIODevice::ReadOnly ) )
+    return QByteArray();
+  return f.readAll();
+}
+
+TestSyncBenchmarks::~TestSyncBenchmarks() = default;
+
+void TestSyncBenchmarks::initTestCase()
+{
+  QVERIFY( mDataDir.isValid() );
+  QVERIFY( mServer.listen() );
+
+  mLocalProjects.reset( new LocalProjectsManager( mDataDir.path() ) );
+  mApi.reset( new MerginApi( *mLocalProjects ) );
+  mApi->mApiRoot = mServer.url();
+  mApi->mApiVersionStatus = MerginApiStatus::OK;
+
+  // the mock server does not check authentication, we only need the client to think it is logged in
+  // (signals are blocked so that the fake credentials do not get stored in settings)
+  mApi->userAuth()->blockSignals( true );
+  mApi->userAuth()->setUsername( BENCHMARK_NAMESPACE );
+  mApi->userAuth()->setPassword( QStringLiteral( "password" ) );
+  mApi->userAuth()->setAuthToken( QByteArray( "token" ) );
+  mApi->userAuth()->setTokenExpiration( QDateTime::currentDateTimeUtc().addDays( 1 ) );
+  mApi->userAuth()->blockSignals( false );
+
+  // many small files of various sizes in a few folders
+  QMap<QString, QByteArray> smallFiles;
+  quint32 seed = 1;
+  for ( int i = 0; i < SMALL_FILES_COUNT; ++i )
+  {
+    seed = seed * 1103515245 + 12345;
+    int size = 1024 + static_cast<int>( ( seed >> 8 ) % ( 15 * 1024 ) );
+    smallFiles.insert( QStringLiteral( "dir%1/file%2.dat" ).arg( i % 20 ).arg( i ), QByteArray( size, static_cast<char>( seed ) ) );
+  }
+  mDataSets.insert( QStringLiteral( "small-files" ), smallFiles );
+
+  // a few huge files (with content that does not repeat within chunks)
+  QMap<QString, QByteArray> largeFiles;
+  for ( int i = 0; i < LARGE_FILES_COUNT; ++i )
+  {
+    QByteArray content;
+    content.reserve( LARGE_FILE_SIZE );
+    for ( int offset = 0; content.size() < LARGE_FILE_SIZE; offset += 16 )
+      content.append( QByteArray::number( offset ).rightJustified( 15, ' ' ) + static_cast<char>( 'a' + i ) );
+    largeFiles.insert( QStringLiteral( "raster%1.tif" ).arg( i ), content );
+  }
+  mDataSets.insert( QStringLiteral( "large-files" ), largeFiles );
+
+  // geopackage with a long history: a row gets added and removed again, over and over
+  QTemporaryDir tempDir;
+  QVERIFY( tempDir.isValid() );
+  QString base = TestUtils::testDataDir() + "/diff_project/base.gpkg";
+  QString addedRow = TestUtils::testDataDir() + "/added_row.gpkg";
+  QString addDiff = tempDir.path() + "/add.diff";
+  QString removeDiff = tempDir.path() + "/remove.diff";
+  QCOMPARE( GEODIFF_createChangeset( base.toUtf8(), addedRow.toUtf8(), addDiff.toUtf8() ), GEODIFF_SUCCESS );
+  QCOMPARE( GEODIFF_createChangeset( addedRow.toUtf8(), base.toUtf8(), removeDiff.toUtf8() ), GEODIFF_SUCCESS );
+
+  mGpkgBase = readFile( base );
+  mGpkgLast = readFile( addedRow );
+  QVERIFY( !mGpkgBase.isEmpty() && !mGpkgLast.isEmpty() );
+  for ( int i = 0; i < GPKG_DIFFS_COUNT; ++i )
+    mGpkgDiffs << readFile( i % 2 == 0 ? addDiff : removeDiff );
+}
+
+void TestSyncBenchmarks::cleanupTestCase()
+{
+  mApi.reset();
+  mLocalProjects.reset();
+}
+
+void TestSyncBenchmarks::benchmarkPull_data()
+{
+  QTest::addColumn<QString>( "dataSet" );
+
+  QTest::newRow( "small-files" ) << QStringLiteral( "small-files" );
+  QTest::newRow( "large-files" ) << QStringLiteral( "large-files" );
+  QTest::newRow( "gpkg-diffs" ) << QStringLiteral( "gpkg-diffs" );
+}
+
+void TestSyncBenchmarks::benchmarkPull()
+{
+  QFETCH( QString, dataSet );
+
+  QString projectName = QStringLiteral( "pull-" ) + dataSet;
+  QString projectFullName = BENCHMARK_NAMESPACE + "/" + projectName;
+
+  MockMerginServer::Project project;
+  project.version = 1;
+  if ( dataSet == QStringLiteral( "gpkg-diffs" ) )
+    project.files.insert( QStringLiteral( "survey.gpkg" ), mGpkgBase );
+  mServer.setProject( projectFullName, project );
+
+  QString projectDir = createLocalProject( projectName );
+
+  if ( dataSet == QStringLiteral( "gpkg-diffs" ) )
+  {
+    for ( const QByteArray &diff : qAsConst( mGpkgDiffs ) )
+    {
+      ++project.version;
+      project.diffs[QStringLiteral( "survey.gpkg" )].insert( project.version, diff );
+    }
+    project.files.insert( QStringLiteral( "survey.gpkg" ), mGpkgLast );
+  }
+  else
+  {
+    project.version = 2;
+    project.files = mDataSets.value( dataSet );
+  }
+  mServer.setProject( projectFullName, project );
+
+  QVERIFY( runSync( projectName, false ) );
+
+  // diffs are much smaller than the file, other files are downloaded as they are
+  qint64 filesSize = 0;
+  for ( const QByteArray &content : qAsConst( project.files ) )
+    filesSize += content.size();
+  if ( dataSet == QStringLiteral( "gpkg-diffs" ) )
+    QVERIFY( mServer.bytesSent() < filesSize );
+  else
+    QVERIFY( mServer.bytesSent() >= filesSize );
+
+  for ( auto it = project.files.constBegin(); it != project.files.constEnd(); ++it )
+  {
+    QVERIFY( QFile::exists( projectDir + "/" + it.key() ) );
+    if ( dataSet != QStringLiteral( "gpkg-diffs" ) )  // geodiff does not write the same bytes
+      QCOMPARE( QFileInfo( projectDir + "/" + it.key() ).size(), static_cast<qint64>( it.value().size() ) );
+  }
+  QCOMPARE( mLocalProjects->projectFromMerginName( projectFullName ).localVersion, project.version );
+}
+
+void TestSyncBenchmarks::benchmarkPush_data()
+{
+  QTest::addColumn<QString>( "dataSet" );
+
+  QTest::newRow( "small-files" ) << QStringLiteral( "small-files" );
+  QTest::newRow( "large-files" ) << QStringLiteral( "large-files" );
+}
+
+void TestSyncBenchmarks::benchmarkPush()
+{
+  QFETCH( QString, dataSet );
+
+  QString projectName = QStringLiteral( "push-" ) + dataSet;
+  QString projectFullName = BENCHMARK_NAMESPACE + "/" + projectName;
+
+  MockMerginServer::Project project;
+  project.version = 1;
+  mServer.setProject( projectFullName, project );
+
+  QString projectDir = createLocalProject( projectName );
+  const QMap<QString, QByteArray> files = mDataSets.value( dataSet );
+  for ( auto it = files.constBegin(); it != files.constEnd(); ++it )
+  {
+    QDir().mkpath( QFileInfo( projectDir + "/" + it.key() ).absolutePath() );
+    QFile f( projectDir + "/" + it.key() );
+    QVERIFY( f.open( QIODevice::WriteOnly ) );
+    f.write( it.value() );
+  }
+
+  QVERIFY( runSync( projectName, true ) );
+  QVERIFY( mServer.chunkRequestCount() > 0 );
+
+  project = mServer.project( projectFullName );
+  QCOMPARE( project.version, 2 );
+  QCOMPARE( project.files.count(), files.count() );
+}
+
+QString TestSyncBenchmarks::createLocalProject( const QString &projectName )
+{
+  QString projectFullName = BENCHMARK_NAMESPACE + "/" + projectName;
+  QString projectDir = mDataDir.path() + "/" + projectName;
+  QDir().mkpath( projectDir + "/.mergin" );
+
+  const MockMerginServer::Project project = mServer.project( projectFullName );
+  for ( auto it = project.files.constBegin(); it != project.files.constEnd(); ++it )
+  {
+    // diffable files need their basefile too
+    for ( const QString &path : { projectDir + "/" + it.key(), projectDir + "/.mergin/" + it.key() } )
+    {
+      QDir().mkpath( QFileInfo( path ).absolutePath() );
+      QFile f( path );
+      if ( f.open( QIODevice::WriteOnly ) )
+        f.write( it.value() );
+    }
+  }
+
+  QFile metadata( projectDir + MerginApi::sMetadataFile );
+  if ( metadata.open( QIODevice::WriteOnly ) )
+    metadata.write( mServer.projectInfo( projectFullName ) );
+  metadata.close();
+
+  mLocalProjects->addMerginProject( projectDir, BENCHMARK_NAMESPACE, projectName );
+  return projectDir;
+}
+
+bool TestSyncBenchmarks::runSync( const QString &projectName, bool push )
+{
+  mServer.resetCounters();
+  QSignalSpy spy( mApi.get(), &MerginApi::syncProjectFinished );
+
+  QElapsedTimer timer;
+  timer.start();
+  if ( push )
+    mApi->uploadProject( BENCHMARK_NAMESPACE, projectName );
+  else
+    mApi->updateProject( BENCHMARK_NAMESPACE, projectName );
+
+  if ( !spy.wait( TestUtils::LONG_REPLY ) || !spy.takeFirst().at( 2 ).toBool() )
+    return false;
+  qint64 elapsedMs = qMax( timer.elapsed(), static_cast<qint64>( 1 ) );
+
+  // QTest takes a single result per benchmark - the traffic is reported next to it
+  qInfo().noquote() << QStringLiteral( "%1: %2 bytes moved, %3 requests" )
+                    .arg( QString::fromLatin1( QTest::currentDataTag() ) )
+                    .arg( mServer.bytesSent() + mServer.bytesReceived() )
+                    .arg( mServer.requestCount() );
+  QTest::setBenchmarkResult( elapsedMs, QTest::WalltimeMilliseconds );
+  return true;
+}
@@ -0,0 +1,73 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef TESTSYNCBENCHMARKS_H
+#define TESTSYNCBENCHMARKS_H
+
+#include <QMap>
+#include <QObject>
+#include <QTemporaryDir>
+
+#include <memory>
+
+#include "mockmerginserver.h"
+
+class LocalProjectsManager;
+class MerginApi;
+
+/**
+ * Benchmarks of whole pulls and pushes against MockMerginServer on localhost, so that they do not
+ * depend on a live server. Each data set is synced once - the wall time is the benchmark result,
+ * bytes moved (requests and responses including headers) and the number of requests are reported
+ * by qInfo() next to it.
+ *
+ * Data sets (generated when the test case starts):
+ * - small-files: 2000 files of 1-16 KB in 20 folders
+ * - large-files: two files of 64 MB
+ * - gpkg-diffs: a geopackage with a history of 41 diffs (pull only - the mock server does not take diffs)
+ */
+class TestSyncBenchmarks: public QObject
+{
+    Q_OBJECT
+  public:
+    TestSyncBenchmarks() = default;
+    ~TestSyncBenchmarks();
+
+  private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void benchmarkPull_data();
+    void benchmarkPull();
+
+    void benchmarkPush_data();
+    void benchmarkPush();
+
+  private:
+    //! Creates a local project in sync with the current version of the project on the server
+    QString createLocalProject( const QString &projectName );
+
+    /**
+     * Runs pull or push of the project and waits for it. Sets the wall time as the benchmark result
+     * and reports bytes moved and requests issued by qInfo(). Returns whether the sync succeeded.
+     */
+    bool runSync( const QString &projectName, bool push );
+
+    QTemporaryDir mDataDir;
+    MockMerginServer mServer;
+    std::unique_ptr<LocalProjectsManager> mLocalProjects;
+    std::unique_ptr<MerginApi> mApi;
+
+    QMap<QString, QMap<QString, QByteArray> > mDataSets;  //!< name -> path -> content
+    QByteArray mGpkgBase;  //!< first version of the geopackage
+    QByteArray mGpkgLast;  //!< version of the geopackage after all diffs
+    QList<QByteArray> mGpkgDiffs;  //!< changesets of the following versions
+};
+
+#endif // TESTSYNCBENCHMARKS_H
@@ -21,6 +21,10 @@
 #include "qgsunittypes.h"
 
 #include "testutils.h"
+#include "adaptivechunkpolicy.h"
+#include "coreutils.h"
+#include "httpcompression.h"
+#include "ratelimiter.h"
 
 #include <QtTest/QtTest>
 #include <QtCore/QObject>
@@ -162,6 +166,151 @@ void TestUtilsFunctions::fileExists()
   QVERIFY( mUtils->fileExists( path ) );
 }
 
+void TestUtilsFunctions::cloneFile()
+{
+  QTemporaryDir dir;
+  QString src = dir.path() + "/src.txt";
+  QString dest = dir.path() + "/dest.txt";
+
+  QFile f( src );
+  QVERIFY( f.open( QIODevice::WriteOnly ) );
+  f.write( "hello world" );
+  f.close();
+
+  QVERIFY( CoreUtils::cloneFile( src, dest ) );
+  QFile fDest( dest );
+  QVERIFY( fDest.open( QIODevice::ReadOnly ) );
+  QCOMPARE( fDest.readAll(), QByteArray( "hello world" ) );
+  fDest.close();
+
+  // the clone is independent of the source
+  QVERIFY( f.open( QIODevice::WriteOnly | QIODevice::Append ) );
+  f.write( "!" );
+  f.close();
+  QVERIFY( fDest.open( QIODevice::ReadOnly ) );
+  QCOMPARE( fDest.readAll(), QByteArray( "hello world" ) );
+  fDest.close();
+
+  // existing destination is not overwritten
+  QVERIFY( !CoreUtils::cloneFile( src, dest ) );
+}
+
+void TestUtilsFunctions::replaceFile()
+{
+  QTemporaryDir dir;
+  QString src = dir.path() + "/src.txt";
+  QString dest = dir.path() + "/dest.txt";
+
+  auto writeFile = []( const QString & path, const QByteArray & content )
+  {
+    QFile f( path );
+    QVERIFY( f.open( QIODevice::WriteOnly ) );
+    f.write( content );
+  };
+  auto readFile = []( const QString & path )
+  {
+    QFile f( path );
+    f.open( QIODevice::ReadOnly );
+    return f.readAll();
+  };
+
+  // the destination gets created or replaced
+  writeFile( src, "first" );
+  QVERIFY( CoreUtils::replaceFile( src, dest ) );
+  QCOMPARE( readFile( dest ), QByteArray( "first" ) );
+  QVERIFY( !QFile::exists( src ) );
+
+  writeFile( src, "second" );
+  QVERIFY( CoreUtils::replaceFile( src, dest ) );
+  QCOMPARE( readFile( dest ), QByteArray( "second" ) );
+  QCOMPARE( QDir( dir.path() ).entryList( QDir::Files ), QStringList() << QStringLiteral( "dest.txt" ) );
+
+  // the old file is kept when there is nothing to move
+  QVERIFY( !CoreUtils::replaceFile( src, dest ) );
+  QCOMPARE( readFile( dest ), QByteArray( "second" ) );
+}
+
+void TestUtilsFunctions::adaptiveChunkPolicy()
+{
+  const qint64 MB = 1024 * 1024;
+
+  // nothing measured yet
+  AdaptiveChunkPolicy policy;
+  QVERIFY( !policy.hasEstimate() );
+  QCOMPARE( policy.downloadChunkSize(), AdaptiveChunkPolicy::DEFAULT_CHUNK_SIZE );
+  QCOMPARE( policy.uploadChunkSize(), AdaptiveChunkPolicy::DEFAULT_CHUNK_SIZE );
+
+  // 1 MB/s -> requests of 3 seconds
+  policy.addSample( MB, 1000 );
+  QCOMPARE( policy.downloadChunkSize(), 3 * MB );
+  QCOMPARE( policy.uploadChunkSize(), 3 * MB );
+
+  // a failed request halves the chunks
+  policy.addFailure();
+  QCOMPARE( policy.downloadChunkSize(), 3 * MB / 2 );
+
+  // high latency makes the requests longer
+  AdaptiveChunkPolicy latencyPolicy;
+  latencyPolicy.addSample( MB, 1000, 1000 );
+  QCOMPARE( latencyPolicy.downloadChunkSize(), 9 * MB );
+
+  // fast connection - upload chunks are limited by the server
+  AdaptiveChunkPolicy fastPolicy;
+  fastPolicy.addSample( 100 * MB, 1000 );
+  QCOMPARE( fastPolicy.downloadChunkSize(), AdaptiveChunkPolicy::MAX_DOWNLOAD_CHUNK_SIZE );
+  QCOMPARE( fastPolicy.uploadChunkSize(), AdaptiveChunkPolicy::MAX_UPLOAD_CHUNK_SIZE );
+
+  // very slow connection
+  AdaptiveChunkPolicy slowPolicy;
+  slowPolicy.addSample( 100 * 1024, 10000 );
+  QCOMPARE( slowPolicy.downloadChunkSize(), AdaptiveChunkPolicy::MIN_CHUNK_SIZE );
+}
+
+void TestUtilsFunctions::rateLimiter()
+{
+  // not limited
+  RateLimiter unlimited;
+  QCOMPARE( unlimited.available( 1000000, 0 ), static_cast<qint64>( 1000000 ) );
+  unlimited.consume( 1000000, 0 );
+  QCOMPARE( unlimited.delay( 1000000, 0 ), static_cast<qint64>( 0 ) );
+
+  // 100 kB/s - the bucket starts full with data for half a second
+  RateLimiter limiter;
+  limiter.setRate( 100000 );
+  QCOMPARE( limiter.burstSize(), static_cast<qint64>( 50000 ) );
+  QCOMPARE( limiter.available( 80000, 1000 ), static_cast<qint64>( 50000 ) );
+
+  limiter.consume( 50000, 1000 );
+  QCOMPARE( limiter.available( 80000, 1000 ), static_cast<qint64>( 0 ) );
+  QCOMPARE( limiter.delay( 10000, 1000 ), static_cast<qint64>( 100 ) );
+  QCOMPARE( limiter.available( 80000, 1100 ), static_cast<qint64>( 10000 ) );
+
+  // a pause does not let more data than the burst size through
+  QCOMPARE( limiter.available( 80000, 10000 ), static_cast<qint64>( 50000 ) );
+
+  // debt has to be paid first
+  limiter.consume( 150000, 10000 );
+  QCOMPARE( limiter.available( 80000, 10500 ), static_cast<qint64>( 0 ) );
+  QCOMPARE( limiter.delay( 1, 10500 ), static_cast<qint64>( 501 ) );
+  QCOMPARE( limiter.available( 80000, 11500 ), static_cast<qint64>( 50000 ) );
+}
+
+void TestUtilsFunctions::httpCompression()
+{
+  QVERIFY( HttpCompression::acceptsEncoding( "gzip, deflate", "deflate" ) );
+  QVERIFY( HttpCompression::acceptsEncoding( "*", "deflate" ) );
+  QVERIFY( !HttpCompression::acceptsEncoding( "gzip", "deflate" ) );
+  QVERIFY( !HttpCompression::acceptsEncoding( "gzip, deflate;q=0", "deflate" ) );
+  QVERIFY( HttpCompression::isCompressedFormat( "photos/IMG_001.JPG" ) );
+  QVERIFY( !HttpCompression::isCompressedFormat( "data.csv" ) );
+
+  QByteArray csv;
+  for ( int i = 0; i < 20000; ++i )
+    csv.append( QStringLiteral( "%1,point %1,%2\n" ).arg( i ).arg( i % 7 ).toUtf8() );
+  QByteArray compressed = HttpCompression::compress( csv );
+  QVERIFY( compressed.size() < csv.size() / 2 );
+  QCOMPARE( HttpCompression::decompress( compressed ), csv );
+}
 
 void TestUtilsFunctions::loadQmlComponent()
 {
@@ -29,6 +29,11 @@ class TestUtilsFunctions: public QObject
     void formatDistance();
     void loadIcon();
     void fileExists();
+    void cloneFile();
+    void replaceFile();
+    void adaptiveChunkPolicy();
+    void rateLimiter();
+    void httpCompression();
     void loadQmlComponent();
     void getRelativePath();
     void resolvePhotoPath();
@@ -0,0 +1,64 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "adaptivechunkpolicy.h"
+
+#include <QElapsedTimer>
+
+// weight of a new measurement in the averages
+static const qreal SMOOTHING = 0.3;
+// chunks should take at least this many times the latency, so the waiting is a small part of each request
+static const int LATENCY_FACTOR = 9;
+// requests smaller than this say more about the latency than about the throughput
+static const qint64 MIN_SAMPLE_SIZE = 64 * 1024;
+// sizes are rounded to multiples of this
+static const qint64 CHUNK_ALIGNMENT = 64 * 1024;
+
+void AdaptiveChunkPolicy::addSample( qint64 bytes, qint64 durationMs, qint64 latencyMs )
+{
+  durationMs = qMax( static_cast<qint64>( 1 ), durationMs );
+
+  if ( latencyMs >= 0 )
+    mLatency = mLatency < 0 ? latencyMs : ( 1 - SMOOTHING ) * mLatency + SMOOTHING * latencyMs;
+
+  if ( bytes < MIN_SAMPLE_SIZE )
+    return;
+
+  qreal throughput = static_cast<qreal>( bytes ) / durationMs;
+  mThroughput = mThroughput <= 0 ? throughput : ( 1 - SMOOTHING ) * mThroughput + SMOOTHING * throughput;
+}
+
+void AdaptiveChunkPolicy::addFailure()
+{
+  if ( mThroughput <= 0 )
+    mThroughput = static_cast<qreal>( DEFAULT_CHUNK_SIZE ) / mTargetRequestDuration;
+  mThroughput /= 2;
+}
+
+qint64 AdaptiveChunkPolicy::timestamp()
+{
+  static const QElapsedTimer timer = []
+  {
+    QElapsedTimer t;
+    t.start();
+    return t;
+  }();
+  return timer.elapsed();
+}
+
+qint64 AdaptiveChunkPolicy::chunkSize( qint64 maxSize ) const
+{
+  if ( mThroughput <= 0 )
+    return qMin( DEFAULT_CHUNK_SIZE, maxSize );
+
+  qreal duration = qMax( static_cast<qreal>( mTargetRequestDuration ), LATENCY_FACTOR * mLatency );
+  qint64 size = static_cast<qint64>( mThroughput * duration );
+  size = size / CHUNK_ALIGNMENT * CHUNK_ALIGNMENT;
+  return qBound( MIN_CHUNK_SIZE, size, maxSize );
+}
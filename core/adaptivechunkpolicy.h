@@ -0,0 +1,71 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef ADAPTIVECHUNKPOLICY_H
+#define ADAPTIVECHUNKPOLICY_H
+
+#include <QtGlobal>
+
+/**
+ * Picks sizes of download ranges and upload chunks from the measured speed of the connection.
+ *
+ * Each finished download/upload request is reported with its size and duration. The policy keeps
+ * exponentially weighted averages of the throughput of a single request and of the latency
+ * (time until the first byte of the response) and aims at requests that take about targetRequestDuration():
+ * on a slow link a failed request then does not waste much data, on a fast link the per-request
+ * overhead stays low. Chunks are always at least a few times larger than what would be transferred
+ * during the latency. A failed request halves the throughput estimate.
+ *
+ * Until there is any measurement, the default chunk size is used (the fixed size used before).
+ */
+class AdaptiveChunkPolicy
+{
+  public:
+    static constexpr qint64 MIN_CHUNK_SIZE = 256 * 1024;
+    static constexpr qint64 DEFAULT_CHUNK_SIZE = 10 * 1024 * 1024;
+    static constexpr qint64 MAX_DOWNLOAD_CHUNK_SIZE = 64 * 1024 * 1024;
+    static constexpr qint64 MAX_UPLOAD_CHUNK_SIZE = 10 * 1024 * 1024;  //!< larger chunks are rejected by the server
+
+    /**
+     * Records a successfully finished request that transferred \a bytes in \a durationMs.
+     * \a latencyMs is the time until the first byte of the response arrived (-1 if not known).
+     */
+    void addSample( qint64 bytes, qint64 durationMs, qint64 latencyMs = -1 );
+
+    //! Records a request that failed because of the connection - chunks get smaller
+    void addFailure();
+
+    //! Whether there is any measurement yet
+    bool hasEstimate() const { return mThroughput > 0; }
+
+    //! Estimated throughput of a single request in bytes per second (-1 if unknown)
+    qreal throughput() const { return mThroughput > 0 ? mThroughput * 1000 : -1; }
+
+    //! Estimated latency in milliseconds (-1 if unknown)
+    qreal latency() const { return mLatency; }
+
+    qint64 downloadChunkSize() const { return chunkSize( MAX_DOWNLOAD_CHUNK_SIZE ); }
+    qint64 uploadChunkSize() const { return chunkSize( MAX_UPLOAD_CHUNK_SIZE ); }
+
+    //! How long should a single request take (in milliseconds)
+    int targetRequestDuration() const { return mTargetRequestDuration; }
+    void setTargetRequestDuration( int msecs ) { mTargetRequestDuration = msecs; }
+
+    //! Returns a monotonic timestamp in milliseconds to measure duration of requests
+    static qint64 timestamp();
+
+  private:
+    qint64 chunkSize( qint64 maxSize ) const;
+
+    qreal mThroughput = -1;  //!< bytes per millisecond
+    qreal mLatency = -1;  //!< milliseconds
+    int mTargetRequestDuration = 3000;
+};
+
+#endif // ADAPTIVECHUNKPOLICY_H
@@ -0,0 +1,131 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "basefilestore.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSaveFile>
+
+#include "coreutils.h"
+#include "geodiffutils.h"
+
+const QString BasefileStore::sJournalFile = QStringLiteral( "basefile.journal" );
+
+BasefileStore::BasefileStore( const QString &projectDir )
+  : mProjectDir( projectDir )
+{
+}
+
+QString BasefileStore::basefilePath( const QString &filePath ) const
+{
+  return mProjectDir + "/.mergin/" + filePath;
+}
+
+bool BasefileStore::store( const QString &filePath, const QString &sourcePath )
+{
+  QString basefile = basefilePath( filePath );
+  QDir().mkpath( QFileInfo( basefile ).absolutePath() );
+
+  if ( QFile::exists( basefile ) && !QFile::remove( basefile ) )
+    return false;
+
+  if ( !CoreUtils::cloneFile( sourcePath, basefile ) )
+    return false;
+
+  setInterrupted( filePath, false );
+  return true;
+}
+
+bool BasefileStore::reflinkTo( const QString &filePath, const QString &destPath ) const
+{
+  return CoreUtils::reflinkFile( basefilePath( filePath ), destPath );
+}
+
+bool BasefileStore::applyDiffsInPlace( const QString &filePath, const QStringList &diffFiles )
+{
+  QString basefile = basefilePath( filePath );
+  QString localFile = mProjectDir + "/" + filePath;
+
+  setInterrupted( filePath, true );
+
+  // the basefile goes first: if we get interrupted before the local file is updated,
+  // the local file is still the same as on the server and the pull can simply download it again
+  if ( !GeodiffUtils::applyDiffs( basefile, diffFiles ) )
+  {
+    CoreUtils::log( "basefile", "Failed to apply diffs to basefile: " + filePath );
+    return false;
+  }
+
+  if ( !GeodiffUtils::applyDiffs( localFile, diffFiles ) )
+  {
+    CoreUtils::log( "basefile", "Failed to apply diffs to local file: " + filePath );
+    return false;
+  }
+
+  setInterrupted( filePath, false );
+  return true;
+}
+
+bool BasefileStore::isInterrupted( const QString &filePath ) const
+{
+  return readJournal().contains( filePath );
+}
+
+bool BasefileStore::remove( const QString &filePath )
+{
+  setInterrupted( filePath, false );
+  QString basefile = basefilePath( filePath );
+  return !QFile::exists( basefile ) || QFile::remove( basefile );
+}
+
+QStringList BasefileStore::readJournal() const
+{
+  QFile f( mProjectDir + "/.mergin/" + sJournalFile );
+  if ( !f.open( QIODevice::ReadOnly ) )
+    return QStringList();
+
+  QStringList filePaths;
+  const QJsonArray array = QJsonDocument::fromJson( f.readAll() ).array();
+  for ( const QJsonValue &value : array )
+    filePaths << value.toString();
+  return filePaths;
+}
+
+bool BasefileStore::writeJournal( const QStringList &filePaths )
+{
+  QString journalPath = mProjectDir + "/.mergin/" + sJournalFile;
+  if ( filePaths.isEmpty() )
+    return !QFile::exists( journalPath ) || QFile::remove( journalPath );
+
+  QSaveFile f( journalPath );
+  if ( !f.open( QIODevice::WriteOnly ) )
+  {
+    CoreUtils::log( "basefile", "Failed to open basefile journal for writing: " + journalPath );
+    return false;
+  }
+  f.write( QJsonDocument( QJsonArray::fromStringList( filePaths ) ).toJson( QJsonDocument::Compact ) );
+  return f.commit();
+}
+
+void BasefileStore::setInterrupted( const QString &filePath, bool interrupted )
+{
+  QStringList filePaths = readJournal();
+  if ( filePaths.contains( filePath ) == interrupted )
+    return;
+
+  if ( interrupted )
+    filePaths << filePath;
+  else
+    filePaths.removeAll( filePath );
+  writeJournal( filePaths );
+}
@@ -0,0 +1,64 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef BASEFILESTORE_H
+#define BASEFILESTORE_H
+
+#include <QString>
+#include <QStringList>
+
+/**
+ * Basefiles of diffable files of a project - unmodified copies of the files as they are on the server,
+ * kept in the project's .mergin folder.
+ *
+ * Copies of files are made as reflinks where the file system supports them, so they take no extra space
+ * and no data get written. Where it does not, diffs pulled for files without local changes are applied
+ * to the basefile and to the local file in place instead of assembling a new copy of the file.
+ * SQLite rolls back a single interrupted changeset, but the two files are not updated atomically,
+ * so each in-place update is recorded in a journal until it is complete: basefiles of files whose
+ * update has been interrupted cannot be trusted and the files need to be downloaded in full again.
+ */
+class BasefileStore
+{
+  public:
+    static const QString sJournalFile;  //!< name of the journal in project's .mergin folder
+
+    explicit BasefileStore( const QString &projectDir );
+
+    //! Returns path of the basefile of the given project file
+    QString basefilePath( const QString &filePath ) const;
+
+    //! Replaces the basefile of the given project file by a copy of the file at sourcePath
+    bool store( const QString &filePath, const QString &sourcePath );
+
+    //! Creates a copy of the basefile at destPath, but only if it can be done by a reflink (without copying data)
+    bool reflinkTo( const QString &filePath, const QString &destPath ) const;
+
+    /**
+     * Applies the diffs to the basefile and then to the local file in place. The local file must
+     * not have any local changes (it is the same as the basefile). If the update fails, the file
+     * stays recorded as interrupted.
+     */
+    bool applyDiffsInPlace( const QString &filePath, const QStringList &diffFiles );
+
+    //! Whether an in-place update of the file has not been completed (its basefile cannot be used)
+    bool isInterrupted( const QString &filePath ) const;
+
+    //! Removes the basefile of the given project file
+    bool remove( const QString &filePath );
+
+  private:
+    QStringList readJournal() const;
+    bool writeJournal( const QStringList &filePaths );
+    void setInterrupted( const QString &filePath, bool interrupted );
+
+    QString mProjectDir;
+};
+
+#endif // BASEFILESTORE_H
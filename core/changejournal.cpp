@@ -0,0 +1,412 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "changejournal.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QPair>
+#include <QSocketNotifier>
+
+#include "coreutils.h"
+
+#if defined( Q_OS_LINUX )
+#include <cerrno>
+#include <cstring>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// guards the registry of journals, watches and changes of all journals - changes are returned
+// to the sync worker threads while notifications get processed in the main thread
+static QMutex sMutex;
+static qint64 sSequence = 0;  //!< shared by all journals, so that cursors of removed journals are never valid
+static QHash<QString, std::shared_ptr<ChangeJournal>> sJournals;
+static QList<std::function<void( const QString & )>> sUnwatchHandlers;
+
+#if defined( Q_OS_LINUX )
+// a single inotify instance watches all projects (the number of instances per user is limited)
+static int sInotifyFd = -1;
+static QSocketNotifier *sInotifyNotifier = nullptr;
+static QHash<int, QPair<ChangeJournal *, QString>> sInotifyWatches;  //!< watch descriptor -> journal and watched directory
+static const uint32_t WATCH_MASK = IN_CREATE | IN_DELETE | IN_MODIFY | IN_ATTRIB | IN_MOVED_FROM | IN_MOVED_TO |
+                                   IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR | IN_DONT_FOLLOW;
+#endif
+
+// files that get modified in place - QFileSystemWatcher only notices changes of other files in their directories
+static const QStringList IN_PLACE_FILTERS = { QStringLiteral( "*.gpkg" ), QStringLiteral( "*.qgs" ), QStringLiteral( "*.qgz" ) };
+
+static const QString MERGIN_FOLDER = QStringLiteral( ".mergin" );
+
+void ChangeJournal::watch( const QString &projectDir )
+{
+  QString dir = QDir::cleanPath( projectDir );
+  QMutexLocker locker( &sMutex );
+  if ( sJournals.contains( dir ) || !QFileInfo( dir ).isDir() )
+    return;
+
+  // the last reference may be dropped by a worker thread - the journal is deleted in its own thread
+  std::shared_ptr<ChangeJournal> journal( new ChangeJournal( dir ), []( ChangeJournal * j ) { j->deleteLater(); } );
+  sJournals.insert( dir, journal );
+}
+
+void ChangeJournal::unwatch( const QString &projectDir )
+{
+  QString dir = QDir::cleanPath( projectDir );
+  QList<std::function<void( const QString & )>> handlers;
+  {
+    QMutexLocker locker( &sMutex );
+    if ( !sJournals.remove( dir ) )
+      return;
+    handlers = sUnwatchHandlers;
+  }
+
+  // handlers take locks of their own - they are called without the mutex
+  for ( const auto &handler : qAsConst( handlers ) )
+    handler( dir );
+}
+
+void ChangeJournal::addUnwatchHandler( const std::function<void( const QString & )> &handler )
+{
+  QMutexLocker locker( &sMutex );
+  sUnwatchHandlers << handler;
+}
+
+std::shared_ptr<ChangeJournal> ChangeJournal::find( const QString &projectDir )
+{
+  QMutexLocker locker( &sMutex );
+  return sJournals.value( QDir::cleanPath( projectDir ) );
+}
+
+ChangeJournal::ChangeJournal( const QString &projectDir )
+  : mProjectDir( projectDir )
+{
+  mResetSequence = ++sSequence;
+
+#if defined( Q_OS_LINUX )
+  if ( sInotifyFd < 0 )
+  {
+    sInotifyFd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+    if ( sInotifyFd >= 0 )
+    {
+      sInotifyNotifier = new QSocketNotifier( sInotifyFd, QSocketNotifier::Read );
+      QObject::connect( sInotifyNotifier, &QSocketNotifier::activated, []
+      {
+        QMutexLocker locker( &sMutex );
+        readInotifyEvents();
+      } );
+    }
+    else
+    {
+      CoreUtils::log( "change journal", QStringLiteral( "Failed to initialize inotify: " ) + QString::fromLocal8Bit( strerror( errno ) ) );
+    }
+  }
+  mInotify = sInotifyFd >= 0;
+#endif
+
+  if ( !mInotify )
+  {
+    mWatcher = new QFileSystemWatcher( this );
+    connect( mWatcher, &QFileSystemWatcher::directoryChanged, this, &ChangeJournal::onDirectoryChanged );
+    connect( mWatcher, &QFileSystemWatcher::fileChanged, this, &ChangeJournal::onFileChanged );
+  }
+}
+
+ChangeJournal::~ChangeJournal()
+{
+#if defined( Q_OS_LINUX )
+  QMutexLocker locker( &sMutex );
+  for ( auto it = sInotifyWatches.begin(); it != sInotifyWatches.end(); )
+  {
+    if ( it->first == this )
+    {
+      inotify_rm_watch( sInotifyFd, it.key() );
+      it = sInotifyWatches.erase( it );
+    }
+    else
+      ++it;
+  }
+#endif
+}
+
+bool ChangeJournal::isExact() const
+{
+  return mInotify;
+}
+
+bool ChangeJournal::changesSince( Cursor &cursor, QSet<QString> &paths )
+{
+  startWatching();
+
+  QMutexLocker locker( &sMutex );
+
+  // changes done until now are in the inotify queue already
+  if ( mInotify )
+    readInotifyEvents();
+
+  qint64 now = QDateTime::currentMSecsSinceEpoch();
+  bool journaled = mWatchState == Watched && !mWatchesFailed && cursor.sequence >= mResetSequence && now - cursor.fullScanTime < FULL_SCAN_INTERVAL;
+  if ( journaled )
+  {
+    for ( auto it = mChanges.constBegin(); it != mChanges.constEnd(); ++it )
+    {
+      if ( it.value() > cursor.sequence )
+        paths << it.key();
+    }
+  }
+  else
+  {
+    cursor.fullScanTime = now;
+  }
+  cursor.sequence = sSequence;
+  return journaled;
+}
+
+QString ChangeJournal::absolutePath( const QString &path ) const
+{
+  return path.isEmpty() ? mProjectDir : mProjectDir + "/" + path;
+}
+
+QString ChangeJournal::relativePath( const QString &absolutePath ) const
+{
+  QString path = QDir::cleanPath( absolutePath );
+  return path == mProjectDir ? QString() : path.mid( mProjectDir.length() + 1 );
+}
+
+QStringList ChangeJournal::listDirectories( const QString &dirPath ) const
+{
+  QStringList dirs;
+  dirs << dirPath;
+  QDirIterator it( absolutePath( dirPath ), QDir::Dirs | QDir::Hidden | QDir::NoDotAndDotDot, QDirIterator::Subdirectories );
+  while ( it.hasNext() )
+  {
+    QString path = relativePath( it.next() );
+    if ( path != MERGIN_FOLDER && !path.startsWith( MERGIN_FOLDER + "/" ) )
+      dirs << path;
+  }
+  return dirs;
+}
+
+QStringList ChangeJournal::watcherPaths( const QStringList &dirs ) const
+{
+  QStringList paths;
+  for ( const QString &dir : dirs )
+  {
+    paths << absolutePath( dir );
+    const QStringList files = QDir( absolutePath( dir ) ).entryList( IN_PLACE_FILTERS, QDir::Files | QDir::Hidden );
+    for ( const QString &file : files )
+      paths << absolutePath( dir.isEmpty() ? file : dir + "/" + file );
+  }
+  return paths;
+}
+
+void ChangeJournal::startWatching()
+{
+  {
+    QMutexLocker locker( &sMutex );
+    if ( mWatchState != NotWatched )
+      return;
+    mWatchState = Watching;
+  }
+
+  // the tree is walked without the mutex, so that notifications and other journals are not blocked meanwhile -
+  // changes done before the watches are in place are unknown, so consumers scan the whole project once more
+  QStringList dirs = listDirectories( QString() );
+  if ( mInotify )
+  {
+    QMutexLocker locker( &sMutex );
+    addWatches( dirs );
+    mWatchState = Watched;
+    mResetSequence = ++sSequence;
+    return;
+  }
+
+  // QFileSystemWatcher lives in the thread of the journal
+  QStringList paths = watcherPaths( dirs );
+  QMetaObject::invokeMethod( this, [this, paths]
+  {
+    QMutexLocker locker( &sMutex );
+    mWatcher->addPaths( paths );
+    mWatchState = Watched;
+    mResetSequence = ++sSequence;
+  }, Qt::QueuedConnection );
+}
+
+void ChangeJournal::addWatches( const QStringList &dirs )
+{
+#if defined( Q_OS_LINUX )
+  if ( mInotify )
+  {
+    for ( const QString &dir : dirs )
+    {
+      int wd = inotify_add_watch( sInotifyFd, QFile::encodeName( absolutePath( dir ) ).constData(), WATCH_MASK );
+      if ( wd >= 0 )
+      {
+        sInotifyWatches.insert( wd, qMakePair( this, dir ) );
+      }
+      else if ( errno != ENOENT && errno != ENOTDIR && !mWatchesFailed )
+      {
+        // e.g. the limit of watches has been reached - the project gets scanned fully every time
+        // (directories removed or moved in the meantime are fine - their parents report them)
+        CoreUtils::log( "change journal", QStringLiteral( "Failed to watch %1: %2" ).arg( absolutePath( dir ), QString::fromLocal8Bit( strerror( errno ) ) ) );
+        mWatchesFailed = true;
+      }
+    }
+    return;
+  }
+#endif
+
+  mWatcher->addPaths( watcherPaths( dirs ) );
+}
+
+void ChangeJournal::removeWatches( const QString &dirPath )
+{
+#if defined( Q_OS_LINUX )
+  for ( auto it = sInotifyWatches.begin(); it != sInotifyWatches.end(); )
+  {
+    if ( it->first == this && ( it->second == dirPath || it->second.startsWith( dirPath + "/" ) ) )
+    {
+      inotify_rm_watch( sInotifyFd, it.key() );
+      it = sInotifyWatches.erase( it );
+    }
+    else
+      ++it;
+  }
+#else
+  Q_UNUSED( dirPath )
+#endif
+}
+
+void ChangeJournal::recordChange( const QString &path )
+{
+  mChanges.insert( path, ++sSequence );
+  notifyChanged();
+}
+
+void ChangeJournal::reset()
+{
+  mChanges.clear();
+  mResetSequence = ++sSequence;
+  notifyChanged();
+}
+
+void ChangeJournal::notifyChanged()
+{
+  // changes are recorded with the mutex locked, possibly in a worker thread - the signal is always queued
+  if ( mNotifyPending )
+    return;
+
+  mNotifyPending = true;
+  QMetaObject::invokeMethod( this, [this]
+  {
+    {
+      QMutexLocker locker( &sMutex );
+      mNotifyPending = false;
+    }
+    emit changed( mProjectDir );
+  }, Qt::QueuedConnection );
+}
+
+void ChangeJournal::onDirectoryChanged( const QString &path )
+{
+  QMutexLocker locker( &sMutex );
+  QString dirPath = relativePath( path );
+
+  // we do not know which entries have changed - anything in the project directory itself may have
+  if ( dirPath.isEmpty() )
+    reset();
+  else
+    recordChange( dirPath );
+
+  // new subdirectories and files need to be watched too
+  if ( QFileInfo( path ).isDir() )
+    addWatches( listDirectories( dirPath ) );
+}
+
+void ChangeJournal::onFileChanged( const QString &path )
+{
+  QMutexLocker locker( &sMutex );
+  recordChange( relativePath( path ) );
+
+  // files replaced by a new file stop being watched
+  if ( QFileInfo::exists( path ) && !mWatcher->files().contains( path ) )
+    mWatcher->addPath( path );
+}
+
+void ChangeJournal::readInotifyEvents()
+{
+#if defined( Q_OS_LINUX )
+  alignas( struct inotify_event ) char buffer[16 * 1024];
+  for ( ;; )
+  {
+    ssize_t length = ::read( sInotifyFd, buffer, sizeof( buffer ) );
+    if ( length <= 0 )
+      break;  // nothing more to read
+
+    for ( char *ptr = buffer; ptr < buffer + length; )
+    {
+      const struct inotify_event *event = reinterpret_cast<const struct inotify_event *>( ptr );
+      ptr += sizeof( struct inotify_event ) + event->len;
+
+      if ( event->mask & IN_Q_OVERFLOW )
+      {
+        // events of all projects have been lost
+        CoreUtils::log( "change journal", QStringLiteral( "Event queue overflow" ) );
+        for ( const std::shared_ptr<ChangeJournal> &journal : qAsConst( sJournals ) )
+          journal->reset();
+        continue;
+      }
+
+      auto it = sInotifyWatches.constFind( event->wd );
+      if ( it == sInotifyWatches.constEnd() )
+        continue;
+      ChangeJournal *journal = it->first;
+      QString dirPath = it->second;
+
+      if ( event->mask & IN_IGNORED )
+      {
+        sInotifyWatches.remove( event->wd );
+        continue;
+      }
+
+      // removal or move of a watched directory is reported by its parent as well - but not for the project directory
+      if ( event->mask & ( IN_DELETE_SELF | IN_MOVE_SELF ) )
+      {
+        if ( dirPath.isEmpty() )
+          journal->reset();
+        continue;
+      }
+
+      if ( event->len == 0 )
+        continue;
+
+      QString name = QFile::decodeName( event->name );
+      QString path = dirPath.isEmpty() ? name : dirPath + "/" + name;
+      if ( path == MERGIN_FOLDER )
+        continue;
+
+      journal->recordChange( path );
+
+      if ( event->mask & IN_ISDIR )
+      {
+        if ( event->mask & ( IN_CREATE | IN_MOVED_TO ) )
+          journal->addWatches( journal->listDirectories( path ) );
+        else if ( event->mask & IN_MOVED_FROM )
+          journal->removeWatches( path );
+      }
+    }
+  }
+#endif
+}
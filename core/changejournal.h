@@ -0,0 +1,132 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef CHANGEJOURNAL_H
+#define CHANGEJOURNAL_H
+
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QString>
+
+#include <functional>
+#include <memory>
+
+class QFileSystemWatcher;
+
+/**
+ * Journal of paths changed in a local project, recorded from file system notifications as they happen,
+ * so that scans of the project only need to look at the changed paths instead of walking the whole tree.
+ *
+ * On Linux (and Android) changes are watched by inotify. Its events are read before the changes are returned,
+ * so the journal is exact: everything done before changesSince() is included. Elsewhere QFileSystemWatcher
+ * is used - it watches directories and files that get modified in place (geopackages, QGIS projects), its
+ * notifications may arrive late and other modifications of contents may be missed (isExact() is false).
+ *
+ * Consumers keep a Cursor with their position in the journal. A full scan is requested when the consumer
+ * has not scanned the project yet, when events have been lost (e.g. inotify queue overflow or the limit
+ * of watches has been reached) and at least every FULL_SCAN_INTERVAL as a safety net.
+ *
+ * Changed paths are relative to the project directory and they may be directories - then anything
+ * within them may have changed. Changes within the .mergin folder are not journaled.
+ *
+ * Journals are created for local projects by LocalProjectsManager and they are looked up by find().
+ * Directories of a project get watched when its journal is used for the first time (consumers scan
+ * the whole project then anyway), so that creating journals does not walk the trees of all projects.
+ * Consumers that keep state for journals drop it in handlers registered by addUnwatchHandler().
+ */
+class ChangeJournal : public QObject
+{
+    Q_OBJECT
+  public:
+    //! Consumers do a full scan at least this often (in milliseconds)
+    static constexpr qint64 FULL_SCAN_INTERVAL = 10 * 60 * 1000;
+
+    struct Cursor
+    {
+      qint64 sequence = -1;  //!< sequence number of the last change seen by the consumer (-1 if none)
+      qint64 fullScanTime = 0;  //!< when the consumer scanned the whole project (msecs since epoch)
+    };
+
+    //! Starts journaling changes of the project in the given directory (does nothing if it is journaled already)
+    static void watch( const QString &projectDir );
+
+    //! Stops journaling changes of the project in the given directory
+    static void unwatch( const QString &projectDir );
+
+    //! Registers a function called with the (clean) project directory after the project has been unwatched
+    static void addUnwatchHandler( const std::function<void( const QString & )> &handler );
+
+    //! Returns the journal of the project in the given directory or nullptr if its changes are not journaled
+    static std::shared_ptr<ChangeJournal> find( const QString &projectDir );
+
+    ~ChangeJournal() override;
+
+    QString projectDir() const { return mProjectDir; }
+
+    //! Whether all changes done before changesSince() are returned by it
+    bool isExact() const;
+
+    /**
+     * Adds paths changed since the \a cursor to \a paths and moves the cursor. Returns false if the consumer
+     * needs to scan the whole project instead - the cursor is then moved as if the scan has been done.
+     * Directories get watched by the first call (see startWatching()).
+     */
+    bool changesSince( Cursor &cursor, QSet<QString> &paths );
+
+    /**
+     * Starts watching of the project's directories unless they are watched already - changes are journaled
+     * (and changed() is emitted) from then on. It walks the project's tree, so it should not be called
+     * from the GUI thread.
+     */
+    void startWatching();
+
+  signals:
+    //! Emitted in the thread of the journal after changes have been recorded (changes recorded in a row are reported once)
+    void changed( const QString &projectDir );
+
+  private:
+    explicit ChangeJournal( const QString &projectDir );
+
+    QString absolutePath( const QString &path ) const;
+    QString relativePath( const QString &absolutePath ) const;
+
+    enum WatchState
+    {
+      NotWatched,  //!< directories have not been watched yet
+      Watching,  //!< directories are being listed or watches are being added
+      Watched
+    };
+
+    //! Returns the directory and its subdirectories (relative paths), it does not access any shared state
+    QStringList listDirectories( const QString &dirPath ) const;
+    //! Returns paths watched by QFileSystemWatcher for the directories (with files modified in place)
+    QStringList watcherPaths( const QStringList &dirs ) const;
+    void addWatches( const QStringList &dirs );
+    void removeWatches( const QString &dirPath );
+    void recordChange( const QString &path );
+    void reset();
+    void notifyChanged();
+
+    void onDirectoryChanged( const QString &path );
+    void onFileChanged( const QString &path );
+
+    static void readInotifyEvents();
+
+    QString mProjectDir;
+    QHash<QString, qint64> mChanges;  //!< path -> sequence number of its last change
+    qint64 mResetSequence = 0;  //!< cursors before this need a full scan
+    WatchState mWatchState = NotWatched;
+    bool mWatchesFailed = false;  //!< some directories could not be watched
+    bool mInotify = false;
+    bool mNotifyPending = false;  //!< changed() has been posted already
+    QFileSystemWatcher *mWatcher = nullptr;
+};
+
+#endif // CHANGEJOURNAL_H
@@ -0,0 +1,244 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "checksumcache.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrent>
+
+#include <algorithm>
+#include <vector>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
+
+#include "coreutils.h"
+#include "merginapi.h"
+
+const QString ChecksumCache::sCacheFile = QStringLiteral( "checksums.cache" );
+
+static const quint32 CACHE_MAGIC = 0x4d434331;  // "MCC1"
+static const qint32 CACHE_VERSION = 1;
+
+// files modified less than this time before hashing are not cached: they may still be
+// written to within the resolution of the file system timestamps
+static const qint64 RACY_WINDOW_MSECS = 2000;
+
+ChecksumCache::ChecksumCache( const QString &projectDir )
+  : mProjectDir( projectDir.endsWith( '/' ) ? projectDir : projectDir + '/' )
+{
+  load();
+}
+
+ChecksumCache::Entry ChecksumCache::entry( const QString &filePath )
+{
+  Entry current = statFile( mProjectDir + filePath );
+
+  auto it = mEntries.constFind( filePath );
+  if ( it != mEntries.constEnd() && it->sameStat( current ) && !it->checksum.isEmpty() )
+    return *it;
+
+  QByteArray checksum = MerginApi::getChecksum( mProjectDir + filePath );
+  current.checksum = QString::fromLatin1( checksum.data(), checksum.size() );
+  store( filePath, current );
+
+  return current;
+}
+
+QHash<QString, ChecksumCache::Entry> ChecksumCache::entries( const QStringList &filePaths, int maxThreads, const QSet<QString> *changedPaths )
+{
+  QHash<QString, Entry> result;
+  result.reserve( filePaths.count() );
+
+  std::vector<std::pair<QString, Entry>> toHash;
+  for ( const QString &filePath : filePaths )
+  {
+    auto it = mEntries.constFind( filePath );
+    if ( changedPaths && !changedPaths->contains( filePath ) && it != mEntries.constEnd() && !it->checksum.isEmpty() )
+    {
+      result.insert( filePath, *it );
+      continue;
+    }
+
+    Entry current = statFile( mProjectDir + filePath );
+    if ( it != mEntries.constEnd() && it->sameStat( current ) && !it->checksum.isEmpty() )
+      result.insert( filePath, *it );
+    else
+      toHash.emplace_back( filePath, current );
+  }
+
+  // largest first: the remaining small files fill the gaps of the other threads
+  std::sort( toHash.begin(), toHash.end(), []( const std::pair<QString, Entry> &a, const std::pair<QString, Entry> &b )
+  {
+    return a.second.size > b.second.size;
+  } );
+
+  const QString projectDir = mProjectDir;
+  auto hashFile = [projectDir]( std::pair<QString, Entry> &item )
+  {
+    QByteArray checksum = MerginApi::getChecksum( projectDir + item.first );
+    item.second.checksum = QString::fromLatin1( checksum.data(), checksum.size() );
+  };
+
+  int threadCount = qMin( maxThreads, static_cast<int>( toHash.size() ) );
+  if ( threadCount <= 1 )
+  {
+    for ( auto &item : toHash )
+      hashFile( item );
+  }
+  else
+  {
+    // each thread takes the next file from the list when it is done with the previous one. Scans of different
+    // projects may run in parallel (e.g. in the sync worker), so they share one pool not to run more threads than cores
+    static QThreadPool sHashingPool;
+    QAtomicInt next( 0 );
+    QList<QFuture<void>> futures;
+    for ( int i = 0; i < threadCount; ++i )
+    {
+      futures << QtConcurrent::run( &sHashingPool, [&toHash, &next, &hashFile]
+      {
+        int index;
+        while ( ( index = next.fetchAndAddRelaxed( 1 ) ) < static_cast<int>( toHash.size() ) )
+          hashFile( toHash[index] );
+      } );
+    }
+    for ( QFuture<void> &future : futures )
+      future.waitForFinished();
+  }
+
+  for ( const auto &item : toHash )
+  {
+    store( item.first, item.second );
+    result.insert( item.first, item.second );
+  }
+
+  return result;
+}
+
+void ChecksumCache::store( const QString &filePath, const Entry &e )
+{
+  if ( e.mtime < QDateTime::currentMSecsSinceEpoch() - RACY_WINDOW_MSECS )
+  {
+    mEntries.insert( filePath, e );
+  }
+  else
+  {
+    mEntries.remove( filePath );
+  }
+  mDirty = true;
+}
+
+void ChecksumCache::retainOnly( const QSet<QString> &filePaths )
+{
+  for ( auto it = mEntries.begin(); it != mEntries.end(); )
+  {
+    if ( !filePaths.contains( it.key() ) )
+    {
+      it = mEntries.erase( it );
+      mDirty = true;
+    }
+    else
+      ++it;
+  }
+}
+
+bool ChecksumCache::load()
+{
+  QFile f( mProjectDir + ".mergin/" + sCacheFile );
+  if ( !f.open( QIODevice::ReadOnly ) )
+    return false;
+
+  QDataStream stream( &f );
+  stream.setVersion( QDataStream::Qt_5_0 );
+
+  quint32 magic;
+  qint32 version;
+  stream >> magic >> version;
+  if ( magic != CACHE_MAGIC || version != CACHE_VERSION )
+  {
+    CoreUtils::log( "checksum cache", QStringLiteral( "Ignoring cache with unknown format: " ) + f.fileName() );
+    return false;
+  }
+
+  quint32 count;
+  stream >> count;
+  mEntries.reserve( static_cast<int>( count ) );
+  for ( quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i )
+  {
+    QString path;
+    Entry e;
+    stream >> path >> e.size >> e.mtime >> e.inode >> e.checksum;
+    mEntries.insert( path, e );
+  }
+
+  if ( stream.status() != QDataStream::Ok )
+  {
+    CoreUtils::log( "checksum cache", QStringLiteral( "Failed to read cache: " ) + f.fileName() );
+    mEntries.clear();
+    return false;
+  }
+  return true;
+}
+
+bool ChecksumCache::save()
+{
+  if ( !mDirty )
+    return true;
+
+  if ( !QDir( mProjectDir + ".mergin" ).exists() )
+    return false;
+
+  QSaveFile f( mProjectDir + ".mergin/" + sCacheFile );
+  if ( !f.open( QIODevice::WriteOnly ) )
+  {
+    CoreUtils::log( "checksum cache", QStringLiteral( "Failed to open cache for writing: " ) + f.fileName() );
+    return false;
+  }
+
+  QDataStream stream( &f );
+  stream.setVersion( QDataStream::Qt_5_0 );
+  stream << CACHE_MAGIC << CACHE_VERSION << static_cast<quint32>( mEntries.count() );
+  for ( auto it = mEntries.constBegin(); it != mEntries.constEnd(); ++it )
+  {
+    stream << it.key() << it->size << it->mtime << it->inode << it->checksum;
+  }
+
+  if ( !f.commit() )
+  {
+    CoreUtils::log( "checksum cache", QStringLiteral( "Failed to write cache: " ) + f.fileName() );
+    return false;
+  }
+
+  mDirty = false;
+  return true;
+}
+
+ChecksumCache::Entry ChecksumCache::statFile( const QString &filePath )
+{
+  Entry e;
+  QFileInfo info( filePath );
+  if ( !info.exists() )
+    return e;
+
+  e.size = info.size();
+  e.mtime = info.lastModified().toMSecsSinceEpoch();
+#ifdef Q_OS_UNIX
+  struct stat st;
+  if ( ::stat( QFile::encodeName( filePath ).constData(), &st ) == 0 )
+    e.inode = static_cast<quint64>( st.st_ino );
+#endif
+  return e;
+}
@@ -0,0 +1,88 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef CHECKSUMCACHE_H
+#define CHECKSUMCACHE_H
+
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+/**
+ * Persistent cache of checksums of files in a local project. It is stored in the project's .mergin folder.
+ *
+ * Entries are keyed by the file path (relative to the project directory) and they keep the size,
+ * modification time and inode of the file from the time it was hashed. A file is hashed again only
+ * when any of these has changed, so repeated scans of a large project do not need to read all the data.
+ */
+class ChecksumCache
+{
+  public:
+    struct Entry
+    {
+      qint64 size = -1;
+      qint64 mtime = -1;  //!< last modification time (msecs since epoch)
+      quint64 inode = 0;  //!< inode of the file (zero where not available)
+      QString checksum;
+
+      //! Whether the stat data (size, mtime, inode) are the same - checksum is not compared
+      bool sameStat( const Entry &other ) const
+      {
+        return size == other.size && mtime == other.mtime && inode == other.inode;
+      }
+    };
+
+    //! Loads cache of the project in the given directory
+    explicit ChecksumCache( const QString &projectDir );
+
+    /**
+     * Returns stat data and checksum of a file (path relative to the project directory).
+     * The file is hashed only if it is not in the cache or its stat data do not match the cached ones.
+     */
+    Entry entry( const QString &filePath );
+
+    /**
+     * Returns entries of multiple files like entry(). Files that need to be hashed are hashed concurrently
+     * by up to \a maxThreads threads - the largest files are picked first, so that a single huge file
+     * does not get hashed at the end while the other threads are idle. The threads come from a pool shared
+     * by all caches, so parallel scans never hash by more threads than there are cores. With \a maxThreads 1
+     * the files are hashed one by one in the calling thread.
+     * With \a changedPaths (e.g. from a ChangeJournal), stat data are only checked for the listed files -
+     * cached entries of the other files are trusted.
+     */
+    QHash<QString, Entry> entries( const QStringList &filePaths, int maxThreads, const QSet<QString> *changedPaths = nullptr );
+
+    //! Drops entries of files that are not listed (e.g. they have been removed since the last scan)
+    void retainOnly( const QSet<QString> &filePaths );
+
+    /**
+     * Writes the cache to the project's .mergin folder (only if something has changed).
+     * Nothing is written if the project does not have .mergin folder (i.e. it is not a Mergin project yet).
+     */
+    bool save();
+
+    //! Returns stat data of a file, checksum is left empty
+    static Entry statFile( const QString &filePath );
+
+    //! Name of the cache file within project's .mergin folder
+    static const QString sCacheFile;
+
+  private:
+    bool load();
+
+    //! Stores a freshly hashed entry (unless the file may still be being written)
+    void store( const QString &filePath, const Entry &e );
+
+    QString mProjectDir;  //!< with a trailing slash
+    QHash<QString, Entry> mEntries;
+    bool mDirty = false;
+};
+
+#endif // CHECKSUMCACHE_H
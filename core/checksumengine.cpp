@@ -0,0 +1,519 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "checksumengine.h"
+
+#include <QFile>
+
+#include <cstring>
+#include <utility>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define CHECKSUM_ENGINE_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define CHECKSUM_ENGINE_TARGET_SHANI
+#else
+#include <cpuid.h>
+#define CHECKSUM_ENGINE_TARGET_SHANI __attribute__((target("sha,sse4.1")))
+#endif
+#endif
+
+// SHA1 instructions of ARMv8 are only available when the compiler targets the cryptography extension
+#if ( defined(__aarch64__) || defined(_M_ARM64) ) && ( defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_SHA2) )
+#define CHECKSUM_ENGINE_ARM
+#include <arm_neon.h>
+#if defined(Q_OS_LINUX)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+
+// files smaller than this are read to a buffer - setting up a mapping would take longer than reading them
+static const qint64 MAP_MIN_SIZE = 1024 * 1024;
+// large files are mapped in windows of this size to keep the address space usage low on 32-bit systems
+static const qint64 MAP_WINDOW_SIZE = 64 * 1024 * 1024;
+static const int READ_BUFFER_SIZE = 256 * 1024;
+
+static const quint32 SHA1_INIT[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+
+#ifdef CHECKSUM_ENGINE_X86
+
+static bool cpuHasShaNi()
+{
+  unsigned int ecx1, ebx7;
+#if defined(_MSC_VER)
+  int regs[4];
+  __cpuid( regs, 0 );
+  if ( regs[0] < 7 )
+    return false;
+  __cpuid( regs, 1 );
+  ecx1 = static_cast<unsigned int>( regs[2] );
+  __cpuidex( regs, 7, 0 );
+  ebx7 = static_cast<unsigned int>( regs[1] );
+#else
+  unsigned int eax, ebx, ecx, edx;
+  if ( !__get_cpuid( 1, &eax, &ebx, &ecx, &edx ) )
+    return false;
+  ecx1 = ecx;
+  if ( !__get_cpuid_count( 7, 0, &eax, &ebx, &ecx, &edx ) )
+    return false;
+  ebx7 = ebx;
+#endif
+  const bool ssse3 = ecx1 & ( 1u << 9 );
+  const bool sse41 = ecx1 & ( 1u << 19 );
+  const bool sha = ebx7 & ( 1u << 29 );
+  return ssse3 && sse41 && sha;
+}
+
+/**
+ * Processes 64-byte blocks with SHA-NI instructions. Each step does four rounds, while the message
+ * schedule for the following steps is computed in between.
+ */
+CHECKSUM_ENGINE_TARGET_SHANI
+static void sha1BlocksShaNi( quint32 state[5], const uchar *data, qint64 blocks )
+{
+  const __m128i byteSwap = _mm_set_epi64x( 0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL );
+
+  __m128i abcd = _mm_shuffle_epi32( _mm_loadu_si128( reinterpret_cast<const __m128i *>( state ) ), 0x1B );
+  __m128i e0 = _mm_set_epi32( static_cast<int>( state[4] ), 0, 0, 0 );
+  __m128i e1;
+  __m128i msg0, msg1, msg2, msg3;
+
+  for ( ; blocks > 0; --blocks, data += 64 )
+  {
+    const __m128i abcdSaved = abcd;
+    const __m128i eSaved = e0;
+
+    // rounds 0-3
+    msg0 = _mm_shuffle_epi8( _mm_loadu_si128( reinterpret_cast<const __m128i *>( data ) ), byteSwap );
+    e0 = _mm_add_epi32( e0, msg0 );
+    e1 = abcd;
+    abcd = _mm_sha1rnds4_epu32( abcd, e0, 0 );
+
+    // rounds 4-7
+    msg1 = _mm_shuffle_epi8( _mm_loadu_si128( reinterpret_cast<const __m128i *>( data + 16 ) ), byteSwap );
+    e1 = _mm_sha1nexte_epu32( e1, msg1 );
+    e0 = abcd;
+    abcd = _mm_sha1rnds4_epu32( abcd, e1, 0 );
+    msg0 = _mm_sha1msg1_epu32( msg0, msg1 );
+
+    // rounds 8-11
+    msg2 = _mm_shuffle_epi8( _mm_loadu_si128( reinterpret_cast<const __m128i *>( data + 32 ) ), byteSwap );
+    e0 = _mm_sha1nexte_epu32( e0, msg2 );
+    e1 = abcd;
+    abcd = _mm_sha1rnds4_epu32( abcd, e0, 0 );
+    msg1 = _mm_sha1msg1_epu32( msg1, msg2 );
+    msg0 = _mm_xor_si128( msg0, msg2 );
+
+    // rounds 12-15
+    msg3 = _mm_shuffle_epi8( _mm_loadu_si128( reinterpret_cast<const __m128i *>( data + 48 ) ), byteSwap );
+    e1 = _mm_sha1nexte_epu32( e1, msg3 );
+    e0 = abcd;
+    msg0 = _mm_sha1msg2_epu32( msg0, msg3 );
+    abcd = _mm_sha1rnds4_epu32( abcd, e1, 0 );
+    msg2 = _mm_sha1msg1_epu32( msg2, msg3 );
+    msg1 = _mm_xor_si128( msg1, msg3 );
+
+    // rounds 16-19
+    e0 = _mm_sha1nexte_epu32( e0, msg0 );
+    e1 = abcd;
+    msg1 = _mm_sha1msg2_epu32( msg1, msg0 );
+    abcd = _mm_sha1rnds4_epu32( abcd, e0, 0 );
+    msg3 = _mm_sha1msg1_epu32( msg3, msg0 );
+    msg2 = _mm_xor_si128( msg2, msg0 );
+
+    // rounds 20-23
+    e1 = _mm_sha1nexte_epu32( e1, msg1 );
+    e0 = abcd;
+    msg2 = _mm_sha1msg2_epu32( msg2, msg1 );
+    abcd = _mm_sha1rnds4_epu32( abcd, e1, 1 );
+    msg0 = _mm_sha1msg1_epu32( msg0, msg1 );
+    msg3 = _mm_xor_si128( msg3, msg1 );
+
+    // rounds 24-27
+    e0 = _mm_sha1nexte_epu32( e0, msg2 );
+    e1 = abcd;
+    msg3 = _mm_sha1msg2_epu32( msg3, msg2 );
+    abcd = _mm_sha1rnds4_epu32( abcd, e0, 1 );
+    msg1 = _mm_sha1msg1_epu32( msg1, msg2 );
+    msg0 = _mm_xor_si128( msg0, msg2 );
+
+    // rounds 28-31
+    e1 = _mm_sha1nexte_epu32( e1, msg3 );
+    e0 = abcd;
+    msg0 = _mm_sha1msg2_epu32( msg0, msg3 );
+    abcd = _mm_sha1rnds4_epu32( abcd, e1, 1 );
+    msg2 = _mm_sha1msg1_epu32( msg2, msg3 );
+    msg1 = _mm_xor_si128( msg1, msg3 );
+
+    // rounds 32-35
+    e0 = _mm_sha1nexte_epu32( e0, msg0 );
+    e1 = abcd;
+    msg1 = _mm_sha1msg2_epu32( msg1, msg0 );
+    abcd = _mm_sha1rnds4_epu32( abcd, e0, 1 );
+    msg3 = _mm_sha1msg1_epu32( msg3, msg0 );
+    msg2 = _mm_xor_si128( msg2, msg0 );
+
+    // rounds 36-39
+    e1 = _mm_sha1nexte_epu32( e1, msg1 );
+    e0 = abcd;
+    msg2 = _mm_sha1msg2_epu32( msg2, msg1 );
+    abcd = _mm_sha1rnds4_epu32( abcd, e1, 1 );
+    msg0 = _mm_sha1msg1_epu32( msg0, msg1 );
+    msg3 = _mm_xor_si128( msg3, msg1 );
+
+    // rounds 40-43
+    e0 = _mm_sha1nexte_epu32( e0, msg2 );
+    e1 = abcd;
+    msg3 = _mm_sha1msg2_epu32( msg3, msg2 );
+    abcd = _mm_sha1rnds4_epu32( abcd, e0, 2 );
+    msg1 = _mm_sha1msg1_epu32( msg1, msg2 );
+    msg0 = _mm_xor_si128( msg0, msg2 );
+
+    // rounds 44-47
+    e1 = _mm_sha1nexte_epu32( e1, msg3 );
+    e0 = abcd;
+    msg0 = _mm_sha1msg2_epu32( msg0, msg3 );
+    abcd = _mm_sha1rnds4_epu32( abcd, e1, 2 );
+    msg2 = _mm_sha1msg1_epu32( msg2, msg3 );
+    msg1 = _mm_xor_si128( msg1, msg3 );
+
+    // rounds 48-51
+    e0 = _mm_sha1nexte_epu32( e0, msg0 );
+    e1 = abcd;
+    msg1 = _mm_sha1msg2_epu32( msg1, msg0 );
+    abcd = _mm_sha1rnds4_epu32( abcd, e0, 2 );
+    msg3 = _mm_sha1msg1_epu32( msg3, msg0 );
+    msg2 = _mm_xor_si128( msg2, msg0 );
+
+    // rounds 52-55
+    e1 = _mm_sha1nexte_epu32( e1, msg1 );
+    e0 = abcd;
+    msg2 = _mm_sha1msg2_epu32( msg2, msg1 );
+    abcd = _mm_sha1rnds4_epu32( abcd, e1, 2 );
+    msg0 = _mm_sha1msg1_epu32( msg0, msg1 );
+    msg3 = _mm_xor_si128( msg3, msg1 );
+
+    // rounds 56-59
+    e0 = _mm_sha1nexte_epu32( e0, msg2 );
+    e1 = abcd;
+    msg3 = _mm_sha1msg2_epu32( msg3, msg2 );
+    abcd = _mm_sha1rnds4_epu32( abcd, e0, 2 );
+    msg1 = _mm_sha1msg1_epu32( msg1, msg2 );
+    msg0 = _mm_xor_si128( msg0, msg2 );
+
+    // rounds 60-63
+    e1 = _mm_sha1nexte_epu32( e1, msg3 );
+    e0 = abcd;
+    msg0 = _mm_sha1msg2_epu32( msg0, msg3 );
+    abcd = _mm_sha1rnds4_epu32( abcd, e1, 3 );
+    msg2 = _mm_sha1msg1_epu32( msg2, msg3 );
+    msg1 = _mm_xor_si128( msg1, msg3 );
+
+    // rounds 64-67
+    e0 = _mm_sha1nexte_epu32( e0, msg0 );
+    e1 = abcd;
+    msg1 = _mm_sha1msg2_epu32( msg1, msg0 );
+    abcd = _mm_sha1rnds4_epu32( abcd, e0, 3 );
+    msg3 = _mm_sha1msg1_epu32( msg3, msg0 );
+    msg2 = _mm_xor_si128( msg2, msg0 );
+
+    // rounds 68-71
+    e1 = _mm_sha1nexte_epu32( e1, msg1 );
+    e0 = abcd;
+    msg2 = _mm_sha1msg2_epu32( msg2, msg1 );
+    abcd = _mm_sha1rnds4_epu32( abcd, e1, 3 );
+    msg3 = _mm_xor_si128( msg3, msg1 );
+
+    // rounds 72-75
+    e0 = _mm_sha1nexte_epu32( e0, msg2 );
+    e1 = abcd;
+    msg3 = _mm_sha1msg2_epu32( msg3, msg2 );
+    abcd = _mm_sha1rnds4_epu32( abcd, e0, 3 );
+
+    // rounds 76-79
+    e1 = _mm_sha1nexte_epu32( e1, msg3 );
+    e0 = abcd;
+    abcd = _mm_sha1rnds4_epu32( abcd, e1, 3 );
+
+    e0 = _mm_sha1nexte_epu32( e0, eSaved );
+    abcd = _mm_add_epi32( abcd, abcdSaved );
+  }
+
+  _mm_storeu_si128( reinterpret_cast<__m128i *>( state ), _mm_shuffle_epi32( abcd, 0x1B ) );
+  state[4] = static_cast<quint32>( _mm_extract_epi32( e0, 3 ) );
+}
+
+#endif // CHECKSUM_ENGINE_X86
+
+#ifdef CHECKSUM_ENGINE_ARM
+
+static bool cpuHasArmSha1()
+{
+#if defined(Q_OS_LINUX)
+  return getauxval( AT_HWCAP ) & HWCAP_SHA1;
+#else
+  // the compiler already targets CPUs with the cryptography extension (e.g. all 64-bit Apple devices)
+  return true;
+#endif
+}
+
+/**
+ * Processes 64-byte blocks with ARMv8 SHA1 instructions. Each step does four rounds and then
+ * computes the message words for the step four steps later.
+ */
+static void sha1BlocksArmV8( quint32 state[5], const uchar *data, qint64 blocks )
+{
+  static const quint32 K[4] = { 0x5A827999, 0x6ED9EBA1, 0x8F1BBCDC, 0xCA62C1D6 };
+
+  uint32x4_t abcd = vld1q_u32( state );
+  uint32_t e = state[4];
+
+  for ( ; blocks > 0; --blocks, data += 64 )
+  {
+    const uint32x4_t abcdSaved = abcd;
+    const uint32_t eSaved = e;
+
+    uint32x4_t msg[4];
+    for ( int i = 0; i < 4; ++i )
+      msg[i] = vreinterpretq_u32_u8( vrev32q_u8( vld1q_u8( data + 16 * i ) ) );
+
+    for ( int step = 0; step < 20; ++step )
+    {
+      const uint32x4_t wk = vaddq_u32( msg[step % 4], vdupq_n_u32( K[step / 5] ) );
+      const uint32_t eNext = vsha1h_u32( vgetq_lane_u32( abcd, 0 ) );
+      if ( step < 5 )
+        abcd = vsha1cq_u32( abcd, e, wk );
+      else if ( step >= 10 && step < 15 )
+        abcd = vsha1mq_u32( abcd, e, wk );
+      else
+        abcd = vsha1pq_u32( abcd, e, wk );
+      e = eNext;
+
+      if ( step < 16 )
+        msg[step % 4] = vsha1su1q_u32( vsha1su0q_u32( msg[step % 4], msg[( step + 1 ) % 4], msg[( step + 2 ) % 4] ), msg[( step + 3 ) % 4] );
+    }
+
+    abcd = vaddq_u32( abcd, abcdSaved );
+    e += eSaved;
+  }
+
+  vst1q_u32( state, abcd );
+  state[4] = e;
+}
+
+#endif // CHECKSUM_ENGINE_ARM
+
+namespace
+{
+  //! Buffer for reading of files, allocated once per thread
+  struct ReadBuffer
+  {
+    ReadBuffer() : data( static_cast<char *>( qMallocAligned( READ_BUFFER_SIZE, 64 ) ) ) {}
+    ~ReadBuffer() { qFreeAligned( data ); }
+    char *data;
+  };
+}
+
+ChecksumEngine::ChecksumEngine( Backend backend )
+  : mBackend( isBackendSupported( backend ) ? backend : Generic )
+  , mGenericHash( QCryptographicHash::Sha1 )
+{
+  reset();
+}
+
+void ChecksumEngine::reset()
+{
+  mGenericHash.reset();
+  memcpy( mState, SHA1_INIT, sizeof( mState ) );
+  mBufferLength = 0;
+  mLength = 0;
+}
+
+void ChecksumEngine::addData( const char *data, qint64 length )
+{
+  if ( mBackend == Generic )
+  {
+    // QCryptographicHash takes int lengths
+    while ( length > 0 )
+    {
+      int n = static_cast<int>( qMin( length, static_cast<qint64>( 1 << 30 ) ) );
+      mGenericHash.addData( data, n );
+      data += n;
+      length -= n;
+    }
+    return;
+  }
+
+  const uchar *bytes = reinterpret_cast<const uchar *>( data );
+  mLength += static_cast<quint64>( length );
+
+  if ( mBufferLength > 0 )
+  {
+    int n = static_cast<int>( qMin( static_cast<qint64>( 64 - mBufferLength ), length ) );
+    memcpy( mBuffer + mBufferLength, bytes, static_cast<size_t>( n ) );
+    mBufferLength += n;
+    bytes += n;
+    length -= n;
+    if ( mBufferLength < 64 )
+      return;
+    processBlocks( mBuffer, 1 );
+    mBufferLength = 0;
+  }
+
+  qint64 blocks = length / 64;
+  if ( blocks > 0 )
+  {
+    processBlocks( bytes, blocks );
+    bytes += blocks * 64;
+    length -= blocks * 64;
+  }
+
+  if ( length > 0 )
+  {
+    memcpy( mBuffer, bytes, static_cast<size_t>( length ) );
+    mBufferLength = static_cast<int>( length );
+  }
+}
+
+QByteArray ChecksumEngine::result()
+{
+  if ( mBackend == Generic )
+    return mGenericHash.result().toHex();
+
+  // padding is added to a copy of the state, so that more data may be added afterwards
+  quint32 state[5];
+  memcpy( state, mState, sizeof( state ) );
+  uchar buffer[128];
+  memcpy( buffer, mBuffer, static_cast<size_t>( mBufferLength ) );
+
+  int paddedLength = mBufferLength < 56 ? 64 : 128;
+  buffer[mBufferLength] = 0x80;
+  memset( buffer + mBufferLength + 1, 0, static_cast<size_t>( paddedLength - mBufferLength - 1 ) );
+  const quint64 bitLength = mLength * 8;
+  for ( int i = 0; i < 8; ++i )
+    buffer[paddedLength - 1 - i] = static_cast<uchar>( bitLength >> ( 8 * i ) );
+
+  std::swap( state, mState );
+  processBlocks( buffer, paddedLength / 64 );
+  std::swap( state, mState );
+
+  QByteArray digest( 20, Qt::Uninitialized );
+  for ( int i = 0; i < 5; ++i )
+  {
+    digest[4 * i] = static_cast<char>( state[i] >> 24 );
+    digest[4 * i + 1] = static_cast<char>( state[i] >> 16 );
+    digest[4 * i + 2] = static_cast<char>( state[i] >> 8 );
+    digest[4 * i + 3] = static_cast<char>( state[i] );
+  }
+  return digest.toHex();
+}
+
+void ChecksumEngine::processBlocks( const uchar *data, qint64 blocks )
+{
+  switch ( mBackend )
+  {
+#ifdef CHECKSUM_ENGINE_X86
+    case ShaNi:
+      sha1BlocksShaNi( mState, data, blocks );
+      break;
+#endif
+#ifdef CHECKSUM_ENGINE_ARM
+    case ArmV8:
+      sha1BlocksArmV8( mState, data, blocks );
+      break;
+#endif
+    default:
+      Q_ASSERT( false );  // generic backend does not use the state
+      break;
+  }
+}
+
+QByteArray ChecksumEngine::fileChecksum( const QString &filePath, Backend backend, bool mapFiles )
+{
+  QFile f( filePath );
+  if ( !f.open( QFile::ReadOnly ) )
+    return QByteArray();
+
+  ChecksumEngine engine( backend );
+  const qint64 size = f.size();
+  qint64 offset = 0;
+
+  if ( mapFiles && size >= MAP_MIN_SIZE )
+  {
+    while ( offset < size )
+    {
+      const qint64 length = qMin( MAP_WINDOW_SIZE, size - offset );
+      uchar *data = f.map( offset, length );
+      if ( !data )
+        break;  // e.g. a file system that does not support mapping - the rest gets read
+      engine.addData( reinterpret_cast<const char *>( data ), length );
+      f.unmap( data );
+      offset += length;
+    }
+  }
+
+  static thread_local ReadBuffer buffer;
+  f.seek( offset );
+  qint64 n;
+  while ( ( n = f.read( buffer.data, READ_BUFFER_SIZE ) ) > 0 )
+    engine.addData( buffer.data, n );
+
+  return engine.result();
+}
+
+ChecksumEngine::Backend ChecksumEngine::bestBackend()
+{
+  static const Backend backend = isBackendSupported( ShaNi ) ? ShaNi : isBackendSupported( ArmV8 ) ? ArmV8 : Generic;
+  return backend;
+}
+
+bool ChecksumEngine::isBackendSupported( Backend backend )
+{
+  switch ( backend )
+  {
+    case Generic:
+      return true;
+    case ShaNi:
+    {
+#ifdef CHECKSUM_ENGINE_X86
+      static const bool supported = cpuHasShaNi();
+      return supported;
+#else
+      return false;
+#endif
+    }
+    case ArmV8:
+    {
+#ifdef CHECKSUM_ENGINE_ARM
+      static const bool supported = cpuHasArmSha1();
+      return supported;
+#else
+      return false;
+#endif
+    }
+  }
+  return false;
+}
+
+QString ChecksumEngine::backendName( Backend backend )
+{
+  switch ( backend )
+  {
+    case Generic:
+      return QStringLiteral( "generic" );
+    case ShaNi:
+      return QStringLiteral( "sha-ni" );
+    case ArmV8:
+      return QStringLiteral( "armv8" );
+  }
+  return QString();
+}
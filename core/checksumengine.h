@@ -0,0 +1,73 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef CHECKSUMENGINE_H
+#define CHECKSUMENGINE_H
+
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QString>
+
+/**
+ * SHA1 hashing of files as used for checksums of project files (hex encoded digest).
+ *
+ * Larger files are hashed from memory mapped regions, smaller files are read to a buffer
+ * that is allocated once per thread, so no data get copied to temporary byte arrays.
+ * When the CPU has SHA instructions (SHA-NI on x86, crypto extension on ARMv8), they are used
+ * to compute the digest, otherwise the hashing is done by QCryptographicHash.
+ * All backends produce the same checksums.
+ */
+class ChecksumEngine
+{
+  public:
+    enum Backend
+    {
+      Generic,  //!< QCryptographicHash
+      ShaNi,    //!< x86 SHA extensions
+      ArmV8     //!< ARMv8 cryptography extension
+    };
+
+    //! Starts a new SHA1 hash computed with the given backend (it must be supported by the CPU)
+    explicit ChecksumEngine( Backend backend = bestBackend() );
+
+    void addData( const char *data, qint64 length );
+
+    //! Returns hex encoded SHA1 digest of the data added so far
+    QByteArray result();
+
+    //! Resets to the initial state to hash other data
+    void reset();
+
+    /**
+     * Returns hex encoded SHA1 checksum of the file or an empty array if the file cannot be opened.
+     * \a mapFiles may be set to false to always read the file to a buffer (e.g. for benchmarking).
+     */
+    static QByteArray fileChecksum( const QString &filePath, Backend backend = bestBackend(), bool mapFiles = true );
+
+    //! Returns the fastest backend supported by this CPU (detected on the first call)
+    static Backend bestBackend();
+
+    static bool isBackendSupported( Backend backend );
+
+    static QString backendName( Backend backend );
+
+  private:
+    void processBlocks( const uchar *data, qint64 blocks );
+
+    Backend mBackend;
+    QCryptographicHash mGenericHash;
+
+    // state of the hash computed by SHA instructions
+    quint32 mState[5];
+    uchar mBuffer[64];
+    int mBufferLength = 0;
+    quint64 mLength = 0;
+};
+
+#endif // CHECKSUMENGINE_H
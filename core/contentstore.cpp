@@ -0,0 +1,186 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "contentstore.h"
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QUuid>
+
+#include "coreutils.h"
+
+// references are read and written by pulls running in the sync worker and by removal of projects
+static QMutex sReferencesMutex;
+
+QString ContentStore::storeDir( const QString &dataDir )
+{
+  return dataDir + "/.objects";
+}
+
+ContentStore::ContentStore( const QString &storeDir )
+  : mStoreDir( storeDir )
+{
+}
+
+QString ContentStore::objectPath( const QString &checksum ) const
+{
+  return mStoreDir + "/objects/" + checksum.left( 2 ) + "/" + checksum;
+}
+
+bool ContentStore::contains( const QString &checksum, qint64 size ) const
+{
+  QFileInfo info( objectPath( checksum ) );
+  return info.exists() && info.size() == size;
+}
+
+bool ContentStore::add( const QString &checksum, const QString &filePath )
+{
+  if ( checksum.isEmpty() )
+    return false;
+
+  if ( contains( checksum, QFileInfo( filePath ).size() ) )
+    return true;
+
+  // pulls of other projects may be adding the same object at the same time - each uses its own temporary file
+  QString object = objectPath( checksum );
+  QString tempObject = object + "." + CoreUtils::uuidWithoutBraces( QUuid::createUuid() ) + ".tmp";
+  QDir().mkpath( QFileInfo( object ).absolutePath() );
+  if ( !CoreUtils::cloneFile( filePath, tempObject ) )
+  {
+    QFile::remove( tempObject );
+    return false;
+  }
+
+  if ( !CoreUtils::replaceFile( tempObject, object ) )
+  {
+    QFile::remove( tempObject );
+    return false;
+  }
+  return true;
+}
+
+bool ContentStore::materialize( const QString &checksum, const QString &destPath )
+{
+  QString object = objectPath( checksum );
+  if ( checksum.isEmpty() || !QFile::exists( object ) )
+    return false;
+
+  QString tempFile = destPath + ".tmp";
+  QDir().mkpath( QFileInfo( destPath ).absolutePath() );
+  QFile::remove( tempFile );
+  if ( !CoreUtils::cloneFile( object, tempFile ) )
+  {
+    QFile::remove( tempFile );
+    return false;
+  }
+
+  if ( !CoreUtils::replaceFile( tempFile, destPath ) )
+  {
+    QFile::remove( tempFile );
+    return false;
+  }
+  return true;
+}
+
+void ContentStore::addReferences( const QString &projectDir, const QSet<QString> &checksums )
+{
+  QMutexLocker locker( &sReferencesMutex );
+  QString refsFile = refsPath( projectDir );
+  QSet<QString> references = readReferences( refsFile );
+  int count = references.count();
+  references += checksums;
+  if ( references.count() != count )
+    writeReferences( refsFile, references );
+}
+
+void ContentStore::setReferences( const QString &projectDir, const QSet<QString> &checksums )
+{
+  QMutexLocker locker( &sReferencesMutex );
+  writeReferences( refsPath( projectDir ), checksums );
+}
+
+void ContentStore::release( const QString &projectDir )
+{
+  QMutexLocker locker( &sReferencesMutex );
+  QFile::remove( refsPath( projectDir ) );
+}
+
+int ContentStore::collectGarbage()
+{
+  QMutexLocker locker( &sReferencesMutex );
+
+  // references of projects that do not exist anymore are dropped as well
+  QString dataDir = QFileInfo( mStoreDir ).path();
+  QSet<QString> referenced;
+  const QFileInfoList refsFiles = QDir( mStoreDir + "/refs" ).entryInfoList( QDir::Files );
+  for ( const QFileInfo &refsFile : refsFiles )
+  {
+    if ( !QFileInfo( dataDir + "/" + refsFile.fileName() ).isDir() )
+      QFile::remove( refsFile.filePath() );
+    else
+      referenced += readReferences( refsFile.filePath() );
+  }
+
+  int removed = 0;
+  QDirIterator it( mStoreDir + "/objects", QDir::Files, QDirIterator::Subdirectories );
+  while ( it.hasNext() )
+  {
+    QString path = it.next();
+    if ( referenced.contains( it.fileName() ) || path.endsWith( ".tmp" ) )
+      continue;
+
+    if ( QFile::remove( path ) )
+      ++removed;
+  }
+
+  if ( removed )
+    CoreUtils::log( "content store", QStringLiteral( "Removed %1 unreferenced objects" ).arg( removed ) );
+  return removed;
+}
+
+QString ContentStore::refsPath( const QString &projectDir ) const
+{
+  return mStoreDir + "/refs/" + QFileInfo( projectDir ).fileName();
+}
+
+QSet<QString> ContentStore::readReferences( const QString &refsFile ) const
+{
+  QFile f( refsFile );
+  if ( !f.open( QIODevice::ReadOnly ) )
+    return QSet<QString>();
+
+  QSet<QString> checksums;
+  const QJsonArray array = QJsonDocument::fromJson( f.readAll() ).array();
+  for ( const QJsonValue &value : array )
+    checksums << value.toString();
+  return checksums;
+}
+
+bool ContentStore::writeReferences( const QString &refsFile, const QSet<QString> &checksums )
+{
+  if ( checksums.isEmpty() )
+    return !QFile::exists( refsFile ) || QFile::remove( refsFile );
+
+  QDir().mkpath( QFileInfo( refsFile ).absolutePath() );
+  QSaveFile f( refsFile );
+  if ( !f.open( QIODevice::WriteOnly ) )
+  {
+    CoreUtils::log( "content store", "Failed to open references for writing: " + refsFile );
+    return false;
+  }
+  f.write( QJsonDocument( QJsonArray::fromStringList( QStringList( checksums.begin(), checksums.end() ) ) ).toJson( QJsonDocument::Compact ) );
+  return f.commit();
+}
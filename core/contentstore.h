@@ -0,0 +1,73 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef CONTENTSTORE_H
+#define CONTENTSTORE_H
+
+#include <QSet>
+#include <QString>
+
+/**
+ * Content of files shared by local projects, addressed by the checksum from the server.
+ *
+ * Projects often contain the same files (base maps, symbol libraries, ...). A file downloaded by a pull
+ * is added to the store as an object and files with the same content pulled to other projects are
+ * created from the object instead of being downloaded again. Files are added and created by reflinks
+ * (copy-on-write) where the file system supports them, so objects take no extra space, otherwise they
+ * are copied. Objects never share data with project files in a way that would let a file modified
+ * in place (e.g. a geopackage) change the object or files of other projects.
+ *
+ * Each project references the objects of its files (references are kept by names of project directories).
+ * Objects that are not referenced by any existing project get removed by collectGarbage().
+ */
+class ContentStore
+{
+  public:
+    //! Returns the directory of the store for projects in the given data directory
+    static QString storeDir( const QString &dataDir );
+
+    explicit ContentStore( const QString &storeDir );
+
+    //! Returns path of the object with the given checksum
+    QString objectPath( const QString &checksum ) const;
+
+    //! Whether there is an object with the given checksum and size
+    bool contains( const QString &checksum, qint64 size ) const;
+
+    //! Adds the file with the given checksum as an object (it should be referenced by a project, see addReferences())
+    bool add( const QString &checksum, const QString &filePath );
+
+    /**
+     * Creates the file at \a destPath (replacing an existing one) from the object with the given checksum.
+     * Returns false if there is no such object or the file cannot be created. The object should be referenced
+     * by the project before (see addReferences()), so that it does not get collected in the meantime.
+     */
+    bool materialize( const QString &checksum, const QString &destPath );
+
+    //! Adds objects to those referenced by the project (e.g. checksums of files of the project before a pull updates them)
+    void addReferences( const QString &projectDir, const QSet<QString> &checksums );
+
+    //! Sets the objects referenced by the project (e.g. checksums of all files of the project after a pull)
+    void setReferences( const QString &projectDir, const QSet<QString> &checksums );
+
+    //! Drops all references of the project (e.g. it has been removed)
+    void release( const QString &projectDir );
+
+    //! Removes objects that are not referenced by any existing project, returns the number of removed objects
+    int collectGarbage();
+
+  private:
+    QString refsPath( const QString &projectDir ) const;
+    QSet<QString> readReferences( const QString &refsFile ) const;
+    bool writeReferences( const QString &refsFile, const QSet<QString> &checksums );
+
+    QString mStoreDir;
+};
+
+#endif // CONTENTSTORE_H
@@ -1,6 +1,13 @@
 
 SOURCES += \
+  $$PWD/adaptivechunkpolicy.cpp \
+  $$PWD/basefilestore.cpp \
+  $$PWD/changejournal.cpp \
+  $$PWD/checksumcache.cpp \
+  $$PWD/checksumengine.cpp \
+  $$PWD/contentstore.cpp \
   $$PWD/coreutils.cpp \
+  $$PWD/httpcompression.cpp \
   $$PWD/merginapi.cpp \
   $$PWD/merginapistatus.cpp \
   $$PWD/merginsubscriptioninfo.cpp \
@@ -12,10 +19,23 @@ SOURCES += \
   $$PWD/localprojectsmanager.cpp \
   $$PWD/merginprojectmetadata.cpp \
   $$PWD/project.cpp \
+  $$PWD/projectlistcache.cpp \
+  $$PWD/projectstatuscache.cpp \
+  $$PWD/ratelimiter.cpp \
+  $$PWD/syncmetrics.cpp \
+  $$PWD/syncscheduler.cpp \
+  $$PWD/syncworker.cpp \
   $$PWD/geodiffutils.cpp
 
 HEADERS += \
+  $$PWD/adaptivechunkpolicy.h \
+  $$PWD/basefilestore.h \
+  $$PWD/changejournal.h \
+  $$PWD/checksumcache.h \
+  $$PWD/checksumengine.h \
+  $$PWD/contentstore.h \
   $$PWD/coreutils.h \
+  $$PWD/httpcompression.h \
   $$PWD/merginapi.h \
   $$PWD/merginapistatus.h \
   $$PWD/merginsubscriptioninfo.h \
@@ -27,6 +47,12 @@ HEADERS += \
   $$PWD/localprojectsmanager.h \
   $$PWD/merginprojectmetadata.h \
   $$PWD/project.h \
+  $$PWD/projectlistcache.h \
+  $$PWD/projectstatuscache.h \
+  $$PWD/ratelimiter.h \
+  $$PWD/syncmetrics.h \
+  $$PWD/syncscheduler.h \
+  $$PWD/syncworker.h \
   $$PWD/geodiffutils.h
 
 exists($$PWD/merginsecrets.cpp) {
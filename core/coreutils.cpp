@@ -14,11 +14,24 @@
 #include <QDir>
 #include <QFile>
 #include <QDirIterator>
+#include <QMutex>
 #include <QTextStream>
 
 #include "qcoreapplication.h"
 #include "merginapi.h"
 
+#include <cstdio>
+
+#if defined( Q_OS_LINUX )
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/fs.h>
+#elif defined( Q_OS_MACOS ) || defined( Q_OS_IOS )
+#include <sys/clonefile.h>
+#endif
+
 const QString CoreUtils::LOG_TO_DEVNULL = QStringLiteral();
 const QString CoreUtils::LOG_TO_STDOUT = QStringLiteral( "TO_STDOUT" );
 QString CoreUtils::sLogFile = CoreUtils::LOG_TO_DEVNULL;
@@ -96,6 +109,10 @@ void CoreUtils::log( const QString &topic, const QString &info )
   QString logFilePath;
   QByteArray data;
   data.append( QString( "%1 %2: %3\n" ).arg( QDateTime().currentDateTimeUtc().toString( Qt::ISODateWithMs ) ).arg( topic ).arg( info ) );
+
+  // sync tasks log from worker threads too
+  static QMutex sLogMutex;
+  QMutexLocker locker( &sLogMutex );
   appendLog( data, sLogFile );
 }
 
@@ -197,3 +214,71 @@ bool CoreUtils::createEmptyFile( const QString &filePath )
   newFile.close();
   return true;
 }
+
+bool CoreUtils::cloneFile( const QString &srcPath, const QString &destPath )
+{
+  if ( QFile::exists( destPath ) )
+    return false;
+
+  if ( reflinkFile( srcPath, destPath ) )
+    return true;
+
+  return QFile::copy( srcPath, destPath );
+}
+
+bool CoreUtils::reflinkFile( const QString &srcPath, const QString &destPath )
+{
+  if ( QFile::exists( destPath ) )
+    return false;
+
+#if defined( Q_OS_LINUX ) && defined( FICLONE )
+  int srcFd = ::open( QFile::encodeName( srcPath ).constData(), O_RDONLY );
+  if ( srcFd < 0 )
+    return false;
+
+  struct stat st;
+  mode_t mode = ::fstat( srcFd, &st ) == 0 ? ( st.st_mode & 0777 ) : 0644;
+  int destFd = ::open( QFile::encodeName( destPath ).constData(), O_WRONLY | O_CREAT | O_EXCL, mode );
+  if ( destFd < 0 )
+  {
+    ::close( srcFd );
+    return false;
+  }
+
+  bool cloned = ::ioctl( destFd, FICLONE, srcFd ) == 0;
+  ::close( destFd );
+  ::close( srcFd );
+  if ( !cloned )
+    ::unlink( QFile::encodeName( destPath ).constData() );  // e.g. not supported by the file system
+  return cloned;
+#elif defined( Q_OS_MACOS ) || defined( Q_OS_IOS )
+  return ::clonefile( QFile::encodeName( srcPath ).constData(), QFile::encodeName( destPath ).constData(), 0 ) == 0;
+#else
+  Q_UNUSED( srcPath )
+  return false;
+#endif
+}
+
+bool CoreUtils::replaceFile( const QString &srcPath, const QString &destPath )
+{
+  if ( !QFile::exists( destPath ) )
+    return QFile::rename( srcPath, destPath );
+
+#if defined( Q_OS_UNIX )
+  return ::rename( QFile::encodeName( srcPath ).constData(), QFile::encodeName( destPath ).constData() ) == 0;
+#else
+  // the old file is moved aside and put back if the new one cannot take its place
+  QString backupPath = findUniquePath( destPath + ".old", false );
+  if ( !QFile::rename( destPath, backupPath ) )
+    return false;
+
+  if ( !QFile::rename( srcPath, destPath ) )
+  {
+    QFile::rename( backupPath, destPath );
+    return false;
+  }
+
+  QFile::remove( backupPath );
+  return true;
+#endif
+}
@@ -53,6 +53,25 @@ class CoreUtils
 
     static bool createEmptyFile( const QString &filePath );
 
+    /**
+     * Copies a file like QFile::copy() - destination must not exist. Where the file system supports it
+     * (reflinks on Linux, clonefile() on Apple platforms), the copy shares data blocks with the source
+     * and no data get copied. Otherwise the content is copied by a single streamed copy.
+     */
+    static bool cloneFile( const QString &srcPath, const QString &destPath );
+
+    /**
+     * Clones a file like cloneFile(), but only if the file system supports sharing of data blocks.
+     * Returns false (and leaves no destination file) when the data would have to be copied.
+     */
+    static bool reflinkFile( const QString &srcPath, const QString &destPath );
+
+    /**
+     * Moves a file to the destination, replacing the file that is there. If the file cannot be moved,
+     * the destination is left as it was. On Unix the file is replaced atomically by rename().
+     */
+    static bool replaceFile( const QString &srcPath, const QString &destPath );
+
     /**
      * Sets the filename of the internal text log file
      * - Use LOG_TO_DEVNULL to do not output any logs
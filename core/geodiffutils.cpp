@@ -9,12 +9,16 @@
 
 #include "geodiffutils.h"
 
+#include <QElapsedTimer>
+#include <QFile>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QTemporaryFile>
 #include <QUuid>
 
+#include <vector>
+
 #include <geodiff.h>
 #include "coreutils.h"
 
@@ -100,6 +104,35 @@ bool GeodiffUtils::applyDiffs( const QString &src, const QStringList &diffFiles
     return false;
   }
 
+  QElapsedTimer timer;
+  timer.start();
+
+  if ( diffFiles.count() > 1 )
+  {
+    // each applied changeset is a separate transaction over the whole file - when the file is many
+    // versions behind, it is much faster to squash the diffs into a single changeset and apply it once
+    QString concatFile = src + "-concat.diff";
+    if ( concatDiffs( diffFiles, concatFile ) )
+    {
+      qint64 concatMs = timer.elapsed();
+      int res = GEODIFF_applyChangeset( src.toUtf8().constData(), concatFile.toUtf8().constData() );
+      QFile::remove( concatFile );
+      if ( res == GEODIFF_SUCCESS )
+      {
+        CoreUtils::log( "GEODIFF", QStringLiteral( "applied %1 diffs as a single changeset in %2 ms (concatenation %3 ms), %4 transactions saved" )
+                        .arg( diffFiles.count() ).arg( timer.elapsed() ).arg( concatMs ).arg( diffFiles.count() - 1 ) );
+        return true;
+      }
+      // geodiff applies a changeset in a transaction - nothing has been changed, so the diffs may still be applied one by one
+      CoreUtils::log( "GEODIFF", "apply of concatenated changeset failed, applying diffs one by one" );
+    }
+    else
+    {
+      QFile::remove( concatFile );
+      CoreUtils::log( "GEODIFF", "concatenation of diffs failed, applying them one by one" );
+    }
+  }
+
   for ( QString diffFile : diffFiles )
   {
     int res = GEODIFF_applyChangeset( src.toUtf8().constData(), diffFile.toUtf8().constData() );
@@ -109,9 +142,25 @@ bool GeodiffUtils::applyDiffs( const QString &src, const QStringList &diffFiles
       return false;
     }
   }
+
+  if ( diffFiles.count() > 1 )
+    CoreUtils::log( "GEODIFF", QStringLiteral( "applied %1 diffs one by one in %2 ms" ).arg( diffFiles.count() ).arg( timer.elapsed() ) );
   return true;
 }
 
+bool GeodiffUtils::concatDiffs( const QStringList &diffFiles, const QString &outputFile )
+{
+  QList<QByteArray> paths;
+  std::vector<const char *> pathPointers;
+  for ( const QString &diffFile : diffFiles )
+    paths << diffFile.toUtf8();
+  for ( const QByteArray &path : paths )
+    pathPointers.push_back( path.constData() );
+
+  int res = GEODIFF_concatChanges( static_cast<int>( pathPointers.size() ), pathPointers.data(), outputFile.toUtf8().constData() );
+  return res == GEODIFF_SUCCESS;
+}
+
 void GeodiffUtils::log( GEODIFF_LoggerLevel level, const char *msg )
 {
   QString prefix;
@@ -55,9 +55,16 @@ class GeodiffUtils
      */
     static int createChangeset( const QString &projectDir, const QString &fileName, QString &diffName );
 
-    //! Takes "src" file and applies a sequence of changesets for the list in "diffFiles"
+    /**
+     * Takes "src" file and applies a sequence of changesets for the list in "diffFiles".
+     * Multiple changesets are concatenated first and applied in one go. If that fails,
+     * they are applied one by one.
+     */
     static bool applyDiffs( const QString &src, const QStringList &diffFiles );
 
+    //! Concatenates a sequence of changesets into a single changeset written to "outputFile"
+    static bool concatDiffs( const QStringList &diffFiles, const QString &outputFile );
+
     //! Geodiff logger callback function used to forward logs to Input.
     static void log( GEODIFF_LoggerLevel level, const char *msg );
 };
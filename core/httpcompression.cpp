@@ -0,0 +1,73 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "httpcompression.h"
+
+#include <QFileInfo>
+#include <QList>
+#include <QSet>
+#include <QtEndian>
+
+const QByteArray HttpCompression::ENCODING = QByteArrayLiteral( "deflate" );
+
+// GeoTIFF and GeoPackage are left out on purpose: they may or may not be compressed inside,
+// the ratio of the first compressed chunk decides
+static const QSet<QString> COMPRESSED_SUFFIXES =
+{
+  QStringLiteral( "jpg" ), QStringLiteral( "jpeg" ), QStringLiteral( "png" ), QStringLiteral( "gif" ),
+  QStringLiteral( "webp" ), QStringLiteral( "heic" ), QStringLiteral( "jp2" ), QStringLiteral( "ecw" ),
+  QStringLiteral( "zip" ), QStringLiteral( "gz" ), QStringLiteral( "bz2" ), QStringLiteral( "xz" ),
+  QStringLiteral( "7z" ), QStringLiteral( "zst" ), QStringLiteral( "qgz" ), QStringLiteral( "kmz" ),
+  QStringLiteral( "mbtiles" ), QStringLiteral( "mp3" ), QStringLiteral( "m4a" ), QStringLiteral( "ogg" ),
+  QStringLiteral( "mp4" ), QStringLiteral( "mov" ), QStringLiteral( "avi" ), QStringLiteral( "mkv" )
+};
+
+QByteArray HttpCompression::compress( const QByteArray &data, int level )
+{
+  // qCompress() prepends the uncompressed size (4 bytes, big endian) to the zlib stream
+  return qCompress( data, level ).mid( 4 );
+}
+
+QByteArray HttpCompression::decompress( const QByteArray &data, qint64 sizeHint )
+{
+  if ( data.isEmpty() )
+    return QByteArray();
+
+  QByteArray prefixed( 4, Qt::Uninitialized );
+  qToBigEndian<quint32>( static_cast<quint32>( qBound( static_cast<qint64>( 1 ), sizeHint, static_cast<qint64>( 0x7fffffff ) ) ),
+                         prefixed.data() );
+  prefixed.append( data );
+  return qUncompress( prefixed );
+}
+
+bool HttpCompression::acceptsEncoding( const QByteArray &acceptEncoding, const QByteArray &coding )
+{
+  const QList<QByteArray> items = acceptEncoding.split( ',' );
+  for ( const QByteArray &item : items )
+  {
+    QList<QByteArray> parts = item.split( ';' );
+    QByteArray name = parts.takeFirst().trimmed().toLower();
+    if ( name != coding && name != "*" )
+      continue;
+
+    for ( const QByteArray &param : qAsConst( parts ) )
+    {
+      QByteArray p = param.trimmed();
+      if ( p.startsWith( "q=" ) && p.mid( 2 ).toDouble() <= 0 )
+        return false;
+    }
+    return true;
+  }
+  return false;
+}
+
+bool HttpCompression::isCompressedFormat( const QString &filePath )
+{
+  return COMPRESSED_SUFFIXES.contains( QFileInfo( filePath ).suffix().toLower() );
+}
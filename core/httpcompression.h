@@ -0,0 +1,57 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef HTTPCOMPRESSION_H
+#define HTTPCOMPRESSION_H
+
+#include <QByteArray>
+#include <QString>
+
+/**
+ * Helpers for compression of HTTP payloads (content coding).
+ *
+ * Uploaded data are compressed with the "deflate" coding (zlib format, RFC 9110), which only needs zlib bundled
+ * with Qt. Downloads do not need anything from here: QNetworkAccessManager asks for gzip/deflate
+ * and inflates replies on the fly unless the request sets its own Accept-Encoding header.
+ */
+class HttpCompression
+{
+  public:
+    //! Name of the content coding produced by compress()
+    static const QByteArray ENCODING;
+
+    //! Compressed data are sent only if they are at most this fraction of the original size
+    static constexpr qreal MAX_COMPRESSION_RATIO = 0.9;
+
+    //! Payloads smaller than this are not worth compressing
+    static constexpr qint64 MIN_COMPRESSION_SIZE = 1024;
+
+    //! Returns data compressed in zlib format (the "deflate" HTTP content coding)
+    static QByteArray compress( const QByteArray &data, int level = 1 );
+
+    /**
+     * Returns data decompressed from zlib format or an empty array if they are not valid.
+     * \a sizeHint is the expected size of the decompressed data (the buffer grows if it is too small).
+     */
+    static QByteArray decompress( const QByteArray &data, qint64 sizeHint = 0 );
+
+    /**
+     * Returns whether value of an Accept-Encoding header (e.g. "gzip, deflate;q=0.5") allows the given coding.
+     * Codings with zero quality are not accepted.
+     */
+    static bool acceptsEncoding( const QByteArray &acceptEncoding, const QByteArray &coding );
+
+    /**
+     * Returns whether the file is of a format that is already compressed (images, archives, ...),
+     * so there is no point in compressing it again for the transfer.
+     */
+    static bool isCompressedFormat( const QString &filePath );
+};
+
+#endif // HTTPCOMPRESSION_H
@@ -11,6 +11,8 @@
 
 #include "merginapi.h"
 #include "merginprojectmetadata.h"
+#include "changejournal.h"
+#include "contentstore.h"
 #include "coreutils.h"
 
 #include <QDir>
@@ -22,10 +24,26 @@ LocalProjectsManager::LocalProjectsManager( const QString &dataDir )
   reloadDataDir();
 }
 
+LocalProjectsManager::~LocalProjectsManager()
+{
+  for ( const LocalProject &project : qAsConst( mProjects ) )
+    ChangeJournal::unwatch( project.projectDir );
+}
+
 void LocalProjectsManager::reloadDataDir()
 {
-  mProjects.clear();
+  // journals of projects that are still there are kept, so that their trees do not need to be watched again
   QStringList entryList = QDir( mDataDir ).entryList( QDir::NoDotAndDotDot | QDir::Dirs );
+  QSet<QString> projectDirs;
+  for ( const QString &folderName : entryList )
+    projectDirs << mDataDir + "/" + folderName;
+  for ( const LocalProject &project : qAsConst( mProjects ) )
+  {
+    if ( !projectDirs.contains( project.projectDir ) )
+      ChangeJournal::unwatch( project.projectDir );
+  }
+  mProjects.clear();
+  mStatusCache.clear();
   for ( const QString &folderName : entryList )
   {
     LocalProject info;
@@ -44,8 +62,10 @@ void LocalProjectsManager::reloadDataDir()
       info.projectName = folderName;
     }
 
+    ChangeJournal::watch( info.projectDir );
     mProjects << info;
   }
+  rebuildIndices();
 
   QString msg = QString( "Found %1 local projects in %2" ).arg( mProjects.size() ).arg( mDataDir );
   CoreUtils::log( "Local projects", msg );
@@ -54,32 +74,20 @@ void LocalProjectsManager::reloadDataDir()
 
 LocalProject LocalProjectsManager::projectFromDirectory( const QString &projectDir ) const
 {
-  for ( const LocalProject &info : mProjects )
-  {
-    if ( info.projectDir == projectDir )
-      return info;
-  }
-  return LocalProject();
+  int i = mIndexByDir.value( projectDir, -1 );
+  return i >= 0 ? mProjects.at( i ) : LocalProject();
 }
 
 LocalProject LocalProjectsManager::projectFromProjectFilePath( const QString &projectFilePath ) const
 {
-  for ( const LocalProject &info : mProjects )
-  {
-    if ( info.qgisProjectFilePath == projectFilePath )
-      return info;
-  }
-  return LocalProject();
+  int i = mIndexByProjectFilePath.value( projectFilePath, -1 );
+  return i >= 0 ? mProjects.at( i ) : LocalProject();
 }
 
 LocalProject LocalProjectsManager::projectFromMerginName( const QString &projectFullName ) const
 {
-  for ( const LocalProject &info : mProjects )
-  {
-    if ( info.id() == projectFullName )
-      return info;
-  }
-  return LocalProject();
+  int i = mIndexById.value( projectFullName, -1 );
+  return i >= 0 ? mProjects.at( i ) : LocalProject();
 }
 
 LocalProject LocalProjectsManager::projectFromMerginName( const QString &projectNamespace, const QString &projectName ) const
@@ -99,71 +107,60 @@ void LocalProjectsManager::addMerginProject( const QString &projectDir, const QS
 
 void LocalProjectsManager::removeLocalProject( const QString &projectId )
 {
-  for ( int i = 0; i < mProjects.count(); ++i )
-  {
-    if ( mProjects[i].id() == projectId )
-    {
-      emit aboutToRemoveLocalProject( mProjects[i] );
+  int i = mIndexById.value( projectId, -1 );
+  if ( i < 0 )
+    return;
 
-      CoreUtils::removeDir( mProjects[i].projectDir );
-      mProjects.removeAt( i );
+  emit aboutToRemoveLocalProject( mProjects[i] );
 
-      return;
-    }
-  }
+  ChangeJournal::unwatch( mProjects[i].projectDir );
+  mStatusCache.remove( mProjects[i].projectDir );
+  CoreUtils::removeDir( mProjects[i].projectDir );
+
+  // objects of the shared content store may not be needed by other projects
+  ContentStore contentStore( ContentStore::storeDir( mDataDir ) );
+  contentStore.release( mProjects[i].projectDir );
+  contentStore.collectGarbage();
+
+  mProjects.removeAt( i );
+  rebuildIndices();
 }
 
 bool LocalProjectsManager::projectIsValid( const QString &path ) const
 {
-  for ( int i = 0; i < mProjects.count(); ++i )
-  {
-    if ( mProjects[i].qgisProjectFilePath == path )
-    {
-      return mProjects[i].projectError.isEmpty();
-    }
-  }
-  return false;
+  int i = mIndexByProjectFilePath.value( path, -1 );
+  return i >= 0 && mProjects[i].projectError.isEmpty();
 }
 
 QString LocalProjectsManager::projectId( const QString &path ) const
 {
-  for ( int i = 0; i < mProjects.count(); ++i )
-  {
-    if ( mProjects[i].qgisProjectFilePath == path )
-    {
-      return mProjects[i].id();
-    }
-  }
-  return QString();
+  int i = mIndexByProjectFilePath.value( path, -1 );
+  return i >= 0 ? mProjects[i].id() : QString();
 }
 
 void LocalProjectsManager::updateLocalVersion( const QString &projectDir, int version )
 {
-  for ( int i = 0; i < mProjects.count(); ++i )
-  {
-    if ( mProjects[i].projectDir == projectDir )
-    {
-      mProjects[i].localVersion = version;
+  int i = mIndexByDir.value( projectDir, -1 );
+  Q_ASSERT( i >= 0 );  // should not happen
+  if ( i < 0 )
+    return;
 
-      emit localProjectDataChanged( mProjects[i] );
-      return;
-    }
-  }
-  Q_ASSERT( false );  // should not happen
+  mProjects[i].localVersion = version;
+  mStatusCache.invalidate( projectDir );
+
+  emit localProjectDataChanged( mProjects[i] );
 }
 
 void LocalProjectsManager::updateNamespace( const QString &projectDir, const QString &projectNamespace )
 {
-  for ( int i = 0; i < mProjects.count(); ++i )
-  {
-    if ( mProjects[i].projectDir == projectDir )
-    {
-      mProjects[i].projectNamespace = projectNamespace;
+  int i = mIndexByDir.value( projectDir, -1 );
+  if ( i < 0 )
+    return;
 
-      emit localProjectDataChanged( mProjects[i] );
-      return;
-    }
-  }
+  mProjects[i].projectNamespace = projectNamespace;
+  rebuildIndices();  // the full name has changed
+
+  emit localProjectDataChanged( mProjects[i] );
 }
 
 QString LocalProjectsManager::findQgisProjectFile( const QString &projectDir, QString &err )
@@ -206,12 +203,46 @@ QString LocalProjectsManager::findQgisProjectFile( const QString &projectDir, QS
 
 void LocalProjectsManager::addProject( const QString &projectDir, const QString &projectNamespace, const QString &projectName )
 {
+  // the directory may be listed already (e.g. a first time download that has been interrupted and resumed later)
+  int i = mIndexByDir.value( projectDir, -1 );
+  if ( i >= 0 )
+  {
+    emit aboutToRemoveLocalProject( mProjects[i] );
+    mProjects.removeAt( i );
+    rebuildIndices();
+  }
+
   LocalProject project;
   project.projectDir = projectDir;
   project.qgisProjectFilePath = findQgisProjectFile( projectDir, project.projectError );
   project.projectName = projectName;
   project.projectNamespace = projectNamespace;
 
+  ChangeJournal::watch( projectDir );
+  mStatusCache.invalidate( projectDir );
   mProjects << project;
+  indexProject( mProjects.count() - 1 );
   emit localProjectAdded( project );
 }
+
+void LocalProjectsManager::rebuildIndices()
+{
+  mIndexByDir.clear();
+  mIndexByProjectFilePath.clear();
+  mIndexById.clear();
+  for ( int i = 0; i < mProjects.count(); ++i )
+    indexProject( i );
+}
+
+void LocalProjectsManager::indexProject( int i )
+{
+  // keys may not be unique (e.g. a project copied to another directory) - the first project wins like with a linear search
+  const LocalProject &project = mProjects.at( i );
+  if ( !mIndexByDir.contains( project.projectDir ) )
+    mIndexByDir.insert( project.projectDir, i );
+  if ( !mIndexByProjectFilePath.contains( project.qgisProjectFilePath ) )
+    mIndexByProjectFilePath.insert( project.qgisProjectFilePath, i );
+  QString id = project.id();
+  if ( !mIndexById.contains( id ) )
+    mIndexById.insert( id, i );
+}
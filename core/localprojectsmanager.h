@@ -10,16 +10,20 @@
 #ifndef LOCALPROJECTSMANAGER_H
 #define LOCALPROJECTSMANAGER_H
 
+#include <QHash>
 #include <QObject>
 #include <project.h>
 
+#include "projectstatuscache.h"
+
 class LocalProjectsManager : public QObject
 {
     Q_OBJECT
   public:
     explicit LocalProjectsManager( const QString &dataDir );
+    ~LocalProjectsManager() override;
 
-    //! Loads all projects from mDataDir, removes all old projects
+    //! Loads all projects from mDataDir, removes all old projects. Changes of the projects get journaled (see ChangeJournal).
     void reloadDataDir();
 
     QString dataDir() const { return mDataDir; }
@@ -54,6 +58,9 @@ class LocalProjectsManager : public QObject
     //! Finds all QGIS project files and set the err variable if any occured.
     QString findQgisProjectFile( const QString &projectDir, QString &err );
 
+    //! Local changes of the projects checked in background - results are invalidated when projects are synced or removed
+    ProjectStatusCache *statusCache() { return &mStatusCache; }
+
   signals:
     void projectMetadataChanged( const QString &projectDir );
     void localMerginProjectAdded( const QString &projectDir );
@@ -65,8 +72,20 @@ class LocalProjectsManager : public QObject
   private:
     void addProject( const QString &projectDir, const QString &projectNamespace, const QString &projectName );
 
+    //! Rebuilds the lookup indices (after projects have been removed or their keys have changed)
+    void rebuildIndices();
+
+    //! Adds the project at position \a i of mProjects to the lookup indices
+    void indexProject( int i );
+
     QString mDataDir;   //!< directory with all local projects
     LocalProjectsList mProjects;
+    ProjectStatusCache mStatusCache;
+
+    // positions of projects in mProjects, so that lookups do not need to go through all projects
+    QHash<QString, int> mIndexByDir;
+    QHash<QString, int> mIndexByProjectFilePath;
+    QHash<QString, int> mIndexById;  //!< by LocalProject::id() - full Mergin name or name of the directory
 };
 
 
@@ -18,21 +18,35 @@
 #include <QSet>
 #include <QUuid>
 #include <QtMath>
+#include <QThread>
+#include <QMutex>
 
+#include <limits>
+
+#include "basefilestore.h"
+#include "changejournal.h"
+#include "checksumcache.h"
+#include "checksumengine.h"
+#include "contentstore.h"
 #include "coreutils.h"
 #include "geodiffutils.h"
+#include "httpcompression.h"
 #include "localprojectsmanager.h"
 #include "merginuserauth.h"
 #include "merginuserinfo.h"
 #include "merginsubscriptioninfo.h"
+#include "syncmetrics.h"
 
 #include <geodiff.h>
 
 const QString MerginApi::sMetadataFile = QStringLiteral( "/.mergin/mergin.json" );
+const QString MerginApi::sPullJournalFile = QStringLiteral( "pull.journal" );
+const QString MerginApi::sPushJournalFile = QStringLiteral( "push.journal" );
+const QString MerginApi::sProjectListCacheFile = QStringLiteral( "projectlist.cache" );
+const QString MerginApi::sSyncMetricsFile = QStringLiteral( "syncmetrics.jsonl" );
 const QString MerginApi::sDefaultApiRoot = QStringLiteral( "https://public.cloudmergin.com/" );
 const QSet<QString> MerginApi::sIgnoreExtensions = QSet<QString>() << "gpkg-shm" << "gpkg-wal" << "qgs~" << "qgz~" << "pyc" << "swap";
 const QSet<QString> MerginApi::sIgnoreFiles = QSet<QString>() << "mergin.json" << ".DS_Store";
-const int MerginApi::UPLOAD_CHUNK_SIZE = 10 * 1024 * 1024; // Should be the same as on Mergin server
 
 
 MerginApi::MerginApi( LocalProjectsManager &localProjects, QObject *parent )
@@ -52,6 +66,36 @@ MerginApi::MerginApi( LocalProjectsManager &localProjects, QObject *parent )
   QObject::connect( mSubscriptionInfo, &MerginSubscriptionInfo::subscriptionInfoChanged, this, &MerginApi::subscriptionInfoChanged );
   QObject::connect( mSubscriptionInfo, &MerginSubscriptionInfo::planProductIdChanged, this, &MerginApi::onPlanProductIdChanged );
   QObject::connect( mUserAuth, &MerginUserAuth::authChanged, this, &MerginApi::authChanged );
+  QObject::connect( &mSyncScheduler, &SyncScheduler::startSyncRequested, this, &MerginApi::startScheduledSync );
+
+  mThrottleTimer.setSingleShot( true );
+  QObject::connect( &mThrottleTimer, &QTimer::timeout, this, &MerginApi::resumeThrottledTransfers );
+
+  QSettings settings;
+  settings.beginGroup( QStringLiteral( "Input/" ) );
+  mRateLimiter.setRate( settings.value( QStringLiteral( "syncRateLimit" ), 0 ).toLongLong() );
+  mTransactionRateLimit = settings.value( QStringLiteral( "syncTransactionRateLimit" ), 0 ).toLongLong();
+  mMeteredConnection = settings.value( QStringLiteral( "meteredConnection" ), false ).toBool();
+  mSharedContentStore = settings.value( QStringLiteral( "sharedContentStore" ), false ).toBool();
+  settings.endGroup();
+
+  // listed projects change with syncs and new projects
+  mProjectListCache = ProjectListCache( mDataDir + "/" + TEMP_FOLDER + sProjectListCacheFile );
+  QObject::connect( this, &MerginApi::syncProjectFinished, this, [this]( const QString &, const QString & projectFullName, bool successfully )
+  {
+    if ( successfully )
+      mProjectListCache.invalidateProject( projectFullName );
+  } );
+  QObject::connect( this, &MerginApi::projectCreated, this, [this]( const QString &, bool result )
+  {
+    if ( result )
+      mProjectListCache.invalidateAll();
+  } );
+  QObject::connect( this, &MerginApi::serverProjectDeleted, this, [this]( const QString &, bool result )
+  {
+    if ( result )
+      mProjectListCache.invalidateAll();
+  } );
 
   loadAuthData();
   GEODIFF_init();
@@ -104,15 +148,40 @@ QString MerginApi::listProjects( const QString &searchExpression, const QString
   QUrl url( mApiRoot + QStringLiteral( "/v1/project/paginated" ) );
   url.setQuery( query );
 
+  QString requestId = CoreUtils::uuidWithoutBraces( QUuid::createUuid() );
+  QString cacheKey = ProjectListCache::key( mUserAuth->username(), url.toString() );
+
+  if ( mProjectListCache.isFreshPrefetch( cacheKey ) )
+  {
+    // the page has been prefetched a moment ago - no need to ask the server again
+    CoreUtils::log( "list projects", QStringLiteral( "Using prefetched: " ) + url.toString() );
+    mProjectListCache.markUsed( cacheKey );
+    QMetaObject::invokeMethod( this, [this, cacheKey, page, requestId]
+    {
+      int projectCount = mProjectListCache.entry( cacheKey ).projectCount;
+      emit listProjectsFinished( cachedProjectList( cacheKey ), mTransactionalStatus, projectCount, page, requestId );
+    }, Qt::QueuedConnection );
+    return requestId;
+  }
+
   // Even if the authorization is not required, it can be include to fetch more results
   QNetworkRequest request = getDefaultRequest( mUserAuth->hasAuthData() );
   request.setUrl( url );
 
-  QString requestId = CoreUtils::uuidWithoutBraces( QUuid::createUuid() );
+  if ( mProjectListCache.contains( cacheKey ) )
+  {
+    // show what we have right away, the server then tells whether it is still valid
+    setConditionalHeaders( request, cacheKey );
+    QMetaObject::invokeMethod( this, [this, cacheKey, page, requestId]
+    {
+      int projectCount = mProjectListCache.entry( cacheKey ).projectCount;
+      emit listProjectsFromCache( cachedProjectList( cacheKey ), mTransactionalStatus, projectCount, page, requestId );
+    }, Qt::QueuedConnection );
+  }
 
   QNetworkReply *reply = mManager.get( request );
   CoreUtils::log( "list projects", QStringLiteral( "Requesting: " ) + url.toString() );
-  connect( reply, &QNetworkReply::finished, this, [this, requestId]() {this->listProjectsReplyFinished( requestId );} );
+  connect( reply, &QNetworkReply::finished, this, [this, requestId, cacheKey]() {this->listProjectsReplyFinished( requestId, cacheKey );} );
 
   return requestId;
 }
@@ -134,56 +203,227 @@ QString MerginApi::listProjectsByName( const QStringList &projectNames )
   request.setRawHeader( "Content-type", "application/json" );
 
   QString requestId = CoreUtils::uuidWithoutBraces( QUuid::createUuid() );
+  QByteArray data = body.toJson();
+  QString cacheKey = ProjectListCache::key( mUserAuth->username(), url.toString(), data );
+
+  if ( mProjectListCache.contains( cacheKey ) )
+  {
+    setConditionalHeaders( request, cacheKey );
+    QMetaObject::invokeMethod( this, [this, cacheKey, requestId]
+    {
+      emit listProjectsByNameFromCache( cachedProjectList( cacheKey ), mTransactionalStatus, requestId );
+    }, Qt::QueuedConnection );
+  }
 
-  QNetworkReply *reply = mManager.post( request, body.toJson() );
+  QNetworkReply *reply = mManager.post( request, data );
   CoreUtils::log( "list projects by name", QStringLiteral( "Requesting: " ) + url.toString() );
-  connect( reply, &QNetworkReply::finished, this, [this, requestId]() {this->listProjectsByNameReplyFinished( requestId );} );
+  connect( reply, &QNetworkReply::finished, this, [this, requestId, cacheKey]() {this->listProjectsByNameReplyFinished( requestId, cacheKey );} );
 
   return requestId;
 }
 
+void MerginApi::prefetchProjects( const QUrl &url )
+{
+  QString cacheKey = ProjectListCache::key( mUserAuth->username(), url.toString() );
+  if ( mPrefetchedProjectLists.contains( cacheKey ) || mProjectListCache.isFresh( cacheKey ) )
+    return;  // being prefetched or it has just been listed
+
+  QNetworkRequest request = getDefaultRequest( mUserAuth->hasAuthData() );
+  request.setUrl( url );
+  if ( mProjectListCache.contains( cacheKey ) )
+    setConditionalHeaders( request, cacheKey );
 
-void MerginApi::downloadNextItem( const QString &projectFullName )
+  mPrefetchedProjectLists.insert( cacheKey );
+
+  QNetworkReply *reply = mManager.get( request );
+  CoreUtils::log( "list projects", QStringLiteral( "Prefetching: " ) + url.toString() );
+  connect( reply, &QNetworkReply::finished, this, [this, reply, cacheKey]
+  {
+    mPrefetchedProjectLists.remove( cacheKey );
+    if ( reply->error() == QNetworkReply::NoError )
+    {
+      QByteArray data = reply->readAll();
+      int projectCount = QJsonDocument::fromJson( data ).object().value( "count" ).toInt( -1 );
+      updateProjectListCache( reply, cacheKey, data, projectCount, true );
+    }
+    else
+    {
+      CoreUtils::log( "list projects", QStringLiteral( "Prefetch failed - %1" ).arg( reply->errorString() ) );
+    }
+    reply->deleteLater();
+  } );
+}
+
+void MerginApi::setConditionalHeaders( QNetworkRequest &request, const QString &cacheKey )
+{
+  ProjectListCache::Entry entry = mProjectListCache.entry( cacheKey );
+  if ( !entry.etag.isEmpty() )
+    request.setRawHeader( "If-None-Match", entry.etag );
+  if ( !entry.lastModified.isEmpty() )
+    request.setRawHeader( "If-Modified-Since", entry.lastModified );
+}
+
+bool MerginApi::updateProjectListCache( QNetworkReply *r, const QString &cacheKey, const QByteArray &data, int projectCount, bool prefetched )
+{
+  int status = r->attribute( QNetworkRequest::HttpStatusCodeAttribute ).toInt();
+  if ( status == 304 )
+  {
+    mProjectListCache.touch( cacheKey, prefetched );
+    return true;
+  }
+
+  // responses that cannot be revalidated are not worth keeping
+  ProjectListCache::Entry entry;
+  entry.etag = r->rawHeader( "ETag" );
+  entry.lastModified = r->rawHeader( "Last-Modified" );
+  if ( entry.etag.isEmpty() && entry.lastModified.isEmpty() )
+  {
+    mProjectListCache.remove( cacheKey );
+    return false;
+  }
+
+  entry.data = data;
+  entry.fetched = QDateTime::currentMSecsSinceEpoch();
+  entry.prefetched = prefetched;
+  entry.projectCount = projectCount;
+  mProjectListCache.store( cacheKey, entry );
+  return false;
+}
+
+MerginProjectsList MerginApi::cachedProjectList( const QString &cacheKey )
+{
+  ProjectListCache::Entry entry = mProjectListCache.entry( cacheKey );
+  if ( entry.parsed )
+    return entry.projects;
+
+  MerginProjectsList projects = parseProjectsFromJson( QJsonDocument::fromJson( entry.data ) );
+  mProjectListCache.setParsedProjects( cacheKey, projects );
+  return projects;
+}
+
+
+void MerginApi::downloadNextItems( const QString &projectFullName )
 {
   Q_ASSERT( mTransactionalStatus.contains( projectFullName ) );
   TransactionStatus &transaction = mTransactionalStatus[projectFullName];
 
   if ( transaction.downloadQueue.isEmpty() )
   {
-    // there's nothing to download so just finalize the update
-    finalizeProjectUpdate( projectFullName );
+    // there's nothing (more) to download so just finalize the update once pending requests are done
+    if ( transaction.replyDownloadItems.isEmpty() )
+      finalizeProjectUpdate( projectFullName );
     return;
   }
 
-  DownloadQueueItem item = transaction.downloadQueue.takeFirst();
+  while ( !transaction.downloadQueue.isEmpty() && canStartRequest( transaction.replyDownloadItems.count(), transaction.maxParallelDownloads ) )
+  {
+    // with a rate limit, another request waits until the data of the previous ones have been paid for
+    qint64 delay = transferDelay( transaction );
+    if ( delay > 0 )
+    {
+      scheduleThrottledTransfers( delay );
+      break;
+    }
+
+    DownloadQueueItem item = transaction.downloadQueue.takeFirst();
+
+    // ranges are planned large - request only as much as suits the measured speed and leave the rest for later
+    qint64 chunkSize = transaction.chunkPolicy.downloadChunkSize();
+    if ( item.rangeFrom >= 0 && !item.downloadDiff && item.size > chunkSize + chunkSize / 2 )
+      transaction.downloadQueue.prepend( splitDownloadItem( transaction, item, chunkSize ) );
+
+    QUrl url( mApiRoot + QStringLiteral( "/v1/project/raw/" ) + projectFullName );
+    QUrlQuery query;
+    // Handles special chars in a filePath (e.g prevents to convert "+" sign into a space)
+    query.addQueryItem( "file", item.filePath.toUtf8().toPercentEncoding() );
+    query.addQueryItem( "version", QStringLiteral( "v%1" ).arg( item.version ) );
+    if ( item.downloadDiff )
+      query.addQueryItem( "diff", "true" );
+    url.setQuery( query );
+
+    QNetworkRequest request = getDefaultRequest();
+    request.setUrl( url );
+    request.setAttribute( static_cast<QNetworkRequest::Attribute>( AttrProjectFullName ), projectFullName );
+    request.setAttribute( static_cast<QNetworkRequest::Attribute>( AttrTempFileName ), item.tempFileName );
+    request.setAttribute( static_cast<QNetworkRequest::Attribute>( AttrFilePath ), item.filePath );
+    request.setAttribute( static_cast<QNetworkRequest::Attribute>( AttrRangeFrom ), item.rangeFrom );
+    request.setAttribute( static_cast<QNetworkRequest::Attribute>( AttrRequestStart ), AdaptiveChunkPolicy::timestamp() );
+
+    QString range;
+    if ( item.rangeFrom != -1 && item.rangeTo != -1 )
+    {
+      range = QStringLiteral( "bytes=%1-%2" ).arg( item.rangeFrom ).arg( item.rangeTo );
+      request.setRawHeader( "Range", range.toUtf8() );
+    }
 
-  QUrl url( mApiRoot + QStringLiteral( "/v1/project/raw/" ) + projectFullName );
-  QUrlQuery query;
-  // Handles special chars in a filePath (e.g prevents to convert "+" sign into a space)
-  query.addQueryItem( "file", item.filePath.toUtf8().toPercentEncoding() );
-  query.addQueryItem( "version", QStringLiteral( "v%1" ).arg( item.version ) );
-  if ( item.downloadDiff )
-    query.addQueryItem( "diff", "true" );
-  url.setQuery( query );
+    // other requests get compressed by the server if it is able to, QNetworkAccessManager inflates them on the fly.
+    // A range of compressed content is of no use though, and compressing images etc. again is a waste of time
+    if ( !range.isEmpty() || ( !item.downloadDiff && HttpCompression::isCompressedFormat( item.filePath ) ) )
+      request.setRawHeader( "Accept-Encoding", "identity" );
 
-  QNetworkRequest request = getDefaultRequest();
-  request.setUrl( url );
-  request.setAttribute( static_cast<QNetworkRequest::Attribute>( AttrProjectFullName ), projectFullName );
-  request.setAttribute( static_cast<QNetworkRequest::Attribute>( AttrTempFileName ), item.tempFileName );
+    transaction.requestedItems.insert( downloadItemKey( item.tempFileName, item.rangeFrom ), item );
 
-  QString range;
-  if ( item.rangeFrom != -1 && item.rangeTo != -1 )
+    // data get written to disk as they arrive. With a rate limit the buffer is small, so that the server
+    // gets slowed down by the full buffer rather than the data arriving in large bursts
+    qint64 bufferSize = DOWNLOAD_BUFFER_SIZE;
+    if ( transaction.rateLimiter.isLimited() )
+      bufferSize = qMin( bufferSize, transaction.rateLimiter.burstSize() );
+    if ( mRateLimiter.isLimited() )
+      bufferSize = qMin( bufferSize, mRateLimiter.burstSize() );
+
+    QNetworkReply *reply = mManager.get( request );
+    reply->setReadBufferSize( bufferSize );
+    connect( reply, &QNetworkReply::readyRead, this, &MerginApi::downloadItemReadyRead );
+    connect( reply, &QNetworkReply::finished, this, &MerginApi::downloadItemReplyFinished );
+    transaction.replyDownloadItems << reply;
+
+    CoreUtils::log( "pull " + projectFullName, QStringLiteral( "Requesting item: " ) + url.toString() +
+                    ( !range.isEmpty() ? " Range: " + range : QString() ) );
+  }
+}
+
+DownloadQueueItem MerginApi::splitDownloadItem( TransactionStatus &transaction, DownloadQueueItem &item, qint64 size )
+{
+  DownloadQueueItem rest = item;
+  rest.rangeFrom = item.rangeFrom + size;
+  rest.size = item.size - size;
+  item.rangeTo = rest.rangeFrom - 1;
+  item.size = size;
+
+  // the checksum is computed from the items in order
+  auto it = transaction.downloadChecksums.find( item.filePath );
+  if ( it != transaction.downloadChecksums.end() )
   {
-    range = QStringLiteral( "bytes=%1-%2" ).arg( item.rangeFrom ).arg( item.rangeTo );
-    request.setRawHeader( "Range", range.toUtf8() );
+    for ( int i = 0; i < it->items.count(); ++i )
+    {
+      if ( it->items.at( i ).rangeFrom == item.rangeFrom )
+      {
+        it->items[i] = item;
+        it->items.insert( i + 1, rest );
+        break;
+      }
+    }
   }
+  return rest;
+}
+
+void MerginApi::abortPendingDownloads( TransactionStatus &transaction )
+{
+  const QList< QPointer<QNetworkReply> > replies = transaction.replyDownloadItems;
+  transaction.replyDownloadItems.clear();
+  transaction.downloadFiles.clear();  // closes the temporary files
+  transaction.requestedItems.clear();
+  transaction.downloadFirstDataTimes.clear();
 
-  Q_ASSERT( !transaction.replyDownloadItem );
-  transaction.replyDownloadItem = mManager.get( request );
-  connect( transaction.replyDownloadItem, &QNetworkReply::finished, this, &MerginApi::downloadItemReplyFinished );
+  for ( const QPointer<QNetworkReply> &reply : replies )
+  {
+    if ( !reply )
+      continue;
 
-  CoreUtils::log( "pull " + projectFullName, QStringLiteral( "Requesting item: " ) + url.toString() +
-                  ( !range.isEmpty() ? " Range: " + range : QString() ) );
+    disconnect( reply, nullptr, this, nullptr );
+    reply->abort();
+    reply->deleteLater();
+  }
 }
 
 void MerginApi::removeProjectsTempFolder( const QString &projectNamespace, const QString &projectName )
@@ -195,6 +435,88 @@ void MerginApi::removeProjectsTempFolder( const QString &projectNamespace, const
   QDir( path ).removeRecursively();
 }
 
+QString MerginApi::pullJournalItemId( const DownloadQueueItem &item )
+{
+  return QStringLiteral( "%1|%2|%3|%4|%5" ).arg( item.filePath ).arg( item.version ).arg( item.rangeFrom ).arg( item.rangeTo ).arg( item.downloadDiff );
+}
+
+void MerginApi::writePullJournalHeader( const QString &projectFullName, int version, const QString &projectDir )
+{
+  QString journalPath = getTempProjectDir( projectFullName ) + "/" + sPullJournalFile;
+  createPathIfNotExists( journalPath );
+
+  QJsonObject header;
+  header.insert( QStringLiteral( "version" ), version );
+  header.insert( QStringLiteral( "projectDir" ), projectDir );
+  header.insert( QStringLiteral( "created" ), static_cast<double>( QDateTime::currentMSecsSinceEpoch() ) );
+
+  QFile f( journalPath );
+  if ( !f.open( QIODevice::WriteOnly ) )
+  {
+    CoreUtils::log( "pull " + projectFullName, "Failed to open pull journal for writing: " + journalPath );
+    return;
+  }
+  f.write( QJsonDocument( header ).toJson( QJsonDocument::Compact ) + "\n" );
+}
+
+void MerginApi::appendPullJournalItem( const QString &projectFullName, const DownloadQueueItem &item )
+{
+  QJsonObject entry;
+  entry.insert( QStringLiteral( "file" ), item.filePath );
+  entry.insert( QStringLiteral( "version" ), item.version );
+  entry.insert( QStringLiteral( "from" ), item.rangeFrom );
+  entry.insert( QStringLiteral( "to" ), item.rangeTo );
+  entry.insert( QStringLiteral( "diff" ), item.downloadDiff );
+  entry.insert( QStringLiteral( "temp" ), item.tempFileName );
+
+  QFile f( getTempProjectDir( projectFullName ) + "/" + sPullJournalFile );
+  if ( !f.open( QIODevice::WriteOnly | QIODevice::Append ) )
+  {
+    CoreUtils::log( "pull " + projectFullName, "Failed to open pull journal for writing: " + f.fileName() );
+    return;
+  }
+  f.write( QJsonDocument( entry ).toJson( QJsonDocument::Compact ) + "\n" );
+}
+
+bool MerginApi::readPullJournal( const QString &projectFullName, int version, QString &projectDir, QList<DownloadQueueItem> &items )
+{
+  QString tempDir = getTempProjectDir( projectFullName );
+  QFile f( tempDir + "/" + sPullJournalFile );
+  if ( !f.open( QIODevice::ReadOnly ) )
+    return false;
+
+  QJsonObject header = QJsonDocument::fromJson( f.readLine() ).object();
+  projectDir = header.value( QStringLiteral( "projectDir" ) ).toString();
+  if ( header.value( QStringLiteral( "version" ) ).toInt( -1 ) != version )
+    return false;
+
+  // the server may have dropped the version meanwhile and the data take space - stale downloads start over
+  qint64 created = static_cast<qint64>( header.value( QStringLiteral( "created" ) ).toDouble() );
+  if ( QDateTime::currentMSecsSinceEpoch() - created > PULL_JOURNAL_MAX_AGE )
+  {
+    CoreUtils::log( "pull " + projectFullName, QStringLiteral( "Pull journal is too old, downloaded items are not reused" ) );
+    return false;
+  }
+
+  while ( !f.atEnd() )
+  {
+    // the last line may be incomplete if the app got killed while writing it
+    QJsonObject entry = QJsonDocument::fromJson( f.readLine() ).object();
+    QString tempFileName = entry.value( QStringLiteral( "temp" ) ).toString();
+    if ( tempFileName.isEmpty() || !QFile::exists( tempDir + "/" + tempFileName ) )
+      continue;
+
+    DownloadQueueItem item( entry.value( QStringLiteral( "file" ) ).toString(), 0,
+                            entry.value( QStringLiteral( "version" ) ).toInt(),
+                            static_cast<qint64>( entry.value( QStringLiteral( "from" ) ).toDouble() ),
+                            static_cast<qint64>( entry.value( QStringLiteral( "to" ) ).toDouble() ),
+                            entry.value( QStringLiteral( "diff" ) ).toBool() );
+    item.tempFileName = tempFileName;
+    items << item;
+  }
+  return !projectDir.isEmpty();
+}
+
 QNetworkRequest MerginApi::getDefaultRequest( bool withAuth )
 {
   QNetworkRequest request;
@@ -223,6 +545,12 @@ bool MerginApi::projectFileHasBeenUpdated( const ProjectDiff &diff )
   return false;
 }
 
+bool MerginApi::localFilesHaveBeenReplaced( const ProjectDiff &diff )
+{
+  return !diff.remoteUpdated.isEmpty() || !diff.remoteDeleted.isEmpty() ||
+         !diff.conflictRemoteUpdatedLocalUpdated.isEmpty() || !diff.conflictRemoteAddedLocalAdded.isEmpty();
+}
+
 bool MerginApi::hasProjecFileExtension( const QString filePath )
 {
   return filePath.contains( ".qgs" ) || filePath.contains( ".qgz" );
@@ -258,48 +586,208 @@ QString MerginApi::getApiKey( const QString &serverName )
   return "not-secret-key";
 }
 
-void MerginApi::downloadItemReplyFinished()
+void MerginApi::downloadItemReadyRead()
 {
   QNetworkReply *r = qobject_cast<QNetworkReply *>( sender() );
   Q_ASSERT( r );
 
+  if ( !writeDownloadItemData( r ) )
+    r->abort();  // will trigger downloadItemReplyFinished slot and fail the pull
+}
+
+bool MerginApi::writeDownloadItemData( QNetworkReply *r, bool drain )
+{
+  int status = r->attribute( QNetworkRequest::HttpStatusCodeAttribute ).toInt();
+  if ( r->error() != QNetworkReply::NoError || status >= 300 )
+    return true;  // keep the content for the error message
+
   QString projectFullName = r->request().attribute( static_cast<QNetworkRequest::Attribute>( AttrProjectFullName ) ).toString();
   QString tempFileName = r->request().attribute( static_cast<QNetworkRequest::Attribute>( AttrTempFileName ) ).toString();
+  QString filePath = r->request().attribute( static_cast<QNetworkRequest::Attribute>( AttrFilePath ) ).toString();
+  qint64 rangeFrom = r->request().attribute( static_cast<QNetworkRequest::Attribute>( AttrRangeFrom ) ).toLongLong();
+  qint64 offset = qMax( static_cast<qint64>( 0 ), rangeFrom );
 
   Q_ASSERT( mTransactionalStatus.contains( projectFullName ) );
   TransactionStatus &transaction = mTransactionalStatus[projectFullName];
-  Q_ASSERT( r == transaction.replyDownloadItem );
 
-  if ( r->error() == QNetworkReply::NoError )
+  std::shared_ptr<QFile> &file = transaction.downloadFiles[downloadItemKey( tempFileName, rangeFrom )];
+  if ( !file )
   {
-    QByteArray data = r->readAll();
+    QString tempFilePath = getTempProjectDir( projectFullName ) + "/" + tempFileName;
+    createPathIfNotExists( tempFilePath );
 
-    CoreUtils::log( "pull " + projectFullName, QStringLiteral( "Downloaded item (%1 bytes)" ).arg( data.size() ) );
+    transaction.downloadFirstDataTimes.insert( downloadItemKey( tempFileName, rangeFrom ), AdaptiveChunkPolicy::timestamp() );
 
-    QString tempFolder = getTempProjectDir( projectFullName );
-    QString tempFilePath = tempFolder + "/" + tempFileName;
-    createPathIfNotExists( tempFilePath );
+    // chunks of a file are written at their offsets into a shared staging file - it must not get truncated
+    file = std::make_shared<QFile>( tempFilePath );
+    if ( !file->open( QIODevice::ReadWrite ) || !file->seek( offset ) )
+    {
+      CoreUtils::log( "pull " + projectFullName, "Failed to open for writing: " + file->fileName() );
+      return false;
+    }
+  }
+
+  // with a rate limit, data wait in the reply's buffer until they may be read (a finished reply is read whole)
+  qint64 allowed = std::numeric_limits<qint64>::max();
+  if ( !drain )
+  {
+    qint64 wanted = qMin( r->bytesAvailable(), RateLimiter::MIN_BURST_SIZE );
+    allowed = transferDelay( transaction, wanted ) > 0 ? 0 : transferAllowance( transaction, r->bytesAvailable() );
+  }
 
-    // save to a tmp file, assemble at the end
-    QFile file( tempFilePath );
-    if ( file.open( QIODevice::WriteOnly ) )
+  qint64 bytesWritten = 0;
+  while ( r->bytesAvailable() > 0 && bytesWritten < allowed )
+  {
+    QByteArray data = r->read( qMin( static_cast<qint64>( DOWNLOAD_BUFFER_SIZE ), allowed - bytesWritten ) );
+    if ( file->write( data ) != data.size() )
     {
-      file.write( data );
-      file.close();
+      CoreUtils::log( "pull " + projectFullName, "Failed to write to: " + file->fileName() );
+      return false;
     }
-    else
+    bytesWritten += data.size();
+
+    // hash the data right away if this is the next chunk of the file to be hashed
+    auto it = transaction.downloadChecksums.find( filePath );
+    if ( it != transaction.downloadChecksums.end() &&
+         it->items.at( it->currentItem ).rangeFrom == rangeFrom &&
+         it->currentItemHashed == file->pos() - offset - data.size() )
     {
-      CoreUtils::log( "pull " + projectFullName, "Failed to open for writing: " + file.fileName() );
+      it->hash->addData( data );
+      it->currentItemHashed += data.size();
     }
+  }
 
-    transaction.transferedSize += data.size();
+  if ( bytesWritten )
+  {
+    consumeTransfer( transaction, bytesWritten );
+    transaction.transferedSize += bytesWritten;
     emit syncProjectStatusChanged( projectFullName, transaction.transferedSize / transaction.totalSize );
+  }
+
+  if ( r->bytesAvailable() > 0 && !drain )
+    scheduleThrottledTransfers( transferDelay( transaction, qMin( r->bytesAvailable(), RateLimiter::MIN_BURST_SIZE ) ) );
+  return true;
+}
+
+bool MerginApi::updateDownloadChecksum( const QString &projectFullName, const QString &filePath )
+{
+  Q_ASSERT( mTransactionalStatus.contains( projectFullName ) );
+  TransactionStatus &transaction = mTransactionalStatus[projectFullName];
+
+  auto it = transaction.downloadChecksums.find( filePath );
+  if ( it == transaction.downloadChecksums.end() )
+    return true;  // not verified (e.g. diffs)
+
+  DownloadChecksum &checksum = *it;
+  while ( checksum.currentItem < checksum.items.count() )
+  {
+    const DownloadQueueItem &item = checksum.items.at( checksum.currentItem );
+    QString key = downloadItemKey( item.tempFileName, item.rangeFrom );
+    qint64 offset = qMax( static_cast<qint64>( 0 ), item.rangeFrom );
+    bool itemFinished = transaction.downloadedItems.contains( key );
+
+    // catch up with the data that were written before the item became the current one
+    std::shared_ptr<QFile> writer = transaction.downloadFiles.value( key );
+    qint64 written = itemFinished ? item.size : ( writer ? writer->pos() - offset : 0 );
+    if ( checksum.currentItemHashed < written )
+    {
+      if ( writer )
+        writer->flush();
 
-    transaction.replyDownloadItem->deleteLater();
-    transaction.replyDownloadItem = nullptr;
+      QFile f( getTempProjectDir( projectFullName ) + "/" + item.tempFileName );
+      if ( f.open( QIODevice::ReadOnly ) && f.seek( offset + checksum.currentItemHashed ) )
+      {
+        while ( checksum.currentItemHashed < written )
+        {
+          QByteArray data = f.read( qMin( static_cast<qint64>( DOWNLOAD_BUFFER_SIZE ), written - checksum.currentItemHashed ) );
+          if ( data.isEmpty() )
+            break;
+          checksum.hash->addData( data );
+          checksum.currentItemHashed += data.size();
+        }
+      }
+    }
+
+    if ( !itemFinished )
+      return true;
+
+    ++checksum.currentItem;
+    checksum.currentItemHashed = 0;
+  }
+
+  QString downloadedChecksum = QString::fromLatin1( checksum.hash->result().toHex() );
+  bool valid = downloadedChecksum == checksum.expectedChecksum;
+  if ( !valid )
+  {
+    CoreUtils::log( "pull " + projectFullName, QStringLiteral( "Checksum mismatch of %1: expected %2, downloaded %3" )
+                    .arg( filePath, checksum.expectedChecksum, downloadedChecksum ) );
+  }
+  transaction.downloadChecksums.erase( it );
+  return valid;
+}
+
+void MerginApi::downloadItemReplyFinished()
+{
+  QNetworkReply *r = qobject_cast<QNetworkReply *>( sender() );
+  Q_ASSERT( r );
+  requestFinished();
+
+  QString projectFullName = r->request().attribute( static_cast<QNetworkRequest::Attribute>( AttrProjectFullName ) ).toString();
+  QString tempFileName = r->request().attribute( static_cast<QNetworkRequest::Attribute>( AttrTempFileName ) ).toString();
+  QString filePath = r->request().attribute( static_cast<QNetworkRequest::Attribute>( AttrFilePath ) ).toString();
+  qint64 rangeFrom = r->request().attribute( static_cast<QNetworkRequest::Attribute>( AttrRangeFrom ) ).toLongLong();
+  QString key = downloadItemKey( tempFileName, rangeFrom );
+
+  Q_ASSERT( mTransactionalStatus.contains( projectFullName ) );
+  TransactionStatus &transaction = mTransactionalStatus[projectFullName];
+  Q_ASSERT( transaction.replyDownloadItems.contains( r ) );
+  transaction.replyDownloadItems.removeOne( r );
+
+  if ( r->error() == QNetworkReply::NoError )
+  {
+    if ( !writeDownloadItemData( r, true ) )
+    {
+      r->deleteLater();
+      downloadItemsFailed( projectFullName, tr( "Failed to write downloaded data" ), false );
+      return;
+    }
+
+    std::shared_ptr<QFile> file = transaction.downloadFiles.take( key );
+    if ( !file )
+    {
+      // there was no content at all - we still need the (empty) file
+      QString tempFilePath = getTempProjectDir( projectFullName ) + "/" + tempFileName;
+      createPathIfNotExists( tempFilePath );
+      if ( !QFile::exists( tempFilePath ) )
+        CoreUtils::createEmptyFile( tempFilePath );
+    }
+    else
+    {
+      CoreUtils::log( "pull " + projectFullName, QStringLiteral( "Downloaded item (%1 bytes)" )
+                      .arg( file->pos() - qMax( static_cast<qint64>( 0 ), rangeFrom ) ) );
+      file->close();
+    }
+
+    r->deleteLater();
+
+    DownloadQueueItem item = transaction.requestedItems.take( key );
+    qint64 requestStart = r->request().attribute( static_cast<QNetworkRequest::Attribute>( AttrRequestStart ) ).toLongLong();
+    qint64 firstData = transaction.downloadFirstDataTimes.take( key );
+    transaction.chunkPolicy.addSample( item.size, AdaptiveChunkPolicy::timestamp() - requestStart,
+                                       firstData > 0 ? firstData - requestStart : -1 );
+    transaction.metrics->addSpan( SyncMetrics::Download, AdaptiveChunkPolicy::timestamp() - requestStart, item.size );
+
+    transaction.downloadedItems.insert( key );
+    appendPullJournalItem( projectFullName, item );
+
+    if ( !updateDownloadChecksum( projectFullName, filePath ) )
+    {
+      downloadItemsFailed( projectFullName, tr( "Downloaded file is corrupted: %1" ).arg( filePath ), false );
+      return;
+    }
 
     // Send another request (or finish)
-    downloadNextItem( projectFullName );
+    downloadNextItems( projectFullName );
   }
   else
   {
@@ -310,9 +798,41 @@ void MerginApi::downloadItemReplyFinished()
     }
     CoreUtils::log( "pull " + projectFullName, QStringLiteral( "FAILED - %1. %2" ).arg( r->errorString(), serverMsg ) );
 
-    transaction.replyDownloadItem->deleteLater();
-    transaction.replyDownloadItem = nullptr;
+    // when cancelled by the user, downloaded data are not needed anymore, otherwise keep them to resume later
+    bool keepDownloadedData = r->error() != QNetworkReply::OperationCanceledError;
+    int status = r->attribute( QNetworkRequest::HttpStatusCodeAttribute ).toInt();
+    if ( keepDownloadedData && ( status < 400 || status >= 500 ) )
+      transaction.chunkPolicy.addFailure();
+
+    r->deleteLater();
+
+    downloadItemsFailed( projectFullName, serverMsg, keepDownloadedData );
+  }
+}
+
+void MerginApi::downloadItemsFailed( const QString &projectFullName, const QString &serverMsg, bool keepDownloadedData )
+{
+  Q_ASSERT( mTransactionalStatus.contains( projectFullName ) );
+  TransactionStatus &transaction = mTransactionalStatus[projectFullName];
 
+  // there is no point to continue with other items that are being downloaded
+  abortPendingDownloads( transaction );
+
+  if ( keepDownloadedData )
+  {
+    // the journal in the temp folder tells the next pull of the same version what can be reused
+    CoreUtils::log( "pull " + projectFullName, QStringLiteral( "Keeping %1 downloaded items to resume the pull later" )
+                    .arg( transaction.downloadedItems.count() ) );
+
+    // downloaded items are only in the temp folder - an empty project directory would be listed as a broken project
+    if ( transaction.firstTimeDownload )
+    {
+      Q_ASSERT( !transaction.projectDir.isEmpty() );
+      QDir( transaction.projectDir ).removeRecursively();
+    }
+  }
+  else
+  {
     // get rid of the temporary download dir where we may have left some downloaded files
     QDir( getTempProjectDir( projectFullName ) ).removeRecursively();
 
@@ -321,15 +841,15 @@ void MerginApi::downloadItemReplyFinished()
       Q_ASSERT( !transaction.projectDir.isEmpty() );
       QDir( transaction.projectDir ).removeRecursively();
     }
+  }
 
-    finishProjectSync( projectFullName, false );
+  finishProjectSync( projectFullName, false );
 
-    emit networkErrorOccurred( serverMsg, QStringLiteral( "Mergin API error: downloadFile" ) );
-  }
+  emit networkErrorOccurred( serverMsg, QStringLiteral( "Mergin API error: downloadFile" ) );
 }
 
 
-void MerginApi::uploadFile( const QString &projectFullName, const QString &transactionUUID, MerginFile file, int chunkNo )
+void MerginApi::uploadFile( const QString &projectFullName, const QString &transactionUUID, const UploadChunk &chunk )
 {
   if ( !validateAuthAndContinute() || mApiVersionStatus != MerginApiStatus::OK )
   {
@@ -339,34 +859,567 @@ void MerginApi::uploadFile( const QString &projectFullName, const QString &trans
   Q_ASSERT( mTransactionalStatus.contains( projectFullName ) );
   TransactionStatus &transaction = mTransactionalStatus[projectFullName];
 
-  QString chunkID = file.chunks.at( chunkNo );
+  bool compress = transaction.compressUploads && chunk.size >= HttpCompression::MIN_COMPRESSION_SIZE &&
+                  !transaction.incompressibleFiles.contains( chunk.filePath ) && !HttpCompression::isCompressedFormat( chunk.filePath );
+  if ( !compress )
+  {
+    postUploadChunk( projectFullName, transactionUUID, chunk, readUploadChunk( chunk ), false );
+    return;
+  }
 
-  QString filePath;
-  if ( file.diffName.isEmpty() )
-    filePath = transaction.projectDir + "/" + file.path;
-  else  // use diff file instead of full file
-    filePath = transaction.projectDir + "/.mergin/" + file.diffName;
+  // compression of a whole chunk takes a while - do it in the sync worker
+  transaction.uploadChunksInPreparation.insert( chunk.chunkId );
+  mSyncWorker.run<QByteArray>( projectFullName, [chunk]
+  {
+    QByteArray compressed = HttpCompression::compress( readUploadChunk( chunk ) );
+    if ( compressed.size() > chunk.size * HttpCompression::MAX_COMPRESSION_RATIO )
+      return QByteArray();  // not worth it
+    return compressed;
+  },
+  [this, projectFullName, transactionUUID, chunk]( const QByteArray &compressed )
+  {
+    // the push may have been cancelled or failed in the meantime
+    if ( !mTransactionalStatus.contains( projectFullName ) || !mTransactionalStatus[projectFullName].uploadChunksInPreparation.remove( chunk.chunkId ) )
+      return;
+
+    TransactionStatus &transaction = mTransactionalStatus[projectFullName];
+
+    if ( transaction.cancelRequested )
+    {
+      // cancelled while there was no chunk request to abort
+      CoreUtils::log( "push " + projectFullName, QStringLiteral( "Cancelled while compressing chunks" ) );
+      abortPendingUploads( transaction );
+      discardPushJournal( transaction.projectDir );
+      sendUploadCancelRequest( projectFullName, transactionUUID );
+      finishProjectSync( projectFullName, false );
+      return;
+    }
 
-  QFile f( filePath );
+    if ( compressed.isEmpty() )
+    {
+      CoreUtils::log( "push " + projectFullName, QStringLiteral( "Not compressing %1 - the data are not compressible" ).arg( chunk.filePath ) );
+      transaction.incompressibleFiles.insert( chunk.filePath );
+      postUploadChunk( projectFullName, transactionUUID, chunk, readUploadChunk( chunk ), false );
+    }
+    else
+    {
+      postUploadChunk( projectFullName, transactionUUID, chunk, compressed, true );
+    }
+  } );
+}
+
+QByteArray MerginApi::readUploadChunk( const UploadChunk &chunk )
+{
+  QFile f( chunk.sourcePath );
   QByteArray data;
 
   if ( f.open( QIODevice::ReadOnly ) )
   {
-    f.seek( chunkNo * UPLOAD_CHUNK_SIZE );
-    data = f.read( UPLOAD_CHUNK_SIZE );
+    f.seek( chunk.offset );
+    data = f.read( chunk.size );
   }
+  return data;
+}
+
+void MerginApi::postUploadChunk( const QString &projectFullName, const QString &transactionUUID, const UploadChunk &chunk,
+                                 const QByteArray &data, bool compressed )
+{
+  Q_ASSERT( mTransactionalStatus.contains( projectFullName ) );
+  TransactionStatus &transaction = mTransactionalStatus[projectFullName];
 
   QNetworkRequest request = getDefaultRequest();
-  QUrl url( mApiRoot + QStringLiteral( "/v1/project/push/chunk/%1/%2" ).arg( transactionUUID ).arg( chunkID ) );
+  QUrl url( mApiRoot + QStringLiteral( "/v1/project/push/chunk/%1/%2" ).arg( transactionUUID ).arg( chunk.chunkId ) );
   request.setUrl( url );
   request.setRawHeader( "Content-Type", "application/octet-stream" );
+  if ( compressed )
+    request.setRawHeader( "Content-Encoding", HttpCompression::ENCODING );
   request.setAttribute( static_cast<QNetworkRequest::Attribute>( AttrProjectFullName ), projectFullName );
+  request.setAttribute( static_cast<QNetworkRequest::Attribute>( AttrChunkSize ), chunk.size );
+  request.setAttribute( static_cast<QNetworkRequest::Attribute>( AttrRequestStart ), AdaptiveChunkPolicy::timestamp() );
+
+  transaction.requestedChunks.insert( chunk.chunkId, chunk );
+
+  // the whole chunk is sent at once - the following chunks wait until it has been paid for
+  consumeTransfer( transaction, data.size() );
+
+  QNetworkReply *reply = mManager.post( request, data );
+  connect( reply, &QNetworkReply::finished, this, &MerginApi::uploadFileReplyFinished );
+  transaction.replyUploadFiles << reply;
+
+  CoreUtils::log( "push " + projectFullName, QStringLiteral( "Uploading item: " ) + url.toString() +
+                  ( compressed ? QStringLiteral( " (compressed %1 -> %2 bytes)" ).arg( chunk.size ).arg( data.size() ) : QString() ) );
+}
+
+void MerginApi::uploadNextChunks( const QString &projectFullName )
+{
+  Q_ASSERT( mTransactionalStatus.contains( projectFullName ) );
+  TransactionStatus &transaction = mTransactionalStatus[projectFullName];
+
+  if ( transaction.uploadChunkQueue.isEmpty() )
+  {
+    // wait until all the requests in progress are done
+    if ( !transaction.replyUploadFiles.isEmpty() || !transaction.uploadChunksInPreparation.isEmpty() )
+      return;
+
+    // every chunk of every file must have been acknowledged before we can ask the server to finish
+    for ( const MerginFile &file : qAsConst( transaction.uploadQueue ) )
+    {
+      for ( const QString &chunkId : file.chunks )
+      {
+        if ( !transaction.uploadedChunks.contains( chunkId ) )
+        {
+          CoreUtils::log( "push " + projectFullName, QStringLiteral( "FAILED - chunk %1 of %2 has not been uploaded" ).arg( chunkId, file.path ) );
+          finishProjectSync( projectFullName, false );
+          return;
+        }
+      }
+    }
+    transaction.uploadQueue.clear();
+
+    uploadFinish( projectFullName, transaction.transactionUUID );
+    return;
+  }
+
+  while ( !transaction.uploadChunkQueue.isEmpty() &&
+          canStartRequest( transaction.replyUploadFiles.count() + transaction.uploadChunksInPreparation.count(), transaction.maxParallelUploads ) )
+  {
+    qint64 delay = transferDelay( transaction );
+    if ( delay > 0 )
+    {
+      scheduleThrottledTransfers( delay );
+      break;
+    }
+
+    UploadChunk chunk = transaction.uploadChunkQueue.takeFirst();
+    uploadFile( projectFullName, transaction.transactionUUID, chunk );
+  }
+}
+
+int MerginApi::requestsInFlight() const
+{
+  int count = 0;
+  for ( const TransactionStatus &transaction : mTransactionalStatus )
+    count += transaction.replyDownloadItems.count() + transaction.replyUploadFiles.count() + transaction.uploadChunksInPreparation.count();
+  return count;
+}
+
+bool MerginApi::canStartRequest( int transactionRequests, int maxParallel ) const
+{
+  if ( transactionRequests == 0 )
+    return true;
+  return transactionRequests < qMax( 1, maxParallel ) && requestsInFlight() < mSyncScheduler.maxRequestsInFlight();
+}
+
+void MerginApi::requestFinished()
+{
+  // the finished request is handled first (whichever way it ends), requests held back for its slot are started after it
+  if ( mWaitingRequestsPending )
+    return;
+
+  mWaitingRequestsPending = true;
+  QMetaObject::invokeMethod( this, [this]
+  {
+    mWaitingRequestsPending = false;
+    startWaitingRequests();
+  }, Qt::QueuedConnection );
+}
+
+void MerginApi::startWaitingRequests()
+{
+  // the priority project gets the free slots first
+  QStringList projects = mTransactionalStatus.keys();
+  int priority = projects.indexOf( mSyncScheduler.priorityProject() );
+  if ( priority > 0 )
+    projects.move( priority, 0 );
+
+  for ( const QString &projectFullName : qAsConst( projects ) )
+  {
+    if ( requestsInFlight() >= mSyncScheduler.maxRequestsInFlight() )
+      break;
+
+    // only transactions that are transferring data may be held back (one without requests may always start one)
+    auto it = mTransactionalStatus.constFind( projectFullName );
+    if ( it == mTransactionalStatus.constEnd() )
+      continue;
+    if ( !it->downloadQueue.isEmpty() && !it->replyDownloadItems.isEmpty() )
+      downloadNextItems( projectFullName );
+    else if ( !it->uploadChunkQueue.isEmpty() && ( !it->replyUploadFiles.isEmpty() || !it->uploadChunksInPreparation.isEmpty() ) )
+      uploadNextChunks( projectFullName );
+  }
+}
+
+qint64 MerginApi::transferAllowance( TransactionStatus &transaction, qint64 bytes )
+{
+  qint64 now = AdaptiveChunkPolicy::timestamp();
+  return mRateLimiter.available( transaction.rateLimiter.available( bytes, now ), now );
+}
+
+void MerginApi::consumeTransfer( TransactionStatus &transaction, qint64 bytes )
+{
+  qint64 now = AdaptiveChunkPolicy::timestamp();
+  transaction.rateLimiter.consume( bytes, now );
+  mRateLimiter.consume( bytes, now );
+}
+
+qint64 MerginApi::transferDelay( TransactionStatus &transaction, qint64 bytes )
+{
+  qint64 now = AdaptiveChunkPolicy::timestamp();
+  return qMax( transaction.rateLimiter.delay( bytes, now ), mRateLimiter.delay( bytes, now ) );
+}
+
+void MerginApi::scheduleThrottledTransfers( qint64 delayMs )
+{
+  delayMs = qMax( static_cast<qint64>( 1 ), delayMs );
+  if ( !mThrottleTimer.isActive() || mThrottleTimer.remainingTime() > delayMs )
+    mThrottleTimer.start( static_cast<int>( delayMs ) );
+}
+
+void MerginApi::resumeThrottledTransfers()
+{
+  const QStringList projects = mTransactionalStatus.keys();
+  for ( const QString &projectFullName : projects )
+  {
+    // data held back in buffers of download replies (reading them lets the replies receive more data)
+    const QList< QPointer<QNetworkReply> > replies = mTransactionalStatus.value( projectFullName ).replyDownloadItems;
+    for ( const QPointer<QNetworkReply> &reply : replies )
+    {
+      if ( reply && reply->bytesAvailable() > 0 && !writeDownloadItemData( reply ) )
+        reply->abort();  // fails the pull
+
+      if ( !mTransactionalStatus.contains( projectFullName ) )
+        break;
+    }
+
+    if ( !mTransactionalStatus.contains( projectFullName ) )
+      continue;
+
+    // requests that have not been started
+    const TransactionStatus &transaction = mTransactionalStatus[projectFullName];
+    if ( !transaction.downloadQueue.isEmpty() )
+      downloadNextItems( projectFullName );
+    else if ( !transaction.uploadChunkQueue.isEmpty() )
+      uploadNextChunks( projectFullName );
+  }
+}
+
+void MerginApi::setRateLimit( qint64 bytesPerSecond )
+{
+  if ( bytesPerSecond == mRateLimiter.rate() )
+    return;
+
+  mRateLimiter.setRate( bytesPerSecond );
+  QSettings settings;
+  settings.beginGroup( QStringLiteral( "Input/" ) );
+  settings.setValue( QStringLiteral( "syncRateLimit" ), mRateLimiter.rate() );
+  settings.endGroup();
+  emit transferSettingsChanged();
+
+  resumeThrottledTransfers();
+}
+
+void MerginApi::setTransactionRateLimit( qint64 bytesPerSecond )
+{
+  bytesPerSecond = qMax( static_cast<qint64>( 0 ), bytesPerSecond );
+  if ( bytesPerSecond == mTransactionRateLimit )
+    return;
+
+  mTransactionRateLimit = bytesPerSecond;
+  for ( TransactionStatus &transaction : mTransactionalStatus )
+    transaction.rateLimiter.setRate( mTransactionRateLimit );
+
+  QSettings settings;
+  settings.beginGroup( QStringLiteral( "Input/" ) );
+  settings.setValue( QStringLiteral( "syncTransactionRateLimit" ), mTransactionRateLimit );
+  settings.endGroup();
+  emit transferSettingsChanged();
+
+  resumeThrottledTransfers();
+}
+
+void MerginApi::setMeteredConnection( bool metered )
+{
+  if ( metered == mMeteredConnection )
+    return;
+
+  mMeteredConnection = metered;
+  QSettings settings;
+  settings.beginGroup( QStringLiteral( "Input/" ) );
+  settings.setValue( QStringLiteral( "meteredConnection" ), mMeteredConnection );
+  settings.endGroup();
+  emit transferSettingsChanged();
+
+  if ( !mMeteredConnection )
+    resumeDeferredTransfers();
+}
+
+void MerginApi::setSharedContentStore( bool enabled )
+{
+  if ( enabled == mSharedContentStore )
+    return;
+
+  mSharedContentStore = enabled;
+  QSettings settings;
+  settings.beginGroup( QStringLiteral( "Input/" ) );
+  settings.setValue( QStringLiteral( "sharedContentStore" ), mSharedContentStore );
+  settings.endGroup();
+  emit transferSettingsChanged();
+
+  removeUnusedContentStore();
+}
+
+void MerginApi::removeUnusedContentStore()
+{
+  if ( mSharedContentStore )
+    return;
+
+  // pulls that have started with the store keep using it - it is removed when the last of them finishes
+  for ( const TransactionStatus &transaction : qAsConst( mTransactionalStatus ) )
+  {
+    if ( !transaction.contentStoreDir.isEmpty() )
+      return;
+  }
+
+  // project files never share data with objects other than by reflinks, so the store can simply go away
+  QString storeDir = ContentStore::storeDir( mDataDir );
+  if ( !QFileInfo::exists( storeDir ) )
+    return;
+
+  mSyncWorker.run<bool>( storeDir, [storeDir]
+  {
+    return CoreUtils::removeDir( storeDir );
+  },
+  [storeDir]( const bool & removed )
+  {
+    if ( !removed )
+      CoreUtils::log( "content store", "Failed to remove " + storeDir );
+  } );
+}
+
+QByteArray MerginApi::metadataKeepingFiles( const QString &projectDir, const QByteArray &data, const QSet<QString> &filePaths )
+{
+  QByteArray oldMetadata;
+  QFile oldMetadataFile( projectDir + "/" + sMetadataFile );
+  if ( oldMetadataFile.open( QIODevice::ReadOnly ) )
+    oldMetadata = oldMetadataFile.readAll();
+  return MerginProjectMetadata::withFilesFrom( data, oldMetadata, filePaths );
+}
+
+QByteArray MerginApi::pushedProjectMetadata( const TransactionStatus &transaction, const QByteArray &data )
+{
+  // files changed on the server that have not been pulled (left out on a metered connection) keep their old
+  // metadata, otherwise they would be seen as changed locally by the next sync
+  QSet<QString> unpulledFiles = transaction.diff.remoteAdded + transaction.diff.remoteUpdated;
+  if ( unpulledFiles.isEmpty() )
+    return data;
+  return metadataKeepingFiles( transaction.projectDir, data, unpulledFiles );
+}
 
-  Q_ASSERT( !transaction.replyUploadFile );
-  transaction.replyUploadFile = mManager.post( request, data );
-  connect( transaction.replyUploadFile, &QNetworkReply::finished, this, &MerginApi::uploadFileReplyFinished );
+bool MerginApi::isDeferredOnMeteredConnection( const QString &filePath, qint64 size )
+{
+  return size > METERED_MAX_FILE_SIZE && !isFileDiffable( filePath );
+}
 
-  CoreUtils::log( "push " + projectFullName, QStringLiteral( "Uploading item: " ) + url.toString() );
+bool MerginApi::hasDeferredFiles( const QString &projectFullName ) const
+{
+  return mDeferredPulls.contains( projectFullName ) || mDeferredPushes.contains( projectFullName );
+}
+
+void MerginApi::resumeDeferredTransfers()
+{
+  // a push pulls the left out files as well (see uploadInfoReplyFinished())
+  for ( const QString &projectFullName : mDeferredPushes )
+  {
+    CoreUtils::log( "sync " + projectFullName, QStringLiteral( "Connection is not metered anymore - syncing left out files" ) );
+    SyncScheduler::Request request;
+    request.projectFullName = projectFullName;
+    request.type = SyncScheduler::Upload;
+    mSyncScheduler.requestSync( request );
+  }
+
+  for ( const QString &projectFullName : mDeferredPulls )
+  {
+    if ( mDeferredPushes.contains( projectFullName ) )
+      continue;
+
+    CoreUtils::log( "sync " + projectFullName, QStringLiteral( "Connection is not metered anymore - syncing left out files" ) );
+    SyncScheduler::Request request;
+    request.projectFullName = projectFullName;
+    request.type = SyncScheduler::Update;
+    mSyncScheduler.requestSync( request );
+  }
+}
+
+void MerginApi::abortPendingUploads( TransactionStatus &transaction )
+{
+  const QList< QPointer<QNetworkReply> > replies = transaction.replyUploadFiles;
+  transaction.replyUploadFiles.clear();
+  transaction.requestedChunks.clear();
+  transaction.uploadChunksInPreparation.clear();  // their results get ignored
+
+  for ( const QPointer<QNetworkReply> &reply : replies )
+  {
+    if ( !reply )
+      continue;
+
+    disconnect( reply, nullptr, this, nullptr );
+    reply->abort();
+    reply->deleteLater();
+  }
+}
+
+void MerginApi::writePushJournalHeader( const QString &projectFullName )
+{
+  Q_ASSERT( mTransactionalStatus.contains( projectFullName ) );
+  TransactionStatus &transaction = mTransactionalStatus[projectFullName];
+
+  QJsonArray files;
+  for ( const MerginFile &file : qAsConst( transaction.uploadQueue ) )
+  {
+    QJsonObject fileObj;
+    fileObj.insert( QStringLiteral( "path" ), file.path );
+    fileObj.insert( QStringLiteral( "checksum" ), file.checksum );
+    fileObj.insert( QStringLiteral( "size" ), file.size );
+    fileObj.insert( QStringLiteral( "chunks" ), QJsonArray::fromStringList( file.chunks ) );
+    fileObj.insert( QStringLiteral( "chunkSize" ), file.chunkSize );
+    if ( !file.diffName.isEmpty() )
+    {
+      fileObj.insert( QStringLiteral( "diff" ), file.diffName );
+      fileObj.insert( QStringLiteral( "diffSize" ), file.diffSize );
+      fileObj.insert( QStringLiteral( "diffChecksum" ), file.diffChecksum );
+    }
+    files.append( fileObj );
+  }
+
+  QJsonObject header;
+  header.insert( QStringLiteral( "transaction" ), transaction.transactionUUID );
+  header.insert( QStringLiteral( "version" ), transaction.uploadBaseVersion );
+  header.insert( QStringLiteral( "changes" ), transaction.uploadChanges );
+  header.insert( QStringLiteral( "files" ), files );
+
+  QFile f( transaction.projectDir + "/.mergin/" + sPushJournalFile );
+  if ( !f.open( QIODevice::WriteOnly ) )
+  {
+    CoreUtils::log( "push " + projectFullName, "Failed to open push journal for writing: " + f.fileName() );
+    return;
+  }
+  f.write( QJsonDocument( header ).toJson( QJsonDocument::Compact ) + "\n" );
+}
+
+void MerginApi::appendPushJournalChunk( const QString &projectFullName, const QString &chunkId )
+{
+  Q_ASSERT( mTransactionalStatus.contains( projectFullName ) );
+  TransactionStatus &transaction = mTransactionalStatus[projectFullName];
+
+  QJsonObject entry;
+  entry.insert( QStringLiteral( "chunk" ), chunkId );
+
+  QFile f( transaction.projectDir + "/.mergin/" + sPushJournalFile );
+  if ( !f.open( QIODevice::WriteOnly | QIODevice::Append ) )
+  {
+    CoreUtils::log( "push " + projectFullName, "Failed to open push journal for writing: " + f.fileName() );
+    return;
+  }
+  f.write( QJsonDocument( entry ).toJson( QJsonDocument::Compact ) + "\n" );
+}
+
+bool MerginApi::resumePushFromJournal( const QString &projectFullName )
+{
+  Q_ASSERT( mTransactionalStatus.contains( projectFullName ) );
+  TransactionStatus &transaction = mTransactionalStatus[projectFullName];
+
+  QFile f( transaction.projectDir + "/.mergin/" + sPushJournalFile );
+  if ( !f.open( QIODevice::ReadOnly ) )
+    return false;
+
+  QJsonObject header = QJsonDocument::fromJson( f.readLine() ).object();
+  QString transactionUUID = header.value( QStringLiteral( "transaction" ) ).toString();
+  if ( transactionUUID.isEmpty() ||
+       header.value( QStringLiteral( "version" ) ).toInt( -1 ) != transaction.uploadBaseVersion ||
+       header.value( QStringLiteral( "changes" ) ).toObject() != transaction.uploadChanges )
+    return false;
+
+  QList<MerginFile> files;
+  QList<MerginFile> diffFiles;
+  const QJsonArray filesArray = header.value( QStringLiteral( "files" ) ).toArray();
+  for ( const QJsonValue &value : filesArray )
+  {
+    QJsonObject fileObj = value.toObject();
+    MerginFile file;
+    file.path = fileObj.value( QStringLiteral( "path" ) ).toString();
+    file.checksum = fileObj.value( QStringLiteral( "checksum" ) ).toString();
+    file.size = static_cast<qint64>( fileObj.value( QStringLiteral( "size" ) ).toDouble() );
+    for ( const QJsonValue &chunk : fileObj.value( QStringLiteral( "chunks" ) ).toArray() )
+      file.chunks << chunk.toString();
+    file.chunkSize = static_cast<qint64>( fileObj.value( QStringLiteral( "chunkSize" ) ).toDouble() );
+    file.diffName = fileObj.value( QStringLiteral( "diff" ) ).toString();
+    if ( !file.diffName.isEmpty() )
+    {
+      file.diffSize = static_cast<qint64>( fileObj.value( QStringLiteral( "diffSize" ) ).toDouble() );
+      file.diffChecksum = fileObj.value( QStringLiteral( "diffChecksum" ) ).toString();
+
+      // the diff file must be exactly the one announced to the server
+      if ( !QFile::exists( transaction.projectDir + "/.mergin/" + file.diffName ) )
+        return false;
+      diffFiles << file;
+    }
+    files << file;
+  }
+
+  QSet<QString> uploadedChunks;
+  while ( !f.atEnd() )
+  {
+    // the last line may be incomplete if the app got killed while writing it
+    QString chunkId = QJsonDocument::fromJson( f.readLine() ).object().value( QStringLiteral( "chunk" ) ).toString();
+    if ( !chunkId.isEmpty() )
+      uploadedChunks.insert( chunkId );
+  }
+
+  transaction.transactionUUID = transactionUUID;
+  transaction.uploadQueue = files;
+  transaction.uploadDiffFiles = diffFiles;
+  transaction.uploadedChunks = uploadedChunks;
+  transaction.uploadChunkQueue.clear();
+  transaction.totalSize = 0;
+  transaction.transferedSize = 0;
+  for ( const MerginFile &file : qAsConst( files ) )
+  {
+    const QList<UploadChunk> chunks = uploadChunksForFile( file, transaction.projectDir );
+    for ( const UploadChunk &chunk : chunks )
+    {
+      transaction.totalSize += chunk.size;
+      if ( uploadedChunks.contains( chunk.chunkId ) )
+        transaction.transferedSize += chunk.size;
+      else
+        transaction.uploadChunkQueue << chunk;
+    }
+  }
+
+  CoreUtils::log( "push " + projectFullName, QStringLiteral( "Resuming transaction %1 - %2 chunks uploaded already, %3 chunks to upload" )
+                  .arg( transactionUUID ).arg( uploadedChunks.count() ).arg( transaction.uploadChunkQueue.count() ) );
+
+  uploadNextChunks( projectFullName );
+  emit pushFilesStarted();
+  return true;
+}
+
+void MerginApi::discardPushJournal( const QString &projectDir )
+{
+  QFile f( projectDir + "/.mergin/" + sPushJournalFile );
+  if ( !f.open( QIODevice::ReadOnly ) )
+    return;
+
+  // diff files are created just for the push transaction
+  QJsonObject header = QJsonDocument::fromJson( f.readLine() ).object();
+  const QJsonArray filesArray = header.value( QStringLiteral( "files" ) ).toArray();
+  for ( const QJsonValue &value : filesArray )
+  {
+    QString diffName = value.toObject().value( QStringLiteral( "diff" ) ).toString();
+    if ( !diffName.isEmpty() )
+      QFile::remove( projectDir + "/.mergin/" + diffName );
+  }
+
+  f.close();
+  f.remove();
 }
 
 void MerginApi::uploadStart( const QString &projectFullName, const QByteArray &json )
@@ -394,6 +1447,12 @@ void MerginApi::uploadStart( const QString &projectFullName, const QByteArray &j
 
 void MerginApi::uploadCancel( const QString &projectFullName )
 {
+  if ( mSyncScheduler.removeQueued( projectFullName ) )
+  {
+    CoreUtils::log( "push " + projectFullName, QStringLiteral( "Removed from the sync queue" ) );
+    return;
+  }
+
   if ( !validateAuthAndContinute() || mApiVersionStatus != MerginApiStatus::OK )
   {
     return;
@@ -417,11 +1476,12 @@ void MerginApi::uploadCancel( const QString &projectFullName )
     CoreUtils::log( "push " + projectFullName, QStringLiteral( "Aborting upload start" ) );
     transaction.replyUploadStart->abort();  // will trigger uploadStartReplyFinished slot and emit sync finished
   }
-  else if ( transaction.replyUploadFile )
+  else if ( !transaction.replyUploadFiles.isEmpty() )
   {
     QString transactionUUID = transaction.transactionUUID;  // copy transaction uuid as the transaction object will be gone after abort
     CoreUtils::log( "push " + projectFullName, QStringLiteral( "Aborting upload file" ) );
-    transaction.replyUploadFile->abort();  // will trigger uploadFileReplyFinished slot and emit sync finished
+    // will trigger uploadFileReplyFinished slot which aborts the remaining requests and emits sync finished
+    transaction.replyUploadFiles.first()->abort();
 
     // also need to cancel the transaction
     sendUploadCancelRequest( projectFullName, transactionUUID );
@@ -434,6 +1494,12 @@ void MerginApi::uploadCancel( const QString &projectFullName )
 
     sendUploadCancelRequest( projectFullName, transactionUUID );
   }
+  else if ( mSyncWorker.isBusy( projectFullName ) )
+  {
+    // local files are being processed - the push gets finished once the sync worker is done
+    CoreUtils::log( "push " + projectFullName, QStringLiteral( "Cancelling after the running sync task" ) );
+    transaction.cancelRequested = true;
+  }
   else
   {
     Q_ASSERT( false );  // unexpected state
@@ -456,6 +1522,12 @@ void MerginApi::sendUploadCancelRequest( const QString &projectFullName, const Q
 
 void MerginApi::updateCancel( const QString &projectFullName )
 {
+  if ( mSyncScheduler.removeQueued( projectFullName ) )
+  {
+    CoreUtils::log( "pull " + projectFullName, QStringLiteral( "Removed from the sync queue" ) );
+    return;
+  }
+
   if ( !mTransactionalStatus.contains( projectFullName ) )
     return;
 
@@ -469,11 +1541,18 @@ void MerginApi::updateCancel( const QString &projectFullName )
     CoreUtils::log( "pull " + projectFullName, QStringLiteral( "Aborting project info request" ) );
     transaction.replyProjectInfo->abort();  // abort will trigger updateInfoReplyFinished() slot
   }
-  else if ( transaction.replyDownloadItem )
+  else if ( !transaction.replyDownloadItems.isEmpty() )
   {
     // we're already downloading some files
-    CoreUtils::log( "pull " + projectFullName, QStringLiteral( "Aborting pending download" ) );
-    transaction.replyDownloadItem->abort();  // abort will trigger downloadItemReplyFinished slot
+    CoreUtils::log( "pull " + projectFullName, QStringLiteral( "Aborting pending downloads" ) );
+    // abort will trigger downloadItemReplyFinished slot which also aborts the remaining requests
+    transaction.replyDownloadItems.first()->abort();
+  }
+  else if ( mSyncWorker.isBusy( projectFullName ) )
+  {
+    // local files are being processed - the pull gets finished once the sync worker is done
+    CoreUtils::log( "pull " + projectFullName, QStringLiteral( "Cancelling after the running sync task" ) );
+    transaction.cancelRequested = true;
   }
   else
   {
@@ -496,6 +1575,7 @@ void MerginApi::uploadFinish( const QString &projectFullName, const QString &tra
   request.setUrl( url );
   request.setRawHeader( "Content-Type", "application/json" );
   request.setAttribute( static_cast<QNetworkRequest::Attribute>( AttrProjectFullName ), projectFullName );
+  request.setAttribute( static_cast<QNetworkRequest::Attribute>( AttrRequestStart ), AdaptiveChunkPolicy::timestamp() );
 
   Q_ASSERT( !transaction.replyUploadFinish );
   transaction.replyUploadFinish = mManager.post( request, QByteArray() );
@@ -506,8 +1586,32 @@ void MerginApi::uploadFinish( const QString &projectFullName, const QString &tra
 
 void MerginApi::updateProject( const QString &projectNamespace, const QString &projectName, bool withoutAuth )
 {
-  QString projectFullName = getFullProjectName( projectNamespace, projectName );
+  SyncScheduler::Request request;
+  request.projectFullName = getFullProjectName( projectNamespace, projectName );
+  request.type = SyncScheduler::Update;
+  request.withoutAuth = withoutAuth;
+  mSyncScheduler.requestSync( request );  // startScheduledSync() gets called when it is the project's turn
+}
+
+void MerginApi::uploadProject( const QString &projectNamespace, const QString &projectName, bool isInitialUpload )
+{
+  SyncScheduler::Request request;
+  request.projectFullName = getFullProjectName( projectNamespace, projectName );
+  request.type = SyncScheduler::Upload;
+  request.isInitialUpload = isInitialUpload;
+  mSyncScheduler.requestSync( request );  // startScheduledSync() gets called when it is the project's turn
+}
+
+void MerginApi::startScheduledSync( const SyncScheduler::Request &request )
+{
+  if ( request.type == SyncScheduler::Update )
+    beginProjectUpdate( request.projectFullName, request.withoutAuth );
+  else
+    beginProjectUpload( request.projectFullName, request.isInitialUpload );
+}
 
+void MerginApi::beginProjectUpdate( const QString &projectFullName, bool withoutAuth )
+{
   CoreUtils::log( "pull " + projectFullName, "### Starting ###" );
 
   QNetworkReply *reply = getProjectInfo( projectFullName, withoutAuth );
@@ -518,6 +1622,9 @@ void MerginApi::updateProject( const QString &projectNamespace, const QString &p
     Q_ASSERT( !mTransactionalStatus.contains( projectFullName ) );
     mTransactionalStatus.insert( projectFullName, TransactionStatus() );
     mTransactionalStatus[projectFullName].replyProjectInfo = reply;
+    mTransactionalStatus[projectFullName].chunkPolicy = mChunkPolicy;
+    mTransactionalStatus[projectFullName].metrics = std::make_shared<SyncMetrics>( projectFullName, QStringLiteral( "pull" ) );
+    mTransactionalStatus[projectFullName].rateLimiter.setRate( mTransactionRateLimit );
 
     emit syncProjectStatusChanged( projectFullName, 0 );
 
@@ -526,13 +1633,12 @@ void MerginApi::updateProject( const QString &projectNamespace, const QString &p
   else
   {
     CoreUtils::log( "pull " + projectFullName, QStringLiteral( "FAILED to create project info request!" ) );
+    mSyncScheduler.syncFinished( projectFullName );
   }
 }
 
-void MerginApi::uploadProject( const QString &projectNamespace, const QString &projectName, bool isInitialUpload )
+void MerginApi::beginProjectUpload( const QString &projectFullName, bool isInitialUpload )
 {
-  QString projectFullName = getFullProjectName( projectNamespace, projectName );
-
   CoreUtils::log( "push " + projectFullName, "### Starting ###" );
 
   QNetworkReply *reply = getProjectInfo( projectFullName );
@@ -545,6 +1651,9 @@ void MerginApi::uploadProject( const QString &projectNamespace, const QString &p
     mTransactionalStatus.insert( projectFullName, TransactionStatus() );
     mTransactionalStatus[projectFullName].replyUploadProjectInfo = reply;
     mTransactionalStatus[projectFullName].isInitialUpload = isInitialUpload;
+    mTransactionalStatus[projectFullName].chunkPolicy = mChunkPolicy;
+    mTransactionalStatus[projectFullName].metrics = std::make_shared<SyncMetrics>( projectFullName, QStringLiteral( "push" ) );
+    mTransactionalStatus[projectFullName].rateLimiter.setRate( mTransactionRateLimit );
 
     emit syncProjectStatusChanged( projectFullName, 0 );
 
@@ -553,6 +1662,7 @@ void MerginApi::uploadProject( const QString &projectNamespace, const QString &p
   else
   {
     CoreUtils::log( "push " + projectFullName, QStringLiteral( "FAILED to create project info request!" ) );
+    mSyncScheduler.syncFinished( projectFullName );
   }
 }
 
@@ -696,6 +1806,7 @@ void MerginApi::getSubscriptionInfo()
 
 void MerginApi::clearAuth()
 {
+  mProjectListCache.clear();
   mUserAuth->clear();
   mUserInfo->clear();
   mSubscriptionInfo->clear();
@@ -1228,32 +2339,89 @@ void MerginApi::setApiRoot( const QString &apiRoot )
   }
 }
 
-QString MerginApi::merginUserName() const
+QString MerginApi::merginUserName() const
+{
+  return userAuth()->username();
+}
+
+QString MerginApi::syncMetricsFilePath() const
+{
+  return mDataDir + "/" + TEMP_FOLDER + sSyncMetricsFile;
+}
+
+QList<MerginFile> MerginApi::scanLocalProjectFiles( const QString &projectDir, SyncMetrics *metrics )
 {
-  return userAuth()->username();
+  SyncMetrics::Span span( metrics, SyncMetrics::Scan );
+  QList<MerginFile> files = getLocalProjectFiles( projectDir + "/" );
+
+  qint64 bytes = 0;
+  for ( const MerginFile &file : files )
+    bytes += file.size;
+  span.setBytes( bytes );
+
+  return files;
 }
 
-QList<MerginFile> MerginApi::getLocalProjectFiles( const QString &projectPath )
+QList<MerginFile> MerginApi::getLocalProjectFiles( const QString &projectPath, int hashingThreads )
 {
+  // scans of a project share its checksum cache and its position in the change journal, so they must not overlap
+  // (a scan could otherwise save cached checksums of files that another scan has already seen changed).
+  // Mutexes are only kept while some scan of the project uses them, so that removed projects leave nothing behind.
+  static QMutex sScanMutexesMutex;
+  static QHash<QString, std::shared_ptr<QMutex>> sScanMutexes;
+  const QString scanKey = QDir::cleanPath( projectPath );
+  std::shared_ptr<QMutex> scanMutex;
+  {
+    QMutexLocker locker( &sScanMutexesMutex );
+    std::shared_ptr<QMutex> &mutex = sScanMutexes[scanKey];
+    if ( !mutex )
+      mutex = std::make_shared<QMutex>();
+    scanMutex = mutex;
+  }
+  auto releaseScanMutex = [&scanMutex, &scanKey]
+  {
+    scanMutex->unlock();
+    QMutexLocker locker( &sScanMutexesMutex );
+    scanMutex.reset();
+    auto it = sScanMutexes.find( scanKey );
+    if ( it != sScanMutexes.end() && it->use_count() == 1 )
+      sScanMutexes.erase( it );
+  };
+  scanMutex->lock();
+
+  // the position in the journal is taken before the cache is loaded - changes after it are left to the next scan
   QList<MerginFile> merginFiles;
-  QSet<QString> localFiles = listFiles( projectPath );
-  for ( QString p : localFiles )
+  QSet<QString> changedFiles;
+  bool journaled = false;
+  QSet<QString> localFiles = listProjectFiles( projectPath, changedFiles, journaled );
+  ChecksumCache checksumCache( projectPath );
+
+  // files that are not in the cache get hashed on all cores unless told otherwise
+  if ( hashingThreads <= 0 )
+    hashingThreads = QThread::idealThreadCount();
+  const QHash<QString, ChecksumCache::Entry> entries = checksumCache.entries( localFiles.values(), hashingThreads,
+      journaled ? &changedFiles : nullptr );
+  for ( auto it = entries.constBegin(); it != entries.constEnd(); ++it )
   {
+    const QString &p = it.key();
+    const ChecksumCache::Entry &entry = it.value();
 
     MerginFile file;
-    QByteArray localChecksumBytes = getChecksum( projectPath + p );
-    QString localChecksum = QString::fromLatin1( localChecksumBytes.data(), localChecksumBytes.size() );
-    file.checksum = localChecksum;
+    file.checksum = entry.checksum;
     file.path = p;
-    QFileInfo info( projectPath + p );
-    file.size = info.size();
-    file.mtime = info.lastModified();
+    file.size = entry.size;
+    file.mtime = QDateTime::fromMSecsSinceEpoch( entry.mtime );
     merginFiles.append( file );
   }
+
+  checksumCache.retainOnly( localFiles );
+  checksumCache.save();
+
+  releaseScanMutex();
   return merginFiles;
 }
 
-void MerginApi::listProjectsReplyFinished( QString requestId )
+void MerginApi::listProjectsReplyFinished( QString requestId, QString cacheKey )
 {
   QNetworkReply *r = qobject_cast<QNetworkReply *>( sender() );
   Q_ASSERT( r );
@@ -1269,14 +2437,38 @@ void MerginApi::listProjectsReplyFinished( QString requestId )
 
     QByteArray data = r->readAll();
     QJsonDocument doc = QJsonDocument::fromJson( data );
-
     if ( doc.isObject() )
-    {
       projectCount = doc.object().value( "count" ).toInt();
+
+    if ( updateProjectListCache( r, cacheKey, data, projectCount, false ) )
+    {
+      projectCount = mProjectListCache.entry( cacheKey ).projectCount;
+      projectList = cachedProjectList( cacheKey );
+      CoreUtils::log( "list projects", QStringLiteral( "Not modified - %1 cached projects" ).arg( projectList.count() ) );
+    }
+    else
+    {
       projectList = parseProjectsFromJson( doc );
+      mProjectListCache.setParsedProjects( cacheKey, projectList );
+      CoreUtils::log( "list projects", QStringLiteral( "Success - got %1 projects" ).arg( projectList.count() ) );
     }
 
-    CoreUtils::log( "list projects", QStringLiteral( "Success - got %1 projects" ).arg( projectList.count() ) );
+    // the user is likely to scroll down - have the next page ready
+    if ( requestedPage * PROJECT_PER_PAGE < projectCount )
+    {
+      // keep order of the query items, so that the URL is the same as when the page gets listed
+      QList<QPair<QString, QString>> items = query.queryItems();
+      for ( QPair<QString, QString> &item : items )
+      {
+        if ( item.first == QStringLiteral( "page" ) )
+          item.second = QString::number( requestedPage + 1 );
+      }
+      QUrlQuery nextQuery;
+      nextQuery.setQueryItems( items );
+      QUrl nextUrl = r->request().url();
+      nextUrl.setQuery( nextQuery );
+      prefetchProjects( nextUrl );
+    }
   }
   else
   {
@@ -1293,7 +2485,7 @@ void MerginApi::listProjectsReplyFinished( QString requestId )
   emit listProjectsFinished( projectList, mTransactionalStatus, projectCount, requestedPage, requestId );
 }
 
-void MerginApi::listProjectsByNameReplyFinished( QString requestId )
+void MerginApi::listProjectsByNameReplyFinished( QString requestId, QString cacheKey )
 {
   QNetworkReply *r = qobject_cast<QNetworkReply *>( sender() );
   Q_ASSERT( r );
@@ -1303,9 +2495,18 @@ void MerginApi::listProjectsByNameReplyFinished( QString requestId )
   if ( r->error() == QNetworkReply::NoError )
   {
     QByteArray data = r->readAll();
-    QJsonDocument json = QJsonDocument::fromJson( data );
-    projectList = parseProjectsFromJson( json );
-    CoreUtils::log( "list projects by name", QStringLiteral( "Success - got %1 projects" ).arg( projectList.count() ) );
+    if ( updateProjectListCache( r, cacheKey, data, -1, false ) )
+    {
+      projectList = cachedProjectList( cacheKey );
+      CoreUtils::log( "list projects by name", QStringLiteral( "Not modified - %1 cached projects" ).arg( projectList.count() ) );
+    }
+    else
+    {
+      QJsonDocument json = QJsonDocument::fromJson( data );
+      projectList = parseProjectsFromJson( json );
+      mProjectListCache.setParsedProjects( cacheKey, projectList );
+      CoreUtils::log( "list projects by name", QStringLiteral( "Success - got %1 projects" ).arg( projectList.count() ) );
+    }
   }
   else
   {
@@ -1323,53 +2524,103 @@ void MerginApi::listProjectsByNameReplyFinished( QString requestId )
 }
 
 
-void MerginApi::finalizeProjectUpdateCopy( const QString &projectFullName, const QString &projectDir, const QString &tempDir, const QString &filePath, const QList<DownloadQueueItem> &items )
+bool MerginApi::finalizeProjectUpdateCopy( const QString &projectFullName, const QString &projectDir, const QString &tempDir, const QString &filePath, const QList<DownloadQueueItem> &items )
 {
   CoreUtils::log( "pull " + projectFullName, QStringLiteral( "Copying new content of " ) + filePath );
 
   QString dest = projectDir + "/" + filePath;
   createPathIfNotExists( dest );
 
-  QFile f( dest );
-  if ( !f.open( QIODevice::WriteOnly ) )
+  // all chunks have been written to a single staging file (an empty file has nothing to download) - it replaces
+  // the old file in a single step, so that the old file is kept if the new one cannot be moved in place
+  QString stagingFile;
+  if ( items.isEmpty() )
   {
-    CoreUtils::log( "pull " + projectFullName, "Failed to open file for writing " + dest );
-    return;
+    stagingFile = tempDir + "/" + CoreUtils::uuidWithoutBraces( QUuid::createUuid() );
+    if ( !CoreUtils::createEmptyFile( stagingFile ) )
+    {
+      CoreUtils::log( "pull " + projectFullName, "Failed to open file for writing " + stagingFile );
+      return false;
+    }
+  }
+  else
+  {
+    stagingFile = tempDir + "/" + items.first().tempFileName;
   }
 
-  // assemble file from tmp files
-  for ( const auto &item : items )
+  if ( !CoreUtils::replaceFile( stagingFile, dest ) )
+  {
+    CoreUtils::log( "pull " + projectFullName, "Failed to move temp file " + stagingFile + " to " + dest );
+    if ( items.isEmpty() )
+      QFile::remove( stagingFile );
+    return false;
+  }
+
+  // if diffable, copy to .mergin dir so we have a basefile
+  if ( MerginApi::isFileDiffable( filePath ) )
   {
-    QFile fTmp( tempDir + "/" + item.tempFileName );
-    if ( !fTmp.open( QIODevice::ReadOnly ) )
+    BasefileStore basefiles( projectDir );
+    if ( !basefiles.store( filePath, dest ) )
     {
-      CoreUtils::log( "pull " + projectFullName, "Failed to open temp file for reading " + item.tempFileName );
-      return;
+      CoreUtils::log( "pull " + projectFullName, "failed to copy new basefile for: " + filePath );
     }
-    f.write( fTmp.readAll() );
   }
+  return true;
+}
 
-  f.close();
+bool MerginApi::finalizeProjectUpdateClone( const QString &projectFullName, const QString &projectDir, const QString &filePath, const QString &sourcePath, bool move )
+{
+  CoreUtils::log( "pull " + projectFullName, QStringLiteral( "%1 local file %2 to %3" ).arg( move ? "Moving" : "Copying", sourcePath, filePath ) );
+
+  QString src = projectDir + "/" + sourcePath;
+  QString dest = projectDir + "/" + filePath;
+  createPathIfNotExists( dest );
+
+  if ( !( move ? QFile::rename( src, dest ) : CoreUtils::cloneFile( src, dest ) ) )
+  {
+    CoreUtils::log( "pull " + projectFullName, "Failed to copy local file " + src + " to " + dest );
+    return false;
+  }
 
   // if diffable, copy to .mergin dir so we have a basefile
   if ( MerginApi::isFileDiffable( filePath ) )
   {
-    QString basefile = projectDir + "/.mergin/" + filePath;
-    createPathIfNotExists( basefile );
-
-    if ( !QFile::remove( basefile ) )
+    BasefileStore basefiles( projectDir );
+    if ( !basefiles.store( filePath, dest ) )
     {
-      CoreUtils::log( "pull " + projectFullName, "failed to remove old basefile for: " + filePath );
+      CoreUtils::log( "pull " + projectFullName, "failed to copy new basefile for: " + filePath );
     }
-    if ( !QFile::copy( dest, basefile ) )
+  }
+  return true;
+}
+
+bool MerginApi::finalizeProjectUpdateShared( const QString &projectFullName, const QString &projectDir, const QString &filePath, const QString &checksum, const QString &contentStoreDir )
+{
+  CoreUtils::log( "pull " + projectFullName, "Creating file from the content store: " + filePath );
+
+  QString dest = projectDir + "/" + filePath;
+  ContentStore contentStore( contentStoreDir );
+  if ( !contentStore.materialize( checksum, dest ) )
+  {
+    CoreUtils::log( "pull " + projectFullName, "Failed to create file from the content store: " + filePath );
+    return false;
+  }
+
+  // if diffable, copy to .mergin dir so we have a basefile
+  if ( MerginApi::isFileDiffable( filePath ) )
+  {
+    BasefileStore basefiles( projectDir );
+    if ( !basefiles.store( filePath, dest ) )
     {
       CoreUtils::log( "pull " + projectFullName, "failed to copy new basefile for: " + filePath );
     }
   }
+
+  return true;
 }
 
 
-void MerginApi::finalizeProjectUpdateApplyDiff( const QString &projectFullName, const QString &projectDir, const QString &tempDir, const QString &filePath, const QList<DownloadQueueItem> &items )
+bool MerginApi::finalizeProjectUpdateApplyDiff( const QString &projectFullName, const QString &projectDir, const QString &tempDir, const QString &filePath, const QList<DownloadQueueItem> &items, const QString &conflictPath, bool localChanges, SyncMetrics *metrics )
 {
   CoreUtils::log( "pull " + projectFullName, QStringLiteral( "Applying diff to " ) + filePath );
 
@@ -1392,38 +2643,57 @@ void MerginApi::finalizeProjectUpdateApplyDiff( const QString &projectFullName,
   for ( const auto &item : items )
     diffFiles << tempDir + "/" + item.tempFileName;
 
+  BasefileStore basefiles( projectDir );
+  bool cloned = basefiles.reflinkTo( filePath, src );
+  if ( !cloned && !localChanges )
+  {
+    // a copy of the basefile would mean writing the whole file again - without local changes
+    // there is nothing to rebase, so the diffs are applied to the basefile and to the local file in place
+    SyncMetrics::Span span( metrics, SyncMetrics::GeodiffApply, QFileInfo( dest ).size() );
+    if ( !basefiles.applyDiffsInPlace( filePath, diffFiles ) )
+    {
+      // e.g. the file is open and the database is locked - the file stays recorded as interrupted
+      CoreUtils::log( "pull " + projectFullName, "applying diffs in place failed, the file will be downloaded again: " + filePath );
+      return false;
+    }
+    CoreUtils::log( "pull " + projectFullName, "diffs applied in place: " + filePath );
+    return true;
+  }
+
   //
   // let's first assemble server's file from our basefile + diffs
   //
 
-  if ( !QFile::copy( basefile, src ) )
+  if ( !cloned && !CoreUtils::cloneFile( basefile, src ) )
   {
     CoreUtils::log( "pull " + projectFullName, "assemble server file fail: copying failed " + basefile + " to " + src );
 
     // TODO: this is a critical failure - we should abort pull
   }
 
-  if ( !GeodiffUtils::applyDiffs( src, diffFiles ) )
+  SyncMetrics::Span applySpan( metrics, SyncMetrics::GeodiffApply, QFileInfo( src ).size() );
+  bool applied = GeodiffUtils::applyDiffs( src, diffFiles );
+  applySpan.finish();
+  if ( !applied )
   {
+    // the basefile and the local file are left as they are - the file keeps its old metadata and gets pulled again
     CoreUtils::log( "pull " + projectFullName, "server file assembly failed: " + filePath );
-
-    // TODO: this is a critical failure - we should abort pull
-    // TODO: we could try to delete the basefile and re-download it from scratch on next sync
-  }
-  else
-  {
-    CoreUtils::log( "pull " + projectFullName, "server file assembly successful: " + filePath );
+    QFile::remove( src );
+    return false;
   }
+  CoreUtils::log( "pull " + projectFullName, "server file assembly successful: " + filePath );
 
   //
   // now we are ready for the update of our local file
   //
 
+  SyncMetrics::Span rebaseSpan( metrics, SyncMetrics::GeodiffRebase, QFileInfo( dest ).size() );
   int res = GEODIFF_rebase( basefile.toUtf8().constData(),
                             src.toUtf8().constData(),
                             dest.toUtf8().constData(),
                             conflictfile.toUtf8().constData()
                           );
+  rebaseSpan.finish();
   if ( res == GEODIFF_SUCCESS )
   {
     CoreUtils::log( "pull " + projectFullName, "geodiff rebase successful: " + filePath );
@@ -1434,13 +2704,12 @@ void MerginApi::finalizeProjectUpdateApplyDiff( const QString &projectFullName,
 
     // not good... something went wrong in rebase - we need to save the local changes
     // let's put them into a conflict file and use the server version
-    LocalProject info = mLocalProjects.projectFromMerginName( projectFullName );
-    QString newDest = CoreUtils::findUniquePath( generateConflictFileName( dest, info.localVersion ), false );
+    QString newDest = CoreUtils::findUniquePath( conflictPath, false );
     if ( !QFile::rename( dest, newDest ) )
     {
       CoreUtils::log( "pull " + projectFullName, "failed rename of conflicting file after failed geodiff rebase: " + filePath );
     }
-    if ( !QFile::copy( src, dest ) )
+    if ( !CoreUtils::cloneFile( src, dest ) )
     {
       CoreUtils::log( "pull " + projectFullName, "failed to update local conflicting file after failed geodiff rebase: " + filePath );
     }
@@ -1462,6 +2731,7 @@ void MerginApi::finalizeProjectUpdateApplyDiff( const QString &projectFullName,
 
     // TODO: this is a critical failure - we should abort pull
   }
+  return true;
 }
 
 void MerginApi::finalizeProjectUpdate( const QString &projectFullName )
@@ -1471,16 +2741,71 @@ void MerginApi::finalizeProjectUpdate( const QString &projectFullName )
 
   QString projectDir = transaction.projectDir;
   QString tempProjectDir = getTempProjectDir( projectFullName );
+  QList<UpdateTask> tasks = transaction.updateTasks;
+
+  // local files that conflict with the server get renamed - the name includes the user and the local version
+  QHash<QString, QString> conflictPaths;
+  LocalProject info = mLocalProjects.projectFromMerginName( projectFullName );
+  for ( const UpdateTask &task : qAsConst( tasks ) )
+  {
+    if ( task.method == UpdateTask::CopyConflict || task.method == UpdateTask::ApplyDiff || task.method == UpdateTask::ApplyDiffUnmodified )
+      conflictPaths.insert( task.filePath, generateConflictFileName( projectDir + "/" + task.filePath, info.localVersion ) );
+  }
 
   CoreUtils::log( "pull " + projectFullName, "Running update tasks" );
 
-  for ( const UpdateTask &finalizationItem : transaction.updateTasks )
+  // the project references objects of all its files in the shared content store
+  QString contentStoreDir = transaction.contentStoreDir;
+  QSet<QString> checksums;
+  if ( !contentStoreDir.isEmpty() )
+  {
+    const QList<MerginFile> files = MerginProjectMetadata::fromJson( transaction.projectMetadata ).files;
+    for ( const MerginFile &file : files )
+      checksums << file.checksum;
+  }
+
+  std::shared_ptr<SyncMetrics> metrics = transaction.metrics;
+  mSyncWorker.run<QSet<QString>>( projectFullName, [projectFullName, projectDir, tempProjectDir, tasks, conflictPaths, contentStoreDir, checksums, metrics]
+  {
+    return runUpdateTasks( projectFullName, projectDir, tempProjectDir, tasks, conflictPaths, contentStoreDir, checksums, metrics.get() );
+  },
+  [this, projectFullName]( const QSet<QString> &missingFiles )
+  {
+    updateTasksFinished( projectFullName, missingFiles );
+  } );
+}
+
+QSet<QString> MerginApi::runUpdateTasks( const QString &projectFullName, const QString &projectDir, const QString &tempProjectDir,
+                                         const QList<UpdateTask> &tasks, const QHash<QString, QString> &conflictPaths,
+                                         const QString &contentStoreDir, const QSet<QString> &checksums, SyncMetrics *metrics )
+{
+  SyncMetrics::Span span( metrics, SyncMetrics::Finalize );
+  QSet<QString> missingFiles;
+
+  // objects of the new files are referenced before they get added or used, so that garbage collection
+  // of other pulls leaves them alone - references of files that have gone are dropped at the end
+  if ( !contentStoreDir.isEmpty() )
+  {
+    ContentStore contentStore( contentStoreDir );
+    contentStore.addReferences( projectDir, checksums );
+  }
+
+  for ( const UpdateTask &finalizationItem : tasks )
   {
     switch ( finalizationItem.method )
     {
       case UpdateTask::Copy:
       {
-        finalizeProjectUpdateCopy( projectFullName, projectDir, tempProjectDir, finalizationItem.filePath, finalizationItem.data );
+        if ( !finalizeProjectUpdateCopy( projectFullName, projectDir, tempProjectDir, finalizationItem.filePath, finalizationItem.data ) )
+        {
+          missingFiles << finalizationItem.filePath;
+        }
+        else if ( !contentStoreDir.isEmpty() && !finalizationItem.checksum.isEmpty() )
+        {
+          // share the downloaded file with other projects
+          ContentStore contentStore( contentStoreDir );
+          contentStore.add( finalizationItem.checksum, projectDir + "/" + finalizationItem.filePath );
+        }
         break;
       }
 
@@ -1488,8 +2813,7 @@ void MerginApi::finalizeProjectUpdate( const QString &projectFullName )
       {
         // move local file to conflict file
         QString origPath = projectDir + "/" + finalizationItem.filePath;
-        LocalProject info = mLocalProjects.projectFromMerginName( projectFullName );
-        QString newPath = CoreUtils::findUniquePath( generateConflictFileName( origPath, info.localVersion ), false );
+        QString newPath = CoreUtils::findUniquePath( conflictPaths.value( finalizationItem.filePath ), false );
         if ( !QFile::rename( origPath, newPath ) )
         {
           CoreUtils::log( "pull " + projectFullName, "failed rename of conflicting file: " + finalizationItem.filePath );
@@ -1498,13 +2822,38 @@ void MerginApi::finalizeProjectUpdate( const QString &projectFullName )
         {
           CoreUtils::log( "pull " + projectFullName, "Local file renamed due to conflict with server: " + finalizationItem.filePath );
         }
-        finalizeProjectUpdateCopy( projectFullName, projectDir, tempProjectDir, finalizationItem.filePath, finalizationItem.data );
+        if ( !finalizeProjectUpdateCopy( projectFullName, projectDir, tempProjectDir, finalizationItem.filePath, finalizationItem.data ) )
+          missingFiles << finalizationItem.filePath;
         break;
       }
 
       case UpdateTask::ApplyDiff:
+      case UpdateTask::ApplyDiffUnmodified:
+      {
+        if ( !finalizeProjectUpdateApplyDiff( projectFullName, projectDir, tempProjectDir, finalizationItem.filePath, finalizationItem.data,
+                                              conflictPaths.value( finalizationItem.filePath ), finalizationItem.method == UpdateTask::ApplyDiff, metrics ) )
+          missingFiles << finalizationItem.filePath;
+        break;
+      }
+
+      case UpdateTask::Clone:
+      case UpdateTask::Move:
+      {
+        bool move = finalizationItem.method == UpdateTask::Move;
+        if ( !finalizeProjectUpdateClone( projectFullName, projectDir, finalizationItem.filePath, finalizationItem.sourcePath, move ) )
+        {
+          // a source that has not been moved is still there - it gets removed by the next pull
+          missingFiles << finalizationItem.filePath;
+          if ( move )
+            missingFiles << finalizationItem.sourcePath;
+        }
+        break;
+      }
+
+      case UpdateTask::Shared:
       {
-        finalizeProjectUpdateApplyDiff( projectFullName, projectDir, tempProjectDir, finalizationItem.filePath, finalizationItem.data );
+        if ( !finalizeProjectUpdateShared( projectFullName, projectDir, finalizationItem.filePath, finalizationItem.checksum, contentStoreDir ) )
+          missingFiles << finalizationItem.filePath;
         break;
       }
 
@@ -1517,14 +2866,30 @@ void MerginApi::finalizeProjectUpdate( const QString &projectFullName )
       }
     }
 
-    // remove tmp files associated with this item
+    // remove tmp files associated with this item (staging files of copied files have been moved already)
+    QSet<QString> tempFileNames;
     for ( const auto &downloadItem : finalizationItem.data )
     {
-      if ( !QFile::remove( tempProjectDir + "/" + downloadItem.tempFileName ) )
-        CoreUtils::log( "pull " + projectFullName, "Failed to remove temporary file " + downloadItem.tempFileName );
+      tempFileNames.insert( downloadItem.tempFileName );
+    }
+    for ( const QString &tempFileName : qAsConst( tempFileNames ) )
+    {
+      QString tempFilePath = tempProjectDir + "/" + tempFileName;
+      if ( QFile::exists( tempFilePath ) && !QFile::remove( tempFilePath ) )
+        CoreUtils::log( "pull " + projectFullName, "Failed to remove temporary file " + tempFileName );
     }
   }
 
+  QFile::remove( tempProjectDir + "/" + sPullJournalFile );
+
+  // objects of files that are not in the project anymore may not be needed by any project
+  if ( !contentStoreDir.isEmpty() )
+  {
+    ContentStore contentStore( contentStoreDir );
+    contentStore.setReferences( projectDir, checksums );
+    contentStore.collectGarbage();
+  }
+
   // check there are no files left
   int tmpFilesLeft = QDir( tempProjectDir ).entryList( QDir::NoDotAndDotDot ).count();
   if ( tmpFilesLeft )
@@ -1533,6 +2898,26 @@ void MerginApi::finalizeProjectUpdate( const QString &projectFullName )
   }
 
   QDir( tempProjectDir ).removeRecursively();
+  return missingFiles;
+}
+
+void MerginApi::updateTasksFinished( const QString &projectFullName, const QSet<QString> &missingFiles )
+{
+  Q_ASSERT( mTransactionalStatus.contains( projectFullName ) );
+  TransactionStatus &transaction = mTransactionalStatus[projectFullName];
+
+  if ( transaction.cancelRequested )
+  {
+    // files have been updated already - there is nothing to cancel anymore
+    CoreUtils::log( "pull " + projectFullName, QStringLiteral( "Update tasks have been finished - ignoring cancel request" ) );
+  }
+
+  if ( !missingFiles.isEmpty() )
+  {
+    CoreUtils::log( "pull " + projectFullName, QStringLiteral( "%1 files will be downloaded by the next pull" ).arg( missingFiles.count() ) );
+    transaction.projectMetadata = metadataKeepingFiles( transaction.projectDir, transaction.projectMetadata, missingFiles );
+    mDeferredPulls.insert( projectFullName );
+  }
 
   // add the local project if not there yet
   if ( !mLocalProjects.projectFromMerginName( projectFullName ).isValid() )
@@ -1544,7 +2929,7 @@ void MerginApi::finalizeProjectUpdate( const QString &projectFullName )
     if ( !QFile::remove( CoreUtils::downloadInProgressFilePath( transaction.projectDir ) ) )
       CoreUtils::log( QStringLiteral( "sync %1" ).arg( projectFullName ), QStringLiteral( "Failed to remove download in progress file for project name %1" ).arg( projectName ) );
 
-    mLocalProjects.addMerginProject( projectDir, projectNamespace, projectName );
+    mLocalProjects.addMerginProject( transaction.projectDir, projectNamespace, projectName );
   }
 
   finishProjectSync( projectFullName, true );
@@ -1583,8 +2968,17 @@ void MerginApi::uploadStartReplyFinished()
 
       CoreUtils::log( "push " + projectFullName, QStringLiteral( "Push request accepted. Transaction ID: " ) + transactionUUID );
 
-      MerginFile file = files.first();
-      uploadFile( projectFullName, transactionUUID, file );
+      transaction.uploadChunkQueue.clear();
+      transaction.uploadedChunks.clear();
+      for ( const MerginFile &file : files )
+      {
+        transaction.uploadChunkQueue << uploadChunksForFile( file, transaction.projectDir );
+      }
+
+      // keep track of the transaction so that it can be continued if the push fails
+      writePushJournalHeader( projectFullName );
+
+      uploadNextChunks( projectFullName );
       emit pushFilesStarted();
     }
     else  // pushing only files to be removed
@@ -1594,8 +2988,9 @@ void MerginApi::uploadStartReplyFinished()
 
       CoreUtils::log( "push " + projectFullName, QStringLiteral( "Push request accepted and no files to upload" ) );
 
-      transaction.projectMetadata = data;
+      transaction.projectMetadata = pushedProjectMetadata( transaction, data );
       transaction.version = MerginProjectMetadata::fromJson( data ).version;
+      updateRenamedBasefiles( projectFullName, transaction );
 
       finishProjectSync( projectFullName, true );
     }
@@ -1646,48 +3041,50 @@ void MerginApi::uploadFileReplyFinished()
 {
   QNetworkReply *r = qobject_cast<QNetworkReply *>( sender() );
   Q_ASSERT( r );
+  requestFinished();
 
   QString projectFullName = r->request().attribute( static_cast<QNetworkRequest::Attribute>( AttrProjectFullName ) ).toString();
 
   Q_ASSERT( mTransactionalStatus.contains( projectFullName ) );
   TransactionStatus &transaction = mTransactionalStatus[projectFullName];
-  Q_ASSERT( r == transaction.replyUploadFile );
+  Q_ASSERT( transaction.replyUploadFiles.contains( r ) );
+  transaction.replyUploadFiles.removeOne( r );
 
   QStringList params = ( r->url().toString().split( "/" ) );
   QString transactionUUID = params.at( params.length() - 2 );
   QString chunkID = params.at( params.length() - 1 );
   Q_ASSERT( transactionUUID == transaction.transactionUUID );
+  UploadChunk chunk = transaction.requestedChunks.take( chunkID );
+
+  int status = r->attribute( QNetworkRequest::HttpStatusCodeAttribute ).toInt();
+  if ( status == 415 && r->request().hasRawHeader( "Content-Encoding" ) )
+  {
+    // the server has advertised compression, but does not take it after all - send the data as they are
+    CoreUtils::log( "push " + projectFullName, QStringLiteral( "Compressed upload rejected, uploading uncompressed: " ) + chunkID );
+    r->deleteLater();
+    transaction.compressUploads = false;
+    transaction.uploadChunkQueue.prepend( chunk );
+    uploadNextChunks( projectFullName );
+    return;
+  }
 
   if ( r->error() == QNetworkReply::NoError )
   {
     CoreUtils::log( "push " + projectFullName, QStringLiteral( "Uploaded successfully: " ) + chunkID );
 
-    transaction.replyUploadFile->deleteLater();
-    transaction.replyUploadFile = nullptr;
+    r->deleteLater();
 
-    MerginFile currentFile = transaction.uploadQueue.first();
-    int chunkNo = currentFile.chunks.indexOf( chunkID );
-    if ( chunkNo < currentFile.chunks.size() - 1 )
-    {
-      uploadFile( projectFullName, transactionUUID, currentFile, chunkNo + 1 );
-    }
-    else
-    {
-      transaction.transferedSize += currentFile.size;
+    qint64 chunkSize = r->request().attribute( static_cast<QNetworkRequest::Attribute>( AttrChunkSize ) ).toLongLong();
+    qint64 requestStart = r->request().attribute( static_cast<QNetworkRequest::Attribute>( AttrRequestStart ) ).toLongLong();
+    transaction.chunkPolicy.addSample( chunkSize, AdaptiveChunkPolicy::timestamp() - requestStart );
+    transaction.metrics->addSpan( SyncMetrics::Upload, AdaptiveChunkPolicy::timestamp() - requestStart, chunkSize );
 
-      emit syncProjectStatusChanged( projectFullName, transaction.transferedSize / transaction.totalSize );
-      transaction.uploadQueue.removeFirst();
+    transaction.uploadedChunks.insert( chunkID );
+    appendPushJournalChunk( projectFullName, chunkID );
+    transaction.transferedSize += chunkSize;
+    emit syncProjectStatusChanged( projectFullName, transaction.transferedSize / transaction.totalSize );
 
-      if ( !transaction.uploadQueue.isEmpty() )
-      {
-        MerginFile nextFile = transaction.uploadQueue.first();
-        uploadFile( projectFullName, transactionUUID, nextFile );
-      }
-      else
-      {
-        uploadFinish( projectFullName, transactionUUID );
-      }
-    }
+    uploadNextChunks( projectFullName );
   }
   else
   {
@@ -1695,8 +3092,21 @@ void MerginApi::uploadFileReplyFinished()
     CoreUtils::log( "push " + projectFullName, QStringLiteral( "FAILED - %1. %2" ).arg( r->errorString(), serverMsg ) );
     emit networkErrorOccurred( serverMsg, QStringLiteral( "Mergin API error: uploadFile" ) );
 
-    transaction.replyUploadFile->deleteLater();
-    transaction.replyUploadFile = nullptr;
+    // the transaction is of no use if cancelled or rejected by the server, otherwise it can be continued later
+    if ( r->error() == QNetworkReply::OperationCanceledError || ( status >= 400 && status < 500 ) )
+    {
+      discardPushJournal( transaction.projectDir );
+    }
+    else
+    {
+      transaction.chunkPolicy.addFailure();
+      CoreUtils::log( "push " + projectFullName, QStringLiteral( "Keeping transaction %1 to resume the push later" ).arg( transactionUUID ) );
+    }
+
+    r->deleteLater();
+
+    // the push cannot be completed - no need to wait for the other chunks
+    abortPendingUploads( transaction );
 
     finishProjectSync( projectFullName, false );
   }
@@ -1717,6 +3127,7 @@ void MerginApi::updateInfoReplyFinished()
   {
     QByteArray data = r->readAll();
     CoreUtils::log( "pull " + projectFullName, QStringLiteral( "Downloaded project info." ) );
+    transaction.metrics->addSpan( SyncMetrics::ProjectInfo, transaction.metrics->elapsed(), data.size() );
 
     transaction.replyProjectInfo->deleteLater();
     transaction.replyProjectInfo = nullptr;
@@ -1740,20 +3151,42 @@ void MerginApi::startProjectUpdate( const QString &projectFullName, const QByteA
   Q_ASSERT( mTransactionalStatus.contains( projectFullName ) );
   TransactionStatus &transaction = mTransactionalStatus[projectFullName];
 
+  MerginProjectMetadata serverProject = MerginProjectMetadata::fromJson( data );
+
+  // items downloaded by a previous attempt to update to the same version that has been interrupted
+  QString journalProjectDir;
+  QList<DownloadQueueItem> journalItems;
+  bool resume = readPullJournal( projectFullName, serverProject.version, journalProjectDir, journalItems );
+
   LocalProject projectInfo = mLocalProjects.projectFromMerginName( projectFullName );
   if ( projectInfo.isValid() )
   {
     transaction.projectDir = projectInfo.projectDir;
+    resume = resume && journalProjectDir == transaction.projectDir;
+  }
+  else if ( !journalProjectDir.isEmpty() && ( QFile::exists( CoreUtils::downloadInProgressFilePath( journalProjectDir ) ) ||
+            ( resume && !QFileInfo::exists( journalProjectDir ) ) ) )
+  {
+    // continue with the first time download in the directory used by the previous attempt
+    // (a failed attempt removes the directory, unless the app has been killed meanwhile)
+    transaction.projectDir = journalProjectDir;
+    transaction.firstTimeDownload = true;
+
+    QString downloadInProgressFilePath = CoreUtils::downloadInProgressFilePath( transaction.projectDir );
+    createPathIfNotExists( downloadInProgressFilePath );
+    if ( !QFile::exists( downloadInProgressFilePath ) && !CoreUtils::createEmptyFile( downloadInProgressFilePath ) )
+      CoreUtils::log( QStringLiteral( "pull %1" ).arg( projectFullName ), "Unable to create temporary download in progress file" );
+
+    CoreUtils::log( "pull " + projectFullName, QStringLiteral( "First time download - continuing in directory: " ) + transaction.projectDir );
   }
   else
   {
+    resume = false;
+
     QString projectNamespace;
     QString projectName;
     extractProjectName( projectFullName, projectNamespace, projectName );
 
-    // remove any leftover temp files that could be created from previous unsuccessful download
-    removeProjectsTempFolder( projectNamespace, projectName );
-
     // project has not been downloaded yet - we need to create a directory for it
     transaction.projectDir = CoreUtils::createUniqueProjectDirectory( mDataDir, projectName );
     transaction.firstTimeDownload = true;
@@ -1769,7 +3202,42 @@ void MerginApi::startProjectUpdate( const QString &projectFullName, const QByteA
 
   Q_ASSERT( !transaction.projectDir.isEmpty() );  // that would mean we do not have entry -> fail getting local files
 
-  QList<MerginFile> localFiles = getLocalProjectFiles( transaction.projectDir + "/" );
+  if ( !resume )
+  {
+    // remove any leftover temp files that could be created from previous unsuccessful download
+    QString projectNamespace, projectName;
+    extractProjectName( projectFullName, projectNamespace, projectName );
+    removeProjectsTempFolder( projectNamespace, projectName );
+    journalItems.clear();
+
+    writePullJournalHeader( projectFullName, serverProject.version, transaction.projectDir );
+  }
+
+  // local files get hashed in the sync worker - that may take a while with large projects
+  QString projectDir = transaction.projectDir;
+  std::shared_ptr<SyncMetrics> metrics = transaction.metrics;
+  mSyncWorker.run<QList<MerginFile>>( projectFullName, [projectDir, metrics]
+  {
+    return scanLocalProjectFiles( projectDir, metrics.get() );
+  },
+  [this, projectFullName, data, journalItems]( const QList<MerginFile> &localFiles )
+  {
+    prepareProjectUpdate( projectFullName, data, localFiles, journalItems );
+  } );
+}
+
+void MerginApi::prepareProjectUpdate( const QString &projectFullName, const QByteArray &data, const QList<MerginFile> &localFiles, const QList<DownloadQueueItem> &journalItems )
+{
+  Q_ASSERT( mTransactionalStatus.contains( projectFullName ) );
+  TransactionStatus &transaction = mTransactionalStatus[projectFullName];
+
+  if ( transaction.cancelRequested )
+  {
+    CoreUtils::log( "pull " + projectFullName, QStringLiteral( "Cancelled while scanning local files" ) );
+    downloadItemsFailed( projectFullName, tr( "Operation canceled" ), false );
+    return;
+  }
+
   MerginProjectMetadata serverProject = MerginProjectMetadata::fromJson( data );
   MerginProjectMetadata oldServerProject = MerginProjectMetadata::fromCachedJson( transaction.projectDir + "/" + sMetadataFile );
 
@@ -1778,30 +3246,159 @@ void MerginApi::startProjectUpdate( const QString &projectFullName, const QByteA
 
   transaction.projectMetadata = data;
   transaction.version = serverProject.version;
+  SyncMetrics::Span compareSpan( transaction.metrics.get(), SyncMetrics::Compare );
   transaction.diff = compareProjectFiles( oldServerProject.files, serverProject.files, localFiles, transaction.projectDir );
+  compareSpan.finish();
   CoreUtils::log( "pull " + projectFullName, transaction.diff.dump() );
 
+  // basefiles whose update in place has been interrupted may be ahead of the old server version (and so may be
+  // their local files) - such files are downloaded in full whatever the diff says, differing local files are kept
+  // as conflicting copies
+  BasefileStore basefiles( transaction.projectDir );
+  for ( const MerginFile &file : serverProject.files )
+  {
+    ProjectDiff &diff = transaction.diff;
+    if ( !isFileDiffable( file.path ) || diff.remoteAdded.contains( file.path ) || diff.remoteUpdated.contains( file.path ) ||
+         diff.conflictRemoteUpdatedLocalUpdated.contains( file.path ) || diff.conflictRemoteAddedLocalAdded.contains( file.path ) ||
+         diff.localDeleted.contains( file.path ) || !basefiles.isInterrupted( file.path ) )
+      continue;
+
+    CoreUtils::log( "pull " + projectFullName, "Update of basefile has been interrupted, downloading the whole file: " + file.path );
+    if ( diff.localUpdated.remove( file.path ) )
+      diff.conflictRemoteUpdatedLocalUpdated.insert( file.path );
+    else
+      diff.remoteUpdated.insert( file.path );
+  }
+
+  // local files by their content - files added on the server (e.g. moved there) may be available locally already
+  QHash<QPair<QString, qint64>, QString> localFilesByContent;
+  for ( const MerginFile &file : localFiles )
+  {
+    if ( file.size > 0 )
+      localFilesByContent.insert( qMakePair( file.checksum, file.size ), file.path );
+  }
+  auto localSource = [&localFilesByContent, &serverProject]( const QString & filePath )
+  {
+    MerginFile file = serverProject.fileInfo( filePath );
+    return localFilesByContent.value( qMakePair( file.checksum, file.size ) );
+  };
+
+  // files pulled by other projects may be in the shared content store - the pull keeps using it until it finishes
+  if ( mSharedContentStore )
+    transaction.contentStoreDir = ContentStore::storeDir( mDataDir );
+  ContentStore contentStore( transaction.contentStoreDir );
+  bool useContentStore = !transaction.contentStoreDir.isEmpty();
+  auto inContentStore = [useContentStore, &contentStore, &serverProject]( const QString & filePath )
+  {
+    MerginFile file = serverProject.fileInfo( filePath );
+    return useContentStore && file.size > 0 && contentStore.contains( file.checksum, file.size );
+  };
+  auto sharedTask = [useContentStore, &serverProject]( UpdateTask::Method method, const QString & filePath, const QList<DownloadQueueItem> &items )
+  {
+    UpdateTask task( method, filePath, items );
+    if ( useContentStore )
+      task.checksum = serverProject.fileInfo( filePath ).checksum;
+    return task;
+  };
+
+  // on a metered connection large files that cannot be updated by diffs wait for a better connection
+  QSet<QString> deferredFiles;
+  if ( mMeteredConnection )
+  {
+    for ( const QString &filePath : transaction.diff.remoteAdded + transaction.diff.remoteUpdated )
+    {
+      bool availableLocally = inContentStore( filePath ) ||
+                              ( transaction.diff.remoteAdded.contains( filePath ) && !localSource( filePath ).isEmpty() );
+      if ( isDeferredOnMeteredConnection( filePath, serverProject.fileInfo( filePath ).size ) && !availableLocally )
+        deferredFiles.insert( filePath );
+    }
+  }
+
+  mDeferredPulls.remove( projectFullName );
+  if ( !deferredFiles.isEmpty() )
+  {
+    CoreUtils::log( "pull " + projectFullName, QStringLiteral( "Metered connection - leaving out %1 files: %2" )
+                    .arg( deferredFiles.count() ).arg( deferredFiles.values().join( ", " ) ) );
+    transaction.diff.remoteAdded -= deferredFiles;
+    transaction.diff.remoteUpdated -= deferredFiles;
+
+    // the files keep their old metadata, so that the next pull sees them as changed on the server again
+    transaction.projectMetadata = metadataKeepingFiles( transaction.projectDir, data, deferredFiles );
+    mDeferredPulls.insert( projectFullName );
+  }
+
+  // ranges downloaded by the previous attempt are planned the same way again, so that they can be reused
+  QHash<QString, QString> resumedTempFiles;  // pullJournalItemId() -> temp file name
+  QHash<QString, QMap<qint64, qint64> > resumedRanges;  // file path -> downloaded ranges
+  for ( const DownloadQueueItem &item : journalItems )
+  {
+    resumedTempFiles.insert( pullJournalItemId( item ), item.tempFileName );
+    if ( !item.downloadDiff && item.version == serverProject.version && item.rangeFrom >= 0 )
+      resumedRanges[item.filePath].insert( item.rangeFrom, item.rangeTo );
+  }
+
+  // files whose content is available locally are copied rather than downloaded. A local file that has been
+  // removed on the server is just moved, unless it is the source of more files
+  QHash<QString, int> sourceUses;
+  for ( const QString &filePath : transaction.diff.remoteAdded )
+  {
+    QString sourcePath = localSource( filePath );
+    if ( !sourcePath.isEmpty() )
+      ++sourceUses[sourcePath];
+  }
+
   for ( QString filePath : transaction.diff.remoteAdded )
   {
+    QString sourcePath = localSource( filePath );
+    if ( !sourcePath.isEmpty() )
+    {
+      bool move = transaction.diff.remoteDeleted.contains( sourcePath ) && sourceUses.value( sourcePath ) == 1;
+      transaction.updateTasks << UpdateTask( move ? UpdateTask::Move : UpdateTask::Clone, filePath, QList<DownloadQueueItem>(), sourcePath );
+      continue;
+    }
+
+    if ( inContentStore( filePath ) )
+    {
+      transaction.updateTasks << sharedTask( UpdateTask::Shared, filePath, QList<DownloadQueueItem>() );
+      continue;
+    }
+
     MerginFile file = serverProject.fileInfo( filePath );
-    QList<DownloadQueueItem> items = itemsForFileChunks( file, transaction.version );
-    transaction.updateTasks << UpdateTask( UpdateTask::Copy, filePath, items );
+    QList<DownloadQueueItem> items = itemsForFileChunks( file, transaction.version, AdaptiveChunkPolicy::MAX_DOWNLOAD_CHUNK_SIZE, resumedRanges.value( filePath ) );
+    transaction.updateTasks << sharedTask( UpdateTask::Copy, filePath, items );
   }
 
+  // basefiles whose update has been interrupted may not match the old server version - their files are downloaded in full
+  auto canUseDiffs = [&basefiles, &projectFullName]( const MerginFile &file )
+  {
+    if ( !isFileDiffable( file.path ) || !file.pullCanUseDiff )
+      return false;
+    if ( basefiles.isInterrupted( file.path ) )
+    {
+      CoreUtils::log( "pull " + projectFullName, "Update of basefile has been interrupted, downloading the whole file: " + file.path );
+      return false;
+    }
+    return true;
+  };
+
   for ( QString filePath : transaction.diff.remoteUpdated )
   {
     MerginFile file = serverProject.fileInfo( filePath );
 
+    if ( inContentStore( filePath ) )
+    {
+      transaction.updateTasks << sharedTask( UpdateTask::Shared, filePath, QList<DownloadQueueItem>() );
+    }
     // for diffable files - download and apply to the basefile (without rebase)
-    if ( isFileDiffable( filePath ) && file.pullCanUseDiff )
+    else if ( canUseDiffs( file ) )
     {
       QList<DownloadQueueItem> items = itemsForFileDiffs( file );
-      transaction.updateTasks << UpdateTask( UpdateTask::ApplyDiff, filePath, items );
+      transaction.updateTasks << UpdateTask( UpdateTask::ApplyDiffUnmodified, filePath, items );
     }
     else
     {
-      QList<DownloadQueueItem> items = itemsForFileChunks( file, transaction.version );
-      transaction.updateTasks << UpdateTask( UpdateTask::Copy, filePath, items );
+      QList<DownloadQueueItem> items = itemsForFileChunks( file, transaction.version, AdaptiveChunkPolicy::MAX_DOWNLOAD_CHUNK_SIZE, resumedRanges.value( filePath ) );
+      transaction.updateTasks << sharedTask( UpdateTask::Copy, filePath, items );
     }
   }
 
@@ -1811,14 +3408,14 @@ void MerginApi::startProjectUpdate( const QString &projectFullName, const QByteA
     MerginFile file = serverProject.fileInfo( filePath );
 
     // for diffable files - download and apply to the basefile (will also do rebase)
-    if ( isFileDiffable( filePath ) && file.pullCanUseDiff )
+    if ( canUseDiffs( file ) )
     {
       QList<DownloadQueueItem> items = itemsForFileDiffs( file );
       transaction.updateTasks << UpdateTask( UpdateTask::ApplyDiff, filePath, items );
     }
     else
     {
-      QList<DownloadQueueItem> items = itemsForFileChunks( file, transaction.version );
+      QList<DownloadQueueItem> items = itemsForFileChunks( file, transaction.version, AdaptiveChunkPolicy::MAX_DOWNLOAD_CHUNK_SIZE, resumedRanges.value( filePath ) );
       transaction.updateTasks << UpdateTask( UpdateTask::CopyConflict, filePath, items );
     }
   }
@@ -1827,7 +3424,7 @@ void MerginApi::startProjectUpdate( const QString &projectFullName, const QByteA
   for ( QString filePath : transaction.diff.conflictRemoteAddedLocalAdded )
   {
     MerginFile file = serverProject.fileInfo( filePath );
-    QList<DownloadQueueItem> items = itemsForFileChunks( file, transaction.version );
+    QList<DownloadQueueItem> items = itemsForFileChunks( file, transaction.version, AdaptiveChunkPolicy::MAX_DOWNLOAD_CHUNK_SIZE, resumedRanges.value( filePath ) );
     transaction.updateTasks << UpdateTask( UpdateTask::CopyConflict, filePath, items );
   }
 
@@ -1837,42 +3434,167 @@ void MerginApi::startProjectUpdate( const QString &projectFullName, const QByteA
     transaction.updateTasks << UpdateTask( UpdateTask::Delete, filePath, QList<DownloadQueueItem>() );
   }
 
-  // prepare the download queue
-  for ( const UpdateTask &item : transaction.updateTasks )
-  {
-    transaction.downloadQueue << item.data;
+  // prepare the download queue
+  qint64 totalSize = 0;
+  for ( UpdateTask &item : transaction.updateTasks )
+  {
+    // reuse items that have been downloaded already by the previous attempt
+    QSet<int> resumedItems;
+    for ( int i = 0; i < item.data.count(); ++i )
+    {
+      auto it = resumedTempFiles.constFind( pullJournalItemId( item.data.at( i ) ) );
+      if ( it != resumedTempFiles.constEnd() )
+      {
+        item.data[i].tempFileName = *it;
+        resumedItems.insert( i );
+      }
+    }
+    if ( item.method != UpdateTask::ApplyDiff && item.method != UpdateTask::ApplyDiffUnmodified )
+    {
+      // chunks of a file are written to the same staging file
+      QString stagingFileName = resumedItems.isEmpty() ? CoreUtils::uuidWithoutBraces( QUuid::createUuid() )
+                                : item.data.at( *resumedItems.constBegin() ).tempFileName;
+      for ( DownloadQueueItem &downloadItem : item.data )
+        downloadItem.tempFileName = stagingFileName;
+    }
+    else
+    {
+      for ( DownloadQueueItem &downloadItem : item.data )
+      {
+        if ( downloadItem.tempFileName.isEmpty() )
+          downloadItem.tempFileName = CoreUtils::uuidWithoutBraces( QUuid::createUuid() );
+      }
+    }
+
+    for ( int i = 0; i < item.data.count(); ++i )
+    {
+      const DownloadQueueItem &downloadItem = item.data.at( i );
+      totalSize += downloadItem.size;
+      if ( resumedItems.contains( i ) )
+      {
+        transaction.downloadedItems.insert( downloadItemKey( downloadItem.tempFileName, downloadItem.rangeFrom ) );
+        transaction.transferedSize += downloadItem.size;
+      }
+      else
+      {
+        transaction.downloadQueue << downloadItem;
+      }
+    }
+
+    // full downloads get verified against the checksum from the server as the data arrive
+    if ( ( item.method == UpdateTask::Copy || item.method == UpdateTask::CopyConflict ) && !item.data.isEmpty() )
+    {
+      // preallocate the staging file where the chunks get written at their offsets
+      QString stagingFilePath = getTempProjectDir( projectFullName ) + "/" + item.data.first().tempFileName;
+      createPathIfNotExists( stagingFilePath );
+      QFile stagingFile( stagingFilePath );
+      if ( !stagingFile.open( QIODevice::ReadWrite ) || !stagingFile.resize( serverProject.fileInfo( item.filePath ).size ) )
+        CoreUtils::log( "pull " + projectFullName, "Failed to preallocate staging file for " + item.filePath );
+
+      DownloadChecksum checksum;
+      checksum.hash = std::make_shared<QCryptographicHash>( QCryptographicHash::Sha1 );
+      checksum.expectedChecksum = serverProject.fileInfo( item.filePath ).checksum;
+      checksum.items = item.data;
+      if ( !checksum.expectedChecksum.isEmpty() )
+        transaction.downloadChecksums.insert( item.filePath, checksum );
+    }
   }
 
-  qint64 totalSize = 0;
-  for ( const DownloadQueueItem &item : transaction.downloadQueue )
-  {
-    totalSize += item.size;
-  }
   transaction.totalSize = totalSize;
 
-  CoreUtils::log( "pull " + projectFullName, QStringLiteral( "%1 update tasks, %2 items to download (total size %3 bytes)" )
+  CoreUtils::log( "pull " + projectFullName, QStringLiteral( "%1 update tasks, %2 items to download (total size %3 bytes, chunk size %4 bytes)" )
                   .arg( transaction.updateTasks.count() )
                   .arg( transaction.downloadQueue.count() )
-                  .arg( transaction.totalSize ) );
+                  .arg( transaction.totalSize )
+                  .arg( transaction.chunkPolicy.downloadChunkSize() ) );
+
+  if ( !transaction.downloadedItems.isEmpty() )
+  {
+    CoreUtils::log( "pull " + projectFullName, QStringLiteral( "Resuming - %1 items (%2 bytes) downloaded already" )
+                    .arg( transaction.downloadedItems.count() )
+                    .arg( transaction.transferedSize ) );
+
+    // files that have been downloaded completely can be verified right away
+    const QStringList filePaths = transaction.downloadChecksums.keys();
+    for ( const QString &filePath : filePaths )
+    {
+      if ( !updateDownloadChecksum( projectFullName, filePath ) )
+      {
+        downloadItemsFailed( projectFullName, tr( "Downloaded file is corrupted: %1" ).arg( filePath ), false );
+        return;
+      }
+    }
+  }
 
   emit pullFilesStarted();
-  downloadNextItem( projectFullName );
+  downloadNextItems( projectFullName );
 }
 
 
-QList<DownloadQueueItem> MerginApi::itemsForFileChunks( const MerginFile &file, int version )
+QList<DownloadQueueItem> MerginApi::itemsForFileChunks( const MerginFile &file, int version, qint64 chunkSize, const QMap<qint64, qint64> &downloadedRanges )
 {
   QList<DownloadQueueItem> lst;
-  int from = 0;
+  auto downloaded = downloadedRanges.constBegin();
+  qint64 from = 0;
   while ( from < file.size )
   {
-    int size = qMin( MerginApi::UPLOAD_CHUNK_SIZE, static_cast<int>( file.size ) - from );
-    lst << DownloadQueueItem( file.path, size, version, from, from + size - 1 );
+    while ( downloaded != downloadedRanges.constEnd() && downloaded.key() < from )
+      ++downloaded;  // overlaps with the previous range - cannot be reused
+
+    qint64 to;
+    if ( downloaded != downloadedRanges.constEnd() && downloaded.key() == from && downloaded.value() >= from && downloaded.value() < file.size )
+    {
+      to = downloaded.value();
+      ++downloaded;
+    }
+    else
+    {
+      to = qMin( from + chunkSize, file.size ) - 1;
+      if ( downloaded != downloadedRanges.constEnd() )
+        to = qMin( to, downloaded.key() - 1 );
+    }
+
+    qint64 size = to - from + 1;
+    lst << DownloadQueueItem( file.path, size, version, from, to );
     from += size;
   }
   return lst;
 }
 
+QString MerginApi::downloadItemKey( const QString &tempFileName, qint64 rangeFrom )
+{
+  return QStringLiteral( "%1:%2" ).arg( tempFileName ).arg( rangeFrom );
+}
+
+QList<UploadChunk> MerginApi::uploadChunksForFile( const MerginFile &file, const QString &projectDir )
+{
+  QList<UploadChunk> lst;
+
+  UploadChunk chunk;
+  chunk.filePath = file.path;
+  qint64 totalSize;
+  if ( file.diffName.isEmpty() )
+  {
+    chunk.sourcePath = projectDir + "/" + file.path;
+    totalSize = file.size;
+  }
+  else  // use diff file instead of full file
+  {
+    chunk.sourcePath = projectDir + "/.mergin/" + file.diffName;
+    totalSize = file.diffSize;
+  }
+
+  qint64 chunkSize = file.chunkSize > 0 ? file.chunkSize : AdaptiveChunkPolicy::DEFAULT_CHUNK_SIZE;
+  for ( int i = 0; i < file.chunks.count(); ++i )
+  {
+    chunk.chunkId = file.chunks.at( i );
+    chunk.offset = static_cast<qint64>( i ) * chunkSize;
+    chunk.size = qBound( static_cast<qint64>( 0 ), totalSize - chunk.offset, chunkSize );
+    lst << chunk;
+  }
+  return lst;
+}
+
 QList<DownloadQueueItem> MerginApi::itemsForFileDiffs( const MerginFile &file )
 {
   QList<DownloadQueueItem> items;
@@ -1885,18 +3607,6 @@ QList<DownloadQueueItem> MerginApi::itemsForFileDiffs( const MerginFile &file )
 }
 
 
-static MerginFile findFile( const QString &filePath, const QList<MerginFile> &files )
-{
-  for ( const MerginFile &merginFile : files )
-  {
-    if ( merginFile.path == filePath )
-      return merginFile;
-  }
-  qDebug() << "requested findFile() for non-existant file! " << filePath;
-  return MerginFile();
-}
-
-
 void MerginApi::uploadInfoReplyFinished()
 {
   QNetworkReply *r = qobject_cast<QNetworkReply *>( sender() );
@@ -1913,6 +3623,12 @@ void MerginApi::uploadInfoReplyFinished()
     QString url = r->url().toString();
     CoreUtils::log( "push " + projectFullName, QStringLiteral( "Downloaded project info." ) );
     QByteArray data = r->readAll();
+    transaction.metrics->addSpan( SyncMetrics::ProjectInfo, transaction.metrics->elapsed(), data.size() );
+
+    // servers that take compressed uploads say so in the Accept-Encoding header of their responses (RFC 7694)
+    transaction.compressUploads = HttpCompression::acceptsEncoding( r->rawHeader( "Accept-Encoding" ), HttpCompression::ENCODING );
+    if ( transaction.compressUploads )
+      CoreUtils::log( "push " + projectFullName, QStringLiteral( "Server accepts compressed uploads" ) );
 
     transaction.replyUploadProjectInfo->deleteLater();
     transaction.replyUploadProjectInfo = nullptr;
@@ -1926,7 +3642,9 @@ void MerginApi::uploadInfoReplyFinished()
 
     // now let's figure a key question: are we on the most recent version of the project
     // if we're about to do upload? because if not, we need to do local update first
-    if ( projectInfo.isValid() && projectInfo.localVersion != -1 && projectInfo.localVersion < serverProject.version )
+    // files left out of the last pull on a metered connection get pulled as well
+    bool deferredPull = mDeferredPulls.contains( projectFullName ) && !mMeteredConnection;
+    if ( projectInfo.isValid() && projectInfo.localVersion != -1 && ( projectInfo.localVersion < serverProject.version || deferredPull ) )
     {
       CoreUtils::log( "push " + projectFullName, QStringLiteral( "Need pull first: local version %1 | server version %2" )
                       .arg( projectInfo.localVersion ).arg( serverProject.version ) );
@@ -1935,129 +3653,276 @@ void MerginApi::uploadInfoReplyFinished()
       return;
     }
 
-    QList<MerginFile> localFiles = getLocalProjectFiles( transaction.projectDir + "/" );
-    MerginProjectMetadata oldServerProject = MerginProjectMetadata::fromCachedJson( transaction.projectDir + "/" + sMetadataFile );
+    // local files get hashed in the sync worker - that may take a while with large projects
+    QString projectDir = transaction.projectDir;
+    std::shared_ptr<SyncMetrics> metrics = transaction.metrics;
+    mSyncWorker.run<QList<MerginFile>>( projectFullName, [projectDir, metrics]
+    {
+      return scanLocalProjectFiles( projectDir, metrics.get() );
+    },
+    [this, projectFullName, data]( const QList<MerginFile> &localFiles )
+    {
+      prepareProjectUpload( projectFullName, data, localFiles );
+    } );
+  }
+  else
+  {
+    QString message = QStringLiteral( "Network API error: %1(): %2" ).arg( QStringLiteral( "projectInfo" ), r->errorString() );
+    CoreUtils::log( "push " + projectFullName, QStringLiteral( "FAILED - %1" ).arg( message ) );
+
+    transaction.replyUploadProjectInfo->deleteLater();
+    transaction.replyUploadProjectInfo = nullptr;
 
-    transaction.diff = compareProjectFiles( oldServerProject.files, serverProject.files, localFiles, transaction.projectDir );
-    CoreUtils::log( "push " + projectFullName, transaction.diff.dump() );
+    finishProjectSync( projectFullName, false );
+  }
+}
 
-    // TODO: make sure there are no remote files to add/update/remove nor conflicts
+void MerginApi::prepareProjectUpload( const QString &projectFullName, const QByteArray &data, const QList<MerginFile> &localFiles )
+{
+  Q_ASSERT( mTransactionalStatus.contains( projectFullName ) );
+  TransactionStatus &transaction = mTransactionalStatus[projectFullName];
 
-    QList<MerginFile> filesToUpload;
-    QList<MerginFile> addedMerginFiles, updatedMerginFiles, deletedMerginFiles;
-    QList<MerginFile> diffFiles;
-    for ( QString filePath : transaction.diff.localAdded )
+  if ( transaction.cancelRequested )
+  {
+    CoreUtils::log( "push " + projectFullName, QStringLiteral( "Cancelled while scanning local files" ) );
+    finishProjectSync( projectFullName, false );
+    return;
+  }
+
+  MerginProjectMetadata serverProject = MerginProjectMetadata::fromJson( data );
+  MerginProjectMetadata oldServerProject = MerginProjectMetadata::fromCachedJson( transaction.projectDir + "/" + sMetadataFile );
+
+  SyncMetrics::Span compareSpan( transaction.metrics.get(), SyncMetrics::Compare );
+  transaction.diff = compareProjectFiles( oldServerProject.files, serverProject.files, localFiles, transaction.projectDir );
+  compareSpan.finish();
+  CoreUtils::log( "push " + projectFullName, transaction.diff.dump() );
+
+  // TODO: make sure there are no remote files to add/update/remove nor conflicts
+
+  QHash<QString, MerginFile> localFilesByPath;
+  localFilesByPath.reserve( localFiles.count() );
+  for ( const MerginFile &file : localFiles )
+    localFilesByPath.insert( file.path, file );
+
+  // moved files are pushed as renames - their content is on the server already, so they are never deferred below
+  findLocalRenames( transaction.diff, serverProject, localFiles );
+  for ( auto it = transaction.diff.localRenamed.constBegin(); it != transaction.diff.localRenamed.constEnd(); ++it )
+    CoreUtils::log( "push " + projectFullName, QStringLiteral( "Renamed %1 -> %2" ).arg( it.value(), it.key() ) );
+
+  // on a metered connection large files that cannot be pushed as diffs wait for a better connection
+  // (the server does not get to know about them, so they are still local changes for the next push)
+  QSet<QString> deferredFiles;
+  if ( mMeteredConnection )
+  {
+    for ( const QString &filePath : transaction.diff.localAdded + transaction.diff.localUpdated )
     {
-      MerginFile merginFile = findFile( filePath, localFiles );
-      merginFile.chunks = generateChunkIdsForSize( merginFile.size );
-      addedMerginFiles.append( merginFile );
+      if ( isDeferredOnMeteredConnection( filePath, localFilesByPath.value( filePath ).size ) )
+        deferredFiles.insert( filePath );
     }
+  }
 
-    for ( QString filePath : transaction.diff.localUpdated )
-    {
-      MerginFile merginFile = findFile( filePath, localFiles );
-      merginFile.chunks = generateChunkIdsForSize( merginFile.size );
+  mDeferredPushes.remove( projectFullName );
+  if ( !deferredFiles.isEmpty() )
+  {
+    CoreUtils::log( "push " + projectFullName, QStringLiteral( "Metered connection - leaving out %1 files: %2" )
+                    .arg( deferredFiles.count() ).arg( deferredFiles.values().join( ", " ) ) );
+    transaction.diff.localAdded -= deferredFiles;
+    transaction.diff.localUpdated -= deferredFiles;
+    mDeferredPushes.insert( projectFullName );
+  }
 
-      if ( MerginApi::isFileDiffable( filePath ) )
-      {
-        // try to create a diff
-        QString diffName;
-        int geodiffRes = GeodiffUtils::createChangeset( transaction.projectDir, filePath, diffName );
-        QString diffPath = transaction.projectDir + "/.mergin/" + diffName;
-        QString basePath = transaction.projectDir + "/.mergin/" + filePath;
+  // local changes as path -> checksum (empty for removed files) - to tell whether a push that failed can be continued
+  transaction.uploadBaseVersion = serverProject.version;
+  transaction.uploadChanges = QJsonObject();
+  for ( const QString &filePath : transaction.diff.localAdded + transaction.diff.localUpdated )
+    transaction.uploadChanges.insert( filePath, localFilesByPath.value( filePath ).checksum );
+  for ( const QString &filePath : transaction.diff.localDeleted )
+    transaction.uploadChanges.insert( filePath, QString() );
+  for ( auto it = transaction.diff.localRenamed.constBegin(); it != transaction.diff.localRenamed.constEnd(); ++it )
+  {
+    transaction.uploadChanges.insert( it.key(), localFilesByPath.value( it.key() ).checksum );
+    transaction.uploadChanges.insert( it.value(), QString() );
+  }
 
-        if ( geodiffRes == GEODIFF_SUCCESS )
-        {
-          QByteArray checksumDiff = getChecksum( diffPath );
+  if ( !transaction.uploadChanges.isEmpty() && resumePushFromJournal( projectFullName ) )
+    return;
 
-          // TODO: this is ugly. our basefile may not need to have the same checksum as the server's
-          // basefile (because each of them have applied the diff independently) so we have to fake it
-          QByteArray checksumBase = serverProject.fileInfo( filePath ).checksum.toLatin1();
+  // journal of a different push (if any) is of no use anymore
+  discardPushJournal( transaction.projectDir );
 
-          merginFile.diffName = diffName;
-          merginFile.diffChecksum = QString::fromLatin1( checksumDiff.data(), checksumDiff.size() );
-          merginFile.diffSize = QFileInfo( diffPath ).size();
-          merginFile.chunks = generateChunkIdsForSize( merginFile.diffSize );
-          merginFile.diffBaseChecksum = QString::fromLatin1( checksumBase.data(), checksumBase.size() );
+  // the split of files to chunks is sent to the server at the start, it stays the same for the whole transaction
+  qint64 chunkSize = transaction.chunkPolicy.uploadChunkSize();
 
-          diffFiles.append( merginFile );
+  // with a rate limit each chunk is sent at full speed of the link - keep the bursts short
+  qint64 rateLimit = mRateLimiter.isLimited() ? mRateLimiter.rate() : mTransactionRateLimit;
+  if ( mTransactionRateLimit > 0 )
+    rateLimit = qMin( rateLimit, mTransactionRateLimit );
+  if ( rateLimit > 0 )
+    chunkSize = qMin( chunkSize, qMax( AdaptiveChunkPolicy::MIN_CHUNK_SIZE, rateLimit * RATE_LIMITED_CHUNK_SECS ) );
 
-          CoreUtils::log( "push " + projectFullName, QString( "Geodiff create changeset on %1 successful: total size %2 bytes" ).arg( filePath ).arg( merginFile.diffSize ) );
-        }
-        else
-        {
-          // TODO: remove the diff file (if exists)
-          CoreUtils::log( "push " + projectFullName, QString( "Geodiff create changeset on %1 FAILED with error %2 (will do full upload)" ).arg( filePath ).arg( geodiffRes ) );
-        }
-      }
+  CoreUtils::log( "push " + projectFullName, QStringLiteral( "Upload chunk size %1 bytes (measured throughput %2 bytes/s)" )
+                  .arg( chunkSize ).arg( qRound64( transaction.chunkPolicy.throughput() ) ) );
 
-      updatedMerginFiles.append( merginFile );
-    }
-    for ( QString filePath : transaction.diff.localDeleted )
-    {
-      MerginFile merginFile = findFile( filePath, serverProject.files );
-      deletedMerginFiles.append( merginFile );
-    }
+  QList<MerginFile> addedMerginFiles, updatedMerginFiles, deletedMerginFiles;
+  for ( QString filePath : transaction.diff.localAdded )
+  {
+    MerginFile merginFile = localFilesByPath.value( filePath );
+    merginFile.chunkSize = chunkSize;
+    merginFile.chunks = generateChunkIdsForSize( merginFile.size, chunkSize );
+    addedMerginFiles.append( merginFile );
+  }
 
-    if ( addedMerginFiles.isEmpty() && updatedMerginFiles.isEmpty() && deletedMerginFiles.isEmpty() )
-    {
-      // if nothing has changed, there is no point to even start upload transaction
-      transaction.projectMetadata = data;
-      transaction.version = MerginProjectMetadata::fromJson( data ).version;
+  for ( QString filePath : transaction.diff.localUpdated )
+  {
+    MerginFile merginFile = localFilesByPath.value( filePath );
+    merginFile.chunkSize = chunkSize;
+    merginFile.chunks = generateChunkIdsForSize( merginFile.size, chunkSize );
+    updatedMerginFiles.append( merginFile );
+  }
 
-      finishProjectSync( projectFullName, true );
-      return;
-    }
+  for ( QString filePath : transaction.diff.localDeleted )
+  {
+    MerginFile merginFile = serverProject.fileInfo( filePath );
+    deletedMerginFiles.append( merginFile );
+  }
 
-    QJsonArray added = prepareUploadChangesJSON( addedMerginFiles );
-    filesToUpload.append( addedMerginFiles );
+  if ( addedMerginFiles.isEmpty() && updatedMerginFiles.isEmpty() && deletedMerginFiles.isEmpty() && transaction.diff.localRenamed.isEmpty() )
+  {
+    // if nothing has changed, there is no point to even start upload transaction
+    transaction.projectMetadata = pushedProjectMetadata( transaction, data );
+    transaction.version = serverProject.version;
 
-    QJsonArray modified = prepareUploadChangesJSON( updatedMerginFiles );
-    filesToUpload.append( updatedMerginFiles );
+    finishProjectSync( projectFullName, true );
+    return;
+  }
 
-    QJsonArray removed = prepareUploadChangesJSON( deletedMerginFiles );
-    // removed not in filesToUpload
+  // diffs of modified diffable files are created in the sync worker as well
+  QString projectDir = transaction.projectDir;
+  std::shared_ptr<SyncMetrics> metrics = transaction.metrics;
+  mSyncWorker.run<QList<MerginFile>>( projectFullName, [projectFullName, projectDir, updatedMerginFiles, serverProject, chunkSize, metrics]
+  {
+    return createUploadDiffs( projectFullName, projectDir, updatedMerginFiles, serverProject, chunkSize, metrics.get() );
+  },
+  [this, projectFullName, data, addedMerginFiles, deletedMerginFiles]( const QList<MerginFile> &updatedFiles )
+  {
+    startProjectUpload( projectFullName, data, addedMerginFiles, updatedFiles, deletedMerginFiles );
+  } );
+}
 
-    QJsonObject changes;
-    changes.insert( "added", added );
-    changes.insert( "removed", removed );
-    changes.insert( "updated", modified );
-    changes.insert( "renamed", QJsonArray() );
+QList<MerginFile> MerginApi::createUploadDiffs( const QString &projectFullName, const QString &projectDir, const QList<MerginFile> &files,
+    const MerginProjectMetadata &serverProject, qint64 chunkSize, SyncMetrics *metrics )
+{
+  QList<MerginFile> result;
+  BasefileStore basefiles( projectDir );
+  for ( MerginFile merginFile : files )
+  {
+    QString filePath = merginFile.path;
 
-    qint64 totalSize = 0;
-    for ( MerginFile file : filesToUpload )
+    // a basefile whose update has been interrupted is not the server version - a diff against it would be wrong
+    if ( MerginApi::isFileDiffable( filePath ) && basefiles.isInterrupted( filePath ) )
     {
-      if ( !file.diffName.isEmpty() )
-        totalSize += file.diffSize;
-      else
-        totalSize += file.size;
+      CoreUtils::log( "push " + projectFullName, "Update of basefile has been interrupted, uploading the whole file: " + filePath );
     }
+    else if ( MerginApi::isFileDiffable( filePath ) )
+    {
+      // try to create a diff
+      QString diffName;
+      SyncMetrics::Span span( metrics, SyncMetrics::GeodiffChangeset, merginFile.size );
+      int geodiffRes = GeodiffUtils::createChangeset( projectDir, filePath, diffName );
+      span.finish();
+      QString diffPath = projectDir + "/.mergin/" + diffName;
+
+      if ( geodiffRes == GEODIFF_SUCCESS )
+      {
+        QByteArray checksumDiff = getChecksum( diffPath );
 
-    CoreUtils::log( "push " + projectFullName, QStringLiteral( "%1 items to upload (total size %2 bytes)" )
-                    .arg( filesToUpload.count() ).arg( totalSize ) );
+        // TODO: this is ugly. our basefile may not need to have the same checksum as the server's
+        // basefile (because each of them have applied the diff independently) so we have to fake it
+        QByteArray checksumBase = serverProject.fileInfo( filePath ).checksum.toLatin1();
 
-    transaction.totalSize = totalSize;
-    transaction.uploadQueue = filesToUpload;
-    transaction.uploadDiffFiles = diffFiles;
+        merginFile.diffName = diffName;
+        merginFile.diffChecksum = QString::fromLatin1( checksumDiff.data(), checksumDiff.size() );
+        merginFile.diffSize = QFileInfo( diffPath ).size();
+        merginFile.chunks = generateChunkIdsForSize( merginFile.diffSize, chunkSize );
+        merginFile.diffBaseChecksum = QString::fromLatin1( checksumBase.data(), checksumBase.size() );
 
-    QJsonObject json;
-    json.insert( QStringLiteral( "changes" ), changes );
-    json.insert( QStringLiteral( "version" ), QString( "v%1" ).arg( serverProject.version ) );
-    QJsonDocument jsonDoc;
-    jsonDoc.setObject( json );
+        CoreUtils::log( "push " + projectFullName, QString( "Geodiff create changeset on %1 successful: total size %2 bytes" ).arg( filePath ).arg( merginFile.diffSize ) );
+      }
+      else
+      {
+        // TODO: remove the diff file (if exists)
+        CoreUtils::log( "push " + projectFullName, QString( "Geodiff create changeset on %1 FAILED with error %2 (will do full upload)" ).arg( filePath ).arg( geodiffRes ) );
+      }
+    }
 
-    uploadStart( projectFullName, jsonDoc.toJson( QJsonDocument::Compact ) );
+    result.append( merginFile );
   }
-  else
-  {
-    QString message = QStringLiteral( "Network API error: %1(): %2" ).arg( QStringLiteral( "projectInfo" ), r->errorString() );
-    CoreUtils::log( "push " + projectFullName, QStringLiteral( "FAILED - %1" ).arg( message ) );
+  return result;
+}
 
-    transaction.replyUploadProjectInfo->deleteLater();
-    transaction.replyUploadProjectInfo = nullptr;
+void MerginApi::startProjectUpload( const QString &projectFullName, const QByteArray &data, const QList<MerginFile> &addedMerginFiles,
+                                    const QList<MerginFile> &updatedMerginFiles, const QList<MerginFile> &deletedMerginFiles )
+{
+  Q_ASSERT( mTransactionalStatus.contains( projectFullName ) );
+  TransactionStatus &transaction = mTransactionalStatus[projectFullName];
 
+  QList<MerginFile> diffFiles;
+  for ( const MerginFile &file : updatedMerginFiles )
+  {
+    if ( !file.diffName.isEmpty() )
+      diffFiles.append( file );
+  }
+
+  if ( transaction.cancelRequested )
+  {
+    CoreUtils::log( "push " + projectFullName, QStringLiteral( "Cancelled while creating diffs" ) );
+    for ( const MerginFile &file : qAsConst( diffFiles ) )
+      QFile::remove( transaction.projectDir + "/.mergin/" + file.diffName );
     finishProjectSync( projectFullName, false );
+    return;
+  }
+
+  MerginProjectMetadata serverProject = MerginProjectMetadata::fromJson( data );
+  QList<MerginFile> filesToUpload;
+
+  QJsonArray added = prepareUploadChangesJSON( addedMerginFiles );
+  filesToUpload.append( addedMerginFiles );
+
+  QJsonArray modified = prepareUploadChangesJSON( updatedMerginFiles );
+  filesToUpload.append( updatedMerginFiles );
+
+  QJsonArray removed = prepareUploadChangesJSON( deletedMerginFiles );
+  // removed not in filesToUpload
+
+  QJsonObject changes;
+  changes.insert( "added", added );
+  changes.insert( "removed", removed );
+  changes.insert( "updated", modified );
+  changes.insert( "renamed", prepareUploadRenamesJSON( transaction.diff.localRenamed, serverProject ) );
+
+  qint64 totalSize = 0;
+  for ( MerginFile file : filesToUpload )
+  {
+    if ( !file.diffName.isEmpty() )
+      totalSize += file.diffSize;
+    else
+      totalSize += file.size;
   }
+
+  CoreUtils::log( "push " + projectFullName, QStringLiteral( "%1 items to upload (total size %2 bytes)" )
+                  .arg( filesToUpload.count() ).arg( totalSize ) );
+
+  transaction.totalSize = totalSize;
+  transaction.uploadQueue = filesToUpload;
+  transaction.uploadDiffFiles = diffFiles;
+
+  QJsonObject json;
+  json.insert( QStringLiteral( "changes" ), changes );
+  json.insert( QStringLiteral( "version" ), QString( "v%1" ).arg( serverProject.version ) );
+  QJsonDocument jsonDoc;
+  jsonDoc.setObject( json );
+
+  uploadStart( projectFullName, jsonDoc.toJson( QJsonDocument::Compact ) );
 }
 
 void MerginApi::uploadFinishReplyFinished()
@@ -2080,25 +3945,37 @@ void MerginApi::uploadFinishReplyFinished()
     transaction.replyUploadFinish->deleteLater();
     transaction.replyUploadFinish = nullptr;
 
-    transaction.projectMetadata = data;
+    transaction.projectMetadata = pushedProjectMetadata( transaction, data );
     transaction.version = MerginProjectMetadata::fromJson( data ).version;
 
+    qint64 requestStart = r->request().attribute( static_cast<QNetworkRequest::Attribute>( AttrRequestStart ) ).toLongLong();
+    transaction.metrics->addSpan( SyncMetrics::Finalize, AdaptiveChunkPolicy::timestamp() - requestStart, data.size() );
+
     //  a new diffable files suppose to have their basefile copies in .mergin
+    SyncMetrics::Span basefileSpan( transaction.metrics.get(), SyncMetrics::GeodiffApply );
+    BasefileStore basefiles( transaction.projectDir );
     for ( QString filePath : transaction.diff.localAdded )
     {
       if ( MerginApi::isFileDiffable( filePath ) )
       {
-        QString basefile = transaction.projectDir + "/.mergin/" + filePath;
-        createPathIfNotExists( basefile );
-
         QString sourcePath = transaction.projectDir + "/" + filePath;
-        if ( !QFile::copy( sourcePath, basefile ) )
+        if ( !basefiles.store( filePath, sourcePath ) )
         {
           CoreUtils::log( "push " + projectFullName, "failed to copy new basefile for: " + filePath );
         }
       }
     }
 
+    // files uploaded in full instead of a diff against an interrupted basefile get a new basefile
+    for ( QString filePath : transaction.diff.localUpdated )
+    {
+      if ( MerginApi::isFileDiffable( filePath ) && basefiles.isInterrupted( filePath ) &&
+           !basefiles.store( filePath, transaction.projectDir + "/" + filePath ) )
+      {
+        CoreUtils::log( "push " + projectFullName, "failed to copy new basefile for: " + filePath );
+      }
+    }
+
     // clean up diff-related files
     const auto diffFiles = transaction.uploadDiffFiles;
     for ( const MerginFile &merginFile : diffFiles )
@@ -2121,6 +3998,10 @@ void MerginApi::uploadFinishReplyFinished()
       if ( !QFile::remove( diffPath ) )
         CoreUtils::log( "push " + projectFullName, "Failed to remove diff: " + diffPath );
     }
+    updateRenamedBasefiles( projectFullName, transaction );
+    basefileSpan.finish();
+
+    QFile::remove( transaction.projectDir + "/.mergin/" + sPushJournalFile );
 
     finishProjectSync( projectFullName, true );
   }
@@ -2130,6 +4011,10 @@ void MerginApi::uploadFinishReplyFinished()
     QString message = QStringLiteral( "Network API error: %1(): %2. %3" ).arg( QStringLiteral( "uploadFinish" ), r->errorString(), serverMsg );
     CoreUtils::log( "push " + projectFullName, QStringLiteral( "FAILED - %1" ).arg( message ) );
 
+    int status = r->attribute( QNetworkRequest::HttpStatusCodeAttribute ).toInt();
+    if ( r->error() == QNetworkReply::OperationCanceledError || ( status >= 400 && status < 500 ) )
+      discardPushJournal( transaction.projectDir );
+
     transaction.replyUploadFinish->deleteLater();
     transaction.replyUploadFinish = nullptr;
 
@@ -2366,6 +4251,51 @@ ProjectDiff MerginApi::compareProjectFiles( const QList<MerginFile> &oldServerFi
   return diff;
 }
 
+void MerginApi::findLocalRenames( ProjectDiff &diff, const MerginProjectMetadata &serverProject, const QList<MerginFile> &localFiles )
+{
+  if ( diff.localAdded.isEmpty() || diff.localDeleted.isEmpty() )
+    return;
+
+  // removed files by their content (empty files are not worth it - they all have the same checksum)
+  QHash<QPair<QString, qint64>, QStringList> deletedByContent;
+  for ( const QString &filePath : diff.localDeleted )
+  {
+    MerginFile file = serverProject.fileInfo( filePath );
+    if ( file.size > 0 )
+      deletedByContent[qMakePair( file.checksum, file.size )] << filePath;
+  }
+
+  QList<MerginFile> sortedLocalFiles = localFiles;
+  std::sort( sortedLocalFiles.begin(), sortedLocalFiles.end(), []( const MerginFile & a, const MerginFile & b ) { return a.path < b.path; } );
+
+  for ( const MerginFile &file : qAsConst( sortedLocalFiles ) )
+  {
+    if ( !diff.localAdded.contains( file.path ) )
+      continue;
+
+    auto it = deletedByContent.find( qMakePair( file.checksum, file.size ) );
+    if ( it == deletedByContent.end() || it->isEmpty() )
+      continue;
+
+    // prefer a file with the same name (moved to another folder)
+    QString fileName = QFileInfo( file.path ).fileName();
+    int index = 0;
+    for ( int i = 0; i < it->count(); ++i )
+    {
+      if ( QFileInfo( it->at( i ) ).fileName() == fileName )
+      {
+        index = i;
+        break;
+      }
+    }
+
+    QString oldPath = it->takeAt( index );
+    diff.localRenamed.insert( file.path, oldPath );
+    diff.localAdded.remove( file.path );
+    diff.localDeleted.remove( oldPath );
+  }
+}
+
 MerginProject MerginApi::parseProjectMetadata( const QJsonObject &proj )
 {
   MerginProject project;
@@ -2443,9 +4373,9 @@ MerginProjectsList MerginApi::parseProjectsFromJson( const QJsonDocument &doc )
 }
 
 
-QStringList MerginApi::generateChunkIdsForSize( qint64 fileSize )
+QStringList MerginApi::generateChunkIdsForSize( qint64 fileSize, qint64 chunkSize )
 {
-  qreal rawNoOfChunks = qreal( fileSize ) / UPLOAD_CHUNK_SIZE;
+  qreal rawNoOfChunks = qreal( fileSize ) / chunkSize;
   int noOfChunks = qCeil( rawNoOfChunks );
 
   // edge case when file is empty, filesize equals zero
@@ -2462,6 +4392,37 @@ QStringList MerginApi::generateChunkIdsForSize( qint64 fileSize )
   return chunks;
 }
 
+void MerginApi::updateRenamedBasefiles( const QString &projectFullName, const TransactionStatus &transaction )
+{
+  BasefileStore basefiles( transaction.projectDir );
+  for ( auto it = transaction.diff.localRenamed.constBegin(); it != transaction.diff.localRenamed.constEnd(); ++it )
+  {
+    if ( MerginApi::isFileDiffable( it.key() ) && !basefiles.store( it.key(), transaction.projectDir + "/" + it.key() ) )
+      CoreUtils::log( "push " + projectFullName, "failed to copy basefile of renamed file: " + it.key() );
+    if ( MerginApi::isFileDiffable( it.value() ) )
+      basefiles.remove( it.value() );
+  }
+}
+
+QJsonArray MerginApi::prepareUploadRenamesJSON( const QHash<QString, QString> &renamed, const MerginProjectMetadata &serverProject )
+{
+  QJsonArray jsonArray;
+
+  for ( auto it = renamed.constBegin(); it != renamed.constEnd(); ++it )
+  {
+    MerginFile file = serverProject.fileInfo( it.value() );
+
+    QJsonObject fileObject;
+    fileObject.insert( "path", it.value() );
+    fileObject.insert( "new_path", it.key() );
+    fileObject.insert( "checksum", file.checksum );
+    fileObject.insert( "size", file.size );
+    fileObject.insert( "mtime", file.mtime.toString( Qt::ISODateWithMs ) );
+    jsonArray.append( fileObject );
+  }
+  return jsonArray;
+}
+
 QJsonArray MerginApi::prepareUploadChangesJSON( const QList<MerginFile> &files )
 {
   QJsonArray jsonArray;
@@ -2510,12 +4471,15 @@ void MerginApi::finishProjectSync( const QString &projectFullName, bool syncSucc
 
   if ( syncSuccessful )
   {
+    SyncMetrics::Span metadataSpan( transaction.metrics.get(), SyncMetrics::Metadata, transaction.projectMetadata.size() );
+
     // update the local metadata file
     writeData( transaction.projectMetadata, transaction.projectDir + "/" + MerginApi::sMetadataFile );
 
     // update info of local projects
     mLocalProjects.updateLocalVersion( transaction.projectDir, transaction.version );
 
+    metadataSpan.finish();
     CoreUtils::log( "sync " + projectFullName, QStringLiteral( "### Finished ###  New project version: %1\n" ).arg( transaction.version ) );
   }
   else
@@ -2526,24 +4490,43 @@ void MerginApi::finishProjectSync( const QString &projectFullName, bool syncSucc
   bool updateBeforeUpload = transaction.updateBeforeUpload;
   QString projectDir = transaction.projectDir;  // keep it before the transaction gets removed
   ProjectDiff diff = transaction.diff;
+
+  // files of the open project are replaced in the sync worker while its layers keep the files they have opened -
+  // the layers get reloaded in the GUI thread once the pull is done (the push of a sync does not change files)
+  bool reloadOpenProject = syncSuccessful && projectFullName == mOpenProject &&
+                           ( projectFileHasBeenUpdated( diff ) || localFilesHaveBeenReplaced( diff ) );
+
   int newVersion = syncSuccessful ? transaction.version : -1;
+  if ( transaction.chunkPolicy.hasEstimate() )
+    mChunkPolicy = transaction.chunkPolicy;  // the next transactions start with what has been measured
+
+  transaction.metrics->finish( syncSuccessful );
+  transaction.metrics->appendToFile( syncMetricsFilePath() );
+  mLastSyncMetrics = transaction.metrics->toVariantMap();
   mTransactionalStatus.remove( projectFullName );
+  emit lastSyncMetricsChanged();
+  removeUnusedContentStore();
 
   if ( updateBeforeUpload )
   {
+    if ( reloadOpenProject )
+      emit reloadProject( projectDir );
+
     CoreUtils::log( "sync " + projectFullName, QStringLiteral( "Continue with push after pull" ) );
     // we're done only with the download part before the actual upload - so let's continue with upload
-    QString projectNamespace, projectName;
-    extractProjectName( projectFullName, projectNamespace, projectName );
-    uploadProject( projectNamespace, projectName );
+    // (the project keeps its slot in the sync scheduler)
+    beginProjectUpload( projectFullName, false );
   }
   else
   {
+    // let another project sync (before anyone reacts to the finished sync, e.g. by requesting another one)
+    mSyncScheduler.syncFinished( projectFullName );
+
     emit syncProjectFinished( projectDir, projectFullName, syncSuccessful, newVersion );
 
     if ( syncSuccessful )
     {
-      if ( projectFileHasBeenUpdated( diff ) )
+      if ( reloadOpenProject || projectFileHasBeenUpdated( diff ) )
       {
         emit reloadProject( projectDir );
       }
@@ -2573,14 +4556,10 @@ bool MerginApi::writeData( const QByteArray &data, const QString &path )
 
 void MerginApi::createPathIfNotExists( const QString &filePath )
 {
-  QDir dir;
-  if ( !dir.exists( mDataDir ) )
-    dir.mkpath( mDataDir );
-
   QFileInfo newFile( filePath );
   if ( !newFile.absoluteDir().exists() )
   {
-    if ( !dir.mkpath( newFile.absolutePath() ) )
+    if ( !QDir().mkpath( newFile.absolutePath() ) )
     {
       CoreUtils::log( "create path", QString( "Creating a folder failed for path: %1" ).arg( filePath ) );
     }
@@ -2594,21 +4573,7 @@ bool MerginApi::isInIgnore( const QFileInfo &info )
 
 QByteArray MerginApi::getChecksum( const QString &filePath )
 {
-  QFile f( filePath );
-  if ( f.open( QFile::ReadOnly ) )
-  {
-    QCryptographicHash hash( QCryptographicHash::Sha1 );
-    QByteArray chunk = f.read( CHUNK_SIZE );
-    while ( !chunk.isEmpty() )
-    {
-      hash.addData( chunk );
-      chunk = f.read( CHUNK_SIZE );
-    }
-    f.close();
-    return hash.result().toHex();
-  }
-
-  return QByteArray();
+  return ChecksumEngine::fileChecksum( filePath );
 }
 
 QSet<QString> MerginApi::listFiles( const QString &path )
@@ -2626,8 +4591,101 @@ QSet<QString> MerginApi::listFiles( const QString &path )
   return files;
 }
 
-DownloadQueueItem::DownloadQueueItem( const QString &fp, int s, int v, int rf, int rt, bool diff )
+QSet<QString> MerginApi::listProjectFiles( const QString &projectPath, QSet<QString> &changedFiles, bool &journaled )
+{
+  journaled = false;
+  std::shared_ptr<ChangeJournal> journal = ChangeJournal::find( projectPath );
+  if ( !journal || !journal->isExact() )
+    return listFiles( projectPath );
+
+  // files of journaled projects from their last scan (scans may run in the sync worker threads)
+  struct JournaledFiles
+  {
+    ChangeJournal::Cursor cursor;
+    QSet<QString> files;
+  };
+  static QMutex sJournaledFilesMutex;
+  static QHash<QString, JournaledFiles> sJournaledFiles;
+  static const bool sUnwatchHandlerAdded = []
+  {
+    ChangeJournal::addUnwatchHandler( []( const QString & dir )
+    {
+      QMutexLocker locker( &sJournaledFilesMutex );
+      sJournaledFiles.remove( dir );
+    } );
+    return true;
+  }();
+  Q_UNUSED( sUnwatchHandlerAdded )
+
+  JournaledFiles state;
+  {
+    QMutexLocker locker( &sJournaledFilesMutex );
+    state = sJournaledFiles.value( journal->projectDir() );
+  }
+
+  QSet<QString> changedPaths;
+  if ( !journal->changesSince( state.cursor, changedPaths ) )
+  {
+    state.files = listFiles( projectPath );
+  }
+  else
+  {
+    journaled = true;
+
+    // changed directories may have had any files in them
+    QSet<QString> changedDirs;
+    for ( const QString &path : qAsConst( changedPaths ) )
+    {
+      if ( !state.files.contains( path ) )
+        changedDirs << path;
+    }
+    for ( auto it = state.files.begin(); !changedDirs.isEmpty() && it != state.files.end(); )
+    {
+      bool inChangedDir = false;
+      for ( int i = it->indexOf( '/' ); i >= 0 && !inChangedDir; i = it->indexOf( '/', i + 1 ) )
+        inChangedDir = changedDirs.contains( it->left( i ) );
+      if ( inChangedDir )
+        it = state.files.erase( it );
+      else
+        ++it;
+    }
+
+    for ( const QString &path : qAsConst( changedPaths ) )
+    {
+      state.files.remove( path );
+
+      // hidden files and directories are not listed
+      QFileInfo info( projectPath + path );
+      if ( info.isHidden() || path.startsWith( '.' ) || path.contains( QStringLiteral( "/." ) ) )
+        continue;
+
+      if ( info.isDir() )
+      {
+        const QSet<QString> dirFiles = listFiles( projectPath + path + "/" );
+        for ( const QString &file : dirFiles )
+        {
+          state.files << path + "/" + file;
+          changedFiles << path + "/" + file;
+        }
+      }
+      else if ( info.isFile() && !isInIgnore( info ) )
+      {
+        state.files << path;
+        changedFiles << path;
+      }
+    }
+  }
+
+  {
+    // files of a project that has been unwatched in the meantime are not kept (its handler has run or waits for the mutex)
+    QMutexLocker locker( &sJournaledFilesMutex );
+    if ( ChangeJournal::find( journal->projectDir() ) == journal )
+      sJournaledFiles.insert( journal->projectDir(), state );
+  }
+  return state.files;
+}
+
+DownloadQueueItem::DownloadQueueItem( const QString &fp, qint64 s, int v, qint64 rf, qint64 rt, bool diff )
   : filePath( fp ), size( s ), version( v ), rangeFrom( rf ), rangeTo( rt ), downloadDiff( diff )
 {
-  tempFileName = CoreUtils::uuidWithoutBraces( QUuid::createUuid() );
 }
@@ -21,13 +21,23 @@
 #include <QPointer>
 #include <QSet>
 #include <QByteArray>
+#include <QCryptographicHash>
+#include <QJsonObject>
 #include <QDateTime>
+#include <QMap>
+#include <QTimer>
 
+#include "adaptivechunkpolicy.h"
 #include "merginapistatus.h"
 #include "merginsubscriptionstatus.h"
 #include "merginprojectmetadata.h"
 #include "localprojectsmanager.h"
 #include "project.h"
+#include "projectlistcache.h"
+#include "ratelimiter.h"
+#include "syncmetrics.h"
+#include "syncscheduler.h"
+#include "syncworker.h"
 
 class MerginUserAuth;
 class MerginUserInfo;
@@ -40,6 +50,7 @@ struct ProjectDiff
   QSet<QString> localAdded;
   QSet<QString> localUpdated;
   QSet<QString> localDeleted;
+  QHash<QString, QString> localRenamed;  //!< files moved locally (new path -> old path), not in localAdded / localDeleted
 
   // changes that should be pulled (downloaded)
   QSet<QString> remoteAdded;
@@ -61,6 +72,7 @@ struct ProjectDiff
     return localAdded == other.localAdded &&
            localUpdated == other.localUpdated &&
            localDeleted == other.localDeleted &&
+           localRenamed == other.localRenamed &&
            remoteAdded == other.remoteAdded &&
            remoteUpdated == other.remoteUpdated &&
            remoteDeleted == other.remoteDeleted &&
@@ -74,10 +86,11 @@ struct ProjectDiff
   {
     QStringList lines;
     lines << "--- project diff ---";
-    lines << QString( "local: %1 added, %2 updated, %3 deleted" )
+    lines << QString( "local: %1 added, %2 updated, %3 deleted, %4 renamed" )
           .arg( localAdded.count() )
           .arg( localUpdated.count() )
-          .arg( localDeleted.count() );
+          .arg( localDeleted.count() )
+          .arg( localRenamed.count() );
     lines << QString( "remote: %1 added, %2 updated, %3 deleted" )
           .arg( remoteAdded.count() )
           .arg( remoteUpdated.count() )
@@ -98,15 +111,16 @@ struct ProjectDiff
  */
 struct DownloadQueueItem
 {
-  DownloadQueueItem( const QString &fp, int s, int v, int rf = -1, int rt = -1, bool diff = false );
+  DownloadQueueItem() = default;
+  DownloadQueueItem( const QString &fp, qint64 s, int v, qint64 rf = -1, qint64 rt = -1, bool diff = false );
 
   QString filePath;          //!< path within the project
-  int size;                  //!< size of the item in bytes
+  qint64 size = 0;           //!< size of the item in bytes
   int version = -1;          //!< what version to download  (for ordinary files it will be the target version, for diffs it can be different version)
-  int rangeFrom = -1;        //!< what range of bytes to download (-1 if downloading the whole file)
-  int rangeTo = -1;          //!< what range of bytes to download (-1 if downloading the whole file)
+  qint64 rangeFrom = -1;     //!< what range of bytes to download (-1 if downloading the whole file)
+  qint64 rangeTo = -1;       //!< what range of bytes to download (-1 if downloading the whole file)
   bool downloadDiff = false; //!< whether to download just the diff between the previous version and the current one
-  QString tempFileName;      //!< relative filename of the temporary file where the downloaded content will be stored
+  QString tempFileName;      //!< relative filename of the temporary file where the downloaded content will be stored (chunks of a file share one staging file and are written at their offsets, assigned when the pull is prepared)
 };
 
 
@@ -120,48 +134,104 @@ struct UpdateTask
   {
     Copy,           //!< simply write a new version of the file
     CopyConflict,   //!< like Copy, but also create a conflict file of the locally modified file
-    ApplyDiff,      //!< apply diffs
+    ApplyDiff,      //!< apply diffs (local changes of the file get rebased on top of them)
+    ApplyDiffUnmodified,  //!< apply diffs to a file without local changes (may be done in place)
     Delete,         //!< remove files that have been removed from the server
+    Clone,          //!< create the file from a local file with the same content (nothing gets downloaded)
+    Move,           //!< like Clone, but the local file has been removed from the server, so it is just moved
+    Shared,         //!< create the file from the shared content store (nothing gets downloaded)
   };
 
-  UpdateTask( Method m, const QString &fp, const QList<DownloadQueueItem> &d )
-    : method( m ), filePath( fp ), data( d ) {}
+  UpdateTask( Method m, const QString &fp, const QList<DownloadQueueItem> &d, const QString &sp = QString() )
+    : method( m ), filePath( fp ), data( d ), sourcePath( sp ) {}
 
   Method method;                  //!< what to do with the file
   QString filePath;               //!< what is the file path within project
   QList<DownloadQueueItem> data;  //!< list of chunks / list of diffs to apply
+  QString sourcePath;             //!< path of the local file with the same content within project (only for Clone and Move)
+  QString checksum;               //!< checksum of the file on the server if it is shared through the content store
+};
+
+
+/**
+ * Checksum of a file that is being downloaded in chunks, computed on the fly as the data arrive.
+ * Chunks are hashed in order: if a chunk arrives before the preceding chunks are complete,
+ * its data are hashed from its temporary file once it becomes the current one.
+ */
+struct DownloadChecksum
+{
+  std::shared_ptr<QCryptographicHash> hash;
+  QString expectedChecksum;           //!< checksum of the file as reported by the server
+  QList<DownloadQueueItem> items;     //!< chunks of the file (in order)
+  int currentItem = 0;                //!< index of the item that is being hashed
+  qint64 currentItemHashed = 0;       //!< how many bytes of the current item have been hashed
+};
+
+
+/**
+ * A chunk of data that should be uploaded during project upload (push).
+ * This is a part of a full file or a part of a diff file of a diffable file.
+ */
+struct UploadChunk
+{
+  QString filePath;    //!< path of the file within project
+  QString sourcePath;  //!< absolute path of the file with data to upload (the project file itself or its diff in .mergin)
+  QString chunkId;     //!< ID of the chunk as sent to the server at the start of the upload
+  qint64 offset = 0;   //!< position of the chunk's data within the source file
+  qint64 size = 0;     //!< size of the chunk in bytes
 };
 
 
 struct TransactionStatus
 {
   qreal totalSize = 0;     //!< total size (in bytes) of files to be uploaded or downloaded
-  int transferedSize = 0;  //!< size (in bytes) of amount of data transferred so far
+  qint64 transferedSize = 0;  //!< size (in bytes) of amount of data transferred so far
   QString transactionUUID; //!< only for upload. Initially dummy non-empty string, after server confirms a valid UUID, on finish/cancel it is empty
 
   // download replies
   QPointer<QNetworkReply> replyProjectInfo;
-  QPointer<QNetworkReply> replyDownloadItem;
+  QList< QPointer<QNetworkReply> > replyDownloadItems;  //!< requests for download queue items that are currently in progress
 
   // upload replies
   QPointer<QNetworkReply> replyUploadProjectInfo;
   QPointer<QNetworkReply> replyUploadStart;
-  QPointer<QNetworkReply> replyUploadFile;
+  QList< QPointer<QNetworkReply> > replyUploadFiles;  //!< requests for upload of chunks that are currently in progress
   QPointer<QNetworkReply> replyUploadFinish;
 
   // download-related data
   QList<DownloadQueueItem> downloadQueue;  //!< pending list of stuff to download - chunks of project files or diff files (at the end of transaction it is empty)
   QList<UpdateTask> updateTasks;  //!< tasks to do at the end of update (pull) when everything has been downloaded
+  int maxParallelDownloads = 4;  //!< how many download queue items may be requested at the same time
+  QHash<QString, qint64> downloadFirstDataTimes;  //!< when the first data of items being downloaded arrived (key = download item key)
+  QHash<QString, std::shared_ptr<QFile> > downloadFiles;  //!< open temporary files of items being downloaded (key = download item key)
+  QSet<QString> downloadedItems;  //!< keys of items that have been completely downloaded
+  QHash<QString, DownloadQueueItem> requestedItems;  //!< items that are being downloaded (key = download item key)
+  QHash<QString, DownloadChecksum> downloadChecksums;  //!< checksums of files being downloaded as a whole (key = file path)
 
   // upload-related data
   QList<MerginFile> uploadQueue; //!< pending list of files to upload (at the end of transaction it is empty)
   QList<MerginFile> uploadDiffFiles;  //!< these are just diff files for upload - we don't remove them when uploading chunks (needed for finalization)
+  QList<UploadChunk> uploadChunkQueue;  //!< chunks of files from upload queue that have not been requested yet
+  QSet<QString> uploadedChunks;  //!< IDs of chunks that have been acknowledged by the server
+  int maxParallelUploads = 4;  //!< how many chunks may be uploaded at the same time
+  QHash<QString, UploadChunk> requestedChunks;  //!< chunks that are being uploaded (key = chunk ID)
+  QSet<QString> uploadChunksInPreparation;  //!< IDs of chunks being compressed in the sync worker (counted as requests in progress)
+  bool compressUploads = false;  //!< whether the server accepts compressed chunks
+  QSet<QString> incompressibleFiles;  //!< files whose data did not get smaller by compression - sent as they are
+  QJsonObject uploadChanges;  //!< local changes being pushed (path -> checksum, empty for removed files) to match the push journal
+  int uploadBaseVersion = -1;  //!< server version the push is based on
+
+  AdaptiveChunkPolicy chunkPolicy;  //!< sizes of download ranges and upload chunks, measured by the requests of this transaction
+  std::shared_ptr<SyncMetrics> metrics;  //!< timing of phases of the transaction (shared with tasks in the sync worker)
+  RateLimiter rateLimiter;  //!< limit of throughput of this transaction (see MerginApi::transactionRateLimit())
 
   QString projectDir;
   QByteArray projectMetadata;  //!< metadata of the new project (not parsed)
   bool firstTimeDownload = false;   //!< only for update. whether this is first time to download the project (on failure we would also remove the project folder)
   bool updateBeforeUpload = false; //!< true when we're first doing update before doing actual upload. Used in sync finalization to figure out whether restart with upload or finish.
   bool isInitialUpload = false; //! true when we are first time uploading the project - migration to Mergin
+  bool cancelRequested = false;  //!< cancel was requested while a sync task was running in the sync worker
+  QString contentStoreDir;  //!< only for update. shared content store used by the pull (empty if it is not used)
 
   int version = -1;  //!< version to which we are updating / the version which we have uploaded
 
@@ -181,12 +251,21 @@ class MerginApi: public QObject
     Q_PROPERTY( QString apiRoot READ apiRoot WRITE setApiRoot NOTIFY apiRootChanged )
     Q_PROPERTY( bool apiSupportsSubscriptions READ apiSupportsSubscriptions NOTIFY apiSupportsSubscriptionsChanged )
     Q_PROPERTY( /*MerginApiStatus::ApiStatus*/ int apiVersionStatus READ apiVersionStatus NOTIFY apiVersionStatusChanged )
+    Q_PROPERTY( QVariantMap lastSyncMetrics READ lastSyncMetrics NOTIFY lastSyncMetricsChanged )
+    Q_PROPERTY( qint64 rateLimit READ rateLimit WRITE setRateLimit NOTIFY transferSettingsChanged )
+    Q_PROPERTY( qint64 transactionRateLimit READ transactionRateLimit WRITE setTransactionRateLimit NOTIFY transferSettingsChanged )
+    Q_PROPERTY( bool meteredConnection READ meteredConnection WRITE setMeteredConnection NOTIFY transferSettingsChanged )
+    Q_PROPERTY( bool sharedContentStore READ sharedContentStore WRITE setSharedContentStore NOTIFY transferSettingsChanged )
 
   public:
     explicit MerginApi( LocalProjectsManager &localProjects, QObject *parent = nullptr );
     ~MerginApi() = default;
 
     MerginUserAuth *userAuth() const;
+
+    //! Returns scheduler that queues syncs of projects
+    SyncScheduler *syncScheduler() { return &mSyncScheduler; }
+
     MerginUserInfo *userInfo() const;
     MerginSubscriptionInfo *subscriptionInfo() const;
 
@@ -205,6 +284,9 @@ class MerginApi: public QObject
      * when a response is received, parses projects json and sets mMerginProjects. The authorization is not required
      * for "exploring" all public projects. However, it can be applied to fetch more results.
      * Eventually emits listProjectsFinished on which ProjectPanel (qml component) updates content.
+     * Responses are cached: if the same request has been made before, listProjectsFromCache is emitted with the cached
+     * projects first and the request asks the server only to confirm they are still valid (ETag/Last-Modified).
+     * The next page is prefetched in the background, so it is available without a request when it gets listed.
      * \param searchExpression Search filter on projects name.
      * \param flag If defined, it is used to filter out projects tagged as 'created' or 'shared' with a authorized user
      * \param filterTag Name of tag that fetched projects have to have.
@@ -217,6 +299,7 @@ class MerginApi: public QObject
     /**
      * Sends non-blocking GET request to the server to listProjectsByName API. Response is handled in listProjectsByNameFinished
      * method. Projects are parsed from response JSON.
+     * Like with listProjects(), cached projects are emitted by listProjectsByNameFromCache while the request is in progress.
      *
      * \param projectNames QStringList of project full names (namespace/name)
      * \returns unique id of a sent request
@@ -232,6 +315,7 @@ class MerginApi: public QObject
      * \param projectNamespace Project's namespace used in request.
      * \param projectName  Project's name used in request.
      * \param withoutAuth If True, a request is  without authorization (only public projects dont require auth)
+     * \note The update may wait in the sync queue if too many projects are being synced (see SyncScheduler)
      */
     Q_INVOKABLE void updateProject( const QString &projectNamespace, const QString &projectName, bool withoutAuth = false );
 
@@ -242,6 +326,7 @@ class MerginApi: public QObject
      * Emits also notify signal with a message for the GUI.
      * \param projectNamespace Project's namespace used in request.
      * \param projectName  Project's name used in request.
+     * \note The upload may wait in the sync queue if too many projects are being synced (see SyncScheduler)
      */
     Q_INVOKABLE void uploadProject( const QString &projectNamespace, const QString &projectName, bool isInitialUpload = false );
 
@@ -321,6 +406,51 @@ class MerginApi: public QObject
 
     static bool isFileDiffable( const QString &fileName ) { return fileName.endsWith( ".gpkg" ); }
 
+    //! Files larger than this are not synced on a metered connection unless they can be synced by diffs
+    static constexpr qint64 METERED_MAX_FILE_SIZE = 1024 * 1024;
+
+    //! Items downloaded by an interrupted pull are reused by pulls started at most this long after it (in milliseconds)
+    static constexpr qint64 PULL_JOURNAL_MAX_AGE = 7 * 24 * 60 * 60 * 1000LL;
+
+    //! Returns whether sync of a file of the given size waits for a connection that is not metered
+    static bool isDeferredOnMeteredConnection( const QString &filePath, qint64 size );
+
+    /**
+     * Returns limit of throughput of all syncs together in bytes per second (0 if not limited).
+     * Both downloaded and uploaded data count towards the limit.
+     */
+    qint64 rateLimit() const { return mRateLimiter.rate(); }
+    void setRateLimit( qint64 bytesPerSecond );
+
+    //! Returns limit of throughput of each sync in bytes per second (0 if not limited)
+    qint64 transactionRateLimit() const { return mTransactionRateLimit; }
+    void setTransactionRateLimit( qint64 bytesPerSecond );
+
+    /**
+     * Returns whether the connection is metered (expensive). On a metered connection large files that cannot
+     * be synced by diffs (photos, rasters...) are left out of syncs, changes of geopackages are synced right away.
+     * When the connection stops being metered, projects with left out files get synced again.
+     */
+    bool meteredConnection() const { return mMeteredConnection; }
+    void setMeteredConnection( bool metered );
+
+    //! Returns whether some files of the project have been left out of its last sync because of a metered connection
+    bool hasDeferredFiles( const QString &projectFullName ) const;
+
+    /**
+     * Returns whether pulled files are shared by projects through the content store (see ContentStore),
+     * so that files with the same content are not downloaded and stored again for each project.
+     * Turning it off removes the store once no pull uses it anymore.
+     */
+    bool sharedContentStore() const { return mSharedContentStore; }
+    void setSharedContentStore( bool enabled );
+
+    /**
+     * Sets the project open in the map (empty if there is none). Its layers keep the files they have opened,
+     * so the project gets reloaded (see reloadProject()) when a pull replaces or removes some of its files.
+     */
+    void setOpenProject( const QString &projectFullName ) { mOpenProject = projectFullName; }
+
     //! Get a list of all files that can be used with geodiff
     QStringList projectDiffableFiles( const QString &projectFullName );
 
@@ -365,7 +495,34 @@ class MerginApi: public QObject
      */
     static ProjectDiff compareProjectFiles( const QList<MerginFile> &oldServerFiles, const QList<MerginFile> &newServerFiles, const QList<MerginFile> &localFiles, const QString &projectDir );
 
-    static QList<MerginFile> getLocalProjectFiles( const QString &projectPath );
+    /**
+     * Finds files that have been moved locally: removed files with the same checksum and size as an added file
+     * (a file with the same name is preferred if there are more of them). Such files are taken out of localAdded
+     * and localDeleted of the diff and put to localRenamed, so that they can be pushed without upload of their content.
+     * Removed files are described by \a serverProject, added files by \a localFiles.
+     */
+    static void findLocalRenames( ProjectDiff &diff, const MerginProjectMetadata &serverProject, const QList<MerginFile> &localFiles );
+
+    /**
+     * Returns list of files in the local project directory with their checksums.
+     * Checksums are read from the project's checksum cache and only files that have changed
+     * since the last scan get hashed again. If the project has an exact ChangeJournal, only paths
+     * changed since the last scan get listed and checked. Scans of the same project are serialised.
+     * Files are hashed by up to \a hashingThreads threads (0 means all cores).
+     */
+    static QList<MerginFile> getLocalProjectFiles( const QString &projectPath, int hashingThreads = 0 );
+
+    /**
+     * Returns timing of phases of the last finished sync (see SyncMetrics::toVariantMap()) for diagnostics.
+     * Metrics of all syncs are appended to syncMetricsFilePath().
+     */
+    QVariantMap lastSyncMetrics() const { return mLastSyncMetrics; }
+
+    //! Returns path of the file with metrics of sync transactions (one JSON object per line)
+    QString syncMetricsFilePath() const;
+
+    //! Returns SHA1 checksum (hex encoded) of the file content
+    static QByteArray getChecksum( const QString &filePath );
 
     QString apiRoot() const;
     void setApiRoot( const QString &apiRoot );
@@ -397,6 +554,10 @@ class MerginApi: public QObject
     void listProjectsFinished( const MerginProjectsList &merginProjects, Transactions pendingProjects, int projectCount, int page, QString requestId );
     void listProjectsFailed();
     void listProjectsByNameFinished( const MerginProjectsList &merginProjects, Transactions pendingProjects, QString requestId );
+    //! Emitted with the cached response of a listProjects() request before the server confirms it or sends a new one
+    void listProjectsFromCache( const MerginProjectsList &merginProjects, Transactions pendingProjects, int projectCount, int page, QString requestId );
+    //! Emitted with the cached response of a listProjectsByName() request before the server confirms it or sends a new one
+    void listProjectsByNameFromCache( const MerginProjectsList &merginProjects, Transactions pendingProjects, QString requestId );
     void syncProjectFinished( const QString &projectDir, const QString &projectFullName, bool successfully, int version );
     /**
      * Emitted when sync starts/finishes or the progress changes - useful to give a clue in the GUI about the status.
@@ -415,6 +576,8 @@ class MerginApi: public QObject
     void registrationFailed();
     void apiRootChanged();
     void apiVersionStatusChanged();
+    void lastSyncMetricsChanged();
+    void transferSettingsChanged();
     void projectCreated( const QString &projectName, bool result );
     void serverProjectDeleted( const QString &projecFullName, bool result );
     void userInfoChanged();
@@ -430,11 +593,12 @@ class MerginApi: public QObject
     void projectAttachedToMergin( const QString &projectFullName );
 
   private slots:
-    void listProjectsReplyFinished( QString requestId );
-    void listProjectsByNameReplyFinished( QString requestId );
+    void listProjectsReplyFinished( QString requestId, QString cacheKey );
+    void listProjectsByNameReplyFinished( QString requestId, QString cacheKey );
 
     // Pull slots
     void updateInfoReplyFinished();
+    void downloadItemReadyRead();
     void downloadItemReplyFinished();
 
     // Push slots
@@ -461,8 +625,26 @@ class MerginApi: public QObject
   private:
     MerginProject parseProjectMetadata( const QJsonObject &project );
     MerginProjectsList parseProjectsFromJson( const QJsonDocument &object );
-    static QStringList generateChunkIdsForSize( qint64 fileSize );
+
+    //! Requests projects in the background to have them in the project list cache
+    void prefetchProjects( const QUrl &url );
+    //! Adds If-None-Match/If-Modified-Since headers to revalidate a cached project list response
+    void setConditionalHeaders( QNetworkRequest &request, const QString &cacheKey );
+
+    /**
+     * Updates the project list cache with a reply (its body is passed in \a data).
+     * Returns true if the server has confirmed the cached response is still valid (304 Not Modified).
+     */
+    bool updateProjectListCache( QNetworkReply *r, const QString &cacheKey, const QByteArray &data, int projectCount, bool prefetched );
+
+    //! Returns projects of a cached project list response (parsed only the first time)
+    MerginProjectsList cachedProjectList( const QString &cacheKey );
+    static QStringList generateChunkIdsForSize( qint64 fileSize, qint64 chunkSize );
     QJsonArray prepareUploadChangesJSON( const QList<MerginFile> &files );
+    //! Moves basefiles of diffable files that have been pushed as renamed
+    static void updateRenamedBasefiles( const QString &projectFullName, const TransactionStatus &transaction );
+    //! Returns renamed files for the push request (path and new_path of each file)
+    static QJsonArray prepareUploadRenamesJSON( const QHash<QString, QString> &renamed, const MerginProjectMetadata &serverProject );
     static QString getApiKey( const QString &serverName );
 
     /**
@@ -474,12 +656,70 @@ class MerginApi: public QObject
 
     /**
      * Sends non-blocking POST request to the server to upload a file (chunk).
+     * If the server accepts compressed uploads, the data get compressed in the sync worker first.
      * \param projectFullName Namespace/name
      * \param transactionUUID Transaction ID which servers sends on uploadStart
-     * \param file Mergin file to upload
-     * \param chunkNo Chunk number of given file to be uploaded
+     * \param chunk Chunk of a file to be uploaded
+     */
+    void uploadFile( const QString &projectFullName, const QString &transactionUUID, const UploadChunk &chunk );
+
+    //! Reads data of the chunk from its source file
+    static QByteArray readUploadChunk( const UploadChunk &chunk );
+
+    //! Sends request with data of the chunk (\a compressed if they are in HttpCompression::ENCODING)
+    void postUploadChunk( const QString &projectFullName, const QString &transactionUUID, const UploadChunk &chunk,
+                          const QByteArray &data, bool compressed );
+
+    /**
+     * Starts upload requests of further chunks from the chunk queue, so that there are up to
+     * TransactionStatus::maxParallelUploads requests in progress. When all chunks have been
+     * acknowledged by the server, the upload gets finished.
+     */
+    void uploadNextChunks( const QString &projectFullName );
+
+    //! Returns number of download and upload requests in progress of all syncs
+    int requestsInFlight() const;
+
+    /**
+     * Whether a transaction may send another download/upload request: there must be less than \a maxParallel
+     * requests of the transaction and the global limit of the sync scheduler must not be reached.
+     * A transaction without any request in progress may always send one, so that it does not get stuck.
+     */
+    bool canStartRequest( int transactionRequests, int maxParallel ) const;
+
+    //! Called when a download or upload request has finished - starts requests held back by the global limit (asynchronously)
+    void requestFinished();
+
+    //! Lets transactions waiting for a free slot of the global limit of requests start their requests
+    void startWaitingRequests();
+
+    //! Starts a sync that has been let through by the sync scheduler
+    void startScheduledSync( const SyncScheduler::Request &request );
+    //! Requests project info to start update (pull) - the first step of the sync
+    void beginProjectUpdate( const QString &projectFullName, bool withoutAuth );
+    //! Requests project info to start upload (push) - the first step of the sync
+    void beginProjectUpload( const QString &projectFullName, bool isInitialUpload );
+
+    //! Aborts all chunk upload requests in progress without handling their replies
+    void abortPendingUploads( TransactionStatus &transaction );
+
+    /**
+     * The push journal in the project's .mergin folder keeps track of a push transaction that has been started,
+     * so that a failed push can be resumed - only the chunks not acknowledged by the server get uploaded then.
+     * The first line describes the transaction (UUID, base version, local changes and files to upload with their
+     * chunk IDs and diff files), each further line holds ID of an acknowledged chunk (JSON objects, one per line).
+     */
+    void writePushJournalHeader( const QString &projectFullName );
+    void appendPushJournalChunk( const QString &projectFullName, const QString &chunkId );
+
+    /**
+     * Continues the push transaction from the journal if it was started for the same local changes
+     * and the same server version. Returns false if there is nothing to continue with.
      */
-    void uploadFile( const QString &projectFullName, const QString &transactionUUID, MerginFile file, int chunkNo = 0 );
+    bool resumePushFromJournal( const QString &projectFullName );
+
+    //! Removes the push journal together with the diff files it refers to
+    void discardPushJournal( const QString &projectDir );
 
     /**
      * Closing request after successful upload.
@@ -491,11 +731,17 @@ class MerginApi: public QObject
     void sendUploadCancelRequest( const QString &projectFullName, const QString &transactionUUID );
 
     bool writeData( const QByteArray &data, const QString &path );
-    void createPathIfNotExists( const QString &filePath );
+    static void createPathIfNotExists( const QString &filePath );
 
-    static QByteArray getChecksum( const QString &filePath );
     static QSet<QString> listFiles( const QString &projectPath );
 
+    /**
+     * Returns files of the project like listFiles(). With an exact change journal, the files listed by the previous
+     * call get updated with the changed paths only - \a journaled is then set and \a changedFiles gets files
+     * that may have changed since the previous call.
+     */
+    static QSet<QString> listProjectFiles( const QString &projectPath, QSet<QString> &changedFiles, bool &journaled );
+
     void loadAuthData();
 
     bool validateAuthAndContinute();
@@ -526,16 +772,147 @@ class MerginApi: public QObject
     //! Called when download/update of project data has finished to finalize things and emit sync finished signal
     void finalizeProjectUpdate( const QString &projectFullName );
 
-    void finalizeProjectUpdateCopy( const QString &projectFullName, const QString &projectDir, const QString &tempDir, const QString &filePath, const QList<DownloadQueueItem> &items );
-    void finalizeProjectUpdateApplyDiff( const QString &projectFullName, const QString &projectDir, const QString &tempDir, const QString &filePath, const QList<DownloadQueueItem> &items );
+    /**
+     * Runs update tasks of a pull when all items have been downloaded (moves downloaded files in place, applies diffs)
+     * and cleans up the temp folder. It is run in the sync worker, so it must not access any member data.
+     * \param conflictPaths paths for conflicting copies of local files (key = file path)
+     * \param contentStoreDir directory of the shared content store (empty if files are not shared)
+     * \param checksums checksums of all files of the project after the pull (objects it references in the content store)
+     * Returns files that could not be created (from local copies or the content store) or updated by diffs in place.
+     */
+    static QSet<QString> runUpdateTasks( const QString &projectFullName, const QString &projectDir, const QString &tempDir,
+                                const QList<UpdateTask> &tasks, const QHash<QString, QString> &conflictPaths,
+                                const QString &contentStoreDir, const QSet<QString> &checksums, SyncMetrics *metrics = nullptr );
+
+    /**
+     * Called when update tasks have been run by the sync worker - registers a downloaded project and finishes the sync.
+     * Files that could not be created (or updated) keep their old metadata, so they get pulled again.
+     */
+    void updateTasksFinished( const QString &projectFullName, const QSet<QString> &missingFiles );
+
+    //! Moves the downloaded file in place of the project's file, returns false if it could not be replaced (the old file is kept)
+    static bool finalizeProjectUpdateCopy( const QString &projectFullName, const QString &projectDir, const QString &tempDir, const QString &filePath, const QList<DownloadQueueItem> &items );
+    //! Creates a file from a local file with the same content - it is moved if \a move is true, cloned otherwise. Returns false on failure
+    static bool finalizeProjectUpdateClone( const QString &projectFullName, const QString &projectDir, const QString &filePath, const QString &sourcePath, bool move );
+    //! Creates a file from the object in the shared content store, returns false if the object cannot be used
+    static bool finalizeProjectUpdateShared( const QString &projectFullName, const QString &projectDir, const QString &filePath, const QString &checksum, const QString &contentStoreDir );
+    //! Applies pulled diffs to a diffable file, returns false if they could not be applied in place (the file needs to be downloaded in full)
+    static bool finalizeProjectUpdateApplyDiff( const QString &projectFullName, const QString &projectDir, const QString &tempDir, const QString &filePath, const QList<DownloadQueueItem> &items, const QString &conflictPath, bool localChanges, SyncMetrics *metrics = nullptr );
 
     //! Takes care of removal of the transaction, writing new metadata and emits syncProjectFinished()
     void finishProjectSync( const QString &projectFullName, bool syncSuccessful );
 
+    //! Removes the shared content store in the sync worker if it has been turned off and no pull uses it
+    void removeUnusedContentStore();
+
     void startProjectUpdate( const QString &projectFullName, const QByteArray &data );
 
-    //! Starts download request of another item
-    void downloadNextItem( const QString &projectFullName );
+    /**
+     * Continues startProjectUpdate() when local files have been scanned by the sync worker:
+     * compares local files with the server and starts download of the changes.
+     */
+    void prepareProjectUpdate( const QString &projectFullName, const QByteArray &data, const QList<MerginFile> &localFiles, const QList<DownloadQueueItem> &journalItems );
+
+    //! Runs getLocalProjectFiles() measured as the scan phase of the transaction. It is run in the sync worker.
+    static QList<MerginFile> scanLocalProjectFiles( const QString &projectDir, SyncMetrics *metrics );
+
+    /**
+     * Continues uploadInfoReplyFinished() when local files have been scanned by the sync worker:
+     * figures out local changes and either resumes a previous push or lets the sync worker create diffs of modified files.
+     */
+    void prepareProjectUpload( const QString &projectFullName, const QByteArray &data, const QList<MerginFile> &localFiles );
+
+    /**
+     * Creates diffs of modified diffable files to be pushed instead of the whole files. Files for which the diff
+     * cannot be created are returned unchanged (full upload). It is run in the sync worker.
+     */
+    static QList<MerginFile> createUploadDiffs( const QString &projectFullName, const QString &projectDir, const QList<MerginFile> &files,
+        const MerginProjectMetadata &serverProject, qint64 chunkSize, SyncMetrics *metrics = nullptr );
+
+    //! Sends request to start the push transaction for the given changes (last step of preparation of the push)
+    void startProjectUpload( const QString &projectFullName, const QByteArray &data, const QList<MerginFile> &addedMerginFiles,
+                             const QList<MerginFile> &updatedMerginFiles, const QList<MerginFile> &deletedMerginFiles );
+
+    /**
+     * Starts download requests of further items from the download queue, so that there are up to
+     * TransactionStatus::maxParallelDownloads requests in progress. When the queue is empty
+     * and all requests have finished, the update gets finalized.
+     * Ranges larger than the download chunk size of the transaction's chunk policy get split first.
+     */
+    void downloadNextItems( const QString &projectFullName );
+
+    //! Aborts all download requests in progress without handling their replies
+    void abortPendingDownloads( TransactionStatus &transaction );
+
+    /**
+     * Splits a download item of a range of a file into the first \a size bytes and the rest. The checksum
+     * items of the file get updated accordingly. Returns the remaining part.
+     */
+    DownloadQueueItem splitDownloadItem( TransactionStatus &transaction, DownloadQueueItem &item, qint64 size );
+
+    /**
+     * Writes data available in the reply of a download queue item to its temporary file and adds them
+     * to the checksum of the downloaded file. Replies with an error are left untouched so that the error
+     * message can be read later. Returns false if the data could not be written.
+     */
+    bool writeDownloadItemData( QNetworkReply *r, bool drain = false );
+
+    //! Returns how many of \a bytes the transaction may transfer now with respect to the rate limits
+    qint64 transferAllowance( TransactionStatus &transaction, qint64 bytes );
+
+    //! Takes bytes transferred by the transaction out of the rate limits
+    void consumeTransfer( TransactionStatus &transaction, qint64 bytes );
+
+    //! Returns milliseconds until the transaction may transfer \a bytes with respect to the rate limits (0 if right away)
+    qint64 transferDelay( TransactionStatus &transaction, qint64 bytes = 1 );
+
+    //! Makes sure that resumeThrottledTransfers() gets called in \a delayMs at the latest
+    void scheduleThrottledTransfers( qint64 delayMs );
+
+    //! Continues downloads and uploads that have been held back by the rate limits
+    void resumeThrottledTransfers();
+
+    //! Requests syncs of projects whose files have been left out on a metered connection
+    void resumeDeferredTransfers();
+
+    //! Returns metadata \a data in which files \a filePaths keep their entries from the project's current metadata file
+    static QByteArray metadataKeepingFiles( const QString &projectDir, const QByteArray &data, const QSet<QString> &filePaths );
+
+    //! Returns metadata of the project after a push to be written to the project's metadata file
+    static QByteArray pushedProjectMetadata( const TransactionStatus &transaction, const QByteArray &data );
+
+    /**
+     * Hashes data of the file's downloaded items that could not be hashed on the fly (because they arrived
+     * out of order). When all items have been hashed, the checksum is compared with the one from the server.
+     * Returns false on checksum mismatch.
+     */
+    bool updateDownloadChecksum( const QString &projectFullName, const QString &filePath );
+
+    /**
+     * Handles failure of a pull while downloading items - aborts other requests and cleans up.
+     * With \a keepDownloadedData the downloaded items are left in the temp folder, so that the next pull
+     * of the same version can resume (e.g. after a network error). Otherwise they get removed (e.g. after cancellation).
+     */
+    void downloadItemsFailed( const QString &projectFullName, const QString &serverMsg, bool keepDownloadedData );
+
+    /**
+     * The pull journal in the project's temp folder keeps track of the items downloaded so far, so that an interrupted
+     * pull (network loss, app killed) can be resumed. The first line is a header with the target version, the project
+     * directory and the creation time, each further line describes a downloaded item (JSON objects, one per line).
+     */
+    void writePullJournalHeader( const QString &projectFullName, int version, const QString &projectDir );
+    void appendPullJournalItem( const QString &projectFullName, const DownloadQueueItem &item );
+
+    /**
+     * Reads pull journal of an interrupted pull. Returns false if there is no journal for the given target version
+     * or it is older than PULL_JOURNAL_MAX_AGE.
+     * \param projectDir will contain project directory of the interrupted pull (even if it was for a different version)
+     * \param items will contain the downloaded items (with their temp file names)
+     */
+    bool readPullJournal( const QString &projectFullName, int version, QString &projectDir, QList<DownloadQueueItem> &items );
+
+    //! Returns ID of a download queue item that does not depend on the temp file name
+    static QString pullJournalItemId( const DownloadQueueItem &item );
 
     //! Removes temp folder for project
     void removeProjectsTempFolder( const QString &projectNamespace, const QString &projectName );
@@ -544,9 +921,17 @@ class MerginApi: public QObject
 
     bool projectFileHasBeenUpdated( const ProjectDiff &diff );
 
+    //! Whether a pull with the diff has replaced or removed local files (files only added by it are not counted)
+    bool localFilesHaveBeenReplaced( const ProjectDiff &diff );
+
     bool hasProjecFileExtension( const QString filePath );
 
     QNetworkAccessManager mManager;
+    SyncWorker mSyncWorker;  //!< runs hashing, diffing and other heavy work of syncs off the GUI thread
+    SyncScheduler mSyncScheduler;  //!< limits how many projects get synced at the same time
+    AdaptiveChunkPolicy mChunkPolicy;  //!< speed of the connection measured by the previous transactions (seeds new transactions)
+    ProjectListCache mProjectListCache;  //!< responses of project listing requests
+    QSet<QString> mPrefetchedProjectLists;  //!< cache keys of project lists being prefetched
     QString mApiRoot;
     LocalProjectsManager &mLocalProjects;
     QString mDataDir; // dir with all projects
@@ -559,24 +944,52 @@ class MerginApi: public QObject
     {
       AttrProjectFullName = QNetworkRequest::User,
       AttrTempFileName    = QNetworkRequest::User + 1,
+      AttrChunkSize       = QNetworkRequest::User + 2,
+      AttrFilePath        = QNetworkRequest::User + 3,
+      AttrRangeFrom       = QNetworkRequest::User + 4,
+      AttrRequestStart    = QNetworkRequest::User + 5,  //!< AdaptiveChunkPolicy::timestamp() when the request was sent
     };
 
     Transactions mTransactionalStatus; //projectFullname -> transactionStatus
     static const QSet<QString> sIgnoreExtensions;
     static const QSet<QString> sIgnoreFiles;
+    static const QString sPullJournalFile;  //!< name of the pull journal in project's temp folder
+    static const QString sPushJournalFile;  //!< name of the push journal in project's .mergin folder
+    static const QString sProjectListCacheFile;  //!< name of the project list cache in the temp folder
+    static const QString sSyncMetricsFile;  //!< name of the file with metrics of sync transactions in the temp folder
+    QVariantMap mLastSyncMetrics;
+    RateLimiter mRateLimiter;  //!< limit of throughput of all transactions together
+    qint64 mTransactionRateLimit = 0;
+    QTimer mThrottleTimer;  //!< resumes transfers held back by the rate limits
+    bool mWaitingRequestsPending = false;  //!< startWaitingRequests() has been posted already
+    bool mMeteredConnection = false;
+    bool mSharedContentStore = false;
+    QString mOpenProject;  //!< full name of the project open in the map
+    QSet<QString> mDeferredPulls;  //!< projects with server changes left out of the last pull on a metered connection
+    QSet<QString> mDeferredPushes;  //!< projects with local changes left out of the last push on a metered connection
     QEventLoop mAuthLoopEvent;
     MerginApiStatus::VersionStatus mApiVersionStatus = MerginApiStatus::VersionStatus::UNKNOWN;
     bool mApiSupportsSubscriptions = false;
 
-    static const int CHUNK_SIZE = 65536;
-    static const int UPLOAD_CHUNK_SIZE;
+    static const int DOWNLOAD_BUFFER_SIZE = 1024 * 1024;  //!< max. amount of data of a download reply held in memory
+    static const int RATE_LIMITED_CHUNK_SECS = 2;  //!< with a rate limit, upload chunks are not larger than what may be sent in this time
     const int PROJECT_PER_PAGE = 50;
     const QString TEMP_FOLDER = QStringLiteral( ".temp/" );
 
-    static QList<DownloadQueueItem> itemsForFileChunks( const MerginFile &file, int version );
+    /**
+     * Splits download of a file to ranges of up to \a chunkSize bytes. Ranges downloaded by a previous attempt
+     * (\a downloadedRanges: first byte -> last byte) are kept as they were, so that they can be reused.
+     */
+    static QList<DownloadQueueItem> itemsForFileChunks( const MerginFile &file, int version, qint64 chunkSize,
+        const QMap<qint64, qint64> &downloadedRanges = QMap<qint64, qint64>() );
     static QList<DownloadQueueItem> itemsForFileDiffs( const MerginFile &file );
+    static QList<UploadChunk> uploadChunksForFile( const MerginFile &file, const QString &projectDir );
+    //! Returns key identifying a download queue item (chunks of a file share the temp file name)
+    static QString downloadItemKey( const QString &tempFileName, qint64 rangeFrom );
 
     friend class TestMerginApi;
+    friend class TestMerginApiMock;
+    friend class TestSyncBenchmarks;
     friend class Purchasing;
     friend class PurchasingTransaction;
 };
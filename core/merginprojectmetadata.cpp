@@ -9,12 +9,22 @@
 
 #include "merginprojectmetadata.h"
 
+#include <QDataStream>
 #include <QDebug>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <algorithm>
 #include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+static const quint32 SIDECAR_MAGIC = 0x4d504d31;  // "MPM1"
+static const qint32 SIDECAR_VERSION = 1;
+
+// the JSON file may be written again within the resolution of file system timestamps,
+// so the sidecar is only written for files that have not been modified recently
+static const qint64 RACY_WINDOW_MSECS = 2000;
 
 MerginFile MerginFile::fromJsonObject( const QJsonObject &merginFileInfo )
 {
@@ -119,26 +129,158 @@ MerginProjectMetadata MerginProjectMetadata::fromJson( const QByteArray &data )
     project.version = versionStr.toInt();
   }
 
+  project.rebuildIndex();
   return project;
 }
 
+QByteArray MerginProjectMetadata::withFilesFrom( const QByteArray &data, const QByteArray &oldData, const QSet<QString> &filePaths )
+{
+  QJsonObject docObj = QJsonDocument::fromJson( data ).object();
+
+  QHash<QString, QJsonValue> oldFiles;
+  const QJsonArray oldFilesArray = QJsonDocument::fromJson( oldData ).object().value( QStringLiteral( "files" ) ).toArray();
+  for ( const QJsonValue &file : oldFilesArray )
+  {
+    QString path = file.toObject().value( QStringLiteral( "path" ) ).toString();
+    if ( filePaths.contains( path ) )
+      oldFiles.insert( path, file );
+  }
+
+  QJsonArray files;
+  const QJsonArray filesArray = docObj.value( QStringLiteral( "files" ) ).toArray();
+  for ( const QJsonValue &file : filesArray )
+  {
+    QString path = file.toObject().value( QStringLiteral( "path" ) ).toString();
+    if ( !filePaths.contains( path ) )
+      files.append( file );
+    else if ( oldFiles.contains( path ) )
+      files.append( oldFiles.value( path ) );
+  }
+  docObj.insert( QStringLiteral( "files" ), files );
+
+  return QJsonDocument( docObj ).toJson();
+}
+
 MerginProjectMetadata MerginProjectMetadata::fromCachedJson( const QString &metadataFilePath )
 {
+  QFileInfo info( metadataFilePath );
+  if ( !info.exists() )
+    return MerginProjectMetadata();
+
+  qint64 jsonSize = info.size();
+  qint64 jsonMtime = info.lastModified().toMSecsSinceEpoch();
+  QString sidecarPath = sidecarFilePath( metadataFilePath );
+
+  MerginProjectMetadata project;
+  if ( project.readSidecar( sidecarPath, jsonSize, jsonMtime ) )
+    return project;
+
   QFile file( metadataFilePath );
   if ( file.open( QIODevice::ReadOnly ) )
   {
-    return fromJson( file.readAll() );
+    project = fromJson( file.readAll() );
+    if ( project.isValid() && jsonMtime < QDateTime::currentMSecsSinceEpoch() - RACY_WINDOW_MSECS )
+      project.writeSidecar( sidecarPath, jsonSize, jsonMtime );
+    return project;
   }
   return MerginProjectMetadata();
 }
 
+QString MerginProjectMetadata::sidecarFilePath( const QString &metadataFilePath )
+{
+  QFileInfo info( metadataFilePath );
+  return info.path() + "/" + info.completeBaseName() + QStringLiteral( ".cache" );
+}
+
 MerginFile MerginProjectMetadata::fileInfo( const QString &filePath ) const
 {
-  for ( const MerginFile &merginFile : files )
-  {
-    if ( merginFile.path == filePath )
-      return merginFile;
-  }
+  int index = fileIndex( filePath );
+  if ( index >= 0 )
+    return files.at( index );
+
   qDebug() << "requested fileInfo() for non-existant file! " << filePath;
   return MerginFile();
 }
+
+bool MerginProjectMetadata::hasFile( const QString &filePath ) const
+{
+  return fileIndex( filePath ) >= 0;
+}
+
+int MerginProjectMetadata::fileIndex( const QString &filePath ) const
+{
+  // files may have been modified since the index was built - it is rebuilt if it does not match
+  int index = mFileIndex.value( filePath, -1 );
+  if ( index >= 0 && index < files.count() && files.at( index ).path == filePath )
+    return index;
+
+  if ( index >= 0 || mFileIndex.count() != files.count() )
+  {
+    rebuildIndex();
+    return mFileIndex.value( filePath, -1 );
+  }
+  return -1;
+}
+
+void MerginProjectMetadata::rebuildIndex() const
+{
+  mFileIndex.clear();
+  mFileIndex.reserve( files.count() );
+  for ( int i = 0; i < files.count(); ++i )
+    mFileIndex.insert( files.at( i ).path, i );
+}
+
+bool MerginProjectMetadata::readSidecar( const QString &sidecarPath, qint64 jsonSize, qint64 jsonMtime )
+{
+  QFile f( sidecarPath );
+  if ( !f.open( QIODevice::ReadOnly ) )
+    return false;
+
+  QDataStream stream( &f );
+  stream.setVersion( QDataStream::Qt_5_0 );
+
+  quint32 magic;
+  qint32 sidecarVersion;
+  qint64 size, mtime;
+  stream >> magic >> sidecarVersion >> size >> mtime;
+  if ( magic != SIDECAR_MAGIC || sidecarVersion != SIDECAR_VERSION || size != jsonSize || mtime != jsonMtime )
+    return false;  // the JSON file has been written since
+
+  quint32 count;
+  stream >> name >> projectNamespace >> writersnames >> version >> count;
+  files.clear();
+  files.reserve( static_cast<int>( count ) );
+  for ( quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i )
+  {
+    MerginFile file;
+    stream >> file.path >> file.checksum >> file.size >> file.mtime >> file.pullCanUseDiff >> file.pullDiffFiles;
+    files << file;
+  }
+
+  if ( stream.status() != QDataStream::Ok )
+  {
+    *this = MerginProjectMetadata();
+    return false;
+  }
+
+  rebuildIndex();
+  return true;
+}
+
+bool MerginProjectMetadata::writeSidecar( const QString &sidecarPath, qint64 jsonSize, qint64 jsonMtime ) const
+{
+  QSaveFile f( sidecarPath );
+  if ( !f.open( QIODevice::WriteOnly ) )
+    return false;
+
+  QDataStream stream( &f );
+  stream.setVersion( QDataStream::Qt_5_0 );
+  stream << SIDECAR_MAGIC << SIDECAR_VERSION << jsonSize << jsonMtime;
+  stream << name << projectNamespace << writersnames << version << static_cast<quint32>( files.count() );
+  for ( const MerginFile &file : files )
+  {
+    stream << file.path << file.checksum << file.size << file.mtime << file.pullCanUseDiff << file.pullDiffFiles;
+  }
+
+  return f.commit();
+}
@@ -11,7 +11,9 @@
 #define MERGINPROJECTMETADATA_H
 
 #include <QDateTime>
+#include <QHash>
 #include <QList>
+#include <QSet>
 #include <QJsonObject>
 
 struct MerginFile
@@ -21,6 +23,7 @@ struct MerginFile
   qint64 size;
   QDateTime mtime;
   QStringList chunks; // used only for upload otherwise suppose to be empty
+  qint64 chunkSize = 0; // size of the upload chunks (the last one may be smaller)
 
   //
   // these are members only used for upload of changed file through a geo-diff
@@ -43,7 +46,13 @@ struct MerginFile
 };
 
 
-//! Metadata read from project info reply or read from cached local .mergin.json file
+/**
+ * Metadata read from project info reply or read from cached local .mergin.json file.
+ *
+ * Files are indexed by their path, so that fileInfo() does not need to go through the whole list.
+ * Metadata read by fromCachedJson() are also stored in a binary sidecar file next to the JSON file,
+ * which is used instead of parsing the JSON again while the JSON file has not been modified.
+ */
 struct MerginProjectMetadata
 {
   QString name;
@@ -60,7 +69,31 @@ struct MerginProjectMetadata
 
   static MerginProjectMetadata fromCachedJson( const QString &metadataFilePath );
 
+  /**
+   * Returns metadata JSON \a data with entries of files \a filePaths taken from metadata \a oldData
+   * (files that are not in the old metadata are left out). Used when some files are not pulled,
+   * so that the next pull sees them as changed on the server again.
+   */
+  static QByteArray withFilesFrom( const QByteArray &data, const QByteArray &oldData, const QSet<QString> &filePaths );
+
+  //! Returns path of the binary sidecar cache of the given metadata file
+  static QString sidecarFilePath( const QString &metadataFilePath );
+
+  //! Returns file with the given path or an empty MerginFile if there is no such file
   MerginFile fileInfo( const QString &filePath ) const;
+
+  //! Returns whether there is a file with the given path
+  bool hasFile( const QString &filePath ) const;
+
+  private:
+    //! Returns index of the file in files (-1 if there is no such file)
+    int fileIndex( const QString &filePath ) const;
+    void rebuildIndex() const;
+
+    bool readSidecar( const QString &sidecarPath, qint64 jsonSize, qint64 jsonMtime );
+    bool writeSidecar( const QString &sidecarPath, qint64 jsonSize, qint64 jsonMtime ) const;
+
+    mutable QHash<QString, int> mFileIndex;  //!< path -> index in files
 };
 
 
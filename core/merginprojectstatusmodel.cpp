@@ -15,6 +15,7 @@ MerginProjectStatusModel::MerginProjectStatusModel( LocalProjectsManager &localP
   : QAbstractListModel( parent )
   , mLocalProjects( localProjects )
 {
+  mWorker.setMaxThreadCount( 1 );
 }
 
 int MerginProjectStatusModel::rowCount( const QModelIndex &parent ) const
@@ -58,7 +59,7 @@ QVariant MerginProjectStatusModel::data( const QModelIndex &index, int role ) co
 
 }
 
-void MerginProjectStatusModel::insertIntoItems( const QSet<QString> &files, const ProjectChangelogStatus &status, const QString &projectDir )
+void MerginProjectStatusModel::insertIntoItems( QList<ProjectStatusItem> &items, const QSet<QString> &files, const ProjectChangelogStatus &status, const QString &projectDir )
 {
   for ( QString file : files )
   {
@@ -68,19 +69,19 @@ void MerginProjectStatusModel::insertIntoItems( const QSet<QString> &files, cons
       item.status = status;
       item.text = file;
       item.section = tr( "Pending Changes" );
-      mItems.append( item );
+      items.append( item );
     }
   }
 }
 
-void MerginProjectStatusModel::infoProjectUpdated( const ProjectDiff &projectDiff, const QString &projectDir )
+QList<MerginProjectStatusModel::ProjectStatusItem> MerginProjectStatusModel::projectStatusItems( const QString &projectDir )
 {
-  beginResetModel();
-  mItems.clear();
+  QList<ProjectStatusItem> items;
+  ProjectDiff projectDiff = MerginApi::localProjectChanges( projectDir );
 
-  insertIntoItems( projectDiff.localUpdated, ProjectChangelogStatus::Updated, projectDir );
-  insertIntoItems( projectDiff.localAdded, ProjectChangelogStatus::Added, projectDir );
-  insertIntoItems( projectDiff.localDeleted, ProjectChangelogStatus::Deleted, projectDir );
+  insertIntoItems( items, projectDiff.localUpdated, ProjectChangelogStatus::Updated, projectDir );
+  insertIntoItems( items, projectDiff.localAdded, ProjectChangelogStatus::Added, projectDir );
+  insertIntoItems( items, projectDiff.localDeleted, ProjectChangelogStatus::Deleted, projectDir );
 
   for ( QString file : projectDiff.localUpdated )
   {
@@ -97,7 +98,7 @@ void MerginProjectStatusModel::infoProjectUpdated( const ProjectDiff &projectDif
         item.filename = file;
         item.section = file;
 
-        mItems.append( item );
+        items.append( item );
       }
       else
       {
@@ -114,28 +115,39 @@ void MerginProjectStatusModel::infoProjectUpdated( const ProjectDiff &projectDif
           item.deletes = summary[key].deletes;
           item.section = file;
 
-          mItems.append( item );
+          items.append( item );
         }
 
       }
     }
   }
-  endResetModel();
+  return items;
 }
 
-bool MerginProjectStatusModel::loadProjectInfo( const QString &projectFullName )
+void MerginProjectStatusModel::loadProjectInfo( const QString &projectFullName )
 {
+  int request = ++mLastRequest;
   LocalProject projectInfo = mLocalProjects.projectFromMerginName( projectFullName );
-  if ( !projectInfo.projectDir.isEmpty() )
+  if ( projectInfo.projectDir.isEmpty() )
   {
-    ProjectDiff diff = MerginApi::localProjectChanges( projectInfo.projectDir );
-    if ( diff.localAdded.isEmpty() && diff.localUpdated.isEmpty() && diff.localDeleted.isEmpty() )
-      return false;
-    else
-    {
-      infoProjectUpdated( diff, projectInfo.projectDir );
-      return true;
-    }
+    emit projectInfoLoaded( projectFullName, false );
+    return;
   }
-  return false;
+
+  // scanning may take a while (and wait for a sync of the project to finish its scan) - never in the GUI thread
+  QString projectDir = projectInfo.projectDir;
+  mWorker.run<QList<ProjectStatusItem>>( projectDir, [projectDir]
+  {
+    return projectStatusItems( projectDir );
+  },
+  [this, projectFullName, request]( const QList<ProjectStatusItem> &items )
+  {
+    if ( request != mLastRequest )
+      return;  // another project has been asked for in the meantime
+
+    beginResetModel();
+    mItems = items;
+    endResetModel();
+    emit projectInfoLoaded( projectFullName, !mItems.isEmpty() );
+  } );
 }
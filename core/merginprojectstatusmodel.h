@@ -13,6 +13,7 @@
 #include <QObject>
 #include <QAbstractListModel>
 #include "merginapi.h"
+#include "syncworker.h"
 
 class MerginProjectStatusModel : public QAbstractListModel
 {
@@ -59,16 +60,25 @@ class MerginProjectStatusModel : public QAbstractListModel
     QHash<int, QByteArray> roleNames() const override;
     Q_INVOKABLE QVariant data( const QModelIndex &index, int role ) const override;
 
-    Q_INVOKABLE bool loadProjectInfo( const QString &projectFullName );
+    /**
+     * Starts loading of local changes of the project. The project gets scanned in a background thread,
+     * the model is updated and projectInfoLoaded() is emitted when it is done.
+     */
+    Q_INVOKABLE void loadProjectInfo( const QString &projectFullName );
+
+  signals:
+    void projectInfoLoaded( const QString &projectFullName, bool hasChanges );
 
   private:
-    void insertIntoItems( const QSet<QString> &files, const ProjectChangelogStatus &status, const QString &projectDir );
-    void infoProjectUpdated( const ProjectDiff &projectDiff, const QString &projectDir );
+    //! Scans the project and returns items describing its local changes, it is run in the worker thread
+    static QList<ProjectStatusItem> projectStatusItems( const QString &projectDir );
+    static void insertIntoItems( QList<ProjectStatusItem> &items, const QSet<QString> &files, const ProjectChangelogStatus &status, const QString &projectDir );
 
-    ProjectDiff mProjectDiff;
     QList<ProjectStatusItem> mItems;
+    int mLastRequest = 0;  //!< results of older requests are discarded
 
     LocalProjectsManager &mLocalProjects;
+    SyncWorker mWorker;
 
 };
 
@@ -8,9 +8,13 @@
  ***************************************************************************/
 
 #include "project.h"
+#include "changejournal.h"
 #include "merginapi.h"
 #include "coreutils.h"
 
+#include <QMutex>
+#include <QMutexLocker>
+
 QString LocalProject::id() const
 {
   if ( !projectName.isEmpty() && !projectNamespace.isEmpty() )
@@ -51,7 +55,7 @@ MerginProject *MerginProject::clone() const
   return me;
 }
 
-ProjectStatus::Status ProjectStatus::projectStatus( const std::shared_ptr<Project> project )
+ProjectStatus::Status ProjectStatus::projectStatus( const std::shared_ptr<Project> project, bool modified )
 {
   if ( !project || !project->isMergin() || !project->isLocal() ) // This is not a Mergin project or not downloaded project
     return ProjectStatus::NoVersion;
@@ -63,28 +67,95 @@ ProjectStatus::Status ProjectStatus::projectStatus( const std::shared_ptr<Projec
   }
 
   // Something has locally changed after last sync with server
-  QString metadataFilePath = project->local->projectDir + "/" + MerginApi::sMetadataFile;
-  QDateTime lastModified = CoreUtils::getLastModifiedFileDateTime( project->local->projectDir );
+  if ( modified )
+    return ProjectStatus::Modified;
+
+  // Version is lower than latest one, last sync also before updated
+  if ( project->local->localVersion < project->mergin->serverVersion )
+  {
+    return ProjectStatus::OutOfDate;
+  }
+
+  return ProjectStatus::UpToDate;
+}
+
+bool ProjectStatus::hasLocalChanges( const QString &projectDir, int hashingThreads )
+{
+  QString metadataFilePath = projectDir + "/" + MerginApi::sMetadataFile;
   QDateTime lastSync = QFileInfo( metadataFilePath ).lastModified().toUTC();
-  MerginProjectMetadata meta = MerginProjectMetadata::fromCachedJson( metadataFilePath );
-  int filesCount = CoreUtils::getProjectFilesCount( project->local->projectDir );
-  if ( lastSync < lastModified || meta.files.count() != filesCount )
+  auto compareLocalFiles = [&projectDir, &metadataFilePath, hashingThreads]
   {
+    MerginProjectMetadata meta = MerginProjectMetadata::fromCachedJson( metadataFilePath );
+    QList<MerginFile> localFiles = MerginApi::getLocalProjectFiles( projectDir + "/", hashingThreads );
+    ProjectDiff diff = MerginApi::compareProjectFiles( meta.files, meta.files, localFiles, projectDir );
+    return !diff.localAdded.isEmpty() || !diff.localDeleted.isEmpty() || !diff.localUpdated.isEmpty();
+  };
+
+  // with an exact change journal the result of the last check stays valid until something changes in the project
+  // (other journals may miss modifications of contents, so they are not trusted)
+  struct JournaledStatus
+  {
+    ChangeJournal::Cursor cursor;
+    QDateTime lastSync;
+    bool modified = false;
+  };
+  static QMutex sJournaledStatusesMutex;  // checks run in the worker thread of ProjectStatusCache (or in tests) while unwatch handlers run in the GUI thread
+  static QHash<QString, JournaledStatus> sJournaledStatuses;
+  static const bool sUnwatchHandlerAdded = []
+  {
+    ChangeJournal::addUnwatchHandler( []( const QString & dir )
+    {
+      QMutexLocker locker( &sJournaledStatusesMutex );
+      sJournaledStatuses.remove( dir );
+    } );
+    return true;
+  }();
+  Q_UNUSED( sUnwatchHandlerAdded )
+
+  // changes of the project invalidate results kept by ProjectStatusCache even if they are not journaled exactly
+  std::shared_ptr<ChangeJournal> journal = ChangeJournal::find( projectDir );
+  if ( journal )
+    journal->startWatching();
+  if ( journal && !journal->isExact() )
+    journal.reset();
+
+  QString key = QDir::cleanPath( projectDir );
+  JournaledStatus status;
+  if ( journal )
+  {
+    QMutexLocker locker( &sJournaledStatusesMutex );
+    status = sJournaledStatuses.value( key );
+  }
+
+  bool modified = false;
+  QSet<QString> changedPaths;
+  if ( journal && journal->changesSince( status.cursor, changedPaths ) && status.lastSync == lastSync )
+  {
+    modified = changedPaths.isEmpty() ? status.modified : compareLocalFiles();
+  }
+  else
+  {
+    QDateTime lastModified = CoreUtils::getLastModifiedFileDateTime( projectDir );
+    int filesCount = CoreUtils::getProjectFilesCount( projectDir );
+    int serverFilesCount = MerginProjectMetadata::fromCachedJson( metadataFilePath ).files.count();
+
     // When GPKG is opened, its header is updated and therefore lastModified timestamp is updated as well.
     // Double check if there is really something to upload
-    QList<MerginFile> localFiles = MerginApi::getLocalProjectFiles( project->local->projectDir + "/" );
-    MerginProjectMetadata serverProject = MerginProjectMetadata::fromCachedJson( metadataFilePath );
-    ProjectDiff diff = MerginApi::compareProjectFiles( serverProject.files, serverProject.files, localFiles, project->local->projectDir );
-
-    if ( !diff.localAdded.isEmpty() || !diff.localDeleted.isEmpty() || !diff.localUpdated.isEmpty() )
-      return ProjectStatus::Modified;
+    modified = ( lastSync < lastModified || serverFilesCount != filesCount ) && compareLocalFiles();
   }
 
-  // Version is lower than latest one, last sync also before updated
-  if ( project->local->localVersion < project->mergin->serverVersion )
+  // the status of a project that has been unwatched in the meantime is not kept (its handler has run or waits for the mutex)
+  QMutexLocker locker( &sJournaledStatusesMutex );
+  if ( journal && ChangeJournal::find( key ) == journal )
   {
-    return ProjectStatus::OutOfDate;
+    status.lastSync = lastSync;
+    status.modified = modified;
+    sJournaledStatuses.insert( key, status );
+  }
+  else
+  {
+    sJournaledStatuses.remove( key );
   }
 
-  return ProjectStatus::UpToDate;
+  return modified;
 }
@@ -30,8 +30,15 @@ namespace ProjectStatus
   };
   Q_ENUM_NS( Status )
 
-  //! Returns project state from ProjectStatus::Status enum for the project
-  Status projectStatus( const std::shared_ptr<Project> project );
+  //! Returns project state from ProjectStatus::Status enum for the project whose local changes are known already (see hasLocalChanges())
+  Status projectStatus( const std::shared_ptr<Project> project, bool modified );
+
+  /**
+   * Returns whether the downloaded project in the given directory has local changes that need to be pushed.
+   * This may need to scan and hash files of the project (by up to \a hashingThreads threads, 0 means all cores)
+   * - it may be called from any thread (see ProjectStatusCache).
+   */
+  bool hasLocalChanges( const QString &projectDir, int hashingThreads = 0 );
 }
 
 /**
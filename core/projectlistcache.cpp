@@ -0,0 +1,247 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "projectlistcache.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include <algorithm>
+
+#include "coreutils.h"
+
+static const quint32 CACHE_MAGIC = 0x4d504c31;  // "MPL1"
+static const qint32 CACHE_VERSION = 1;
+
+ProjectListCache::ProjectListCache( const QString &filePath )
+  : mFilePath( filePath )
+{
+}
+
+QString ProjectListCache::key( const QString &username, const QString &url, const QByteArray &body )
+{
+  QCryptographicHash hash( QCryptographicHash::Sha1 );
+  hash.addData( username.toUtf8() );
+  hash.addData( "\n", 1 );
+  hash.addData( url.toUtf8() );
+  hash.addData( "\n", 1 );
+  hash.addData( body );
+  return QString::fromLatin1( hash.result().toHex() );
+}
+
+bool ProjectListCache::contains( const QString &key )
+{
+  load();
+  return mEntries.contains( key );
+}
+
+ProjectListCache::Entry ProjectListCache::entry( const QString &key )
+{
+  load();
+  return mEntries.value( key );
+}
+
+bool ProjectListCache::isFresh( const QString &key )
+{
+  load();
+  auto it = mEntries.constFind( key );
+  return it != mEntries.constEnd() && it->fetched > QDateTime::currentMSecsSinceEpoch() - PREFETCH_FRESH_MSECS;
+}
+
+bool ProjectListCache::isFreshPrefetch( const QString &key )
+{
+  return isFresh( key ) && mEntries.value( key ).prefetched;
+}
+
+void ProjectListCache::store( const QString &key, const Entry &entry )
+{
+  load();
+  mEntries.insert( key, entry );
+
+  if ( mEntries.count() > MAX_ENTRIES )
+  {
+    QList<QPair<qint64, QString>> ages;
+    for ( auto it = mEntries.constBegin(); it != mEntries.constEnd(); ++it )
+      ages << qMakePair( it->fetched, it.key() );
+    std::sort( ages.begin(), ages.end() );
+    for ( int i = 0; i < ages.count() - MAX_ENTRIES; ++i )
+      mEntries.remove( ages.at( i ).second );
+  }
+
+  save();
+}
+
+void ProjectListCache::touch( const QString &key, bool prefetched )
+{
+  load();
+  auto it = mEntries.find( key );
+  if ( it == mEntries.end() )
+    return;
+
+  it->fetched = QDateTime::currentMSecsSinceEpoch();
+  it->prefetched = prefetched;
+  save();
+}
+
+void ProjectListCache::markUsed( const QString &key )
+{
+  load();
+  auto it = mEntries.find( key );
+  if ( it == mEntries.end() || !it->prefetched )
+    return;
+
+  it->prefetched = false;
+  save();
+}
+
+void ProjectListCache::setParsedProjects( const QString &key, const MerginProjectsList &projects )
+{
+  auto it = mEntries.find( key );
+  if ( it == mEntries.end() )
+    return;
+
+  it->projects = projects;
+  it->parsed = true;
+}
+
+void ProjectListCache::remove( const QString &key )
+{
+  load();
+  if ( mEntries.remove( key ) )
+    save();
+}
+
+void ProjectListCache::invalidateProject( const QString &projectFullName )
+{
+  load();
+
+  QString projectNamespace = projectFullName.section( '/', 0, 0 );
+  QString projectName = projectFullName.section( '/', 1 );
+  QByteArray quotedName = "\"" + projectName.toUtf8() + "\"";
+
+  bool changed = false;
+  for ( auto it = mEntries.begin(); it != mEntries.end(); )
+  {
+    bool listed = false;
+    if ( it->parsed )
+    {
+      listed = std::any_of( it->projects.constBegin(), it->projects.constEnd(), [&]( const MerginProject & project )
+      {
+        return project.projectName == projectName && project.projectNamespace == projectNamespace;
+      } );
+    }
+    else
+    {
+      listed = it->data.contains( quotedName );  // may be a false positive - just a bit more to download
+    }
+
+    if ( listed )
+    {
+      it = mEntries.erase( it );
+      changed = true;
+    }
+    else
+      ++it;
+  }
+
+  if ( changed )
+    save();
+}
+
+void ProjectListCache::invalidateAll()
+{
+  load();
+  if ( mEntries.isEmpty() )
+    return;
+
+  mEntries.clear();
+  save();
+}
+
+void ProjectListCache::clear()
+{
+  mEntries.clear();
+  mLoaded = true;
+  if ( !mFilePath.isEmpty() )
+    QFile::remove( mFilePath );
+}
+
+void ProjectListCache::load()
+{
+  if ( mLoaded )
+    return;
+  mLoaded = true;
+
+  QFile f( mFilePath );
+  if ( mFilePath.isEmpty() || !f.open( QIODevice::ReadOnly ) )
+    return;
+
+  QDataStream stream( &f );
+  stream.setVersion( QDataStream::Qt_5_0 );
+
+  quint32 magic;
+  qint32 version;
+  stream >> magic >> version;
+  if ( magic != CACHE_MAGIC || version != CACHE_VERSION )
+  {
+    CoreUtils::log( "project list cache", QStringLiteral( "Ignoring cache with unknown format: " ) + f.fileName() );
+    return;
+  }
+
+  quint32 count;
+  stream >> count;
+  for ( quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i )
+  {
+    QString key;
+    Entry e;
+    stream >> key >> e.etag >> e.lastModified >> e.data >> e.fetched >> e.prefetched >> e.projectCount;
+    mEntries.insert( key, e );
+  }
+
+  if ( stream.status() != QDataStream::Ok )
+  {
+    CoreUtils::log( "project list cache", QStringLiteral( "Failed to read cache: " ) + f.fileName() );
+    mEntries.clear();
+  }
+}
+
+bool ProjectListCache::save()
+{
+  if ( mFilePath.isEmpty() )
+    return true;
+
+  QDir().mkpath( QFileInfo( mFilePath ).absolutePath() );
+
+  QSaveFile f( mFilePath );
+  if ( !f.open( QIODevice::WriteOnly ) )
+  {
+    CoreUtils::log( "project list cache", QStringLiteral( "Failed to open cache for writing: " ) + f.fileName() );
+    return false;
+  }
+
+  QDataStream stream( &f );
+  stream.setVersion( QDataStream::Qt_5_0 );
+  stream << CACHE_MAGIC << CACHE_VERSION << static_cast<quint32>( mEntries.count() );
+  for ( auto it = mEntries.constBegin(); it != mEntries.constEnd(); ++it )
+  {
+    stream << it.key() << it->etag << it->lastModified << it->data << it->fetched << it->prefetched << it->projectCount;
+  }
+
+  if ( !f.commit() )
+  {
+    CoreUtils::log( "project list cache", QStringLiteral( "Failed to write cache: " ) + f.fileName() );
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,105 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef PROJECTLISTCACHE_H
+#define PROJECTLISTCACHE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+#include "project.h"
+
+/**
+ * Persistent cache of responses of the project listing API (paginated list and list by names).
+ *
+ * Entries are keyed by the request (see key()) and keep the raw response together with its ETag
+ * and Last-Modified headers, so that the request can be revalidated with If-None-Match/If-Modified-Since
+ * and the server only needs to reply "304 Not Modified" when nothing has changed. Parsed projects
+ * are kept in memory, so a response is parsed only once.
+ *
+ * Entries of responses that were prefetched (e.g. the next page while the user scrolls) are used without
+ * revalidation, but only once and only while they are fresh.
+ */
+class ProjectListCache
+{
+  public:
+    struct Entry
+    {
+      QByteArray etag;
+      QByteArray lastModified;
+      QByteArray data;  //!< body of the response
+      qint64 fetched = 0;  //!< when the response was received or revalidated (msecs since epoch)
+      bool prefetched = false;  //!< received by a prefetch and not used yet
+      int projectCount = -1;  //!< total number of projects reported by the paginated API
+
+      // not stored on disk
+      bool parsed = false;
+      MerginProjectsList projects;
+    };
+
+    //! Prefetched entries older than this are revalidated like any other
+    static constexpr qint64 PREFETCH_FRESH_MSECS = 60 * 1000;
+
+    //! At most this many responses are kept, the least recently fetched go first
+    static constexpr int MAX_ENTRIES = 50;
+
+    //! Creates cache stored in the given file (it is loaded on first use)
+    explicit ProjectListCache( const QString &filePath = QString() );
+
+    //! Returns key of a request for the given user
+    static QString key( const QString &username, const QString &url, const QByteArray &body = QByteArray() );
+
+    bool contains( const QString &key );
+
+    //! Returns cached entry (default constructed if there is none)
+    Entry entry( const QString &key );
+
+    //! Returns whether the entry has been received or revalidated less than PREFETCH_FRESH_MSECS ago
+    bool isFresh( const QString &key );
+
+    //! Returns whether there is a prefetched entry that has not been used yet and it is still fresh
+    bool isFreshPrefetch( const QString &key );
+
+    //! Adds or replaces an entry and writes the cache to disk
+    void store( const QString &key, const Entry &entry );
+
+    //! Marks entry as revalidated by the server (304 response)
+    void touch( const QString &key, bool prefetched );
+
+    //! Marks prefetched entry as used - next time it gets revalidated
+    void markUsed( const QString &key );
+
+    //! Keeps projects parsed from the entry's data in memory
+    void setParsedProjects( const QString &key, const MerginProjectsList &projects );
+
+    void remove( const QString &key );
+
+    //! Removes entries that list the given project (e.g. its version has changed after sync)
+    void invalidateProject( const QString &projectFullName );
+
+    //! Removes all entries (e.g. a project was created - pages of the list are shifted)
+    void invalidateAll();
+
+    //! Removes all entries and the cache file
+    void clear();
+
+    QString filePath() const { return mFilePath; }
+
+  private:
+    void load();
+    bool save();
+
+    QString mFilePath;
+    bool mLoaded = false;
+    QHash<QString, Entry> mEntries;
+};
+
+#endif // PROJECTLISTCACHE_H
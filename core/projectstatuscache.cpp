@@ -0,0 +1,114 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "projectstatuscache.h"
+
+#include "changejournal.h"
+#include "project.h"
+
+ProjectStatusCache::ProjectStatusCache( QObject *parent )
+  : QObject( parent )
+{
+  mWorker.setMaxThreadCount( 1 );
+}
+
+bool ProjectStatusCache::hasLocalChanges( const QString &projectDir )
+{
+  auto it = mEntries.find( projectDir );
+  if ( it == mEntries.end() )
+  {
+    it = mEntries.insert( projectDir, Entry() );
+    it->generation = ++mLastGeneration;
+  }
+
+  if ( !it->known && !it->checkGeneration )
+    startCheck( projectDir );
+  return it->modified;
+}
+
+bool ProjectStatusCache::isKnown( const QString &projectDir ) const
+{
+  return mEntries.value( projectDir ).known;
+}
+
+bool ProjectStatusCache::isBusy() const
+{
+  for ( const Entry &entry : mEntries )
+  {
+    if ( entry.checkGeneration )
+      return true;
+  }
+  return false;
+}
+
+void ProjectStatusCache::remove( const QString &projectDir )
+{
+  // results of checks that are running get discarded
+  mEntries.remove( projectDir );
+}
+
+void ProjectStatusCache::clear()
+{
+  mEntries.clear();
+}
+
+void ProjectStatusCache::invalidate( const QString &projectDir )
+{
+  auto it = mEntries.find( projectDir );
+  if ( it == mEntries.end() )
+    return;
+
+  it->known = false;
+  it->generation = ++mLastGeneration;
+
+  // a running check is repeated once it finishes
+  if ( !it->checkGeneration )
+    startCheck( projectDir );
+}
+
+void ProjectStatusCache::startCheck( const QString &projectDir )
+{
+  Entry &entry = mEntries[projectDir];
+  entry.checkGeneration = entry.generation;
+
+  // journals get replaced when projects are reloaded
+  std::shared_ptr<ChangeJournal> journal = ChangeJournal::find( projectDir );
+  if ( journal )
+    connect( journal.get(), &ChangeJournal::changed, this, &ProjectStatusCache::invalidate, Qt::UniqueConnection );
+
+  int generation = entry.generation;
+  mWorker.run<bool>( projectDir, [projectDir]
+  {
+    return ProjectStatus::hasLocalChanges( projectDir, 1 );
+  },
+  [this, projectDir, generation]( const bool & modified )
+  {
+    checkFinished( projectDir, generation, modified );
+  } );
+}
+
+void ProjectStatusCache::checkFinished( const QString &projectDir, int generation, bool modified )
+{
+  auto it = mEntries.find( projectDir );
+  if ( it == mEntries.end() || it->checkGeneration != generation )
+    return;  // removed in the meantime
+
+  it->checkGeneration = 0;
+  if ( it->generation != generation )
+  {
+    startCheck( projectDir );
+    return;
+  }
+
+  bool changed = it->modified != modified;
+  it->modified = modified;
+  it->known = true;
+  if ( changed )
+    emit localChangesUpdated( projectDir, modified );
+}
@@ -0,0 +1,76 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef PROJECTSTATUSCACHE_H
+#define PROJECTSTATUSCACHE_H
+
+#include <QHash>
+#include <QObject>
+#include <QString>
+
+#include "syncworker.h"
+
+/**
+ * Keeps whether local projects have local changes (see ProjectStatus::hasLocalChanges()), so that statuses
+ * of projects can be shown without scanning projects in the GUI thread.
+ *
+ * Local changes of a project are checked in a background thread when they are asked for the first time
+ * or after they have been invalidated. Checks run one at a time and hash files in that thread only, so that
+ * they do not compete with syncs for the cores - a check and a sync never scan the same project at once
+ * (see MerginApi::getLocalProjectFiles()). Meanwhile the last known result is returned (no changes if there
+ * is none) and localChangesUpdated() is emitted when the check finds something different. Results are
+ * invalidated when the project's ChangeJournal reports changes of files and they should be invalidated
+ * whenever the project gets synced - projects that have been asked for are then checked again right away.
+ */
+class ProjectStatusCache : public QObject
+{
+    Q_OBJECT
+  public:
+    explicit ProjectStatusCache( QObject *parent = nullptr );
+
+    //! Returns the last known result for the project in the given directory, starts a check if it is not up to date
+    bool hasLocalChanges( const QString &projectDir );
+
+    //! Whether the result for the project is up to date
+    bool isKnown( const QString &projectDir ) const;
+
+    //! Whether some check is running or waiting to be run
+    bool isBusy() const;
+
+    //! Drops the result of the project that has been removed
+    void remove( const QString &projectDir );
+
+    //! Drops all results (e.g. the projects have been reloaded)
+    void clear();
+
+  public slots:
+    //! Marks the result for the project as outdated, it is checked again if it has been asked for already
+    void invalidate( const QString &projectDir );
+
+  signals:
+    void localChangesUpdated( const QString &projectDir, bool modified );
+
+  private:
+    struct Entry
+    {
+      bool modified = false;
+      bool known = false;
+      int generation = 0;  //!< changed by invalidation, results of checks started before are outdated
+      int checkGeneration = 0;  //!< generation of the running check (0 if there is none)
+    };
+
+    void startCheck( const QString &projectDir );
+    void checkFinished( const QString &projectDir, int generation, bool modified );
+
+    QHash<QString, Entry> mEntries;
+    int mLastGeneration = 0;  //!< generations are unique, so that checks of removed entries are not mistaken for new ones
+    SyncWorker mWorker;
+};
+
+#endif // PROJECTSTATUSCACHE_H
@@ -0,0 +1,61 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "ratelimiter.h"
+
+#include <cmath>
+
+void RateLimiter::setRate( qint64 bytesPerSecond )
+{
+  mRate = qMax( static_cast<qint64>( 0 ), bytesPerSecond );
+  mTokens = burstSize();
+  mLastRefill = -1;
+}
+
+qint64 RateLimiter::burstSize() const
+{
+  return qMax( MIN_BURST_SIZE, mRate * BURST_MSECS / 1000 );
+}
+
+qint64 RateLimiter::available( qint64 bytes, qint64 now )
+{
+  if ( !isLimited() )
+    return bytes;
+
+  refill( now );
+  return qBound( static_cast<qint64>( 0 ), static_cast<qint64>( mTokens ), bytes );
+}
+
+void RateLimiter::consume( qint64 bytes, qint64 now )
+{
+  if ( !isLimited() )
+    return;
+
+  refill( now );
+  mTokens -= bytes;
+}
+
+qint64 RateLimiter::delay( qint64 bytes, qint64 now )
+{
+  if ( !isLimited() )
+    return 0;
+
+  refill( now );
+  qreal missing = qMin( bytes, burstSize() ) - mTokens;
+  if ( missing <= 0 )
+    return 0;
+  return static_cast<qint64>( std::ceil( missing * 1000 / mRate ) );
+}
+
+void RateLimiter::refill( qint64 now )
+{
+  if ( mLastRefill >= 0 && now > mLastRefill )
+    mTokens = qMin( static_cast<qreal>( burstSize() ), mTokens + static_cast<qreal>( mRate ) * ( now - mLastRefill ) / 1000 );
+  mLastRefill = qMax( mLastRefill, now );
+}
@@ -0,0 +1,61 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef RATELIMITER_H
+#define RATELIMITER_H
+
+#include <QtGlobal>
+
+/**
+ * Token bucket that caps the throughput of transfers.
+ *
+ * The bucket gets filled with rate() bytes per second up to burstSize(). Data may be transferred
+ * while there are bytes in the bucket (see available()), transferred data are taken out by consume().
+ * The bucket may get into debt when more data have been transferred than there were tokens
+ * (e.g. a whole upload chunk is sent at once) - no more data may be transferred until the debt is paid.
+ *
+ * Times are timestamps in milliseconds (see AdaptiveChunkPolicy::timestamp()).
+ * With zero rate there is no limit.
+ */
+class RateLimiter
+{
+  public:
+    //! The bucket holds at most data for this time (so a pause in transfers is not followed by a long burst)
+    static constexpr qint64 BURST_MSECS = 500;
+    static constexpr qint64 MIN_BURST_SIZE = 16 * 1024;
+
+    //! Returns the limit in bytes per second (0 if not limited)
+    qint64 rate() const { return mRate; }
+
+    //! Sets the limit in bytes per second (0 to remove the limit), the bucket starts full
+    void setRate( qint64 bytesPerSecond );
+
+    bool isLimited() const { return mRate > 0; }
+
+    //! Returns the maximum number of bytes in the bucket
+    qint64 burstSize() const;
+
+    //! Returns how many of \a bytes may be transferred at time \a now
+    qint64 available( qint64 bytes, qint64 now );
+
+    //! Takes \a bytes transferred at time \a now out of the bucket (it may get into debt)
+    void consume( qint64 bytes, qint64 now );
+
+    //! Returns milliseconds from \a now until at least \a bytes (up to burstSize()) may be transferred
+    qint64 delay( qint64 bytes, qint64 now );
+
+  private:
+    void refill( qint64 now );
+
+    qint64 mRate = 0;
+    qreal mTokens = 0;
+    qint64 mLastRefill = -1;
+};
+
+#endif // RATELIMITER_H
@@ -0,0 +1,158 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "syncmetrics.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QVariantList>
+
+const QString SyncMetrics::ProjectInfo = QStringLiteral( "projectInfo" );
+const QString SyncMetrics::Scan = QStringLiteral( "scan" );
+const QString SyncMetrics::Compare = QStringLiteral( "compare" );
+const QString SyncMetrics::Download = QStringLiteral( "download" );
+const QString SyncMetrics::Upload = QStringLiteral( "upload" );
+const QString SyncMetrics::GeodiffApply = QStringLiteral( "geodiffApply" );
+const QString SyncMetrics::GeodiffRebase = QStringLiteral( "geodiffRebase" );
+const QString SyncMetrics::GeodiffChangeset = QStringLiteral( "geodiffChangeset" );
+const QString SyncMetrics::Finalize = QStringLiteral( "finalize" );
+const QString SyncMetrics::Metadata = QStringLiteral( "metadata" );
+
+SyncMetrics::Span::Span( SyncMetrics *metrics, const QString &phase, qint64 bytes )
+  : mMetrics( metrics )
+  , mPhase( phase )
+  , mBytes( bytes )
+{
+  mTimer.start();
+}
+
+SyncMetrics::Span::~Span()
+{
+  finish();
+}
+
+void SyncMetrics::Span::finish()
+{
+  if ( mMetrics )
+    mMetrics->addSpan( mPhase, mTimer.elapsed(), mBytes );
+  mMetrics = nullptr;
+}
+
+SyncMetrics::SyncMetrics( const QString &projectFullName, const QString &type )
+  : mProjectFullName( projectFullName )
+  , mType( type )
+  , mStarted( QDateTime::currentDateTimeUtc() )
+{
+  mTimer.start();
+}
+
+void SyncMetrics::addSpan( const QString &phase, qint64 durationMs, qint64 bytes )
+{
+  QMutexLocker locker( &mMutex );
+  Phase &p = mPhases[phase];
+  p.durationMs += durationMs;
+  p.bytes += bytes;
+  ++p.count;
+}
+
+void SyncMetrics::finish( bool successful )
+{
+  QMutexLocker locker( &mMutex );
+  mDurationMs = mTimer.elapsed();
+  mSuccessful = successful;
+}
+
+SyncMetrics::Phase SyncMetrics::phase( const QString &phase ) const
+{
+  QMutexLocker locker( &mMutex );
+  return mPhases.value( phase );
+}
+
+QJsonObject SyncMetrics::toJson() const
+{
+  QMutexLocker locker( &mMutex );
+
+  QJsonObject phases;
+  for ( auto it = mPhases.constBegin(); it != mPhases.constEnd(); ++it )
+  {
+    QJsonObject phase;
+    phase.insert( QStringLiteral( "durationMs" ), it->durationMs );
+    phase.insert( QStringLiteral( "bytes" ), it->bytes );
+    phase.insert( QStringLiteral( "count" ), it->count );
+    phases.insert( it.key(), phase );
+  }
+
+  QJsonObject obj;
+  obj.insert( QStringLiteral( "project" ), mProjectFullName );
+  obj.insert( QStringLiteral( "type" ), mType );
+  obj.insert( QStringLiteral( "started" ), mStarted.toString( Qt::ISODateWithMs ) );
+  obj.insert( QStringLiteral( "durationMs" ), mDurationMs );
+  obj.insert( QStringLiteral( "successful" ), mSuccessful );
+  obj.insert( QStringLiteral( "phases" ), phases );
+  return obj;
+}
+
+QVariantMap SyncMetrics::toVariantMap() const
+{
+  QMutexLocker locker( &mMutex );
+
+  QVariantList phases;
+  for ( auto it = mPhases.constBegin(); it != mPhases.constEnd(); ++it )
+  {
+    QVariantMap phase;
+    phase.insert( QStringLiteral( "name" ), it.key() );
+    phase.insert( QStringLiteral( "durationMs" ), it->durationMs );
+    phase.insert( QStringLiteral( "bytes" ), it->bytes );
+    phase.insert( QStringLiteral( "count" ), it->count );
+    phases << phase;
+  }
+
+  QVariantMap map;
+  map.insert( QStringLiteral( "project" ), mProjectFullName );
+  map.insert( QStringLiteral( "type" ), mType );
+  map.insert( QStringLiteral( "started" ), mStarted );
+  map.insert( QStringLiteral( "durationMs" ), mDurationMs );
+  map.insert( QStringLiteral( "successful" ), mSuccessful );
+  map.insert( QStringLiteral( "phases" ), phases );
+  return map;
+}
+
+bool SyncMetrics::appendToFile( const QString &filePath ) const
+{
+  QByteArray line = QJsonDocument( toJson() ).toJson( QJsonDocument::Compact ) + "\n";
+
+  QDir().mkpath( QFileInfo( filePath ).absolutePath() );
+  if ( QFileInfo( filePath ).size() + line.size() > MAX_FILE_SIZE )
+  {
+    // keep the newer half of the lines
+    QFile f( filePath );
+    if ( !f.open( QIODevice::ReadOnly ) )
+      return false;
+    QList<QByteArray> lines = f.readAll().split( '\n' );
+    f.close();
+    lines.removeAll( QByteArray() );
+
+    QSaveFile out( filePath );
+    if ( !out.open( QIODevice::WriteOnly ) )
+      return false;
+    for ( int i = lines.count() / 2; i < lines.count(); ++i )
+      out.write( lines.at( i ) + "\n" );
+    out.write( line );
+    return out.commit();
+  }
+
+  QFile f( filePath );
+  if ( !f.open( QIODevice::WriteOnly | QIODevice::Append ) )
+    return false;
+  return f.write( line ) == line.size();
+}
@@ -0,0 +1,112 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef SYNCMETRICS_H
+#define SYNCMETRICS_H
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QMap>
+#include <QMutex>
+#include <QString>
+#include <QVariantMap>
+
+/**
+ * Timing of phases of a single sync transaction (a pull or a push), e.g. how long it took to hash
+ * local files, to download items or to apply diffs, and how many bytes were processed by them.
+ *
+ * Each phase is made of spans - e.g. each downloaded item is a span of the "download" phase.
+ * Spans of a phase are summed up (their count is kept too). Spans may be recorded by the sync worker,
+ * so recording is thread safe.
+ *
+ * When the transaction is finished, the metrics are appended as a single JSON line to a file,
+ * which may be used to find out whether hashing, network or geodiff is the bottleneck on a device.
+ */
+class SyncMetrics
+{
+  public:
+    // names of phases
+    static const QString ProjectInfo;      //!< request of project info
+    static const QString Scan;             //!< listing and hashing of local files
+    static const QString Compare;          //!< comparison of local and server files
+    static const QString Download;         //!< download of items (files, ranges of files or diffs)
+    static const QString Upload;           //!< upload of chunks
+    static const QString GeodiffApply;     //!< application of diffs to diffable files and basefiles
+    static const QString GeodiffRebase;    //!< rebase of local changes of diffable files
+    static const QString GeodiffChangeset; //!< creation of diffs of local changes
+    static const QString Finalize;         //!< update tasks of a pull / finish request of a push
+    static const QString Metadata;         //!< write of project metadata
+
+    //! The metrics file is truncated (older half of lines removed) when it gets larger than this
+    static constexpr qint64 MAX_FILE_SIZE = 1024 * 1024;
+
+    struct Phase
+    {
+      qint64 durationMs = 0;
+      qint64 bytes = 0;
+      int count = 0;  //!< number of spans
+    };
+
+    /**
+     * Measures a span of a phase from its construction until finish() or its destruction.
+     * Nothing is recorded if metrics are null.
+     */
+    class Span
+    {
+      public:
+        Span( SyncMetrics *metrics, const QString &phase, qint64 bytes = 0 );
+        ~Span();
+
+        void setBytes( qint64 bytes ) { mBytes = bytes; }
+
+        //! Records the span (only the first call has any effect)
+        void finish();
+
+      private:
+        SyncMetrics *mMetrics = nullptr;
+        QString mPhase;
+        qint64 mBytes = 0;
+        QElapsedTimer mTimer;
+    };
+
+    //! Starts metrics of a transaction of the given type ("pull" or "push")
+    SyncMetrics( const QString &projectFullName, const QString &type );
+
+    //! Adds a span of a phase
+    void addSpan( const QString &phase, qint64 durationMs, qint64 bytes = 0 );
+
+    //! Returns milliseconds since the start of the transaction
+    qint64 elapsed() const { return mTimer.elapsed(); }
+
+    //! Marks the end of the transaction
+    void finish( bool successful );
+
+    Phase phase( const QString &phase ) const;
+
+    QJsonObject toJson() const;
+
+    //! Returns the metrics for QML: project, type, started, durationMs, successful and phases (list of maps with name, durationMs, bytes, count)
+    QVariantMap toVariantMap() const;
+
+    //! Appends the metrics as a single JSON line to the file
+    bool appendToFile( const QString &filePath ) const;
+
+  private:
+    mutable QMutex mMutex;
+    QString mProjectFullName;
+    QString mType;
+    QDateTime mStarted;
+    QElapsedTimer mTimer;
+    qint64 mDurationMs = -1;
+    bool mSuccessful = false;
+    QMap<QString, Phase> mPhases;
+};
+
+#endif // SYNCMETRICS_H
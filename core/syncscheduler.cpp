@@ -0,0 +1,142 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "syncscheduler.h"
+
+#include "coreutils.h"
+
+SyncScheduler::SyncScheduler( QObject *parent )
+  : QObject( parent )
+{
+}
+
+bool SyncScheduler::requestSync( const Request &request )
+{
+  if ( mActive.contains( request.projectFullName ) )
+  {
+    CoreUtils::log( "sync " + request.projectFullName, QStringLiteral( "Sync is already in progress - ignoring the request" ) );
+    return false;
+  }
+
+  for ( Request &queued : mQueue )
+  {
+    if ( queued.projectFullName != request.projectFullName )
+      continue;
+
+    // an upload pulls server changes first, so it does the work of a waiting update as well
+    if ( request.type == Upload && queued.type == Update )
+    {
+      CoreUtils::log( "sync " + request.projectFullName, QStringLiteral( "Waiting update changed to upload" ) );
+      queued = request;
+      emit queueChanged( request.projectFullName );
+    }
+    else
+    {
+      CoreUtils::log( "sync " + request.projectFullName, QStringLiteral( "Sync is already waiting - ignoring the request" ) );
+    }
+    return false;
+  }
+
+  if ( request.projectFullName == mPriorityProject )
+    mQueue.prepend( request );
+  else
+    mQueue.append( request );
+
+  if ( mActive.count() >= mMaxActiveSyncs )
+  {
+    CoreUtils::log( "sync " + request.projectFullName, QStringLiteral( "Waiting for other syncs to finish (%1 in progress, %2 waiting)" )
+                    .arg( mActive.count() ).arg( mQueue.count() ) );
+  }
+
+  emit queueChanged( request.projectFullName );
+  startNext();
+  return true;
+}
+
+void SyncScheduler::syncFinished( const QString &projectFullName )
+{
+  if ( !mActive.remove( projectFullName ) )
+    return;
+
+  startNext();
+}
+
+bool SyncScheduler::removeQueued( const QString &projectFullName )
+{
+  for ( int i = 0; i < mQueue.count(); ++i )
+  {
+    if ( mQueue.at( i ).projectFullName == projectFullName )
+    {
+      mQueue.removeAt( i );
+      emit queueChanged( projectFullName );
+      return true;
+    }
+  }
+  return false;
+}
+
+bool SyncScheduler::isQueued( const QString &projectFullName ) const
+{
+  for ( const Request &request : mQueue )
+  {
+    if ( request.projectFullName == projectFullName )
+      return true;
+  }
+  return false;
+}
+
+bool SyncScheduler::isActive( const QString &projectFullName ) const
+{
+  return mActive.contains( projectFullName );
+}
+
+QStringList SyncScheduler::queuedProjects() const
+{
+  QStringList projects;
+  for ( const Request &request : mQueue )
+    projects << request.projectFullName;
+  return projects;
+}
+
+void SyncScheduler::setPriorityProject( const QString &projectFullName )
+{
+  mPriorityProject = projectFullName;
+
+  // move the project to the front if it is waiting already
+  for ( int i = 1; i < mQueue.count(); ++i )
+  {
+    if ( mQueue.at( i ).projectFullName == projectFullName )
+    {
+      mQueue.move( i, 0 );
+      break;
+    }
+  }
+}
+
+void SyncScheduler::setMaxActiveSyncs( int maxActiveSyncs )
+{
+  mMaxActiveSyncs = qMax( 1, maxActiveSyncs );
+  startNext();
+}
+
+void SyncScheduler::setMaxRequestsInFlight( int maxRequestsInFlight )
+{
+  mMaxRequestsInFlight = qMax( 1, maxRequestsInFlight );
+}
+
+void SyncScheduler::startNext()
+{
+  while ( !mQueue.isEmpty() && mActive.count() < mMaxActiveSyncs )
+  {
+    Request request = mQueue.takeFirst();
+    mActive.insert( request.projectFullName );
+    emit queueChanged( request.projectFullName );
+    emit startSyncRequested( request );
+  }
+}
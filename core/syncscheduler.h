@@ -0,0 +1,97 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef SYNCSCHEDULER_H
+#define SYNCSCHEDULER_H
+
+#include <QList>
+#include <QObject>
+#include <QSet>
+#include <QString>
+
+/**
+ * Decides when requested syncs (update or upload) of projects may start, so that syncing
+ * of many projects at once does not make them all compete for bandwidth and disk.
+ *
+ * At most maxActiveSyncs() projects are synced at the same time, further requests wait in a queue.
+ * The priority project (the one that is currently opened) always gets to the front of the queue,
+ * otherwise the requests are started in the order they came.
+ *
+ * The scheduler also holds the limit of network requests of all syncs in progress - it is up to
+ * the transactions to respect it and to wake each other when a request finishes (see MerginApi::canStartRequest()).
+ */
+class SyncScheduler : public QObject
+{
+    Q_OBJECT
+  public:
+    enum SyncType
+    {
+      Update,
+      Upload
+    };
+
+    struct Request
+    {
+      QString projectFullName;
+      SyncType type = Update;
+      bool withoutAuth = false;      //!< only for update
+      bool isInitialUpload = false;  //!< only for upload
+    };
+
+    explicit SyncScheduler( QObject *parent = nullptr );
+
+    /**
+     * Queues sync of a project. If there is a free slot, startSyncRequested() gets emitted right away.
+     * Requests for projects that are being synced or already waiting are not queued again (returns false) -
+     * an upload request turns a waiting update of the project into an upload, other requests are ignored.
+     */
+    bool requestSync( const Request &request );
+
+    //! Frees the slot of a project whose sync has finished and starts the next queued sync (if any)
+    void syncFinished( const QString &projectFullName );
+
+    //! Removes a waiting request of the project. Returns false if the project was not in the queue.
+    bool removeQueued( const QString &projectFullName );
+
+    bool isQueued( const QString &projectFullName ) const;
+    bool isActive( const QString &projectFullName ) const;
+
+    //! Returns full names of projects waiting for sync in the order they will be started
+    QStringList queuedProjects() const;
+
+    //! Project that should be synced before others (e.g. the currently opened one), empty if none
+    QString priorityProject() const { return mPriorityProject; }
+    void setPriorityProject( const QString &projectFullName );
+
+    int maxActiveSyncs() const { return mMaxActiveSyncs; }
+    void setMaxActiveSyncs( int maxActiveSyncs );
+
+    //! Maximum number of network requests (chunks, download items) of all syncs in progress together
+    int maxRequestsInFlight() const { return mMaxRequestsInFlight; }
+    void setMaxRequestsInFlight( int maxRequestsInFlight );
+
+  signals:
+    //! Emitted when a sync should be started - the receiver is expected to call syncFinished() when it is done
+    void startSyncRequested( const SyncScheduler::Request &request );
+
+    //! Emitted when a project has been added to or removed from the queue
+    void queueChanged( const QString &projectFullName );
+
+  private:
+    //! Starts queued syncs while there are free slots
+    void startNext();
+
+    QList<Request> mQueue;
+    QSet<QString> mActive;
+    QString mPriorityProject;
+    int mMaxActiveSyncs = 3;
+    int mMaxRequestsInFlight = 8;
+};
+
+#endif // SYNCSCHEDULER_H
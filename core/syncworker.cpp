@@ -0,0 +1,91 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "syncworker.h"
+
+#include <QRunnable>
+#include <QThread>
+
+class SyncWorkerJob : public QRunnable
+{
+  public:
+    explicit SyncWorkerJob( std::function<void()> job )
+      : mJob( std::move( job ) )
+    {
+    }
+
+    void run() override
+    {
+      mJob();
+    }
+
+  private:
+    std::function<void()> mJob;
+};
+
+
+SyncWorker::SyncWorker( QObject *parent )
+  : QObject( parent )
+{
+  // the work is mostly disk bound - there is not much to gain from many threads
+  mPool.setMaxThreadCount( qBound( 1, QThread::idealThreadCount(), 4 ) );
+}
+
+SyncWorker::~SyncWorker()
+{
+  // results of jobs that are still running get discarded together with this object
+  mPool.waitForDone();
+}
+
+bool SyncWorker::isBusy( const QString &key ) const
+{
+  return mRunning.contains( key );
+}
+
+void SyncWorker::setMaxThreadCount( int maxThreadCount )
+{
+  mPool.setMaxThreadCount( qMax( 1, maxThreadCount ) );
+}
+
+int SyncWorker::maxThreadCount() const
+{
+  return mPool.maxThreadCount();
+}
+
+void SyncWorker::waitForDone()
+{
+  mPool.waitForDone();
+}
+
+void SyncWorker::enqueue( const QString &key, std::function<void()> job )
+{
+  mQueues[key].enqueue( std::move( job ) );
+  if ( !mRunning.contains( key ) )
+    startNext( key );
+}
+
+void SyncWorker::startNext( const QString &key )
+{
+  auto it = mQueues.find( key );
+  if ( it == mQueues.end() || it->isEmpty() )
+  {
+    mQueues.remove( key );
+    mRunning.remove( key );
+    return;
+  }
+
+  mRunning.insert( key );
+  mPool.start( new SyncWorkerJob( it->dequeue() ) );
+}
+
+void SyncWorker::jobFinished( const QString &key )
+{
+  mRunning.remove( key );
+  startNext( key );
+}
@@ -0,0 +1,84 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef SYNCWORKER_H
+#define SYNCWORKER_H
+
+#include <QHash>
+#include <QObject>
+#include <QQueue>
+#include <QSet>
+#include <QString>
+#include <QThreadPool>
+
+#include <functional>
+
+/**
+ * Runs CPU and disk heavy parts of project synchronization (hashing of local files, creating and applying
+ * diffs, moving downloaded files in place) in a thread pool, so that the GUI thread does not get blocked.
+ *
+ * Tasks are submitted with a key (full name of the project). Tasks with the same key never run in parallel,
+ * they are run one after another in the order they were submitted, while tasks of different projects may run
+ * at the same time. The result of a task is passed to a callback that is called in the thread of this object
+ * (the GUI thread), so the callback may safely access state of MerginApi.
+ *
+ * Tasks must not touch any state shared with the GUI thread - they should only work with data captured by value.
+ */
+class SyncWorker : public QObject
+{
+    Q_OBJECT
+  public:
+    explicit SyncWorker( QObject *parent = nullptr );
+    ~SyncWorker() override;
+
+    /**
+     * Queues a task to be run in a worker thread. When it is done, \a onFinished gets called
+     * with the task's result through the event loop of this object's thread.
+     */
+    template <typename T>
+    void run( const QString &key, std::function<T()> task, std::function<void( const T & )> onFinished );
+
+    //! Whether a task with the given key is running or waiting to be run
+    bool isBusy( const QString &key ) const;
+
+    //! Sets the maximum number of tasks (of different keys) running at the same time
+    void setMaxThreadCount( int maxThreadCount );
+    int maxThreadCount() const;
+
+    //! Blocks until all started tasks are finished (callbacks are still delivered through the event loop)
+    void waitForDone();
+
+  private:
+    void enqueue( const QString &key, std::function<void()> job );
+    void startNext( const QString &key );
+    void jobFinished( const QString &key );
+
+    QThreadPool mPool;
+    QHash<QString, QQueue<std::function<void()>>> mQueues;  //!< jobs waiting for the previous job of the same key
+    QSet<QString> mRunning;  //!< keys with a job in progress
+};
+
+template <typename T>
+void SyncWorker::run( const QString &key, std::function<T()> task, std::function<void( const T & )> onFinished )
+{
+  enqueue( key, [this, key, task, onFinished]
+  {
+    // in a worker thread
+    T result = task();
+
+    QMetaObject::invokeMethod( this, [this, key, result, onFinished]
+    {
+      // back in the thread of the worker object
+      jobFinished( key );
+      onFinished( result );
+    }, Qt::QueuedConnection );
+  } );
+}
+
+#endif // SYNCWORKER_H
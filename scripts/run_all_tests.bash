@@ -21,6 +21,9 @@ NFAILURES=$(($NFAILURES+$?))
 $INPUT_EXECUTABLE --testMerginApi
 NFAILURES=$(($NFAILURES+$?))
 
+$INPUT_EXECUTABLE --testMerginApiMock
+NFAILURES=$(($NFAILURES+$?))
+
 $INPUT_EXECUTABLE --testPurchasing
 NFAILURES=$(($NFAILURES+$?))
 